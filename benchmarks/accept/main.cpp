@@ -0,0 +1,355 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <string>
+
+#include <clipp.h>
+
+#include <packeteer.h>
+#include <packeteer/error.h>
+#include <packeteer/connector.h>
+#include <packeteer/scheduler.h>
+
+using namespace packeteer;
+
+#define VERBOSE_LOG(opts, msg) \
+  if (opts.verbose) { \
+    std::cout << msg << std::endl; \
+  }
+
+
+namespace {
+
+// Connections that may await accept() at any time; see perform_run().
+constexpr size_t MAX_PENDING = 64;
+
+struct options
+{
+  size_t      connections = 2000;
+  size_t      clients = 4;
+  size_t      batch = 64;
+  uint16_t    port = 2000;
+  size_t      runs = 5;
+  bool        verbose = false;
+  std::string output_file;
+};
+
+
+
+options parse_cli(int argc, char **argv)
+{
+  using namespace clipp;
+
+  bool help = false;
+  options opts;
+
+  auto cli = (
+      option("-n", "--connections")
+        .doc("The number of connections to establish per run.")
+        & value("connections", opts.connections),
+      option("-c", "--clients")
+        .doc("The number of client threads establishing connections.")
+        & value("clients", opts.clients),
+      option("-b", "--batch")
+        .doc("The maximum number of connections accept_many() accepts at "
+          "once.")
+        & value("batch", opts.batch),
+
+      option("-p", "--port")
+        .doc("The port to use.")
+        & value("port", opts.port),
+
+      option("-r", "--runs")
+        .doc("Number of test runs to perform.")
+        & value("runs", opts.runs),
+
+      option("-o", "--output")
+        .doc("Output file (CSV) for test results.")
+        & value("output_file", opts.output_file),
+
+      option("-v", "--verbose")
+        .set(opts.verbose)
+        .doc("Be verbose."),
+
+      option("--help", "-?")
+        .set(help)
+        .doc("Display this help.")
+  );
+
+  if (!parse(argc, argv, cli) || help || !opts.connections || !opts.clients
+      || !opts.batch)
+  {
+    auto fmt = doc_formatting{}
+        .first_column(3)
+        .last_column(79);
+    std::cerr << make_man_page(cli, argv[0], fmt);
+    exit(1);
+  }
+
+  if (opts.verbose) {
+    std::cout << "Summary of options:" << std::endl;
+    std::cout << "  Connections per run:  " << opts.connections << std::endl;
+    std::cout << "  Client threads:       " << opts.clients << std::endl;
+    std::cout << "  Batch size:           " << opts.batch << std::endl;
+    std::cout << "  Port:                 " << opts.port << std::endl;
+    std::cout << "  Test runs:            " << opts.runs << std::endl;
+    std::cout << "  Output file:          " << opts.output_file << std::endl;
+  }
+
+  return opts;
+}
+
+
+
+struct run_result
+{
+  size_t  accepted = 0;
+  size_t  usec = 0;
+  size_t  wakeups = 0;
+
+  double accepts_per_sec() const
+  {
+    if (!usec) {
+      return 0;
+    }
+    return double(accepted) * 1000000 / usec;
+  }
+
+  double accepts_per_wakeup() const
+  {
+    if (!wakeups) {
+      return 0;
+    }
+    return double(accepted) / wakeups;
+  }
+};
+
+
+
+run_result
+perform_run(options const & opts, bool batched, std::shared_ptr<api> api,
+    std::string const & url, connector & server)
+{
+  run_result result;
+  std::atomic<size_t> accepted{0};
+  std::atomic<packeteer::error_t> failure{ERR_SUCCESS};
+
+  // The server accepts either a single connection per callback, or drains
+  // the backlog with accept_many().
+  std::thread listener([&]()
+  {
+    scheduler sched{api, 0};
+    std::vector<connector> batch;
+    batch.reserve(opts.batch);
+    auto cb = [&](time_point const &, events_t, connector * conn)
+      -> packeteer::error_t
+    {
+      ++result.wakeups;
+      if (batched) {
+        batch.clear();
+        if (ERR_SUCCESS == conn->accept_many(batch, opts.batch)) {
+          accepted += batch.size();
+        }
+      }
+      else {
+        auto conn_accepted = conn->accept();
+        if (conn_accepted.communicating()) {
+          ++accepted;
+        }
+      }
+      return ERR_SUCCESS;
+    };
+    sched.register_connector(PEV_IO_READ, server, cb);
+    while (accepted < opts.connections && ERR_SUCCESS == failure) {
+      sched.process_events(std::chrono::milliseconds(1));
+    }
+    sched.unregister_connector(PEV_IO_READ, server, cb);
+  });
+
+  auto start_ts = std::chrono::steady_clock::now();
+
+  // Clients keep their connections open until the run ends; closing them
+  // early would reset connections that are still waiting to be accepted.
+  // They also keep the number of connections not yet accepted below the
+  // listen backlog, as the kernel drops excess SYNs and clients would
+  // otherwise measure retransmission timeouts.
+  std::atomic<size_t> issued{0};
+  std::vector<std::vector<connector>> connections(opts.clients);
+  std::vector<std::thread> clients;
+  for (size_t c = 0 ; c < opts.clients ; ++c) {
+    clients.emplace_back([&, c]()
+    {
+      size_t amount = opts.connections / opts.clients
+        + (c < opts.connections % opts.clients ? 1 : 0);
+      for (size_t i = 0 ; i < amount ; ++i) {
+        while (issued - accepted >= MAX_PENDING && ERR_SUCCESS == failure) {
+          std::this_thread::yield();
+        }
+        ++issued;
+
+        connector client{api, url};
+        auto err = client.connect();
+        if (ERR_SUCCESS != err && ERR_ASYNC != err) {
+          failure = err;
+          return;
+        }
+        connections[c].push_back(client);
+      }
+    });
+  }
+
+  for (auto & client : clients) {
+    client.join();
+  }
+  listener.join();
+
+  auto end_ts = std::chrono::steady_clock::now();
+
+  if (ERR_SUCCESS != failure) {
+    throw exception(failure, "Could not connect.");
+  }
+
+  auto diff = end_ts - start_ts;
+  result.usec = std::chrono::duration_cast<std::chrono::microseconds>(
+      diff).count();
+  result.accepted = accepted;
+  return result;
+}
+
+
+
+void output_console(std::string const & mode, size_t run,
+    run_result const & result)
+{
+  std::cout << "Run " << run << " (" << mode << ") completed in "
+    << result.usec << " usec." << std::endl;
+  std::cout << "  Accepted:        " << result.accepted << std::endl;
+  std::cout << "  Accepts/sec:     " << size_t(result.accepts_per_sec())
+    << std::endl;
+  std::cout << "  Accepts/wakeup:  " << result.accepts_per_wakeup()
+    << std::endl;
+}
+
+
+
+void output_csv(options const & opts, std::string const & mode, size_t run,
+    run_result const & result, std::ofstream & file)
+{
+  file << mode << ",";
+  file << opts.connections << ",";
+  file << opts.clients << ",";
+  file << opts.batch << ",";
+  file << opts.runs << ",";
+
+  file << run << ",";
+  file << result.usec << ",";
+  file << size_t(result.accepts_per_sec()) << ",";
+  file << result.wakeups << ",";
+
+  file << "\n";
+}
+
+
+
+void output_csv_header(std::ofstream & file)
+{
+  file << "Mode,";
+  file << "Connections per Run,";
+  file << "Client Threads,";
+  file << "Batch Size,";
+  file << "Total Runs,";
+
+  file << "Run,";
+  file << "Time (usec),";
+  file << "Accepts/sec,";
+  file << "Wakeups,";
+
+  file << "\n";
+}
+
+
+} // anonymous namespace
+
+
+
+int main(int argc, char **argv)
+{
+  try {
+    auto opts = parse_cli(argc, argv);
+
+    auto api = api::create();
+
+    std::ofstream output_file;
+    if (!opts.output_file.empty()) {
+      output_file.open(opts.output_file);
+      output_csv_header(output_file);
+    }
+
+    std::string url = "tcp4://127.0.0.1:" + std::to_string(opts.port);
+
+    for (bool batched : { false, true }) {
+      std::string mode = batched ? "accept_many" : "accept";
+
+      connector server{api, url};
+      auto err = server.listen();
+      if (err != ERR_SUCCESS) {
+        throw exception(err, "Could not listen.");
+      }
+
+      double total_rate = 0;
+      for (size_t run = 0 ; run < opts.runs ; ++run) {
+        VERBOSE_LOG(opts, "=== Start of test run: " << run << " ("
+            << mode << ")");
+
+        auto result = perform_run(opts, batched, api, url, server);
+        total_rate += result.accepts_per_sec();
+
+        output_console(mode, run, result);
+        if (output_file.is_open()) {
+          output_csv(opts, mode, run, result, output_file);
+        }
+
+        VERBOSE_LOG(opts, "=== End of test run: " << run);
+      }
+
+      std::cout << "Average (" << mode << "): "
+        << size_t(total_rate / opts.runs) << " accepts/sec." << std::endl;
+    }
+
+    if (output_file.is_open()) {
+      output_file.close();
+    }
+    return 0;
+  } catch (packeteer::exception const & ex) {
+    std::cerr << ex.what() << std::endl;
+    return -3;
+  } catch (std::exception const & ex) {
+    std::cerr << ex.what() << std::endl;
+    return -4;
+  } catch (...) {
+    std::cerr << "Unknown exception caught, aborting." << std::endl;
+    return -5;
+  }
+}
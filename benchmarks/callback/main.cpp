@@ -0,0 +1,261 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <iostream>
+#include <chrono>
+#include <array>
+#include <vector>
+#include <string>
+
+#include <clipp.h>
+
+#include <packeteer/error.h>
+#include <packeteer/scheduler/callback.h>
+
+using namespace packeteer;
+
+#define VERBOSE_LOG(opts, msg) \
+  if (opts.verbose) { \
+    std::cout << msg << std::endl; \
+  }
+
+
+namespace {
+
+struct options
+{
+  size_t      iterations = 10000000;
+  size_t      runs = 5;
+  bool        verbose = false;
+};
+
+
+
+options parse_cli(int argc, char **argv)
+{
+  using namespace clipp;
+
+  bool help = false;
+  options opts;
+
+  auto cli = (
+      option("-n", "--iterations")
+        .doc("The number of operations per run.")
+        & value("iterations", opts.iterations),
+
+      option("-r", "--runs")
+        .doc("Number of test runs to perform.")
+        & value("runs", opts.runs),
+
+      option("-v", "--verbose")
+        .set(opts.verbose)
+        .doc("Be verbose."),
+
+      option("--help", "-?")
+        .set(help)
+        .doc("Display this help.")
+  );
+
+  if (!parse(argc, argv, cli) || help || !opts.iterations || !opts.runs) {
+    auto fmt = doc_formatting{}
+        .first_column(3)
+        .last_column(79);
+    std::cerr << make_man_page(cli, argv[0], fmt);
+    exit(1);
+  }
+
+  if (opts.verbose) {
+    std::cout << "Summary of options:" << std::endl;
+    std::cout << "  Operations per run:   " << opts.iterations << std::endl;
+    std::cout << "  Test runs:            " << opts.runs << std::endl;
+  }
+
+  return opts;
+}
+
+
+
+/**
+ * The kinds of callbacks the scheduler typically holds.
+ **/
+packeteer::error_t
+free_function(time_point const &, events_t events, connector *)
+{
+  return packeteer::error_t(events);
+}
+
+
+struct handler
+{
+  size_t m_count = 0;
+
+  packeteer::error_t
+  member_function(time_point const &, events_t events, connector *)
+  {
+    m_count += events;
+    return ERR_SUCCESS;
+  }
+};
+
+
+
+std::vector<std::pair<std::string, callback>>
+make_callbacks(handler & h)
+{
+  std::vector<std::pair<std::string, callback>> result;
+
+  result.push_back({"free function", callback{&free_function}});
+  result.push_back({"member function",
+      callback{&h, &handler::member_function}});
+
+  // Captures a pointer and a counter; fits the inline storage.
+  size_t count = 0;
+  result.push_back({"small lambda", callback{
+      [&h, count](time_point const &, events_t events, connector *) mutable
+      {
+        count += events;
+        h.m_count += count;
+        return ERR_SUCCESS;
+      }
+  }});
+
+  // Captures more than fits the inline storage.
+  std::array<size_t, 16> counts{};
+  result.push_back({"large lambda", callback{
+      [&h, counts](time_point const &, events_t events, connector *) mutable
+      {
+        counts[events % counts.size()] += events;
+        h.m_count += counts[0];
+        return ERR_SUCCESS;
+      }
+  }});
+
+  return result;
+}
+
+
+
+/**
+ * Operations; each returns a value derived from the work done so the
+ * compiler cannot elide it.
+ **/
+size_t
+bench_copy(options const & opts, callback const & cb)
+{
+  size_t result = 0;
+  callback copy;
+  for (size_t i = 0 ; i < opts.iterations ; ++i) {
+    copy = cb;
+    result += !copy.empty();
+  }
+  return result;
+}
+
+
+
+size_t
+bench_invoke(options const & opts, callback const & cb)
+{
+  size_t result = 0;
+  callback copy = cb;
+  auto now = clock::now();
+  for (size_t i = 0 ; i < opts.iterations ; ++i) {
+    result += copy(now, events_t(i & 0xff), nullptr);
+  }
+  return result;
+}
+
+
+
+size_t
+bench_hash(options const & opts, callback const & cb)
+{
+  size_t result = 0;
+  std::hash<callback> hasher;
+  for (size_t i = 0 ; i < opts.iterations ; ++i) {
+    result ^= hasher(cb);
+  }
+  return result;
+}
+
+
+
+using bench_function = size_t (*)(options const &, callback const &);
+
+struct operation
+{
+  char const *    name;
+  bench_function  func;
+};
+
+operation const operations[] = {
+  { "copy", &bench_copy },
+  { "invoke", &bench_invoke },
+  { "hash", &bench_hash },
+};
+
+
+} // anonymous namespace
+
+
+
+int main(int argc, char **argv)
+{
+  try {
+    auto opts = parse_cli(argc, argv);
+
+    handler h;
+    auto callbacks = make_callbacks(h);
+    volatile size_t sink = 0;
+
+    for (auto const & op : operations) {
+      for (auto const & [name, cb] : callbacks) {
+        double total_ns = 0;
+        for (size_t run = 0 ; run < opts.runs ; ++run) {
+          VERBOSE_LOG(opts, "=== Start of test run: " << run << " ("
+              << op.name << ", " << name << ")");
+
+          auto start_ts = std::chrono::steady_clock::now();
+          sink = sink + op.func(opts, cb);
+          auto end_ts = std::chrono::steady_clock::now();
+
+          auto nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(
+              end_ts - start_ts).count();
+          total_ns += double(nsec) / opts.iterations;
+
+          VERBOSE_LOG(opts, "=== End of test run: " << run);
+        }
+
+        std::cout << "Average (" << op.name << ", " << name << "): "
+          << (total_ns / opts.runs) << " nsec/op." << std::endl;
+      }
+    }
+
+    return 0;
+  } catch (packeteer::exception const & ex) {
+    std::cerr << ex.what() << std::endl;
+    return -3;
+  } catch (std::exception const & ex) {
+    std::cerr << ex.what() << std::endl;
+    return -4;
+  } catch (...) {
+    std::cerr << "Unknown exception caught, aborting." << std::endl;
+    return -5;
+  }
+}
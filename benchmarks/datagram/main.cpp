@@ -0,0 +1,483 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <vector>
+#include <string>
+
+#include <clipp.h>
+
+#include <liberate/net/url.h>
+#include <liberate/net/socket_address.h>
+
+#include <packeteer.h>
+#include <packeteer/error.h>
+#include <packeteer/connector.h>
+
+using namespace packeteer;
+
+#define VERBOSE_LOG(opts, msg) \
+  if (opts.verbose) { \
+    std::cout << msg << std::endl; \
+  }
+
+
+namespace {
+
+struct options
+{
+  size_t      packets = 1000000;
+  size_t      size = 64;
+  size_t      batch = 32;
+  uint16_t    port_range_start = 2000;
+  size_t      runs = 5;
+  bool        verbose = false;
+  std::string output_file;
+};
+
+
+
+options parse_cli(int argc, char **argv)
+{
+  using namespace clipp;
+
+  bool help = false;
+  options opts;
+
+  auto cli = (
+      option("-n", "--packets")
+        .doc("The number of packets to send and receive per run.")
+        & value("packets", opts.packets),
+      option("-s", "--size")
+        .doc("The size of each packet in Bytes.")
+        & value("size", opts.size),
+      option("-b", "--batch")
+        .doc("The number of packets to send and receive with a single call. "
+          "In segmented mode, this is the number of segments per send.")
+        & value("batch", opts.batch),
+
+      option("-p", "--port-range-start")
+        .doc("Start of the port range to use.")
+        & value("start", opts.port_range_start),
+
+      option("-r", "--runs")
+        .doc("Number of test runs to perform.")
+        & value("runs", opts.runs),
+
+      option("-o", "--output")
+        .doc("Output file (CSV) for test results.")
+        & value("output_file", opts.output_file),
+
+      option("-v", "--verbose")
+        .set(opts.verbose)
+        .doc("Be verbose."),
+
+      option("--help", "-?")
+        .set(help)
+        .doc("Display this help.")
+  );
+
+  if (!parse(argc, argv, cli) || help || !opts.batch || !opts.size) {
+    auto fmt = doc_formatting{}
+        .first_column(3)
+        .last_column(79);
+    std::cerr << make_man_page(cli, argv[0], fmt);
+    exit(1);
+  }
+
+  if (opts.verbose) {
+    std::cout << "Summary of options:" << std::endl;
+    std::cout << "  Packets per run:      " << opts.packets << std::endl;
+    std::cout << "  Packet size:          " << opts.size << std::endl;
+    std::cout << "  Batch size:           " << opts.batch << std::endl;
+    std::cout << "  Start of port range:  " << opts.port_range_start << std::endl;
+    std::cout << "  Test runs:            " << opts.runs << std::endl;
+    std::cout << "  Output file:          " << opts.output_file << std::endl;
+  }
+
+  return opts;
+}
+
+
+
+/**
+ * Each mode sends a burst of up to opts.batch packets from the sender, and
+ * receives them all on the receiver before sending the next burst. That
+ * keeps the receiver's socket buffer from overflowing on loopback, so no
+ * packets are lost and the modes stay comparable.
+ **/
+struct mode_ops
+{
+  virtual ~mode_ops() {}
+
+  virtual std::string name() const = 0;
+
+  virtual size_t send_burst(size_t count) = 0;
+  virtual size_t receive_burst(size_t count) = 0;
+};
+
+
+
+struct single_ops : public mode_ops
+{
+  single_ops(options const & opts, connector & sender, connector & receiver)
+    : m_sender{sender}
+    , m_receiver{receiver}
+    , m_recipient{receiver.socket_address()}
+    , m_buf(opts.size, 'x')
+  {
+  }
+
+
+  virtual std::string name() const
+  {
+    return "single";
+  }
+
+
+  virtual size_t send_burst(size_t count)
+  {
+    size_t sent = 0;
+    for ( ; sent < count ; ++sent) {
+      size_t written = 0;
+      auto err = m_sender.send(m_buf.data(), m_buf.size(), written,
+          m_recipient);
+      if (err != ERR_SUCCESS) {
+        break;
+      }
+    }
+    return sent;
+  }
+
+
+  virtual size_t receive_burst(size_t count)
+  {
+    size_t received = 0;
+    for ( ; received < count ; ++received) {
+      size_t read = 0;
+      liberate::net::socket_address sender;
+      auto err = m_receiver.receive(m_buf.data(), m_buf.size(), read, sender);
+      if (err != ERR_SUCCESS) {
+        break;
+      }
+    }
+    return received;
+  }
+
+
+  connector &                   m_sender;
+  connector &                   m_receiver;
+  liberate::net::socket_address m_recipient;
+  std::vector<char>             m_buf;
+};
+
+
+
+struct batch_ops : public mode_ops
+{
+  batch_ops(options const & opts, connector & sender, connector & receiver)
+    : m_sender{sender}
+    , m_receiver{receiver}
+    , m_bufs(opts.batch * opts.size, 'x')
+    , m_out(opts.batch)
+    , m_in(opts.batch)
+  {
+    auto recipient = receiver.socket_address();
+    for (size_t i = 0 ; i < opts.batch ; ++i) {
+      auto buf = &m_bufs[i * opts.size];
+      m_out[i].buffer = { buf, opts.size };
+      m_out[i].length = 0;
+      m_out[i].address = recipient;
+      m_in[i].buffer = { buf, opts.size };
+      m_in[i].length = 0;
+    }
+  }
+
+
+  virtual std::string name() const
+  {
+    return "batch";
+  }
+
+
+  virtual size_t send_burst(size_t count)
+  {
+    size_t sent = 0;
+    auto err = m_sender.send_batch(&m_out[0], count, sent);
+    if (err != ERR_SUCCESS) {
+      return 0;
+    }
+    return sent;
+  }
+
+
+  virtual size_t receive_burst(size_t count)
+  {
+    size_t received = 0;
+    auto err = m_receiver.receive_batch(&m_in[0], count, received);
+    if (err != ERR_SUCCESS) {
+      return 0;
+    }
+    return received;
+  }
+
+
+  connector &                           m_sender;
+  connector &                           m_receiver;
+  std::vector<char>                     m_bufs;
+  std::vector<const_datagram_message>   m_out;
+  std::vector<datagram_message>         m_in;
+};
+
+
+
+struct segmented_ops : public mode_ops
+{
+  segmented_ops(options const & opts, connector & sender,
+      connector & receiver)
+    : m_opts{opts}
+    , m_sender{sender}
+    , m_receiver{receiver}
+    , m_recipient{receiver.socket_address()}
+    , m_sendbuf(opts.batch * opts.size, 'x')
+    , m_recvbuf(65536)
+  {
+  }
+
+
+  virtual std::string name() const
+  {
+    return "segmented";
+  }
+
+
+  virtual size_t send_burst(size_t count)
+  {
+    size_t written = 0;
+    auto err = m_sender.send(m_sendbuf.data(), count * m_opts.size, written,
+        m_recipient, m_opts.size);
+    if (err != ERR_SUCCESS) {
+      return 0;
+    }
+    return written / m_opts.size;
+  }
+
+
+  virtual size_t receive_burst(size_t)
+  {
+    size_t read = 0;
+    size_t segment_size = 0;
+    liberate::net::socket_address sender;
+    auto err = m_receiver.receive(m_recvbuf.data(), m_recvbuf.size(), read,
+        sender, segment_size);
+    if (err != ERR_SUCCESS) {
+      return 0;
+    }
+    return (read + m_opts.size - 1) / m_opts.size;
+  }
+
+
+  options const &               m_opts;
+  connector &                   m_sender;
+  connector &                   m_receiver;
+  liberate::net::socket_address m_recipient;
+  std::vector<char>             m_sendbuf;
+  std::vector<char>             m_recvbuf;
+};
+
+
+
+struct run_result
+{
+  size_t  packets = 0;
+  size_t  usec = 0;
+  size_t  retries = 0;
+
+  double pps() const
+  {
+    if (!usec) {
+      return 0;
+    }
+    return double(packets) * 1000000 / usec;
+  }
+};
+
+
+
+run_result
+perform_run(options const & opts, mode_ops & ops)
+{
+  run_result result;
+
+  auto start_ts = std::chrono::steady_clock::now();
+  while (result.packets < opts.packets) {
+    size_t burst = std::min(opts.batch, opts.packets - result.packets);
+
+    size_t sent = 0;
+    while (sent < burst) {
+      auto amount = ops.send_burst(burst - sent);
+      if (!amount) {
+        ++result.retries;
+      }
+      sent += amount;
+    }
+
+    size_t received = 0;
+    while (received < burst) {
+      auto amount = ops.receive_burst(burst - received);
+      if (!amount) {
+        ++result.retries;
+      }
+      received += amount;
+    }
+
+    result.packets += received;
+  }
+  auto end_ts = std::chrono::steady_clock::now();
+
+  auto diff = end_ts - start_ts;
+  result.usec = std::chrono::duration_cast<std::chrono::microseconds>(
+      diff).count();
+  return result;
+}
+
+
+
+void output_console(std::string const & mode, size_t run,
+    run_result const & result)
+{
+  std::cout << "Run " << run << " (" << mode << ") completed in "
+    << result.usec << " usec." << std::endl;
+  std::cout << "  Packets:         " << result.packets << std::endl;
+  std::cout << "  Retries:         " << result.retries << std::endl;
+  std::cout << "  Packets/sec:     " << size_t(result.pps()) << std::endl;
+}
+
+
+
+void output_csv(options const & opts, std::string const & mode, size_t run,
+    run_result const & result, std::ofstream & file)
+{
+  file << mode << ",";
+  file << opts.packets << ",";
+  file << opts.size << ",";
+  file << opts.batch << ",";
+  file << opts.runs << ",";
+
+  file << run << ",";
+  file << result.usec << ",";
+  file << result.retries << ",";
+  file << size_t(result.pps()) << ",";
+
+  file << "\n";
+}
+
+
+
+void output_csv_header(std::ofstream & file)
+{
+  file << "Mode,";
+  file << "Packets,";
+  file << "Packet Size,";
+  file << "Batch Size,";
+  file << "Total Runs,";
+
+  file << "Run,";
+  file << "Time (usec),";
+  file << "Retries,";
+  file << "Packets/sec,";
+
+  file << "\n";
+}
+
+
+} // anonymous namespace
+
+
+
+int main(int argc, char **argv)
+{
+  try {
+    auto opts = parse_cli(argc, argv);
+
+    auto api = api::create();
+
+    // The last pair of connectors lets the kernel coalesce received
+    // datagrams, which would confuse the other modes.
+    connector conns[4];
+    uint16_t port = opts.port_range_start;
+    for (size_t i = 0 ; i < 4 ; ++i, ++port) {
+      auto url = liberate::net::url::parse("udp://127.0.0.1:"
+          + std::to_string(port) + (i < 2 ? "" : "?gro=1"));
+      conns[i] = connector{api, url};
+      auto err = conns[i].listen();
+      if (err != ERR_SUCCESS) {
+        throw exception(err, "Could not bind UDP connector.");
+      }
+    }
+
+    std::ofstream output_file;
+    if (!opts.output_file.empty()) {
+      output_file.open(opts.output_file);
+      output_csv_header(output_file);
+    }
+
+    single_ops single{opts, conns[0], conns[1]};
+    batch_ops batch{opts, conns[0], conns[1]};
+    segmented_ops segmented{opts, conns[2], conns[3]};
+    mode_ops * modes[] = { &single, &batch, &segmented };
+
+    for (auto mode : modes) {
+      double total_pps = 0;
+      for (size_t run = 0 ; run < opts.runs ; ++run) {
+        VERBOSE_LOG(opts, "=== Start of test run: " << run << " ("
+            << mode->name() << ")");
+
+        auto result = perform_run(opts, *mode);
+        total_pps += result.pps();
+
+        output_console(mode->name(), run, result);
+        if (output_file.is_open()) {
+          output_csv(opts, mode->name(), run, result, output_file);
+        }
+
+        VERBOSE_LOG(opts, "=== End of test run: " << run);
+      }
+
+      std::cout << "Average (" << mode->name() << "): "
+        << size_t(total_pps / opts.runs) << " packets/sec." << std::endl;
+    }
+
+    if (output_file.is_open()) {
+      output_file.close();
+    }
+    return 0;
+  } catch (packeteer::exception const & ex) {
+    std::cerr << ex.what() << std::endl;
+    return -3;
+  } catch (std::exception const & ex) {
+    std::cerr << ex.what() << std::endl;
+    return -4;
+  } catch (...) {
+    std::cerr << "Unknown exception caught, aborting." << std::endl;
+    return -5;
+  }
+}
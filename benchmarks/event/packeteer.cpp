@@ -56,6 +56,7 @@ struct p7r_ops : public backend_ops
   {
     m_opts = opts;
     m_conns.resize(opts.conns);
+    m_recipients.resize(opts.conns);
 
     uint16_t port = opts.port_range_start;
     for (conn_index i = 0 ; i < opts.conns ; ++i, ++port) {
@@ -65,6 +66,7 @@ struct p7r_ops : public backend_ops
 
       conn.listen();
       m_conns[i] = conn;
+      m_recipients[i] = conn.peer_addr();
     }
   }
 
@@ -91,9 +93,10 @@ struct p7r_ops : public backend_ops
   {
     VERBOSE_LOG(m_opts, "Sending from " << from_idx << " to " << to_idx);
 
-    auto recipient = m_conns[to_idx].socket_address();
+    // Recipients are built once in init(), so sending does not allocate.
     size_t bytes_written = 0;
-    auto err = m_conns[from_idx].send(buf, buflen, bytes_written, recipient);
+    auto err = m_conns[from_idx].send(buf, buflen, bytes_written,
+        m_recipients[to_idx]);
     if (err != ERR_SUCCESS && err != ERR_ASYNC) {
       VERBOSE_ERR(m_opts, "Error in send: " << error_name(err) << " / " << error_message(err));
       return false;
@@ -139,10 +142,11 @@ struct p7r_ops : public backend_ops
     m_sched.process_events(1ms);
   }
 
-  options                 m_opts;
-  std::shared_ptr<api>    m_api;
-  scheduler               m_sched;
-  std::vector<connector>  m_conns;
+  options                   m_opts;
+  std::shared_ptr<api>      m_api;
+  scheduler                 m_sched;
+  std::vector<connector>    m_conns;
+  std::vector<peer_address> m_recipients;
 };
 
 
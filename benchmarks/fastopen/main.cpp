@@ -0,0 +1,333 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include <clipp.h>
+
+#include <packeteer.h>
+#include <packeteer/error.h>
+#include <packeteer/connector.h>
+
+using namespace packeteer;
+
+#define VERBOSE_LOG(opts, msg) \
+  if (opts.verbose) { \
+    std::cout << msg << std::endl; \
+  }
+
+
+namespace {
+
+struct options
+{
+  size_t      requests = 1000;
+  size_t      size = 64;
+  uint16_t    port = 2000;
+  size_t      runs = 5;
+  bool        verbose = false;
+  std::string output_file;
+};
+
+
+
+options parse_cli(int argc, char **argv)
+{
+  using namespace clipp;
+
+  bool help = false;
+  options opts;
+
+  auto cli = (
+      option("-n", "--requests")
+        .doc("The number of requests to perform per run; each uses a new "
+          "connection.")
+        & value("requests", opts.requests),
+      option("-s", "--size")
+        .doc("The size of each request and response in Bytes.")
+        & value("size", opts.size),
+
+      option("-p", "--port")
+        .doc("The port to use.")
+        & value("port", opts.port),
+
+      option("-r", "--runs")
+        .doc("Number of test runs to perform.")
+        & value("runs", opts.runs),
+
+      option("-o", "--output")
+        .doc("Output file (CSV) for test results.")
+        & value("output_file", opts.output_file),
+
+      option("-v", "--verbose")
+        .set(opts.verbose)
+        .doc("Be verbose."),
+
+      option("--help", "-?")
+        .set(help)
+        .doc("Display this help.")
+  );
+
+  if (!parse(argc, argv, cli) || help || !opts.requests || !opts.size) {
+    auto fmt = doc_formatting{}
+        .first_column(3)
+        .last_column(79);
+    std::cerr << make_man_page(cli, argv[0], fmt);
+    exit(1);
+  }
+
+  if (opts.verbose) {
+    std::cout << "Summary of options:" << std::endl;
+    std::cout << "  Requests per run:     " << opts.requests << std::endl;
+    std::cout << "  Request size:         " << opts.size << std::endl;
+    std::cout << "  Port:                 " << opts.port << std::endl;
+    std::cout << "  Test runs:            " << opts.runs << std::endl;
+    std::cout << "  Output file:          " << opts.output_file << std::endl;
+  }
+
+  return opts;
+}
+
+
+
+struct run_result
+{
+  size_t  requests = 0;
+  size_t  usec = 0;
+  size_t  p50_usec = 0;
+  size_t  p99_usec = 0;
+
+  double avg_usec() const
+  {
+    if (!requests) {
+      return 0;
+    }
+    return double(usec) / requests;
+  }
+};
+
+
+
+void
+transfer_all(connector & conn, char * buf, size_t size, bool reading)
+{
+  size_t done = 0;
+  while (done < size) {
+    size_t amount = 0;
+    auto err = reading
+      ? conn.read(buf + done, size - done, amount)
+      : conn.write(buf + done, size - done, amount);
+    if (err != ERR_SUCCESS) {
+      throw exception(err, "Transfer failed.");
+    }
+    if (!amount) {
+      throw exception(ERR_UNEXPECTED, "Connection closed.");
+    }
+    done += amount;
+  }
+}
+
+
+
+run_result
+perform_run(options const & opts, bool fastopen, std::shared_ptr<api> api,
+    std::string const & url, connector & server)
+{
+  run_result result;
+
+  // The server answers each request with a response of the same size.
+  std::thread responder([&opts, &server]()
+  {
+    std::vector<char> buf(opts.size);
+    for (size_t i = 0 ; i < opts.requests ; ++i) {
+      auto conn = server.accept();
+      if (!conn.communicating()) {
+        throw exception(ERR_UNEXPECTED, "Could not accept.");
+      }
+      transfer_all(conn, buf.data(), buf.size(), true);
+      transfer_all(conn, buf.data(), buf.size(), false);
+    }
+  });
+
+  std::vector<char> request(opts.size, 'x');
+  std::vector<char> response(opts.size);
+  std::vector<size_t> latencies;
+  latencies.reserve(opts.requests);
+
+  for (size_t i = 0 ; i < opts.requests ; ++i) {
+    auto start_ts = std::chrono::steady_clock::now();
+
+    connector client{api, url};
+    size_t written = 0;
+    packeteer::error_t err = ERR_SUCCESS;
+    if (fastopen) {
+      err = client.connect_with_data(request.data(), request.size(), written);
+    }
+    else {
+      err = client.connect();
+    }
+    if (err != ERR_SUCCESS) {
+      throw exception(err, "Could not connect.");
+    }
+    transfer_all(client, request.data() + written, request.size() - written,
+        false);
+    transfer_all(client, response.data(), response.size(), true);
+
+    auto end_ts = std::chrono::steady_clock::now();
+    latencies.push_back(std::chrono::duration_cast<std::chrono::microseconds>(
+          end_ts - start_ts).count());
+  }
+
+  responder.join();
+
+  std::sort(latencies.begin(), latencies.end());
+  result.requests = latencies.size();
+  for (auto latency : latencies) {
+    result.usec += latency;
+  }
+  result.p50_usec = latencies[latencies.size() / 2];
+  result.p99_usec = latencies[latencies.size() * 99 / 100];
+  return result;
+}
+
+
+
+void output_console(std::string const & mode, size_t run,
+    run_result const & result)
+{
+  std::cout << "Run " << run << " (" << mode << ") completed in "
+    << result.usec << " usec." << std::endl;
+  std::cout << "  Requests:        " << result.requests << std::endl;
+  std::cout << "  Average (usec):  " << result.avg_usec() << std::endl;
+  std::cout << "  p50 (usec):      " << result.p50_usec << std::endl;
+  std::cout << "  p99 (usec):      " << result.p99_usec << std::endl;
+}
+
+
+
+void output_csv(options const & opts, std::string const & mode, size_t run,
+    run_result const & result, std::ofstream & file)
+{
+  file << mode << ",";
+  file << opts.requests << ",";
+  file << opts.size << ",";
+  file << opts.runs << ",";
+
+  file << run << ",";
+  file << result.usec << ",";
+  file << result.avg_usec() << ",";
+  file << result.p50_usec << ",";
+  file << result.p99_usec << ",";
+
+  file << "\n";
+}
+
+
+
+void output_csv_header(std::ofstream & file)
+{
+  file << "Mode,";
+  file << "Requests per Run,";
+  file << "Request Size,";
+  file << "Total Runs,";
+
+  file << "Run,";
+  file << "Time (usec),";
+  file << "Average Latency (usec),";
+  file << "p50 Latency (usec),";
+  file << "p99 Latency (usec),";
+
+  file << "\n";
+}
+
+
+} // anonymous namespace
+
+
+
+int main(int argc, char **argv)
+{
+  try {
+    auto opts = parse_cli(argc, argv);
+
+    auto api = api::create();
+
+    std::ofstream output_file;
+    if (!opts.output_file.empty()) {
+      output_file.open(opts.output_file);
+      output_csv_header(output_file);
+    }
+
+    std::string url = "tcp4://127.0.0.1:" + std::to_string(opts.port)
+      + "?blocking=1";
+
+    for (bool fastopen : { false, true }) {
+      std::string mode = fastopen ? "fastopen" : "connect";
+
+      // The listener accepts Fast Open requests in either mode; only the
+      // client decides whether to use them.
+      connector server{api, url + "&fastopen=" + std::to_string(
+          opts.requests)};
+      auto err = server.listen();
+      if (err != ERR_SUCCESS) {
+        throw exception(err, "Could not listen.");
+      }
+
+      double total_avg = 0;
+      for (size_t run = 0 ; run < opts.runs ; ++run) {
+        VERBOSE_LOG(opts, "=== Start of test run: " << run << " ("
+            << mode << ")");
+
+        auto result = perform_run(opts, fastopen, api, url, server);
+        total_avg += result.avg_usec();
+
+        output_console(mode, run, result);
+        if (output_file.is_open()) {
+          output_csv(opts, mode, run, result, output_file);
+        }
+
+        VERBOSE_LOG(opts, "=== End of test run: " << run);
+      }
+
+      std::cout << "Average (" << mode << "): "
+        << size_t(total_avg / opts.runs) << " usec per request."
+        << std::endl;
+    }
+
+    if (output_file.is_open()) {
+      output_file.close();
+    }
+    return 0;
+  } catch (packeteer::exception const & ex) {
+    std::cerr << ex.what() << std::endl;
+    return -3;
+  } catch (std::exception const & ex) {
+    std::cerr << ex.what() << std::endl;
+    return -4;
+  } catch (...) {
+    std::cerr << "Unknown exception caught, aborting." << std::endl;
+    return -5;
+  }
+}
@@ -0,0 +1,416 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <clipp.h>
+
+#include <packeteer.h>
+#include <packeteer/error.h>
+#include <packeteer/connector.h>
+
+using namespace packeteer;
+
+#define VERBOSE_LOG(opts, msg) \
+  if (opts.verbose) { \
+    std::cout << msg << std::endl; \
+  }
+
+
+namespace {
+
+struct options
+{
+  size_t      size = 64 * 1024;
+  size_t      total_mib = 1024;
+  size_t      buffers = 16;
+  uint16_t    port = 2000;
+  size_t      runs = 5;
+  bool        verbose = false;
+  std::string output_file;
+};
+
+
+
+options parse_cli(int argc, char **argv)
+{
+  using namespace clipp;
+
+  bool help = false;
+  options opts;
+
+  auto cli = (
+      option("-s", "--size")
+        .doc("The size of each write in Bytes.")
+        & value("size", opts.size),
+      option("-t", "--total")
+        .doc("The amount of data to send per run, in MiB.")
+        & value("total", opts.total_mib),
+      option("-b", "--buffers")
+        .doc("The number of buffers to cycle through; in zero-copy mode, "
+          "this limits the number of sends pending completion.")
+        & value("buffers", opts.buffers),
+
+      option("-p", "--port")
+        .doc("The port to use.")
+        & value("port", opts.port),
+
+      option("-r", "--runs")
+        .doc("Number of test runs to perform.")
+        & value("runs", opts.runs),
+
+      option("-o", "--output")
+        .doc("Output file (CSV) for test results.")
+        & value("output_file", opts.output_file),
+
+      option("-v", "--verbose")
+        .set(opts.verbose)
+        .doc("Be verbose."),
+
+      option("--help", "-?")
+        .set(help)
+        .doc("Display this help.")
+  );
+
+  if (!parse(argc, argv, cli) || help || !opts.size || !opts.buffers) {
+    auto fmt = doc_formatting{}
+        .first_column(3)
+        .last_column(79);
+    std::cerr << make_man_page(cli, argv[0], fmt);
+    exit(1);
+  }
+
+  if (opts.verbose) {
+    std::cout << "Summary of options:" << std::endl;
+    std::cout << "  Write size:           " << opts.size << std::endl;
+    std::cout << "  MiB per run:          " << opts.total_mib << std::endl;
+    std::cout << "  Buffers:              " << opts.buffers << std::endl;
+    std::cout << "  Port:                 " << opts.port << std::endl;
+    std::cout << "  Test runs:            " << opts.runs << std::endl;
+    std::cout << "  Output file:          " << opts.output_file << std::endl;
+  }
+
+  return opts;
+}
+
+
+
+struct run_result
+{
+  size_t  bytes = 0;
+  size_t  usec = 0;
+  size_t  cpu_usec = 0;
+  size_t  copied = 0;
+
+  double mib_per_sec() const
+  {
+    if (!usec) {
+      return 0;
+    }
+    return double(bytes) / (1024 * 1024) * 1000000 / usec;
+  }
+
+  double cpu_percent() const
+  {
+    if (!usec) {
+      return 0;
+    }
+    return double(cpu_usec) * 100 / usec;
+  }
+};
+
+
+
+size_t
+thread_cpu_usec()
+{
+  ::rusage usage;
+  ::getrusage(RUSAGE_THREAD, &usage);
+  return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000
+    + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+
+
+/**
+ * Tracks which of the cycled buffers still have zero-copy sends pending.
+ **/
+struct pending_sends
+{
+  explicit pending_sends(size_t buffers)
+    : m_sequences(buffers)
+    , m_pending(buffers, false)
+  {
+  }
+
+
+  void drain(connector & conn, run_result & result)
+  {
+    zerocopy_completion completions[16];
+    size_t received = 0;
+    while (ERR_SUCCESS == conn.zerocopy_completions(completions, 16,
+          received))
+    {
+      for (size_t i = 0 ; i < received ; ++i) {
+        auto & c = completions[i];
+        if (c.copied) {
+          ++result.copied;
+        }
+        for (size_t b = 0 ; b < m_pending.size() ; ++b) {
+          if (m_pending[b]
+              && uint32_t(m_sequences[b] - c.first) <= c.last - c.first)
+          {
+            m_pending[b] = false;
+          }
+        }
+      }
+    }
+  }
+
+
+  std::vector<uint32_t> m_sequences;
+  std::vector<bool>     m_pending;
+};
+
+
+
+run_result
+perform_run(options const & opts, bool zerocopy, connector & sender,
+    connector & receiver)
+{
+  run_result result;
+  size_t total = opts.total_mib * 1024 * 1024;
+
+  // The receiver just drains the connection on a separate thread.
+  std::thread reader([&receiver, total]()
+  {
+    std::vector<char> buf(256 * 1024);
+    size_t received = 0;
+    while (received < total) {
+      size_t amount = 0;
+      auto err = receiver.read(buf.data(), buf.size(), amount);
+      if (err != ERR_SUCCESS) {
+        continue;
+      }
+      received += amount;
+    }
+  });
+
+  std::vector<std::vector<char>> bufs(opts.buffers,
+      std::vector<char>(opts.size, 'x'));
+  pending_sends pending{opts.buffers};
+
+  auto start_cpu = thread_cpu_usec();
+  auto start_ts = std::chrono::steady_clock::now();
+
+  size_t index = 0;
+  while (result.bytes < total) {
+    auto & buf = bufs[index];
+    size_t amount = std::min(opts.size, total - result.bytes);
+    size_t written = 0;
+
+    if (zerocopy) {
+      // Wait for the buffer to be released by the kernel.
+      while (pending.m_pending[index]) {
+        pending.drain(sender, result);
+      }
+
+      uint32_t sequence = 0;
+      auto err = sender.write_zerocopy(buf.data(), amount, written, sequence);
+      if (ERR_NUM_ITEMS == err) {
+        pending.drain(sender, result);
+        continue;
+      }
+      if (err != ERR_SUCCESS) {
+        throw exception(err, "Zero-copy write failed.");
+      }
+      pending.m_sequences[index] = sequence;
+      pending.m_pending[index] = true;
+    }
+    else {
+      auto err = sender.write(buf.data(), amount, written);
+      if (err != ERR_SUCCESS) {
+        throw exception(err, "Write failed.");
+      }
+    }
+
+    result.bytes += written;
+    index = (index + 1) % opts.buffers;
+  }
+
+  reader.join();
+
+  auto end_ts = std::chrono::steady_clock::now();
+  auto end_cpu = thread_cpu_usec();
+
+  // Let the kernel release the remaining buffers before they go away.
+  if (zerocopy) {
+    for (size_t b = 0 ; b < opts.buffers ; ++b) {
+      while (pending.m_pending[b]) {
+        pending.drain(sender, result);
+      }
+    }
+  }
+
+  auto diff = end_ts - start_ts;
+  result.usec = std::chrono::duration_cast<std::chrono::microseconds>(
+      diff).count();
+  result.cpu_usec = end_cpu - start_cpu;
+  return result;
+}
+
+
+
+void output_console(std::string const & mode, size_t run,
+    run_result const & result)
+{
+  std::cout << "Run " << run << " (" << mode << ") completed in "
+    << result.usec << " usec." << std::endl;
+  std::cout << "  Bytes:           " << result.bytes << std::endl;
+  std::cout << "  MiB/sec:         " << size_t(result.mib_per_sec())
+    << std::endl;
+  std::cout << "  Sender CPU:      " << size_t(result.cpu_percent()) << "%"
+    << std::endl;
+  if (result.copied) {
+    std::cout << "  Copied by kernel: " << result.copied << std::endl;
+  }
+}
+
+
+
+void output_csv(options const & opts, std::string const & mode, size_t run,
+    run_result const & result, std::ofstream & file)
+{
+  file << mode << ",";
+  file << opts.size << ",";
+  file << opts.total_mib << ",";
+  file << opts.buffers << ",";
+  file << opts.runs << ",";
+
+  file << run << ",";
+  file << result.usec << ",";
+  file << result.cpu_usec << ",";
+  file << size_t(result.mib_per_sec()) << ",";
+  file << result.copied << ",";
+
+  file << "\n";
+}
+
+
+
+void output_csv_header(std::ofstream & file)
+{
+  file << "Mode,";
+  file << "Write Size,";
+  file << "MiB per Run,";
+  file << "Buffers,";
+  file << "Total Runs,";
+
+  file << "Run,";
+  file << "Time (usec),";
+  file << "Sender CPU (usec),";
+  file << "MiB/sec,";
+  file << "Copied,";
+
+  file << "\n";
+}
+
+
+} // anonymous namespace
+
+
+
+int main(int argc, char **argv)
+{
+  try {
+    auto opts = parse_cli(argc, argv);
+
+    auto api = api::create();
+
+    std::ofstream output_file;
+    if (!opts.output_file.empty()) {
+      output_file.open(opts.output_file);
+      output_csv_header(output_file);
+    }
+
+    std::string base = "tcp4://127.0.0.1:" + std::to_string(opts.port)
+      + "?blocking=1";
+
+    for (bool zerocopy : { false, true }) {
+      std::string mode = zerocopy ? "zerocopy" : "copy";
+
+      // Use a fresh connection per mode.
+      connector server{api, base};
+      connector client{api, base + (zerocopy ? "&zerocopy=1" : "")};
+      auto err = server.listen();
+      if (err != ERR_SUCCESS) {
+        throw exception(err, "Could not listen.");
+      }
+      err = client.connect();
+      if (err != ERR_SUCCESS) {
+        throw exception(err, "Could not connect.");
+      }
+      auto receiver = server.accept();
+
+      double total_rate = 0;
+      double total_cpu = 0;
+      for (size_t run = 0 ; run < opts.runs ; ++run) {
+        VERBOSE_LOG(opts, "=== Start of test run: " << run << " ("
+            << mode << ")");
+
+        auto result = perform_run(opts, zerocopy, client, receiver);
+        total_rate += result.mib_per_sec();
+        total_cpu += result.cpu_percent();
+
+        output_console(mode, run, result);
+        if (output_file.is_open()) {
+          output_csv(opts, mode, run, result, output_file);
+        }
+
+        VERBOSE_LOG(opts, "=== End of test run: " << run);
+      }
+
+      std::cout << "Average (" << mode << "): "
+        << size_t(total_rate / opts.runs) << " MiB/sec at "
+        << size_t(total_cpu / opts.runs) << "% sender CPU." << std::endl;
+    }
+
+    if (output_file.is_open()) {
+      output_file.close();
+    }
+    return 0;
+  } catch (packeteer::exception const & ex) {
+    std::cerr << ex.what() << std::endl;
+    return -3;
+  } catch (std::exception const & ex) {
+    std::cerr << ex.what() << std::endl;
+    return -4;
+  } catch (...) {
+    std::cerr << "Unknown exception caught, aborting." << std::endl;
+    return -5;
+  }
+}
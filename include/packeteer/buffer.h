@@ -0,0 +1,109 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef PACKETEER_BUFFER_H
+#define PACKETEER_BUFFER_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <packeteer.h>
+
+#include <cstddef>
+
+namespace packeteer {
+
+namespace detail {
+struct buffer_block;
+class buffer_pool;
+} // namespace detail
+
+/**
+ * A buffer is a reference counted slice of a memory block the library owns,
+ * e.g. data the scheduler read on your behalf; see scheduler::start_reading().
+ *
+ * Copying a buffer only adds a reference to the same memory, and moving one
+ * transfers the reference. The memory is recycled when the last buffer
+ * referring to it is destroyed, so hold on to buffers only as long as you
+ * need their contents. Buffers may be passed to and released from any
+ * thread, but the contents must not be modified.
+ *
+ * Hand a buffer to scheduler::enqueue_write() to send it onwards without
+ * copying the data.
+ **/
+class PACKETEER_API buffer
+{
+public:
+  buffer() = default;
+  ~buffer();
+
+  buffer(buffer const & other);
+  buffer(buffer && other) noexcept;
+
+  buffer & operator=(buffer const & other);
+  buffer & operator=(buffer && other) noexcept;
+
+  /**
+   * Contents.
+   **/
+  inline void const * data() const
+  {
+    return m_data;
+  }
+
+  inline size_t size() const
+  {
+    return m_size;
+  }
+
+  inline bool empty() const
+  {
+    return !m_size;
+  }
+
+  inline explicit operator bool() const
+  {
+    return m_size > 0;
+  }
+
+  /**
+   * Return a buffer referring to part of this buffer's contents. The range
+   * is clamped to the contents, so the result may be empty.
+   **/
+  buffer slice(size_t offset, size_t size = static_cast<size_t>(-1)) const;
+
+  /**
+   * Drop this buffer's reference; it is empty afterwards.
+   **/
+  void reset();
+
+private:
+  friend class detail::buffer_pool;
+
+  buffer(detail::buffer_block * block, char const * data, size_t size);
+
+  detail::buffer_block *  m_block = nullptr;
+  char const *            m_data = nullptr;
+  size_t                  m_size = 0;
+};
+
+} // namespace packeteer
+
+#endif // guard
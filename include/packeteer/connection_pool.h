@@ -0,0 +1,138 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef PACKETEER_CONNECTION_POOL_H
+#define PACKETEER_CONNECTION_POOL_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <packeteer.h>
+
+#include <memory>
+#include <string>
+
+#include <packeteer/connector.h>
+#include <packeteer/scheduler.h>
+#include <packeteer/connector/peer_address.h>
+
+namespace packeteer {
+
+/**
+ * The connection_pool class keeps connected stream connectors to peers, so
+ * that clients sending many short requests do not pay for creating and
+ * connecting a connector each time.
+ *
+ * Connectors are acquire()d for a peer_address, and release()d back to the
+ * pool when the request is done. While idle, the pool watches them with the
+ * scheduler: a peer closing an idle connection, or sending unsolicited data
+ * on it, gets the connector discarded. Idle connectors are also closed after
+ * a timeout.
+ *
+ * All functions may be called from any thread.
+ */
+class PACKETEER_API connection_pool
+{
+public:
+  struct settings
+  {
+    // Connectors per peer, whether idle, in use or still connecting.
+    size_t    max_per_peer = 16;
+
+    // Idle connectors kept per peer; further released ones are closed.
+    size_t    max_idle_per_peer = 8;
+
+    // Idle connectors are closed after this time.
+    duration  idle_timeout = std::chrono::seconds{30};
+
+    // Query parameters for creating connectors, e.g. "nodelay=1".
+    std::string parameters = {};
+  };
+
+  /**
+   * The pool uses the scheduler for watching idle and connecting connectors,
+   * so the scheduler must outlive the pool.
+   */
+  connection_pool(std::shared_ptr<api> api, scheduler & sched);
+  connection_pool(std::shared_ptr<api> api, scheduler & sched,
+      settings const & pool_settings);
+  ~connection_pool();
+
+  connection_pool(connection_pool &&) = delete;
+  connection_pool(connection_pool const &) = delete;
+  connection_pool & operator=(connection_pool const &) = delete;
+
+  /**
+   * Acquire a connector to the peer. The most recently released idle
+   * connector is handed out first. If there is none, a new, non-blocking
+   * connector is created and connected.
+   *
+   * Returns:
+   * - ERR_SUCCESS if conn is connected.
+   * - ERR_ASYNC if conn is still connecting; it becomes writable once the
+   *   connection is established.
+   * - ERR_NUM_ITEMS if the peer already has max_per_peer connectors.
+   * - ERR_INVALID_OPTION if the peer's scheme does not create stream
+   *   connectors.
+   * - Errors from connect().
+   */
+  error_t acquire(peer_address const & peer, connector & conn);
+
+  /**
+   * Return a connector that was acquired from this pool. Unless reusable is
+   * false - e.g. because the request failed half way - it is kept for the
+   * next acquire(). Connectors beyond max_idle_per_peer are closed.
+   *
+   * Returns ERR_INVALID_VALUE if conn was not acquired from this pool.
+   */
+  error_t release(connector const & conn, bool reusable = true);
+
+  /**
+   * Start connecting up to count connectors to the peer in the background,
+   * within the max_per_peer limit. They become idle, and thus available to
+   * acquire(), as the connections are established; connections that fail
+   * are dropped.
+   *
+   * Returns ERR_NUM_ITEMS if no connector could be started because of the
+   * limit, or errors from connect() for the first connector that failed.
+   */
+  error_t prewarm(peer_address const & peer, size_t count);
+
+  /**
+   * Close idle connectors to all peers.
+   */
+  void clear();
+
+  /**
+   * Counts of connectors to the peer that are idle, in use, or still
+   * connecting in the background respectively.
+   */
+  size_t idle(peer_address const & peer) const;
+  size_t in_use(peer_address const & peer) const;
+  size_t connecting(peer_address const & peer) const;
+
+private:
+  struct connection_pool_impl;
+  std::shared_ptr<connection_pool_impl> m_impl;
+};
+
+} // namespace packeteer
+
+#endif // guard
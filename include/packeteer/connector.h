@@ -31,6 +31,7 @@
 #include <utility>
 #include <functional>
 #include <iostream>
+#include <vector>
 
 #include <liberate/cpp/operators/comparison.h>
 #include <liberate/net/url.h>
@@ -85,6 +86,9 @@ public:
    *  - fifo: POSIX named pipe. Bidirectional and multi client in theory;
    *      in practice, being FIFOs they work to broadcast anything written
    *      to all readers, including the sender.
+   *  - signal: Linux signalfd, initially with an empty signal mask. Reading
+   *      yields struct signalfd_siginfo records. The scheduler uses these for
+   *      register_signal(); there is little need to create them directly.
    *
    * Of these, the first six expect the address string to have the format:
    *    scheme://address[:port]
@@ -99,8 +103,34 @@ public:
    * explicitly, provide the "behaviour" parameter with either the "datagram"
    * or "stream" value.
    *
-   * The anonymous pipe expects the scheme to be followed by nothing at all.
+   * UDP connectors accept the "gro" parameter; set it to "1" to let the
+   * kernel coalesce received datagrams (CO_UDP_GRO). See the segmented
+   * receive() for details.
+   *
+   * TCP connectors accept the "zerocopy" parameter; set it to "1" to permit
+   * zero-copy sends (CO_ZEROCOPY). See write_zerocopy() for details. The
+   * "zerocopy_receive" parameter does the same for receiving into read
+   * leases (CO_ZEROCOPY_RECEIVE); see read() with a read_lease.
+   *
+   * Socket connectors (TCP, UDP and local) also accept tunables, which are
+   * applied as socket options when the socket is created:
+   * - "rcvbuf", "sndbuf" and "rcvlowat" take sizes in Bytes, optionally with
+   *   a K, M or G suffix, e.g. "rcvbuf=4M".
+   * - "nodelay" and "quickack" take "1" or "0".
+   * - "notsent_lowat" takes a size, "busy_poll" a number of microseconds, and
+   *   "incoming_cpu" a CPU number.
+   * - "backlog" sets the listen backlog.
+   * - TCP connectors take "fastopen" with the queue length for TCP Fast Open
+   *   requests when listening, and "fastopen_connect=1" to let connect() and
+   *   the first write() use TCP Fast Open. See also connect_with_data().
+   * Invalid values make listen() or connect() fail; so do options that the
+   * platform or socket type does not support. Further tunables may be added
+   * via the registry.
+   *
+   * The anonymous pipe and signal connectors expect the scheme to be
+   * followed by nothing at all.
    *    anon://[optional parameters]
+   *    signal://[optional parameters]
    *
    * The last few expect the following format:
    *    scheme://path[optional parameters]
@@ -123,6 +153,25 @@ public:
    **/
   connector(std::shared_ptr<api> api, std::string const & connect_url);
   connector(std::shared_ptr<api> api, liberate::net::url const & connect_url);
+
+  /**
+   * Alternatively, construct a connector from an address and options,
+   * without formatting or parsing a URL. That is the cheaper choice when the
+   * address is at hand anyway, e.g. when connecting back to the sender of a
+   * datagram.
+   *
+   * CO_DEFAULT selects the default options for the connector type; other
+   * options are validated as those given in a URL. As there are no URL
+   * parameters, socket connectors use the default tunables.
+   *
+   * The connect_url() of such connectors is only formatted when requested.
+   **/
+  connector(std::shared_ptr<api> api, peer_address const & address,
+      connector_options const & options = CO_DEFAULT);
+  connector(std::shared_ptr<api> api, connector_type type,
+      liberate::net::socket_address const & address,
+      connector_options const & options = CO_DEFAULT);
+
   connector() = default;
   ~connector() = default;
 
@@ -172,6 +221,23 @@ public:
    **/
   error_t connect();
 
+  /**
+   * Connect, and send the first bufsize Bytes of data in the same step. TCP
+   * connectors use TCP Fast Open where the platform supports it, which puts
+   * the data into the connection request and saves the handshake round trip
+   * for servers that listen with the "fastopen" parameter. Without a Fast
+   * Open cookie for the server, the kernel requests one and the data is not
+   * sent.
+   *
+   * Other connectors connect() and write().
+   *
+   * Returns the same as connect(); bytes_written is the amount of data that
+   * was sent. The caller must write() any remainder once the connector
+   * becomes writable.
+   **/
+  error_t connect_with_data(void const * buf, size_t bufsize,
+      size_t & bytes_written);
+
   /**
    * Return whether the connector is listening() or connected().
    *
@@ -211,6 +277,22 @@ public:
    **/
   connector accept() const;
 
+  /**
+   * Accept up to max pending connection requests at once, appending the
+   * resulting connectors to out. This drains the backlog of a listening
+   * socket in a single scheduler callback, which is cheaper than waking up
+   * once per connection when many clients connect at the same time.
+   *
+   * Connectors that return themselves from accept() are appended only once.
+   * Blocking connectors accept a single connection per call, as they would
+   * otherwise wait for further requests.
+   *
+   * Returns:
+   * - ERR_SUCCESS if at least one connection was accepted.
+   * - ERR_REPEAT_ACTION if no connection request was pending.
+   **/
+  error_t accept_many(std::vector<connector> & out, size_t max) const;
+
   /**
    * Connectors, once bound or connected, have one or more handles associated
    * with them. Normally, there is one handle for reading, and one handle for
@@ -239,6 +321,94 @@ public:
   error_t send(void const * buf, size_t bufsize, size_t & bytes_written,
       peer_address const & recipient);
 
+  /**
+   * Scatter/gather variants of receive() and send(). A single message is
+   * received into, or sent from, all buffers in order. This lets you e.g.
+   * send a header and payload in separate buffers without copying them into
+   * one.
+   **/
+  error_t receive(io_buffer const * bufs, size_t bufcount, size_t & bytes_read,
+      ::liberate::net::socket_address & sender);
+  error_t send(const_io_buffer const * bufs, size_t bufcount,
+      size_t & bytes_written,
+      ::liberate::net::socket_address const & recipient);
+
+  error_t receive(io_buffer const * bufs, size_t bufcount, size_t & bytes_read,
+      peer_address & sender);
+  error_t send(const_io_buffer const * bufs, size_t bufcount,
+      size_t & bytes_written, peer_address const & recipient);
+
+  /**
+   * Receive or send up to count datagrams with a single call where the
+   * platform permits it (recvmmsg()/sendmmsg() on Linux), and one call per
+   * datagram elsewhere. See datagram_message for how the messages are used.
+   *
+   * The number of datagrams transferred is returned in received or sent; the
+   * functions succeed if at least one datagram was transferred. Otherwise,
+   * they return the error receive() or send() would for the first datagram,
+   * e.g. ERR_REPEAT_ACTION if there is nothing to receive.
+   **/
+  error_t receive_batch(datagram_message * messages, size_t count,
+      size_t & received);
+  error_t send_batch(const_datagram_message * messages, size_t count,
+      size_t & sent);
+
+  /**
+   * Segmented variants of receive() and send().
+   *
+   * send() splits the buffer into datagrams of segment_size Bytes; the last
+   * may be shorter. With UDP connectors on Linux, the kernel does this in a
+   * single call (UDP_SEGMENT). At most 64 segments of a combined size below
+   * 64 KiB are handed to the kernel at once. bytes_written reports the total
+   * of all datagrams sent.
+   *
+   * receive() reports the size of the datagrams in segment_size. Normally,
+   * that is bytes_read. UDP connectors created with the "gro=1" URL parameter
+   * (CO_UDP_GRO) may receive several datagrams of segment_size Bytes at once,
+   * with only the last one being shorter. Use a buffer of 64 KiB with such
+   * connectors, or coalesced datagrams get truncated.
+   **/
+  error_t receive(void * buf, size_t bufsize, size_t & bytes_read,
+      ::liberate::net::socket_address & sender, size_t & segment_size);
+  error_t send(void const * buf, size_t bufsize, size_t & bytes_written,
+      ::liberate::net::socket_address const & recipient, size_t segment_size);
+
+  error_t receive(void * buf, size_t bufsize, size_t & bytes_read,
+      peer_address & sender, size_t & segment_size);
+  error_t send(void const * buf, size_t bufsize, size_t & bytes_written,
+      peer_address const & recipient, size_t segment_size);
+
+  /**
+   * Zero-copy writes, for TCP connectors created with the "zerocopy=1" URL
+   * parameter (CO_ZEROCOPY) on Linux. Other connectors return
+   * ERR_UNSUPPORTED_ACTION; use write() with them.
+   *
+   * write_zerocopy() behaves like write(), except that the kernel may still
+   * read from buf after the call returns. Each successful call is numbered
+   * sequentially from zero per connection, and the number is returned in
+   * sequence. The buffer must not be modified or freed until a completion
+   * covering its sequence number is reported. If too many sends are pending,
+   * the function returns ERR_NUM_ITEMS; process completions, then retry.
+   *
+   * zerocopy_completions() retrieves up to count completions. It returns
+   * ERR_REPEAT_ACTION if there are none.
+   *
+   * The OS reports completions as an error condition on the connector.
+   * collect_zerocopy_completions() moves them into the connector, where
+   * zerocopy_completions() picks them up, and returns the number collected;
+   * or ERR_REPEAT_ACTION if there were none, i.e. the condition is an actual
+   * error. Schedulers do this for you, and report each batch of completions
+   * once via PEV_IO_ZEROCOPY (except for the select() based type), so
+   * retrieve all of them in the callback.
+   *
+   * Zero-copy sends only pay off for large buffers, typically from 10 KiB.
+   **/
+  error_t write_zerocopy(void const * buf, size_t bufsize,
+      size_t & bytes_written, uint32_t & sequence);
+  error_t zerocopy_completions(zerocopy_completion * completions,
+      size_t count, size_t & received);
+  error_t collect_zerocopy_completions(size_t & collected) const;
+
   /**
    * Get blocking mode of the connector.
    **/
@@ -274,6 +444,65 @@ public:
   error_t read(void * buf, size_t bufsize, size_t & bytes_read);
   error_t write(void const * buf, size_t bufsize, size_t & bytes_written);
 
+  /**
+   * Scatter/gather variants of read() and write(), like POSIX readv() and
+   * writev(). Buffers are filled or written in order; bytes_read and
+   * bytes_written report the total over all buffers. The number of buffers
+   * is limited by the platform (IOV_MAX), typically to 1024.
+   **/
+  error_t read(io_buffer const * bufs, size_t bufcount, size_t & bytes_read);
+  error_t write(const_io_buffer const * bufs, size_t bufcount,
+      size_t & bytes_written);
+
+  /**
+   * Leased reads. Instead of copying into a caller-supplied buffer, read()
+   * hands out a lease on a buffer owned by the connector. Return it with
+   * release() when done; the lease is cleared on success.
+   *
+   * TCP connectors created with the "zerocopy_receive=1" URL parameter
+   * (CO_ZEROCOPY_RECEIVE) on Linux map whole pages from the socket's receive
+   * queue into the lease (TCP_ZEROCOPY_RECEIVE), avoiding a copy. Data that
+   * does not fill a page is copied as usual; expect a lease to end at a page
+   * boundary, with the remainder arriving in the next lease. Such connectors
+   * hand out at most 8 leases of up to 256 KiB at a time; read() returns
+   * ERR_NUM_ITEMS if all are in use. Leases stay valid if the connector is
+   * closed, but must be released before the connector is destroyed.
+   *
+   * Other connectors read into a heap buffer that they reuse once the lease
+   * is released, so leases work everywhere, but only pay off where pages can
+   * be mapped.
+   **/
+  error_t read(read_lease & lease);
+  error_t release(read_lease & lease);
+
+  /**
+   * Forward up to max bytes read from this connector to dst, without passing
+   * them through a user buffer. The amount delivered to dst is returned in
+   * transferred.
+   *
+   * On Linux, data is moved within the kernel: with sendfile() if this
+   * connector refers to a regular file (see the filedesc extension), and
+   * with splice() through an internal pipe otherwise. Where the OS does not
+   * support either for the pair of connectors, the data is read into an
+   * internal buffer and written from there.
+   *
+   * Data read from this connector, but not yet accepted by dst, is kept
+   * and delivered first on the next call. Keep calling with the same dst
+   * until none is pending.
+   *
+   * Returns:
+   * - ERR_SUCCESS if data was delivered, or if this connector reached the
+   *   end of its data; in that case, transferred is zero.
+   * - ERR_REPEAT_ACTION if this connector has no data to read right now.
+   * - ERR_ASYNC if dst would block. Call again when it becomes writable;
+   *   some data may have been transferred already.
+   *
+   * Connectors other than the built-in ones may return
+   * ERR_UNSUPPORTED_ACTION. See also scheduler::add_pump().
+   **/
+  error_t splice_to(connector & dst, size_t max, size_t & transferred,
+      splice_flags flags = SF_DEFAULT);
+
   /**
    * Close the connector, making it neither bound nor connected. Subsequent
    * calls to listen() or connect() should be valid again.
@@ -306,6 +535,10 @@ private:
   // pimpl
   struct connector_impl;
   std::shared_ptr<connector_impl> m_impl;
+
+  // Wrap the result of the implementation's accept()
+  connector wrap_accepted(connector_interface * iconn,
+      liberate::net::socket_address const & peer) const;
 };
 
 
@@ -325,6 +558,37 @@ swap(connector & first, connector & second)
 PACKETEER_API
 std::ostream & operator<<(std::ostream & os, connector const & conn);
 
+
+/**
+ * Listener groups.
+ *
+ * listen_group() creates count connectors for the same TCP or UDP address,
+ * and makes each of them listen(). The kernel distributes incoming
+ * connections - or datagrams - between them, so that accepting and receiving
+ * scales with the number of threads serving the group, e.g. one listener per
+ * worker or scheduler. The reuseport URL parameter is implied; the URL must
+ * name an explicit port.
+ *
+ * By default, the kernel picks a listener by hashing the peer's address. If
+ * steer_by_cpu is set, it picks the listener whose index is the number of the
+ * CPU the connection or datagram arrived on, modulo count, instead. Serve
+ * listener i from a thread running on such a CPU to keep processing local
+ * to it.
+ *
+ * On failure, listeners is left empty. Returns ERR_UNSUPPORTED_ACTION if the
+ * platform does not support listener groups, or steering, and
+ * ERR_INVALID_VALUE if count is zero.
+ **/
+PACKETEER_API
+error_t listen_group(std::shared_ptr<api> api,
+    liberate::net::url const & connect_url, size_t count,
+    std::vector<connector> & listeners, bool steer_by_cpu = false);
+
+PACKETEER_API
+error_t listen_group(std::shared_ptr<api> api, std::string const & connect_url,
+    size_t count, std::vector<connector> & listeners,
+    bool steer_by_cpu = false);
+
 } // namespace packeteer
 
 /*******************************************************************************
@@ -35,6 +35,8 @@
 
 #include <liberate/net/socket_address.h>
 
+#include <memory>
+
 namespace packeteer {
 
 /**
@@ -98,6 +100,78 @@ public:
 
   virtual error_t read(void * buf, size_t bufsize, size_t & bytes_read) = 0;
   virtual error_t write(void const * buf, size_t bufsize, size_t & bytes_written) = 0;
+
+  /**
+   * Scatter/gather variants of the above. The default implementations gather
+   * into, and scatter from, a temporary buffer, and use the functions above.
+   * Override them if the platform offers something better.
+   **/
+  virtual error_t receive(io_buffer const * bufs, size_t bufcount,
+      size_t & bytes_read, ::liberate::net::socket_address & sender);
+  virtual error_t send(const_io_buffer const * bufs, size_t bufcount,
+      size_t & bytes_written,
+      ::liberate::net::socket_address const & recipient);
+
+  virtual error_t read(io_buffer const * bufs, size_t bufcount,
+      size_t & bytes_read);
+  virtual error_t write(const_io_buffer const * bufs, size_t bufcount,
+      size_t & bytes_written);
+
+  /**
+   * Batched variants of receive() and send(). The default implementations
+   * loop over the single message functions above; override them if the
+   * platform can transfer several datagrams with one call.
+   **/
+  virtual error_t receive_batch(datagram_message * messages, size_t count,
+      size_t & received);
+  virtual error_t send_batch(const_datagram_message * messages, size_t count,
+      size_t & sent);
+
+  /**
+   * Segmented variants of receive() and send(), for UDP segmentation and
+   * receive offloads. The default implementations send one datagram per
+   * segment, and receive a single datagram.
+   **/
+  virtual error_t receive(void * buf, size_t bufsize, size_t & bytes_read,
+      ::liberate::net::socket_address & sender, size_t & segment_size);
+  virtual error_t send(void const * buf, size_t bufsize, size_t & bytes_written,
+      ::liberate::net::socket_address const & recipient, size_t segment_size);
+
+  /**
+   * Zero-copy writes. The default implementations return
+   * ERR_UNSUPPORTED_ACTION.
+   **/
+  virtual error_t write_zerocopy(void const * buf, size_t bufsize,
+      size_t & bytes_written, uint32_t & sequence);
+  virtual error_t zerocopy_completions(zerocopy_completion * completions,
+      size_t count, size_t & received);
+  virtual error_t collect_zerocopy_completions(size_t & collected);
+
+  /**
+   * Leased reads. The default implementations read into a heap buffer. The
+   * connector keeps one such buffer for reuse; release() only frees buffers
+   * of additional leases held at the same time.
+   **/
+  virtual error_t read(read_lease & lease);
+  virtual error_t release(read_lease & lease);
+
+  /**
+   * Connect and send initial data. The default implementation calls
+   * connect(), and write() if that succeeded immediately.
+   **/
+  virtual error_t connect_with_data(void const * buf, size_t bufsize,
+      size_t & bytes_written);
+
+  /**
+   * Move data to another connector without passing it through the caller.
+   * The default implementation returns ERR_UNSUPPORTED_ACTION.
+   **/
+  virtual error_t splice_to(connector_interface & dst, size_t max,
+      size_t & transferred, splice_flags flags);
+
+private:
+  // Buffer for the default leased read, while no lease holds it.
+  std::unique_ptr<char[]> m_lease_buffer = {};
 };
 
 } // namespace packeteer
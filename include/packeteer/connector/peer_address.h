@@ -67,6 +67,14 @@ public:
   peer_address(std::shared_ptr<api> api, std::string const & address);
   peer_address(std::shared_ptr<api> api, ::liberate::net::url const & url);
 
+  /**
+   * Constructor from a connector type and socket address, e.g. as returned
+   * by accept() or receive(). Generic types such as CT_TCP are narrowed to
+   * match the address; mismatches raise an exception.
+   **/
+  peer_address(std::shared_ptr<api> api, connector_type type,
+      liberate::net::socket_address const & address);
+
 
   /**
    * Return the address' connector type.
@@ -76,9 +84,18 @@ public:
 
 
   /**
-   * Return the scheme for this peer address.
+   * Return the scheme for this peer address. Schemes are interned, so
+   * copying a peer_address never allocates.
    **/
   std::string scheme() const;
+  char const * scheme_cstr() const;
+
+  /**
+   * Take the connector type and scheme from the other address, keeping this
+   * address' socket address. This is how connectors fill in the sender of a
+   * received message without allocating.
+   **/
+  void assign_type(peer_address const & other);
 
 
   /**
@@ -114,7 +131,7 @@ public:
 private:
   liberate::net::socket_address m_sockaddr;
   connector_type                m_connector_type;
-  std::string                   m_scheme;
+  char const *                  m_scheme;
 
   friend PACKETEER_API_FRIEND std::ostream & operator<<(std::ostream & os, peer_address const & addr);
 };
@@ -27,6 +27,8 @@
 
 #include <packeteer.h>
 
+#include <liberate/net/socket_address.h>
+
 namespace packeteer {
 
 // Connector types can be any of the above constants, or a user-defined
@@ -50,6 +52,7 @@ enum PACKETEER_API : connector_type
   CT_PIPE,
   CT_FIFO,
   CT_ANON,
+  CT_SIGNAL,
   CT_USER = 256, // First user-defined connector
 };
 
@@ -67,10 +70,89 @@ enum PACKETEER_API : connector_options
   CO_BLOCKING = (1 << 3),     // Blocking mode. Mutually exclusive with the below.
   CO_NON_BLOCKING = (1 << 4), // Non-blocking mode
 
+  CO_UDP_GRO  = (1 << 5),     // UDP only; let the kernel coalesce received
+                              // datagrams. See connector::receive().
+  CO_ZEROCOPY = (1 << 6),     // TCP only; permit zero-copy sends. See
+                              // connector::write_zerocopy().
+  CO_ZEROCOPY_RECEIVE = (1 << 7), // TCP only; map received pages into
+                                  // read leases. See connector::read().
   CO_USER     = (1 << 8),     // First user-defined options.
 };
 
 
+// Buffers for scatter/gather I/O; see connector::read() and friends. On POSIX
+// systems, these are layout compatible with struct iovec, so they can be
+// passed to the OS without conversion.
+struct io_buffer
+{
+  void *  data;
+  size_t  size;
+};
+
+struct const_io_buffer
+{
+  void const *  data;
+  size_t        size;
+};
+
+
+// Messages for batched datagram I/O; see connector::receive_batch() and
+// connector::send_batch().
+//
+// When receiving, buffer is the space to receive the datagram into; length
+// and address are set to the datagram's size and sender. When sending, buffer
+// and address name the datagram and its recipient, and length is set to the
+// amount sent.
+struct datagram_message
+{
+  io_buffer                       buffer;
+  size_t                          length;
+  ::liberate::net::socket_address address;
+};
+
+struct const_datagram_message
+{
+  const_io_buffer                 buffer;
+  size_t                          length;
+  ::liberate::net::socket_address address;
+};
+
+
+// Completion notification for zero-copy sends; see
+// connector::zerocopy_completions(). The sends numbered first through last
+// (inclusive, modulo 2^32) are complete, and their buffers may be reused. If
+// copied is set, the kernel copied the data after all, which makes zero-copy
+// sends pointless on this connection.
+struct zerocopy_completion
+{
+  uint32_t  first;
+  uint32_t  last;
+  bool      copied;
+};
+
+
+// Flags for connector::splice_to().
+using splice_flags = uint8_t;
+
+enum PACKETEER_API : splice_flags
+{
+  SF_DEFAULT  = 0,
+  SF_MORE     = (1 << 0),     // More data follows; a hint to the OS, e.g.
+                              // not to send partial TCP segments yet.
+};
+
+
+// Lease on received data; see the connector::read() variant taking a lease.
+// The data stays valid until the lease is handed back with
+// connector::release(). The context is for the connector's use only.
+struct read_lease
+{
+  void const *  data = nullptr;
+  size_t        size = 0;
+  void *        context = nullptr;
+};
+
+
 } // namespace packeteer
 
 #endif // guard
@@ -0,0 +1,92 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef PACKETEER_HAPPY_EYEBALLS_H
+#define PACKETEER_HAPPY_EYEBALLS_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <packeteer.h>
+
+#include <functional>
+#include <memory>
+#include <set>
+
+#include <liberate/net/url.h>
+
+#include <packeteer/connector.h>
+#include <packeteer/scheduler.h>
+
+namespace packeteer {
+
+/**
+ * Connection attempt delay recommended by RFC 8305.
+ */
+constexpr duration HAPPY_EYEBALLS_ATTEMPT_DELAY = std::chrono::milliseconds{250};
+
+/**
+ * Invoked with ERR_SUCCESS and the connected connector when a connection
+ * attempt won the race; otherwise with the error of the last failed attempt
+ * and an empty connector.
+ */
+using happy_eyeballs_callback = std::function<
+  void (error_t, connector const &)
+>;
+
+/**
+ * Connect to one of several equivalent addresses, as resolver::resolve()
+ * produces them for host names, following the Happy Eyeballs algorithm of
+ * RFC 8305.
+ *
+ * The candidates are ordered by alternating IPv6 and IPv4 addresses,
+ * starting with IPv6. Non-blocking connection attempts are started in this
+ * order, each one attempt_delay after the previous, or as soon as the
+ * previous attempt failed. The first attempt to connect wins; all other
+ * attempts are closed.
+ *
+ * The callback is invoked exactly once, as a callback of the scheduler.
+ *
+ * The function returns:
+ * - ERR_SUCCESS if the connection attempts were started.
+ * - ERR_INVALID_VALUE if there are no candidates.
+ * - ERR_EMPTY_CALLBACK if no callback was given.
+ */
+PACKETEER_API error_t
+happy_eyeballs_connect(std::shared_ptr<api> api, scheduler & sched,
+    std::set<liberate::net::url> const & candidates,
+    happy_eyeballs_callback && callback,
+    duration const & attempt_delay = HAPPY_EYEBALLS_ATTEMPT_DELAY);
+
+/**
+ * As above, but resolve the query URL with resolver::resolve_async() first.
+ * Resolution errors are passed to the callback.
+ *
+ * The function returns the errors of resolver::resolve_async().
+ */
+PACKETEER_API error_t
+happy_eyeballs_connect(std::shared_ptr<api> api, scheduler & sched,
+    liberate::net::url const & query,
+    happy_eyeballs_callback && callback,
+    duration const & attempt_delay = HAPPY_EYEBALLS_ATTEMPT_DELAY);
+
+} // namespace packeteer
+
+#endif // guard
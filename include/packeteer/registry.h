@@ -28,9 +28,11 @@
 
 #include <functional>
 #include <map>
+#include <vector>
 
 #include <liberate/net/url.h>
 
+#include <packeteer/handle.h>
 #include <packeteer/connector/types.h>
 #include <packeteer/connector/interface.h>
 
@@ -38,11 +40,13 @@ namespace packeteer {
 
 /**
  * The registry class offers an interface for registering extensions with
- * the API instance. Currently, there are two types of extensions:
+ * the API instance. Currently, there are three types of extensions:
  *
  *   1) Map a connector URL scheme to a connector implementation.
  *   1) Map a connector URL query parameter to a combination of
  *      CO_* options.
+ *   1) Map a connector URL query parameter to a tunable, i.e. a value
+ *      that is applied to the connector's handle, such as a socket option.
  */
 class PACKETEER_API registry
 {
@@ -98,6 +102,45 @@ public:
   connector_options options_from_query(
       std::map<std::string, std::string> const & query) const;
 
+  /***************************************************************************
+   * Tunable parameter interface.
+   */
+  /**
+   * Register a new query parameter function for tunables. Unlike option
+   * parameters, tunables carry a value, e.g. "tcp4://...?rcvbuf=4M".
+   *
+   * Returns:
+   *  ERR_INVALID_VALUE if:
+   *    - the url parameter is not specified or already registered
+   *  ERR_EMPTY_CALLBACK if:
+   *    - the applier function is not specified.
+   *
+   * Option parameters and tunables share the same set of parameter names;
+   * built-in tunables count as already registered.
+   *
+   * The applier function is invoked with a handle of the connector and the
+   * parameter value. Connectors invoke it after creating the handle, but
+   * before binding or connecting it. The applier returns ERR_SUCCESS, or an
+   * error code that listen() or connect() return in turn.
+   */
+  using tunable_applier = std::function<
+    error_t (handle const &, std::string const &)
+  >;
+
+  error_t add_tunable(std::string const & parameter,
+      tunable_applier && applier);
+
+  /**
+   * Return the tunables found in the set of query parameter key/values,
+   * bound to their values. Connector implementations - including those
+   * registered as user schemes - apply each to the handles they create.
+   */
+  using bound_tunable = std::function<error_t (handle const &)>;
+  using tunable_list = std::vector<bound_tunable>;
+
+  tunable_list tunables_from_query(
+      std::map<std::string, std::string> const & query) const;
+
   /***************************************************************************
    * Scheme interface.
    */
@@ -116,6 +159,11 @@ public:
    * The creator function is passed a URL, the type associated with the scheme,
    * and parsed & validated options. It should raise exceptions if it cannot
    * create an instance. If it returns a nullptr, an exception is raised instead.
+   *
+   * Optionally, an address creator may be provided as well. It is used when
+   * connectors are created from a peer_address rather than a URL, and is
+   * passed the address and validated options. Schemes without an address
+   * creator are instead passed the URL the address formats to.
    */
   struct connector_info;
 
@@ -129,6 +177,15 @@ public:
     )
   >;
 
+  using address_creator = std::function<
+    ::packeteer::connector_interface * (
+        std::shared_ptr<api>,
+        peer_address const &,
+        connector_options const &,
+        connector_info const * info
+    )
+  >;
+
   /**
    * The information that's stored and returned in the registry.
    */
@@ -139,6 +196,7 @@ public:
     connector_options possible_options;
     scheme_creator    creator;
     std::string       scheme = {};
+    address_creator   from_address = {};
   };
 
   /**
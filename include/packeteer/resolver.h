@@ -31,8 +31,13 @@
 
 #include <liberate/net/url.h>
 
+#include <packeteer/scheduler/types.h>
+
 namespace packeteer {
 
+// Forward declaration
+class scheduler;
+
 /**
  * The resolver class offers an interface for resolving URLs. In principle,
  * this is a little broader in scope than resolving solely host names to IP
@@ -43,7 +48,7 @@ namespace packeteer {
  * A single input URL can resolve to multiple output URLs; for example,
  * resolving a host name can result in multiple IPv4 *and* IPv6 addresses.
  *
- * Note that the resolution functions may cache resolution results.
+ * Results are cached for a while, see set_cache_ttl().
  */
 class PACKETEER_API resolver
 {
@@ -112,6 +117,49 @@ public:
   error_t resolve(std::set<liberate::net::url> & result,
       liberate::net::url const & query);
 
+
+  /**
+   * Resolves the query URL like resolve(), but without blocking the caller.
+   * The resolution function runs on a thread internal to the resolver, and
+   * the callback is then invoked as a scheduled callback on the given
+   * scheduler. Cached results are also delivered through the scheduler.
+   *
+   * Concurrent resolve_async() calls for the same query share a single
+   * invocation of the resolution function.
+   *
+   * The scheduler must outlive the lookup.
+   *
+   * The function returns:
+   * - ERR_SUCCESS if the callback will be invoked.
+   * - ERR_EMPTY_CALLBACK if no callback was given.
+   * - ERR_INVALID_VALUE if the query scheme was not recognised.
+   *
+   * The callback receives the same error codes and results that resolve()
+   * would.
+   */
+  using resolution_callback = std::function<
+    void (error_t, std::set<liberate::net::url> const &)
+  >;
+
+  error_t resolve_async(scheduler & sched, liberate::net::url const & query,
+      resolution_callback && callback);
+
+
+  /**
+   * Results of resolve() and resolve_async() are cached by query URL. The
+   * resolution functions cannot report record TTLs, so successful results
+   * are kept for the positive TTL, and failures for the negative TTL. A TTL
+   * of zero disables the respective cache.
+   *
+   * The defaults are 30 seconds and 5 seconds respectively.
+   */
+  void set_cache_ttl(duration const & positive, duration const & negative);
+
+  /**
+   * Drop all cached results.
+   */
+  void clear_cache();
+
 private:
   friend class api;
   resolver(std::weak_ptr<api> api);
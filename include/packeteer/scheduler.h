@@ -29,6 +29,7 @@
 #include <packeteer.h>
 
 #include <packeteer/error.h>
+#include <packeteer/handle.h>
 #include <packeteer/connector.h>
 
 #include <packeteer/scheduler/types.h>
@@ -69,6 +70,33 @@ public:
     TYPE_POLL,    // POSIX (old)
     TYPE_SELECT,  // POSIX (newer)
     TYPE_WIN32,   // WIN32 I/O completion ports + select
+    TYPE_EPOLL_THREADED, // Linux; epoll runs in a dedicated poller thread,
+                         // and hands events to the dispatching thread
+                         // without locks.
+  };
+
+  /**
+   * How events get from the I/O subsystem to worker threads.
+   *
+   * - DISPATCH_MAIN_LOOP: a dedicated thread waits for events, and queues the
+   *    callbacks to invoke for the workers to pick up. Every event is handed
+   *    from one thread to another at least once.
+   * - DISPATCH_LEADER_FOLLOWER: there is no dedicated thread. Instead, one
+   *    worker at a time - the leader - waits for events. When it finds any,
+   *    it promotes the next worker to leader, and runs the callbacks for the
+   *    first connector itself; further callbacks are picked up by the
+   *    following leaders. With epoll, each leader takes a single event from
+   *    the kernel, so that I/O callbacks are not queued at all.
+   *    This avoids the hand-off between threads for most events, and tends
+   *    to keep data in the same CPU's caches. It is most beneficial with
+   *    many short callbacks.
+   *
+   * Without worker threads, the mode makes no difference.
+   **/
+  enum dispatch_mode : int8_t
+  {
+    DISPATCH_MAIN_LOOP = 0,
+    DISPATCH_LEADER_FOLLOWER,
   };
 
 
@@ -90,9 +118,12 @@ public:
    *
    * May throw if the specified type is not supported. Best leave it at
    * TYPE_AUTOMATIC.
+   *
+   * See dispatch_mode above for the last parameter.
    **/
   explicit scheduler(std::shared_ptr<api> api, ssize_t num_workers = -1,
-      scheduler_type type = TYPE_AUTOMATIC);
+      scheduler_type type = TYPE_AUTOMATIC,
+      dispatch_mode mode = DISPATCH_MAIN_LOOP);
 
   ~scheduler();
 
@@ -115,6 +146,7 @@ public:
    * It is much better to register callbacks only when you have data to write,
    * and writing is not currently possible - then unregister the callback again
    * when it's called, and all data could be written. See IO_FLAG_REPEAT below.
+   * Better still, let the scheduler do this for you via enqueue_write().
    *
    * You can pass any number of IO flags. The options are:
    * - IO_FLAGS_NONE: no special treatment
@@ -150,6 +182,120 @@ public:
   error_t unregister_connectors(connector const * conns, size_t amount);
 
 
+  /**
+   * Managed writes.
+   *
+   * enqueue_write() copies the buffer into a write queue the scheduler keeps
+   * for the connector. It may be called from any thread; appending to the
+   * queue does not take locks. If nobody else is currently flushing the
+   * queue, the data is written immediately in the calling thread. If the
+   * connector would block, the scheduler registers PEV_IO_WRITE internally,
+   * and keeps writing pending data from its main loop whenever the connector
+   * becomes writable. Once the queue is drained, write interest is dropped
+   * again. Pending buffers are written with as few system calls as possible,
+   * i.e. with writev() for CO_STREAM and sendmmsg() for CO_DATAGRAM
+   * connectors where available. Each buffer passed to enqueue_write() is
+   * sent as one message on CO_DATAGRAM connectors.
+   *
+   * The connector must be non-blocking and connected; otherwise
+   * ERR_INVALID_OPTION or ERR_INVALID_VALUE respectively is returned. If
+   * writing fails, any pending data is discarded, and callbacks registered
+   * for PEV_IO_ERROR on the connector are invoked.
+   *
+   * For backpressure, set watermarks with set_write_watermarks(). When the
+   * amount of pending data reaches the high watermark, callbacks registered
+   * for PEV_IO_HIGH_WATERMARK on the connector are invoked. When it then
+   * drops to the low watermark, PEV_IO_LOW_WATERMARK callbacks are invoked.
+   * A high watermark of zero (the default) disables these events.
+   *
+   * If notsent_lowat is non-zero, TCP_NOTSENT_LOWAT is set on TCP
+   * connectors. The kernel then reports them writable only when fewer than
+   * this many bytes are waiting to be sent, which keeps pending data in the
+   * write queue rather than in kernel buffers. Returns ERR_UNSUPPORTED_ACTION
+   * where the option is not available, and ERR_INVALID_OPTION for other
+   * connector types.
+   *
+   * The overload taking a buffer, e.g. one passed to a data callback, keeps
+   * a reference to it rather than copying its contents; see start_reading().
+   *
+   * write_queue_size() returns the number of bytes still pending.
+   *
+   * The scheduler keeps a copy of the connector only while data is pending,
+   * or while watermarks are set for it.
+   *
+   * unregister_connector(conn) discards any data still pending.
+   **/
+  error_t enqueue_write(connector const & conn, void const * buf,
+      size_t bufsize);
+  error_t enqueue_write(connector const & conn, buffer data);
+
+  error_t set_write_watermarks(connector const & conn, size_t low_watermark,
+      size_t high_watermark, size_t notsent_lowat = 0);
+
+  size_t write_queue_size(connector const & conn) const;
+
+
+  /**
+   * Pumps.
+   *
+   * add_pump() makes the scheduler forward all data read from source to
+   * destination, using connector::splice_to(). This happens in the main loop
+   * whenever source becomes readable, without invoking any callbacks. If
+   * destination would block, the pump stops reading from source until
+   * destination becomes writable again. Both connectors must be non-blocking
+   * and connected; otherwise ERR_INVALID_OPTION or ERR_INVALID_VALUE
+   * respectively is returned. Adding a pump for a source that already has
+   * one replaces it. For bidirectional forwarding, add a pump each way.
+   *
+   * Callbacks registered for PEV_IO_READ on the source are not invoked while
+   * the pump runs. When the source reaches the end of its data or either
+   * connection is closed, or when forwarding fails, the pump is removed, and
+   * callbacks registered for PEV_IO_CLOSE or PEV_IO_ERROR respectively on the
+   * source are invoked.
+   *
+   * remove_pump() stops forwarding from source. Data already read from it,
+   * but not yet written, remains in the source connector; see
+   * connector::splice_to(). unregister_connector(conn) removes conn's pump
+   * as well.
+   **/
+  error_t add_pump(connector const & source, connector const & destination);
+  error_t remove_pump(connector const & source);
+
+
+  /**
+   * Readers.
+   *
+   * start_reading() makes the scheduler read from conn whenever it becomes
+   * readable, and pass the data to the callback with PEV_IO_READ. Reads
+   * happen on the worker thread that then invokes the callback, into memory
+   * taken from a pool that each worker keeps. Successive reads share pool
+   * blocks, so small reads do not waste memory, and blocks are recycled when
+   * the last buffer referring to them is released. Keep, copy or pass on the
+   * buffer as you see fit; hand it to enqueue_write() to forward the data
+   * without copying it.
+   *
+   * Only one worker at a time reads from a connector, so data is passed to
+   * the callback in order. When the end of data is reached, the callback is
+   * invoked with PEV_IO_CLOSE and an empty buffer; when reading fails, with
+   * PEV_IO_ERROR. Either way, reading stops then. The callback's return
+   * value is only logged. The sender of datagrams is not reported; use
+   * connector::receive() for that.
+   *
+   * Callbacks registered for PEV_IO_READ on the connector are not invoked
+   * while reading. The connector must be non-blocking and connected;
+   * otherwise ERR_INVALID_OPTION or ERR_INVALID_VALUE respectively is
+   * returned. Starting to read from a connector again replaces the previous
+   * callback.
+   *
+   * stop_reading() stops reading; a read in progress on a worker thread is
+   * still passed to the callback. unregister_connector(conn) stops reading
+   * as well.
+   **/
+  error_t start_reading(connector const & conn,
+      data_callback const & callback);
+  error_t stop_reading(connector const & conn);
+
+
   /**
    * Schedule a callback:
    * - schedule_once: run the callback once after delay.
@@ -249,6 +395,37 @@ public:
 
 
 
+  /**
+   * Register a callback for a POSIX signal. Whenever the signal is received,
+   * the callback is invoked with PEV_SIGNAL, in the same way as any other
+   * callback; i.e. on a worker thread, or from process_events(). Signals are
+   * read from a signalfd, so callbacks are not restricted to async-signal-
+   * safe functions. Multiple pending instances of the same signal result in
+   * a single invocation. If you register one callback for several signals,
+   * it cannot tell which of them was received; use one callback per signal
+   * instead.
+   *
+   * For the signalfd to receive a signal, it must be blocked in every thread
+   * of the process. register_signal() blocks it in the calling thread and in
+   * all threads the scheduler runs. Block it in other threads of your own,
+   * or create them after registering.
+   *
+   * With TYPE_EPOLL_THREADED, the signalfd is polled from the scheduler's
+   * poller thread, which only sees signals sent to the process, e.g. via
+   * kill(). Signals sent to a specific thread, e.g. via raise(), are not
+   * reported.
+   *
+   * SIGKILL and SIGSTOP cannot be registered; ERR_INVALID_VALUE is returned
+   * for these and invalid signal numbers. Returns ERR_UNSUPPORTED_ACTION on
+   * platforms without signalfd.
+   *
+   * Unregistering the last callback for a signal does not unblock it.
+   **/
+  error_t register_signal(int signal, callback const & callback);
+  error_t unregister_signal(int signal, callback const & callback);
+
+
+
   /**
    * Fire the specified events. If you specify system events here, the function
    * will return ERR_INVALID_VALUE and not fire any events. Any callback
@@ -298,6 +475,29 @@ public:
       bool exit_on_failure = false);
 
 
+  /**
+   * Embedding in foreign event loops. Without worker threads, you can add the
+   * handle returned by poll_handle() to your own loop's poll set, and call
+   * process_events() with a zero timeout whenever it becomes readable. The
+   * handle also becomes readable when commands such as register_connector()
+   * or fire_events() are committed, so changes made from other threads are
+   * picked up as well.
+   *
+   * Scheduled callbacks do not make the handle readable. Use next_deadline()
+   * as the upper bound for your loop's timeout instead; it returns the time
+   * point at which the next scheduled callback is due, or time_point::max()
+   * if there is none. Note that scheduling a callback commits a command, so
+   * the deadline is only up to date after the next process_events() call.
+   *
+   * poll_handle() returns an invalid handle if worker threads are running,
+   * or if the scheduler type does not have a pollable handle (only
+   * TYPE_EPOLL and TYPE_KQUEUE do). next_deadline() returns time_point::max()
+   * if worker threads are running.
+   **/
+  handle poll_handle() const;
+  time_point next_deadline() const;
+
+
   /**
    * Return the current number of worker threads.
    **/
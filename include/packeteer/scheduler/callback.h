@@ -31,11 +31,16 @@
 #include <typeinfo>
 #include <functional>
 #include <type_traits>
+#include <utility>
 #include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <new>
 
 #include <liberate/cpp/hash.h>
 #include <liberate/cpp/operators/comparison.h>
 
+#include <packeteer/buffer.h>
 #include <packeteer/connector.h>
 
 #include <packeteer/scheduler/events.h>
@@ -46,234 +51,245 @@ namespace packeteer {
 namespace detail {
 
 /*****************************************************************************
- * Internally used class.
+ * Internally used types.
  *
- * The callback_helper and its base allow callback to erase functor types,
- * but still be invoked correctly through the virtual invoke() function.
+ * The callback class stores one of the invoker types below, or a copied
+ * functor, in a fixed size buffer. The callback_ops table for the stored type
+ * erases it, much like a vtable would.
  **/
-struct callback_helper_base
+
+// Objects up to this size are stored within the callback.
+constexpr std::size_t CALLBACK_INLINE_SIZE = 48;
+
+using callback_free_function = std::add_pointer<
+    error_t (time_point const &, events_t, connector *)
+>::type;
+
+template <typename T>
+struct callback_member_function
 {
-  virtual ~callback_helper_base() {}
-  virtual error_t invoke(time_point const &, events_t const &, connector *) = 0;
-  virtual size_t hash() const = 0;
-  virtual callback_helper_base * clone() const = 0;
+  using type = error_t (T::*)(time_point const &, events_t, connector *);
 };
 
 
-
 /**
- * The holder class is a not-so-smart-pointer light, or whatever you would
- * like to call it. It combines an object pointer with a reference count,
- * and a flag whether or not the object is owned.
- *
- * It's used in callback_helper_base implementations to model both ownership
- * and non-ownership of the functor they're proxying.
+ * Operations on a stored value. The copy, relocate and destroy functions are
+ * null for trivially copyable values; these are copied with memcpy() and need
+ * no destruction.
  **/
-template <typename T>
-struct holder
+struct callback_ops
 {
-  T *               m_object = nullptr;
-  bool const        m_owned = false;
-  std::atomic<int>  m_refcount = 1;
+  error_t (*invoke)(void * value, time_point const & now, events_t events,
+      connector * conn);
+  void (*copy)(void * dest, void const * source);
+  void (*relocate)(void * dest, void * source);
+  void (*destroy)(void * value);
+  bool is_free_function;
+};
+
 
-  inline holder(T * obj, bool owned = false)
-    : m_object(obj)
-    , m_owned(owned)
+template <typename S>
+struct callback_ops_for
+{
+  static error_t invoke(void * value, time_point const & now,
+      events_t events, connector * conn)
   {
+    return (*static_cast<S *>(value))(now, events, conn);
   }
 
-  inline holder(T const & obj)
-    : m_object(new T{obj})
-    , m_owned(true)
+  static void copy(void * dest, void const * source)
   {
+    new (dest) S(*static_cast<S const *>(source));
   }
 
-  inline holder * increment()
+  static void relocate(void * dest, void * source)
   {
-    ++m_refcount;
-    return this;
+    new (dest) S(std::move(*static_cast<S *>(source)));
+    static_cast<S *>(source)->~S();
   }
 
-  inline bool delete_if_last_reference()
+  static void destroy(void * value)
   {
-    if (--m_refcount <= 0) {
-      if (m_owned) {
-        delete m_object;
-      }
-      m_object = nullptr;
-      return true;
-    }
-    return false;
+    static_cast<S *>(value)->~S();
   }
+
+  static constexpr bool trivial = std::is_trivially_copyable<S>::value;
+
+  static constexpr callback_ops ops = {
+    &invoke,
+    trivial ? nullptr : &copy,
+    trivial ? nullptr : &relocate,
+    trivial ? nullptr : &destroy,
+    false,
+  };
 };
 
 
+template <typename S>
+constexpr bool callback_fits_inline =
+  sizeof(S) <= CALLBACK_INLINE_SIZE
+  && alignof(S) <= alignof(std::max_align_t)
+  && std::is_nothrow_move_constructible<S>::value;
+
 
 /**
- * A proxy for an object and member function.
- *
- * If it's constructed from a pointer and member function pointer, the
- * object is not considered owned. Otherwise, a copy is made and the copy
- * is owned - but only one copy is made thanks to the holder construct.
+ * Invokers for free functions, and for objects the callback does not own.
  **/
-template <typename T>
-struct callback_helper_member : public callback_helper_base
+struct free_function_invoker
 {
-  typedef error_t (T::*member_function_type)(time_point const &, events_t,
-      connector *);
-
-  holder<T> *           m_holder;
-  member_function_type  m_function;
-  size_t                m_hash = 0;
-
-  inline callback_helper_member(T * obj, member_function_type func)
-    : m_holder(new holder<T>{obj})
-    , m_function(func)
-    , m_hash(hash_of(obj))
-  {
-  }
-
-
+  callback_free_function m_function;
 
-  inline callback_helper_member(T const & obj, member_function_type func)
-    : m_holder(new holder<T>{obj})
-    , m_function(func)
-    , m_hash(hash_of(&obj))
+  inline error_t operator()(time_point const & now, events_t events,
+      connector * conn) const
   {
+    return (*m_function)(now, events, conn);
   }
+};
 
-
-
-  ~callback_helper_member()
+template <>
+struct callback_ops_for<free_function_invoker>
+{
+  static error_t invoke(void * value, time_point const & now,
+      events_t events, connector * conn)
   {
-    if (m_holder->delete_if_last_reference()) {
-      delete m_holder;
-    }
-    m_holder = nullptr;
+    return (*static_cast<free_function_invoker *>(value))(now, events, conn);
   }
 
+  static constexpr callback_ops ops = {
+    &invoke, nullptr, nullptr, nullptr, true,
+  };
+};
 
 
-  virtual error_t invoke(time_point const & now, events_t const & events,
-      connector * conn)
-  {
-    // Here lies the trick of this construct: if a member function was given,
-    // the implication is that it has an address (is not inline), so we invoke
-    // it.
-    // If one was given, we invoke operator(), which may or may not be declared
-    // inline, as in e.g. the case of a lambda with capture.
-    return (m_holder->m_object->*m_function)(now, events, conn);
-  }
-
-
+template <typename T>
+struct member_invoker
+{
+  T *                                         m_object;
+  typename callback_member_function<T>::type  m_function;
 
-  virtual size_t hash() const
+  inline error_t operator()(time_point const & now, events_t events,
+      connector * conn) const
   {
-    return m_hash;
+    return (m_object->*m_function)(now, events, conn);
   }
+};
 
 
+template <typename T>
+struct pointer_invoker
+{
+  T * m_object;
 
-  virtual callback_helper_base * clone() const
+  inline error_t operator()(time_point const & now, events_t events,
+      connector * conn) const
   {
-    auto res = new callback_helper_member<T>();
-    res->m_holder = m_holder->increment();
-    res->m_function = m_function;
-    res->m_hash = m_hash;
-    return res;
+    return (*m_object)(now, events, conn);
   }
+};
 
-private:
-  callback_helper_member()
-  {
-  }
 
+/**
+ * Invoker for an object copy and member function.
+ **/
+template <typename T>
+struct owned_member_invoker
+{
+  T                                           m_object;
+  typename callback_member_function<T>::type  m_function;
 
-  inline size_t hash_of(T const * obj)
+  inline error_t operator()(time_point const & now, events_t events,
+      connector * conn)
   {
-    return liberate::cpp::multi_hash(
-        reinterpret_cast<size_t>(obj),
-        reinterpret_cast<size_t>(&typeid(member_function_type)),
-        reinterpret_cast<size_t>(&typeid(T)));
+    return (m_object.*m_function)(now, events, conn);
   }
 };
 
 
 /**
- * A proxy for a functor object.
- *
- * Ownership works the same as in callback_helper_member, but no member
- * function is used. Instead, calls are redirected to operator() - if
- * that is inline because it's a lambda with capture, that works.
+ * Objects the callback owns are shared between callback copies, so state an
+ * invocation changes is seen by every copy.
  **/
-template <typename T>
-struct callback_helper_operator : public callback_helper_base
+template <typename S>
+struct shared_invoker
 {
-  holder<T> * m_holder;
-  size_t      m_hash;
-
-  inline callback_helper_operator(T * obj, bool owned = false)
-    : m_holder(new holder<T>{obj, owned})
-    , m_hash(hash_of(obj))
+  struct shared_value
   {
-  }
+    S                         m_value;
+    std::atomic<std::size_t>  m_refcount;
 
+    inline explicit shared_value(S && value)
+      : m_value(std::move(value))
+      , m_refcount(1)
+    {
+    }
+  };
 
+  shared_value * m_shared;
 
-  inline callback_helper_operator(T const & obj)
-    : m_holder(new holder<T>{obj})
-    , m_hash(hash_of(&obj))
+  inline explicit shared_invoker(S && value)
+    : m_shared(new shared_value{std::move(value)})
   {
   }
 
-
-
-  ~callback_helper_operator()
+  inline shared_invoker(shared_invoker const & other)
+    : m_shared(other.m_shared)
   {
-    if (m_holder->delete_if_last_reference()) {
-      delete m_holder;
-    }
-    m_holder = nullptr;
+    ++m_shared->m_refcount;
   }
 
-
-
-  virtual error_t invoke(time_point const & now, events_t const & events,
-      connector * conn)
+  inline shared_invoker(shared_invoker && other) noexcept
+    : m_shared(other.m_shared)
   {
-    return m_holder->m_object->operator()(now, events, conn);
+    other.m_shared = nullptr;
   }
 
+  inline ~shared_invoker()
+  {
+    if (m_shared && 0 == --m_shared->m_refcount) {
+      delete m_shared;
+    }
+  }
 
+  shared_invoker & operator=(shared_invoker const &) = delete;
 
-  virtual size_t hash() const
+  inline error_t operator()(time_point const & now, events_t events,
+      connector * conn)
   {
-    return m_hash;
+    return m_shared->m_value(now, events, conn);
   }
+};
 
 
+/**
+ * Owned objects that are trivially copyable and cannot change on invocation
+ * may be copied rather than shared; copies are indistinguishable.
+ **/
+template <typename S, typename = void>
+struct callback_const_invocable : std::false_type {};
 
-  virtual callback_helper_base * clone() const
-  {
-    auto res = new callback_helper_operator<T>();
-    res->m_holder = m_holder->increment();
-    res->m_hash = m_hash;
-    return res;
-  }
+template <typename S>
+struct callback_const_invocable<S, std::void_t<decltype(
+    std::declval<S const &>()(std::declval<time_point const &>(),
+      std::declval<events_t>(), std::declval<connector *>())
+  )>> : std::true_type {};
 
-private:
-  callback_helper_operator()
-  {
-  }
+template <typename S>
+constexpr bool callback_copyable_inline =
+  callback_fits_inline<S>
+  && std::is_trivially_copyable<S>::value
+  && callback_const_invocable<S>::value;
 
 
-  inline size_t hash_of(T const * obj)
-  {
-    return liberate::cpp::multi_hash(
-        reinterpret_cast<size_t>(obj),
-        reinterpret_cast<size_t>(&typeid(T)));
-  }
-};
+/**
+ * Results of std::bind() compare equal only to their own copies; each gets
+ * a unique identifier in place of an address.
+ **/
+inline std::size_t
+unique_callback_id()
+{
+  static std::atomic<std::size_t> next{0};
+  return ++next;
+}
 
 } // namespace detail
 
@@ -319,6 +335,17 @@ private:
  * lightweight callbacks without any internally managed copies of anything.
  * Lambdas with capture convert to objects, and would typically be copied,
  * with the copy managed by callback.
+ *
+ * Copies of a callback share the object it owns, so state that changes on
+ * invocation - e.g. in a mutable lambda - is seen by all copies. Function
+ * pointers, object pointers and trivially copyable objects that do not change
+ * on invocation are stored within the callback itself, so neither
+ * constructing nor copying such callbacks allocates.
+ *
+ * Callbacks compare equal if they were constructed from the same function,
+ * object pointer or object (by address), and copies compare equal to their
+ * original. Callbacks constructed from std::bind() results compare equal
+ * only to their copies.
  **/
 class callback
   : public ::liberate::cpp::comparison_operators<callback>
@@ -328,9 +355,7 @@ public:
    * Types
    **/
   // Typedef for free functions.
-  using free_function_type = std::add_pointer<
-      error_t (time_point const &, events_t, connector *)
-  >::type;
+  using free_function_type = detail::callback_free_function;
 
   /*****************************************************************************
    * Implementation
@@ -347,9 +372,10 @@ public:
     typename std::enable_if_t<!std::is_pointer<T>::value>* = nullptr
   >
   inline callback(T const & object,
-      typename detail::callback_helper_member<T>::member_function_type func)
-    : m_object_helper(new detail::callback_helper_member<T>{object, func})
+      typename detail::callback_member_function<T>::type func)
   {
+    emplace(detail::owned_member_invoker<T>{object, func},
+        member_hash<T>(&object));
   }
 
 
@@ -360,13 +386,13 @@ public:
     typename std::enable_if_t<std::is_pointer<T>::value>* = nullptr
   >
   inline callback(T object_ptr,
-      typename detail::callback_helper_member<
+      typename detail::callback_member_function<
         typename std::remove_pointer<T>::type
-      >::member_function_type func)
-    : m_object_helper(new detail::callback_helper_member<
-        typename std::remove_pointer<T>::type
-      >{object_ptr, func})
+      >::type func)
   {
+    using object_type = typename std::remove_pointer<T>::type;
+    emplace(detail::member_invoker<object_type>{object_ptr, func},
+        member_hash<object_type>(object_ptr));
   }
 
 
@@ -382,8 +408,8 @@ public:
   >
   // cppcheck-suppress noExplicitConstructor
   inline callback(T const & object)
-    : m_object_helper(new detail::callback_helper_operator<T>{object})
   {
+    emplace(T{object}, object_hash<T>(reinterpret_cast<std::size_t>(&object)));
   }
 
 
@@ -397,8 +423,8 @@ public:
   >
   // cppcheck-suppress noExplicitConstructor
   inline callback(T const & object)
-    : m_object_helper(new detail::callback_helper_operator<T>{new T{object}, true})
   {
+    emplace(T{object}, object_hash<T>(detail::unique_callback_id()));
   }
 
 
@@ -411,10 +437,10 @@ public:
   >
   // cppcheck-suppress noExplicitConstructor
   inline callback(T object_ptr)
-    : m_object_helper(new detail::callback_helper_operator<
-        typename std::remove_pointer<T>::type
-      >{object_ptr})
   {
+    using object_type = typename std::remove_pointer<T>::type;
+    emplace(detail::pointer_invoker<object_type>{object_ptr},
+        object_hash<object_type>(reinterpret_cast<std::size_t>(object_ptr)));
   }
 
 
@@ -423,38 +449,31 @@ public:
   // capture.
   // cppcheck-suppress noExplicitConstructor
   inline callback(free_function_type free_func)
-    : m_free_function(free_func)
   {
+    assign_free_function(free_func);
   }
 
 
 
   // Copy constructor
   inline callback(callback const & other)
-    : m_free_function(other.m_free_function)
   {
-    if (nullptr != other.m_object_helper) {
-      // By cloning we can take ownership
-      m_object_helper = other.m_object_helper->clone();
-    }
+    copy_from(other);
   }
 
 
 
   // Move constructor
-  inline callback(callback && other)
-    : m_free_function(other.m_free_function)
-    , m_object_helper(other.m_object_helper)
-   {
-     other.m_free_function = nullptr;
-     other.m_object_helper = nullptr;
-   }
+  inline callback(callback && other) noexcept
+  {
+    move_from(other);
+  }
 
 
 
   inline ~callback()
   {
-    delete m_object_helper;
+    reset();
   }
 
 
@@ -464,7 +483,7 @@ public:
    **/
   inline bool empty() const
   {
-    return (nullptr == m_free_function && nullptr == m_object_helper);
+    return nullptr == m_ops;
   }
 
   inline operator bool() const
@@ -480,21 +499,8 @@ public:
    **/
   inline callback & operator=(free_function_type free_func)
   {
-    delete m_object_helper;
-    m_object_helper = nullptr;
-
-    m_free_function = free_func;
-
-    return *this;
-  }
-
-
-  inline callback & operator=(detail::callback_helper_base * helper)
-  {
-    delete m_object_helper;
-    m_object_helper = helper; // take ownership
-
-    m_free_function = nullptr;
+    reset();
+    assign_free_function(free_func);
 
     return *this;
   }
@@ -505,24 +511,20 @@ public:
       return *this;
     }
 
-    delete m_object_helper;
-    m_object_helper = nullptr;
-
-    m_free_function = other.m_free_function;
-    if (nullptr != other.m_object_helper) {
-      m_object_helper = other.m_object_helper->clone();
-    }
+    reset();
+    copy_from(other);
 
     return *this;
   }
 
-  inline callback & operator=(callback && other)
+  inline callback & operator=(callback && other) noexcept
   {
-    m_free_function = other.m_free_function;
-    m_object_helper = other.m_object_helper;
+    if (this == &other) {
+      return *this;
+    }
 
-    other.m_free_function = nullptr;
-    other.m_object_helper = nullptr;
+    reset();
+    move_from(other);
 
     return *this;
   }
@@ -537,15 +539,10 @@ public:
   error_t
   operator()(time_point const & now, events_t events, connector * conn)
   {
-    if (nullptr != m_free_function) {
-      return (*m_free_function)(now, events, conn);
-    }
-    else if (nullptr != m_object_helper) {
-      return m_object_helper->invoke(now, events, conn);
-    }
-    else {
+    if (nullptr == m_ops) {
       throw exception(ERR_EMPTY_CALLBACK);
     }
+    return m_ops->invoke(m_storage, now, events, conn);
   }
 
 
@@ -553,55 +550,185 @@ public:
   /**
    * Hash values
    **/
-  inline size_t hash() const
+  inline std::size_t hash() const
   {
-    if (nullptr != m_free_function) {
-      return std::hash<size_t>()(reinterpret_cast<size_t>(m_free_function));
-    }
-    if (nullptr != m_object_helper) {
-      return m_object_helper->hash();
-    }
-    return static_cast<size_t>(-1);
+    return m_hash;
   }
 
 private:
   friend struct ::liberate::cpp::comparison_operators<callback>;
 
+  inline free_function_type free_function() const
+  {
+    if (nullptr == m_ops || !m_ops->is_free_function) {
+      return nullptr;
+    }
+    return reinterpret_cast<detail::free_function_invoker const *>(
+        m_storage)->m_function;
+  }
+
+
+
   inline bool is_equal_to(callback const & other) const
   {
-    if (nullptr != m_free_function) {
-      return m_free_function == other.m_free_function;
+    auto func = free_function();
+    if (nullptr != func) {
+      return func == other.free_function();
     }
-    if (nullptr == other.m_object_helper
-        || nullptr == m_object_helper)
-    {
+    if (empty() || other.empty() || nullptr != other.free_function()) {
       return false;
     }
-    return m_object_helper->hash() == other.m_object_helper->hash();
+    return m_hash == other.m_hash;
   }
 
 
 
   inline bool is_less_than(callback const & other) const
   {
-    if (nullptr != m_free_function) {
-      return (m_free_function < other.m_free_function);
+    auto func = free_function();
+    if (nullptr != func) {
+      return func < other.free_function();
     }
 
-    if (nullptr == other.m_object_helper
-        || nullptr == m_object_helper)
-    {
-      return m_object_helper < other.m_object_helper;
+    bool has_object = !empty();
+    bool other_has_object = !other.empty()
+      && nullptr == other.free_function();
+    if (!has_object || !other_has_object) {
+      return has_object < other_has_object;
+    }
+    return m_hash < other.m_hash;
+  }
+
+
+
+  template <typename T>
+  static inline std::size_t member_hash(T const * object)
+  {
+    return liberate::cpp::multi_hash(
+        reinterpret_cast<std::size_t>(object),
+        reinterpret_cast<std::size_t>(
+          &typeid(typename detail::callback_member_function<T>::type)),
+        reinterpret_cast<std::size_t>(&typeid(T)));
+  }
+
+
+
+  template <typename T>
+  static inline std::size_t object_hash(std::size_t identity)
+  {
+    return liberate::cpp::multi_hash(identity,
+        reinterpret_cast<std::size_t>(&typeid(T)));
+  }
+
+
+
+  template <typename S>
+  inline void emplace(S && value, std::size_t hash)
+  {
+    using stored_type = std::decay_t<S>;
+    if constexpr (detail::callback_copyable_inline<stored_type>) {
+      store(std::forward<S>(value), hash);
     }
-    return m_object_helper->hash() < other.m_object_helper->hash();
+    else {
+      store(detail::shared_invoker<stored_type>{std::forward<S>(value)},
+          hash);
+    }
+  }
+
+
+
+  template <typename S>
+  inline void store(S && value, std::size_t hash)
+  {
+    using stored_type = std::decay_t<S>;
+    static_assert(detail::callback_fits_inline<stored_type>);
+    new (m_storage) stored_type(std::forward<S>(value));
+    m_ops = &detail::callback_ops_for<stored_type>::ops;
+    m_hash = hash;
+  }
+
+
+
+  inline void assign_free_function(free_function_type free_func)
+  {
+    if (nullptr == free_func) {
+      return;
+    }
+    new (m_storage) detail::free_function_invoker{free_func};
+    m_ops = &detail::callback_ops_for<detail::free_function_invoker>::ops;
+    m_hash = std::hash<std::size_t>()(reinterpret_cast<std::size_t>(free_func));
+  }
+
+
+
+  inline void copy_from(callback const & other)
+  {
+    if (nullptr == other.m_ops) {
+      return;
+    }
+    if (nullptr != other.m_ops->copy) {
+      other.m_ops->copy(m_storage, other.m_storage);
+    }
+    else {
+      std::memcpy(m_storage, other.m_storage, sizeof(m_storage));
+    }
+    m_ops = other.m_ops;
+    m_hash = other.m_hash;
   }
 
 
-  free_function_type              m_free_function = nullptr;
-  detail::callback_helper_base *  m_object_helper = nullptr;
+
+  inline void move_from(callback & other)
+  {
+    if (nullptr == other.m_ops) {
+      return;
+    }
+    if (nullptr != other.m_ops->relocate) {
+      other.m_ops->relocate(m_storage, other.m_storage);
+    }
+    else {
+      std::memcpy(m_storage, other.m_storage, sizeof(m_storage));
+    }
+    m_ops = other.m_ops;
+    m_hash = other.m_hash;
+
+    other.m_ops = nullptr;
+    other.m_hash = EMPTY_HASH;
+  }
+
+
+
+  inline void reset()
+  {
+    if (nullptr != m_ops && nullptr != m_ops->destroy) {
+      m_ops->destroy(m_storage);
+    }
+    m_ops = nullptr;
+    m_hash = EMPTY_HASH;
+  }
+
+
+  static constexpr std::size_t EMPTY_HASH = static_cast<std::size_t>(-1);
+
+  alignas(std::max_align_t)
+  unsigned char                 m_storage[detail::CALLBACK_INLINE_SIZE] = {};
+  detail::callback_ops const *  m_ops = nullptr;
+  std::size_t                   m_hash = EMPTY_HASH;
 };
 
 
+
+/**
+ * Data callbacks receive data the scheduler read on their behalf; see
+ * scheduler::start_reading(). They are not compared or hashed, as there can
+ * be only one per connector.
+ **/
+using data_callback = std::function<
+  error_t (time_point const & now, events_t events, connector * conn,
+      buffer data)
+>;
+
+
 } // namespace packeteer
 
 
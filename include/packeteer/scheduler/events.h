@@ -47,13 +47,24 @@ enum PACKETEER_API : events_t
   PEV_IO_CLOSE   = (1 <<  4),  // A handle has been closed. This event
                                // cannot be reliably reported, consider it
                                // informative only.
+  PEV_IO_HIGH_WATERMARK = (1 <<  5),  // The scheduler's write queue for a
+                                      // connector reached its high watermark.
+                                      // See scheduler::enqueue_write().
+  PEV_IO_LOW_WATERMARK  = (1 <<  6),  // The write queue drained to its low
+                                      // watermark again.
 
   PEV_TIMEOUT    = (1 <<  7),  // A timout has been reached that the callback was
                                // registered for.
   PEV_ERROR      = (1 <<  8),  // Internal scheduler error.
+  PEV_SIGNAL     = (1 <<  9),  // A signal the callback was registered for
+                               // was received. See
+                               // scheduler::register_signal().
+  PEV_IO_ZEROCOPY = (1 << 10), // Zero-copy sends on a connector completed.
+                               // See connector::zerocopy_completions().
 
   PEV_ALL_BUILTIN = PEV_IO_READ | PEV_IO_WRITE | PEV_IO_ERROR | PEV_IO_OPEN
-      | PEV_IO_CLOSE | PEV_TIMEOUT | PEV_ERROR,
+      | PEV_IO_CLOSE | PEV_IO_HIGH_WATERMARK | PEV_IO_LOW_WATERMARK
+      | PEV_TIMEOUT | PEV_ERROR | PEV_SIGNAL | PEV_IO_ZEROCOPY,
 
   PEV_USER       = (1 << 15), // A user-defined event was fired (see below).
 };
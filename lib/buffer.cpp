@@ -0,0 +1,115 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <build-config.h>
+
+#include <packeteer/buffer.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "scheduler/buffer_pool.h"
+
+namespace packeteer {
+
+buffer::buffer(detail::buffer_block * block, char const * data, size_t size)
+  : m_block{block}
+  , m_data{data}
+  , m_size{size}
+{
+}
+
+
+
+buffer::~buffer()
+{
+  detail::buffer_block::unref(m_block);
+}
+
+
+
+buffer::buffer(buffer const & other)
+  : m_block{detail::buffer_block::ref(other.m_block)}
+  , m_data{other.m_data}
+  , m_size{other.m_size}
+{
+}
+
+
+
+buffer::buffer(buffer && other) noexcept
+  : m_block{std::exchange(other.m_block, nullptr)}
+  , m_data{std::exchange(other.m_data, nullptr)}
+  , m_size{std::exchange(other.m_size, 0)}
+{
+}
+
+
+
+buffer &
+buffer::operator=(buffer const & other)
+{
+  if (this != &other) {
+    auto block = detail::buffer_block::ref(other.m_block);
+    detail::buffer_block::unref(m_block);
+    m_block = block;
+    m_data = other.m_data;
+    m_size = other.m_size;
+  }
+  return *this;
+}
+
+
+
+buffer &
+buffer::operator=(buffer && other) noexcept
+{
+  if (this != &other) {
+    detail::buffer_block::unref(m_block);
+    m_block = std::exchange(other.m_block, nullptr);
+    m_data = std::exchange(other.m_data, nullptr);
+    m_size = std::exchange(other.m_size, 0);
+  }
+  return *this;
+}
+
+
+
+buffer
+buffer::slice(size_t offset, size_t size) const
+{
+  if (offset >= m_size) {
+    return {};
+  }
+  size = std::min(size, m_size - offset);
+  return buffer{detail::buffer_block::ref(m_block), m_data + offset, size};
+}
+
+
+
+void
+buffer::reset()
+{
+  detail::buffer_block::unref(m_block);
+  m_block = nullptr;
+  m_data = nullptr;
+  m_size = 0;
+}
+
+} // namespace packeteer
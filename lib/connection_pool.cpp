@@ -0,0 +1,478 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <build-config.h>
+
+#include <packeteer/connection_pool.h>
+
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <liberate/net/url.h>
+
+#include <packeteer/error.h>
+
+#include "macros.h"
+
+namespace packeteer {
+
+namespace {
+
+// Events that indicate a connector is no longer usable.
+constexpr events_t FAILURE_EVENTS = PEV_IO_ERROR | PEV_IO_CLOSE;
+
+} // anonymous namespace
+
+
+/*****************************************************************************
+ * Connection pool implementation
+ **/
+struct connection_pool::connection_pool_impl
+{
+  struct idle_entry
+  {
+    connector   conn;
+    time_point  since;
+  };
+
+  struct peer_state
+  {
+    // The back is the most recently released connector.
+    std::vector<idle_entry> idle = {};
+    std::vector<connector>  connecting = {};
+    size_t                  in_use = 0;
+
+    inline size_t total() const
+    {
+      return idle.size() + connecting.size() + in_use;
+    }
+  };
+
+  std::shared_ptr<api>                        m_api;
+  scheduler &                                 m_scheduler;
+  settings                                    m_settings;
+
+  mutable std::mutex                          m_mutex;
+  std::map<peer_address, peer_state>          m_peers;
+  std::unordered_map<connector, peer_address> m_leased;
+
+  // Callbacks only hold weak references, so the scheduler may invoke them
+  // after the pool is gone.
+  callback                                    m_idle_callback;
+  callback                                    m_connect_callback;
+  callback                                    m_evict_callback;
+
+
+  connection_pool_impl(std::shared_ptr<api> api, scheduler & sched,
+      settings const & pool_settings)
+    : m_api{api}
+    , m_scheduler{sched}
+    , m_settings{pool_settings}
+  {
+  }
+
+
+
+  void start(std::weak_ptr<connection_pool_impl> self)
+  {
+    m_idle_callback = [self](time_point const &, events_t, connector * conn)
+      -> error_t
+    {
+      auto impl = self.lock();
+      if (impl && conn) {
+        impl->on_idle_event(*conn);
+      }
+      return ERR_SUCCESS;
+    };
+
+    m_connect_callback = [self](time_point const &, events_t events,
+        connector * conn) -> error_t
+    {
+      auto impl = self.lock();
+      if (impl && conn) {
+        impl->on_connect_event(*conn, events);
+      }
+      return ERR_SUCCESS;
+    };
+
+    if (m_settings.idle_timeout <= duration{0}) {
+      return;
+    }
+
+    m_evict_callback = [self](time_point const & now, events_t, connector *)
+      -> error_t
+    {
+      auto impl = self.lock();
+      if (impl) {
+        impl->evict(now);
+      }
+      return ERR_SUCCESS;
+    };
+
+    // Checking at half the timeout keeps connectors from idling much longer
+    // than requested.
+    auto interval = m_settings.idle_timeout / 2;
+    m_scheduler.schedule(clock::now() + interval, interval, m_evict_callback);
+  }
+
+
+
+  void stop()
+  {
+    if (m_settings.idle_timeout > duration{0}) {
+      m_scheduler.unschedule(m_evict_callback);
+    }
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    for (auto & [peer, state] : m_peers) {
+      for (auto & entry : state.idle) {
+        discard(entry.conn, PEV_IO_READ | FAILURE_EVENTS, m_idle_callback);
+      }
+      for (auto & conn : state.connecting) {
+        discard(conn, PEV_IO_WRITE | FAILURE_EVENTS, m_connect_callback);
+      }
+    }
+    m_peers.clear();
+  }
+
+
+
+  /**
+   * Helpers; all expect the mutex to be held.
+   **/
+  void discard(connector & conn, events_t events, callback const & cb)
+  {
+    m_scheduler.unregister_connector(events, conn, cb);
+    conn.close();
+  }
+
+
+
+  void make_idle(peer_state & state, connector const & conn,
+      time_point const & now)
+  {
+    state.idle.push_back({conn, now});
+    m_scheduler.register_connector(PEV_IO_READ | FAILURE_EVENTS, conn,
+        m_idle_callback);
+  }
+
+
+
+  void forget_if_unused(peer_address const & peer)
+  {
+    auto iter = m_peers.find(peer);
+    if (iter != m_peers.end() && !iter->second.total()) {
+      m_peers.erase(iter);
+    }
+  }
+
+
+
+  error_t create(peer_address const & peer, connector & conn)
+  {
+    auto url_str = peer.str();
+    if (!m_settings.parameters.empty()) {
+      url_str += "?" + m_settings.parameters;
+    }
+
+    try {
+      // Pooled connectors never block, whatever the parameters say.
+      auto url = liberate::net::url::parse(url_str);
+      url.query["blocking"] = "0";
+      conn = connector{m_api, url};
+    } catch (std::invalid_argument const & ex) {
+      EXC_LOG("Could not parse pooled connector URL", ex);
+      return ERR_FORMAT;
+    } catch (exception const & ex) {
+      EXC_LOG("Could not create pooled connector", ex);
+      return ex.code();
+    }
+
+    if (!(conn.get_options() & CO_STREAM)) {
+      ELOG("Only stream connectors can be pooled: " << url_str);
+      return ERR_INVALID_OPTION;
+    }
+
+    return conn.connect();
+  }
+
+
+
+  /**
+   * Callbacks
+   **/
+  void on_idle_event(connector const & conn)
+  {
+    // An idle connection the peer closed or sent data on cannot be used for
+    // another request.
+    std::lock_guard<std::mutex> lock{m_mutex};
+    for (auto & [peer, state] : m_peers) {
+      for (auto iter = state.idle.begin() ; iter != state.idle.end() ; ++iter) {
+        if (iter->conn == conn) {
+          DLOG("Discarding idle connector to " << peer);
+          discard(iter->conn, PEV_IO_READ | FAILURE_EVENTS, m_idle_callback);
+          state.idle.erase(iter);
+          forget_if_unused(peer);
+          return;
+        }
+      }
+    }
+  }
+
+
+
+  void on_connect_event(connector const & conn, events_t events)
+  {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    for (auto & [peer, state] : m_peers) {
+      for (auto iter = state.connecting.begin()
+          ; iter != state.connecting.end() ; ++iter)
+      {
+        if (*iter != conn) {
+          continue;
+        }
+
+        auto pending = *iter;
+        state.connecting.erase(iter);
+        m_scheduler.unregister_connector(PEV_IO_WRITE | FAILURE_EVENTS,
+            pending, m_connect_callback);
+
+        if (events & FAILURE_EVENTS
+            || state.idle.size() >= m_settings.max_idle_per_peer)
+        {
+          DLOG("Dropping pre-warmed connector to " << peer);
+          pending.close();
+          forget_if_unused(peer);
+        }
+        else {
+          make_idle(state, pending, clock::now());
+        }
+        return;
+      }
+    }
+  }
+
+
+
+  void evict(time_point const & now)
+  {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    for (auto iter = m_peers.begin() ; iter != m_peers.end() ; ) {
+      auto & idle = iter->second.idle;
+
+      // Entries are ordered by release time, so expired ones are in front.
+      size_t expired = 0;
+      while (expired < idle.size()
+          && now - idle[expired].since >= m_settings.idle_timeout)
+      {
+        discard(idle[expired].conn, PEV_IO_READ | FAILURE_EVENTS,
+            m_idle_callback);
+        ++expired;
+      }
+      idle.erase(idle.begin(), idle.begin() + expired);
+
+      if (!iter->second.total()) {
+        iter = m_peers.erase(iter);
+      }
+      else {
+        ++iter;
+      }
+    }
+  }
+};
+
+
+
+/*****************************************************************************
+ * Connection pool
+ **/
+connection_pool::connection_pool(std::shared_ptr<api> api, scheduler & sched)
+  : connection_pool{api, sched, settings{}}
+{
+}
+
+
+
+connection_pool::connection_pool(std::shared_ptr<api> api, scheduler & sched,
+    settings const & pool_settings)
+  : m_impl{std::make_shared<connection_pool_impl>(api, sched, pool_settings)}
+{
+  m_impl->start(m_impl);
+}
+
+
+
+connection_pool::~connection_pool()
+{
+  m_impl->stop();
+}
+
+
+
+error_t
+connection_pool::acquire(peer_address const & peer, connector & conn)
+{
+  std::lock_guard<std::mutex> lock{m_impl->m_mutex};
+  auto & state = m_impl->m_peers[peer];
+
+  error_t err = ERR_SUCCESS;
+  if (!state.idle.empty()) {
+    conn = state.idle.back().conn;
+    state.idle.pop_back();
+    m_impl->m_scheduler.unregister_connector(PEV_IO_READ | FAILURE_EVENTS,
+        conn, m_impl->m_idle_callback);
+  }
+  else {
+    if (state.total() >= m_impl->m_settings.max_per_peer) {
+      return ERR_NUM_ITEMS;
+    }
+
+    err = m_impl->create(peer, conn);
+    if (ERR_SUCCESS != err && ERR_ASYNC != err) {
+      m_impl->forget_if_unused(peer);
+      return err;
+    }
+  }
+
+  ++state.in_use;
+  m_impl->m_leased[conn] = peer;
+  return err;
+}
+
+
+
+error_t
+connection_pool::release(connector const & conn, bool reusable)
+{
+  std::lock_guard<std::mutex> lock{m_impl->m_mutex};
+  auto leased = m_impl->m_leased.find(conn);
+  if (leased == m_impl->m_leased.end()) {
+    return ERR_INVALID_VALUE;
+  }
+  auto peer = leased->second;
+  m_impl->m_leased.erase(leased);
+
+  auto & state = m_impl->m_peers[peer];
+  --state.in_use;
+
+  if (reusable && conn.connected()
+      && state.idle.size() < m_impl->m_settings.max_idle_per_peer)
+  {
+    m_impl->make_idle(state, conn, clock::now());
+  }
+  else {
+    auto copy = conn;
+    copy.close();
+    m_impl->forget_if_unused(peer);
+  }
+  return ERR_SUCCESS;
+}
+
+
+
+error_t
+connection_pool::prewarm(peer_address const & peer, size_t count)
+{
+  std::lock_guard<std::mutex> lock{m_impl->m_mutex};
+  auto & state = m_impl->m_peers[peer];
+
+  size_t started = 0;
+  for ( ; started < count ; ++started) {
+    if (state.total() >= m_impl->m_settings.max_per_peer) {
+      break;
+    }
+
+    connector conn;
+    auto err = m_impl->create(peer, conn);
+    if (ERR_SUCCESS == err) {
+      m_impl->make_idle(state, conn, clock::now());
+    }
+    else if (ERR_ASYNC == err) {
+      state.connecting.push_back(conn);
+      m_impl->m_scheduler.register_connector(PEV_IO_WRITE | FAILURE_EVENTS,
+          conn, m_impl->m_connect_callback);
+    }
+    else {
+      m_impl->forget_if_unused(peer);
+      return err;
+    }
+  }
+
+  if (count && !started) {
+    m_impl->forget_if_unused(peer);
+    return ERR_NUM_ITEMS;
+  }
+  return ERR_SUCCESS;
+}
+
+
+
+void
+connection_pool::clear()
+{
+  std::lock_guard<std::mutex> lock{m_impl->m_mutex};
+  for (auto iter = m_impl->m_peers.begin() ; iter != m_impl->m_peers.end() ; ) {
+    for (auto & entry : iter->second.idle) {
+      m_impl->discard(entry.conn, PEV_IO_READ | FAILURE_EVENTS,
+          m_impl->m_idle_callback);
+    }
+    iter->second.idle.clear();
+
+    if (!iter->second.total()) {
+      iter = m_impl->m_peers.erase(iter);
+    }
+    else {
+      ++iter;
+    }
+  }
+}
+
+
+
+size_t
+connection_pool::idle(peer_address const & peer) const
+{
+  std::lock_guard<std::mutex> lock{m_impl->m_mutex};
+  auto iter = m_impl->m_peers.find(peer);
+  return iter == m_impl->m_peers.end() ? 0 : iter->second.idle.size();
+}
+
+
+
+size_t
+connection_pool::in_use(peer_address const & peer) const
+{
+  std::lock_guard<std::mutex> lock{m_impl->m_mutex};
+  auto iter = m_impl->m_peers.find(peer);
+  return iter == m_impl->m_peers.end() ? 0 : iter->second.in_use;
+}
+
+
+
+size_t
+connection_pool::connecting(peer_address const & peer) const
+{
+  std::lock_guard<std::mutex> lock{m_impl->m_mutex};
+  auto iter = m_impl->m_peers.find(peer);
+  return iter == m_impl->m_peers.end() ? 0 : iter->second.connecting.size();
+}
+
+} // namespace packeteer
@@ -31,6 +31,7 @@
 #endif
 
 #include <cctype>
+#include <mutex>
 
 #include <stdlib.h>
 
@@ -44,6 +45,10 @@
 
 #include "macros.h"
 
+#if defined(PACKETEER_POSIX)
+#include "connector/posix/socket.h"
+#endif
+
 namespace packeteer {
 
 /*****************************************************************************
@@ -58,20 +63,26 @@ struct connector::connector_impl
   connector_options         m_possible_options;
   registry::scheme_creator  m_creator;
 
-  liberate::net::url        m_url;
   connector_interface *     m_iconn;
 
   size_t                    m_hash_seed = rand();
   size_t                    m_hash_cache = 0;
 
+  // Once the connector listens or connects, or if it was created from an
+  // address, the connect URL follows the peer address. It is formatted only
+  // when requested; query and fragment are kept.
+  mutable std::mutex          m_url_mutex;
+  mutable liberate::net::url  m_url;
+  mutable bool                m_url_from_peer = false;
+
   connector_impl(std::shared_ptr<api> api, liberate::net::url const & connect_url,
       connector_interface * iconn)
     : m_api(api)
     , m_type(CT_UNSPEC)
     , m_default_options(CO_DEFAULT)
     , m_possible_options(CO_DEFAULT)
-    , m_url(connect_url)
     , m_iconn(iconn)
+    , m_url(connect_url)
   {
     // We don't really need to validate the address here any further, because
     // it's not set by an outside caller - it comes directly from this file, or
@@ -87,13 +98,45 @@ struct connector::connector_impl
 
 
 
+  connector_impl(connector_impl const & parent,
+      liberate::net::url const & connect_url, connector_interface * iconn)
+    : m_api(parent.m_api)
+    , m_type(parent.m_type)
+    , m_default_options(parent.m_default_options)
+    , m_possible_options(parent.m_possible_options)
+    , m_creator(parent.m_creator)
+    , m_iconn(iconn)
+    , m_url(connect_url)
+  {
+    // Connectors returned by accept() share the scheme with the listening
+    // connector, so there is no need to consult the registry again.
+    update_hash();
+  }
+
+
+
+  connector_impl(connector_impl const & parent, connector_interface * iconn)
+    : m_api(parent.m_api)
+    , m_type(parent.m_type)
+    , m_default_options(parent.m_default_options)
+    , m_possible_options(parent.m_possible_options)
+    , m_creator(parent.m_creator)
+    , m_iconn(iconn)
+    , m_url_from_peer(true)
+  {
+    // As above, but the URL is that of the accepted peer.
+    update_hash();
+  }
+
+
+
   connector_impl(std::shared_ptr<api> api, liberate::net::url const & connect_url)
     : m_api(api)
     , m_type(CT_UNSPEC)
     , m_default_options(CO_DEFAULT)
     , m_possible_options(CO_DEFAULT)
-    , m_url(connect_url)
     , m_iconn(nullptr)
+    , m_url(connect_url)
   {
     // Find the scheme spec
     auto info = m_api->reg().info_for_scheme(m_url.scheme);
@@ -102,29 +145,9 @@ struct connector::connector_impl
     m_possible_options = info.possible_options;
     m_creator = info.creator;
 
-    // Set options - this may be overridden.
-    connector_options options = m_default_options;
-
     // Check if there is a "options" parameter in the url.
-    auto requested = m_api->reg().options_from_query(m_url.query);
-    if (requested != CO_DEFAULT) {
-      // Ensure the requested value is valid.
-      if (!(m_possible_options & requested)) {
-        throw exception(ERR_FORMAT, "The requested options are not supported "
-            "by the connector type!");
-      }
-      options = requested;
-    }
-
-    // Sanity check options - the flags are mutually exclusive.
-    if (options & CO_STREAM and options & CO_DATAGRAM) {
-      throw exception(ERR_INVALID_OPTION, "Cannot choose both stream and "
-          "datagram behaviour!");
-    }
-    if (options & CO_BLOCKING and options & CO_NON_BLOCKING) {
-      throw exception(ERR_INVALID_OPTION, "Cannot choose both blocking and "
-          "non-blocking mode!");
-    }
+    auto options = select_options(
+        m_api->reg().options_from_query(m_url.query));
     DLOG("Got connector options: " << options << " for type " << ctype);
 
     // Try to create the implementation
@@ -142,6 +165,46 @@ struct connector::connector_impl
 
 
 
+  connector_impl(std::shared_ptr<api> api, peer_address const & address,
+      connector_options const & requested)
+    : m_api(api)
+    , m_type(address.conn_type())
+    , m_default_options(CO_DEFAULT)
+    , m_possible_options(CO_DEFAULT)
+    , m_iconn(nullptr)
+    , m_url_from_peer(true)
+  {
+    // Find the type spec
+    auto info = m_api->reg().info_for_type(m_type);
+    m_default_options = info.default_options;
+    m_possible_options = info.possible_options;
+    m_creator = info.creator;
+
+    auto options = select_options(requested);
+    DLOG("Got connector options: " << options << " for type " << m_type);
+
+    // Try to create the implementation; schemes that cannot be created from
+    // an address get the URL it formats to.
+    connector_interface * iconn = nullptr;
+    if (info.from_address) {
+      iconn = info.from_address(m_api, address, options, &info);
+    }
+    else {
+      auto url = liberate::net::url::parse(address.str());
+      iconn = m_creator(m_api, url, m_type, options, &info);
+    }
+    if (!iconn) {
+      throw exception(ERR_INITIALIZATION, "Could not instantiate connector "
+          "scheme.");
+    }
+
+    m_iconn = iconn;
+
+    update_hash();
+  }
+
+
+
   ~connector_impl()
   {
     delete m_iconn;
@@ -173,24 +236,78 @@ struct connector::connector_impl
   }
 
 
+  connector_options select_options(connector_options requested) const
+  {
+    // Set options - this may be overridden.
+    connector_options options = m_default_options;
+
+    if (requested != CO_DEFAULT) {
+      // Ensure the requested value is valid.
+      if (!(m_possible_options & requested)) {
+        throw exception(ERR_FORMAT, "The requested options are not supported "
+            "by the connector type!");
+      }
+      options = requested;
+    }
+
+    // Sanity check options - the flags are mutually exclusive.
+    if (options & CO_STREAM and options & CO_DATAGRAM) {
+      throw exception(ERR_INVALID_OPTION, "Cannot choose both stream and "
+          "datagram behaviour!");
+    }
+    if (options & CO_BLOCKING and options & CO_NON_BLOCKING) {
+      throw exception(ERR_INVALID_OPTION, "Cannot choose both blocking and "
+          "non-blocking mode!");
+    }
+    return options;
+  }
+
+
   inline void update_url_from_peer()
   {
-    auto new_url = liberate::net::url::parse(m_iconn->peer_addr().str());
+    std::lock_guard<std::mutex> lock{m_url_mutex};
+    m_url_from_peer = true;
+  }
+
+
+  liberate::net::url url() const
+  {
+    std::lock_guard<std::mutex> lock{m_url_mutex};
+    if (!m_url_from_peer) {
+      return m_url;
+    }
+    m_url_from_peer = false;
+
+    // IP peers only differ in the authority, so there is no need to
+    // format and parse a whole URL.
+    auto peer = m_iconn->peer_addr();
+    liberate::net::url new_url;
+    auto type = peer.socket_address().type();
+    if (liberate::net::AT_INET4 == type || liberate::net::AT_INET6 == type) {
+      new_url.scheme = peer.scheme_cstr();
+      new_url.authority = peer.socket_address().full_str();
+    }
+    else {
+      new_url = liberate::net::url::parse(peer.str());
+    }
     new_url.query = m_url.query;
     new_url.fragment = m_url.fragment;
     if (m_url != new_url) {
       m_url = new_url;
       LIBLOG_DEBUG("Connect URL changed to: " << m_url);
     }
+    return m_url;
   }
 
 
   void update_hash()
   {
+    // The seed already distinguishes connectors, so the address does not
+    // need to be hashed.
     size_t value = liberate::cpp::multi_hash(
         m_hash_seed,
         static_cast<int>(m_type),
-        m_url);
+        reinterpret_cast<size_t>(this));
 
     m_hash_cache = value;
   }
@@ -218,6 +335,24 @@ connector::connector(std::shared_ptr<api> api, liberate::net::url const & connec
 }
 
 
+
+connector::connector(std::shared_ptr<api> api, peer_address const & address,
+    connector_options const & options)
+  : m_impl{std::make_shared<connector_impl>(api, address, options)}
+{
+}
+
+
+
+connector::connector(std::shared_ptr<api> api, connector_type type,
+    liberate::net::socket_address const & address,
+    connector_options const & options)
+  : m_impl{std::make_shared<connector_impl>(api,
+      peer_address{api, type, address}, options)}
+{
+}
+
+
 connector_type
 connector::type() const
 {
@@ -235,7 +370,7 @@ connector::connect_url() const
   if (!m_impl) {
     throw exception(ERR_INITIALIZATION, "Connector not initialized.");
   }
-  return m_impl->m_url;
+  return m_impl->url();
 }
 
 
@@ -292,6 +427,25 @@ connector::connect()
 
 
 
+error_t
+connector::connect_with_data(void const * buf, size_t bufsize,
+    size_t & bytes_written)
+{
+  if (!m_impl || !*m_impl) {
+    return ERR_INITIALIZATION;
+  }
+  if (!buf && bufsize) {
+    return ERR_INVALID_VALUE;
+  }
+  auto err = (*m_impl)->connect_with_data(buf, bufsize, bytes_written);
+  if (ERR_SUCCESS == err) {
+    m_impl->update_url_from_peer();
+  }
+  return err;
+}
+
+
+
 bool
 connector::listening() const
 {
@@ -348,7 +502,56 @@ connector::accept() const
 
   liberate::net::socket_address peer;
   connector_interface * iconn = (*m_impl)->accept(peer);
+  return wrap_accepted(iconn, peer);
+}
+
+
+
+error_t
+connector::accept_many(std::vector<connector> & out, size_t max) const
+{
+  if (!m_impl || !*m_impl) {
+    throw exception(ERR_INITIALIZATION, "Can't accept() an uninitialized "
+        "connector!");
+  }
 
+  if (!listening()) {
+    throw exception(ERR_UNSUPPORTED_ACTION, "Can't accept() on a non-server "
+        "connector!");
+  }
+
+  size_t accepted = 0;
+  while (accepted < max) {
+    liberate::net::socket_address peer;
+    connector_interface * iconn = (*m_impl)->accept(peer);
+    if (!iconn) {
+      // Backlog drained, or the next request failed; either way, the
+      // scheduler will report the connector again if anything is pending.
+      break;
+    }
+
+    out.push_back(wrap_accepted(iconn, peer));
+    ++accepted;
+
+    // Connectors returning themselves would do so forever, and blocking
+    // ones would wait for the next connection request.
+    if (iconn == m_impl->m_iconn || is_blocking()) {
+      break;
+    }
+  }
+
+  if (!accepted) {
+    return ERR_REPEAT_ACTION;
+  }
+  return ERR_SUCCESS;
+}
+
+
+
+connector
+connector::wrap_accepted(connector_interface * iconn,
+    liberate::net::socket_address const & peer) const
+{
   // 1. If we have a socket address in the result, that'll be the best choice
   //    for the implementation's address. Otherwise pass this object's address
   //    (e.g. for anon connectors).
@@ -363,8 +566,8 @@ connector::accept() const
     }
     else {
       // Address is identical, but connector is not
-      result.m_impl = std::make_shared<connector_impl>(m_impl->m_api,
-          m_impl->m_url, iconn);
+      result.m_impl = std::make_shared<connector_impl>(*m_impl,
+          m_impl->url(), iconn);
     }
   }
   else {
@@ -377,11 +580,10 @@ connector::accept() const
           "with new peer address.");
     }
 
-    auto peer_addr = m_impl->m_url.scheme + "://" + peer.full_str();
-    DLOG("Peer address is: " << peer_addr << " - " << iconn);
+    // The accepted connector's URL is only formatted when requested.
+    DLOG("Peer address is: " << peer << " - " << iconn);
 
-    result.m_impl = std::make_shared<connector_impl>(m_impl->m_api,
-        liberate::net::url::parse(peer_addr), iconn);
+    result.m_impl = std::make_shared<connector_impl>(*m_impl, iconn);
   }
 
   return result;
@@ -446,7 +648,7 @@ connector::receive(void * buf, size_t bufsize, size_t & bytes_read,
 
   error_t err = (*m_impl)->receive(buf, bufsize, bytes_read,
       sender.socket_address());
-  sender.conn_type() = (*m_impl)->peer_addr().conn_type();
+  sender.assign_type((*m_impl)->peer_addr());
   return err;
 }
 
@@ -465,6 +667,172 @@ connector::send(void const * buf, size_t bufsize, size_t & bytes_written,
 
 
 
+error_t
+connector::receive(io_buffer const * bufs, size_t bufcount,
+    size_t & bytes_read, liberate::net::socket_address & sender)
+{
+  if (!m_impl || !*m_impl) {
+    return ERR_INITIALIZATION;
+  }
+  return (*m_impl)->receive(bufs, bufcount, bytes_read, sender);
+}
+
+
+
+error_t
+connector::send(const_io_buffer const * bufs, size_t bufcount,
+    size_t & bytes_written, liberate::net::socket_address const & recipient)
+{
+  if (!m_impl || !*m_impl) {
+    return ERR_INITIALIZATION;
+  }
+  return (*m_impl)->send(bufs, bufcount, bytes_written, recipient);
+}
+
+
+
+error_t
+connector::receive(io_buffer const * bufs, size_t bufcount,
+    size_t & bytes_read, peer_address & sender)
+{
+  if (!m_impl || !*m_impl) {
+    return ERR_INITIALIZATION;
+  }
+
+  error_t err = (*m_impl)->receive(bufs, bufcount, bytes_read,
+      sender.socket_address());
+  sender.assign_type((*m_impl)->peer_addr());
+  return err;
+}
+
+
+
+error_t
+connector::send(const_io_buffer const * bufs, size_t bufcount,
+    size_t & bytes_written, peer_address const & recipient)
+{
+  if (!m_impl || !*m_impl) {
+    return ERR_INITIALIZATION;
+  }
+  return (*m_impl)->send(bufs, bufcount, bytes_written,
+      recipient.socket_address());
+}
+
+
+
+error_t
+connector::receive_batch(datagram_message * messages, size_t count,
+    size_t & received)
+{
+  if (!m_impl || !*m_impl) {
+    return ERR_INITIALIZATION;
+  }
+  return (*m_impl)->receive_batch(messages, count, received);
+}
+
+
+
+error_t
+connector::send_batch(const_datagram_message * messages, size_t count,
+    size_t & sent)
+{
+  if (!m_impl || !*m_impl) {
+    return ERR_INITIALIZATION;
+  }
+  return (*m_impl)->send_batch(messages, count, sent);
+}
+
+
+
+error_t
+connector::receive(void * buf, size_t bufsize, size_t & bytes_read,
+    liberate::net::socket_address & sender, size_t & segment_size)
+{
+  if (!m_impl || !*m_impl) {
+    return ERR_INITIALIZATION;
+  }
+  return (*m_impl)->receive(buf, bufsize, bytes_read, sender, segment_size);
+}
+
+
+
+error_t
+connector::send(void const * buf, size_t bufsize, size_t & bytes_written,
+    liberate::net::socket_address const & recipient, size_t segment_size)
+{
+  if (!m_impl || !*m_impl) {
+    return ERR_INITIALIZATION;
+  }
+  return (*m_impl)->send(buf, bufsize, bytes_written, recipient,
+      segment_size);
+}
+
+
+
+error_t
+connector::receive(void * buf, size_t bufsize, size_t & bytes_read,
+    peer_address & sender, size_t & segment_size)
+{
+  if (!m_impl || !*m_impl) {
+    return ERR_INITIALIZATION;
+  }
+
+  error_t err = (*m_impl)->receive(buf, bufsize, bytes_read,
+      sender.socket_address(), segment_size);
+  sender.assign_type((*m_impl)->peer_addr());
+  return err;
+}
+
+
+
+error_t
+connector::send(void const * buf, size_t bufsize, size_t & bytes_written,
+    peer_address const & recipient, size_t segment_size)
+{
+  if (!m_impl || !*m_impl) {
+    return ERR_INITIALIZATION;
+  }
+  return (*m_impl)->send(buf, bufsize, bytes_written,
+      recipient.socket_address(), segment_size);
+}
+
+
+
+error_t
+connector::write_zerocopy(void const * buf, size_t bufsize,
+    size_t & bytes_written, uint32_t & sequence)
+{
+  if (!m_impl || !*m_impl) {
+    return ERR_INITIALIZATION;
+  }
+  return (*m_impl)->write_zerocopy(buf, bufsize, bytes_written, sequence);
+}
+
+
+
+error_t
+connector::zerocopy_completions(zerocopy_completion * completions,
+    size_t count, size_t & received)
+{
+  if (!m_impl || !*m_impl) {
+    return ERR_INITIALIZATION;
+  }
+  return (*m_impl)->zerocopy_completions(completions, count, received);
+}
+
+
+
+error_t
+connector::collect_zerocopy_completions(size_t & collected) const
+{
+  if (!m_impl || !*m_impl) {
+    return ERR_INITIALIZATION;
+  }
+  return (*m_impl)->collect_zerocopy_completions(collected);
+}
+
+
+
 size_t
 connector::peek() const
 {
@@ -498,6 +866,66 @@ connector::write(void const * buf, size_t bufsize, size_t & bytes_written)
 
 
 
+error_t
+connector::read(io_buffer const * bufs, size_t bufcount, size_t & bytes_read)
+{
+  if (!m_impl || !*m_impl) {
+    return ERR_INITIALIZATION;
+  }
+  return (*m_impl)->read(bufs, bufcount, bytes_read);
+}
+
+
+
+error_t
+connector::write(const_io_buffer const * bufs, size_t bufcount,
+    size_t & bytes_written)
+{
+  if (!m_impl || !*m_impl) {
+    return ERR_INITIALIZATION;
+  }
+  return (*m_impl)->write(bufs, bufcount, bytes_written);
+}
+
+
+
+error_t
+connector::read(read_lease & lease)
+{
+  if (!m_impl || !*m_impl) {
+    return ERR_INITIALIZATION;
+  }
+  return (*m_impl)->read(lease);
+}
+
+
+
+error_t
+connector::release(read_lease & lease)
+{
+  if (!m_impl || !*m_impl) {
+    return ERR_INITIALIZATION;
+  }
+  return (*m_impl)->release(lease);
+}
+
+
+
+error_t
+connector::splice_to(connector & dst, size_t max, size_t & transferred,
+    splice_flags flags /* = SF_DEFAULT */)
+{
+  if (!m_impl || !*m_impl) {
+    return ERR_INITIALIZATION;
+  }
+  if (!dst.m_impl || !*dst.m_impl) {
+    return ERR_INVALID_VALUE;
+  }
+  return (*m_impl)->splice_to(*dst.m_impl->m_iconn, max, transferred, flags);
+}
+
+
+
 error_t
 connector::close()
 {
@@ -592,4 +1020,82 @@ operator<<(std::ostream & ostream, connector const & conn)
 }
 
 
+
+error_t
+listen_group(std::shared_ptr<api> api, liberate::net::url const & connect_url,
+    size_t count, std::vector<connector> & listeners, bool steer_by_cpu)
+{
+  listeners.clear();
+  if (!count) {
+    return ERR_INVALID_VALUE;
+  }
+
+  auto url = connect_url;
+  url.query["reuseport"] = "1";
+
+  // Members join the group in the order they start listening, which is the
+  // order steering refers to.
+  std::vector<connector> group;
+  try {
+    for (size_t i = 0 ; i < count ; ++i) {
+      connector conn{api, url};
+      switch (conn.type()) {
+        case CT_TCP4:
+        case CT_TCP6:
+        case CT_TCP:
+        case CT_UDP4:
+        case CT_UDP6:
+        case CT_UDP:
+          break;
+
+        default:
+          ELOG("Listener groups are not supported for " << url.scheme
+              << " connectors.");
+          return ERR_INVALID_OPTION;
+      }
+      auto err = conn.listen();
+      if (ERR_SUCCESS != err) {
+        return err;
+      }
+      group.push_back(conn);
+    }
+  } catch (exception const & ex) {
+    EXC_LOG("Could not create listener group", ex);
+    return ex.code();
+  }
+
+  if (steer_by_cpu) {
+#if defined(PACKETEER_POSIX)
+    auto err = detail::steer_reuseport_group(group[0].get_read_handle(),
+        count);
+    if (ERR_SUCCESS != err) {
+      return err;
+    }
+#else
+    ELOG("Steering connections to listener group members is not supported "
+        "on this platform.");
+    return ERR_UNSUPPORTED_ACTION;
+#endif
+  }
+
+  listeners.swap(group);
+  return ERR_SUCCESS;
+}
+
+
+
+error_t
+listen_group(std::shared_ptr<api> api, std::string const & connect_url,
+    size_t count, std::vector<connector> & listeners, bool steer_by_cpu)
+{
+  liberate::net::url url;
+  try {
+    url = liberate::net::url::parse(connect_url);
+  } catch (std::invalid_argument const & ex) {
+    ELOG("Bad listener group URL: " << ex.what());
+    return ERR_FORMAT;
+  }
+  return listen_group(api, url, count, listeners, steer_by_cpu);
+}
+
 } // namespace packeteer
@@ -29,6 +29,9 @@
 #  include "posix/udp.h"
 #  include "posix/local.h"
 #  include "posix/fifo.h"
+#  if defined(PACKETEER_HAVE_SIGNALFD)
+#    include "posix/signal.h"
+#  endif
 #else
 #  include "win32/anon.h"
 #  include "win32/tcp.h"
@@ -0,0 +1,329 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <build-config.h>
+
+#include <packeteer/connector/interface.h>
+
+#include "../globals.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace packeteer {
+
+namespace {
+
+template <typename bufT>
+inline size_t
+total_size(bufT const * bufs, size_t bufcount)
+{
+  size_t total = 0;
+  for (size_t i = 0 ; i < bufcount ; ++i) {
+    total += bufs[i].size;
+  }
+  return total;
+}
+
+
+
+inline std::vector<char>
+gather(const_io_buffer const * bufs, size_t bufcount)
+{
+  std::vector<char> result;
+  result.reserve(total_size(bufs, bufcount));
+  for (size_t i = 0 ; i < bufcount ; ++i) {
+    auto start = static_cast<char const *>(bufs[i].data);
+    result.insert(result.end(), start, start + bufs[i].size);
+  }
+  return result;
+}
+
+
+
+inline void
+scatter(io_buffer const * bufs, size_t bufcount, char const * source,
+    size_t amount)
+{
+  size_t offset = 0;
+  for (size_t i = 0 ; i < bufcount && offset < amount ; ++i) {
+    size_t chunk = std::min(bufs[i].size, amount - offset);
+    std::memcpy(bufs[i].data, source + offset, chunk);
+    offset += chunk;
+  }
+}
+
+} // anonymous namespace
+
+
+
+error_t
+connector_interface::receive(io_buffer const * bufs, size_t bufcount,
+    size_t & bytes_read, ::liberate::net::socket_address & sender)
+{
+  if (!bufs || !bufcount) {
+    return ERR_INVALID_VALUE;
+  }
+  if (bufcount == 1) {
+    return receive(bufs[0].data, bufs[0].size, bytes_read, sender);
+  }
+
+  std::vector<char> tmp(total_size(bufs, bufcount));
+  auto err = receive(tmp.data(), tmp.size(), bytes_read, sender);
+  if (ERR_SUCCESS == err) {
+    scatter(bufs, bufcount, tmp.data(), bytes_read);
+  }
+  return err;
+}
+
+
+
+error_t
+connector_interface::send(const_io_buffer const * bufs, size_t bufcount,
+    size_t & bytes_written, ::liberate::net::socket_address const & recipient)
+{
+  if (!bufs || !bufcount) {
+    return ERR_INVALID_VALUE;
+  }
+  if (bufcount == 1) {
+    return send(bufs[0].data, bufs[0].size, bytes_written, recipient);
+  }
+
+  auto tmp = gather(bufs, bufcount);
+  return send(tmp.data(), tmp.size(), bytes_written, recipient);
+}
+
+
+
+error_t
+connector_interface::read(io_buffer const * bufs, size_t bufcount,
+    size_t & bytes_read)
+{
+  if (!bufs || !bufcount) {
+    return ERR_INVALID_VALUE;
+  }
+  if (bufcount == 1) {
+    return read(bufs[0].data, bufs[0].size, bytes_read);
+  }
+
+  std::vector<char> tmp(total_size(bufs, bufcount));
+  auto err = read(tmp.data(), tmp.size(), bytes_read);
+  if (ERR_SUCCESS == err) {
+    scatter(bufs, bufcount, tmp.data(), bytes_read);
+  }
+  return err;
+}
+
+
+
+error_t
+connector_interface::write(const_io_buffer const * bufs, size_t bufcount,
+    size_t & bytes_written)
+{
+  if (!bufs || !bufcount) {
+    return ERR_INVALID_VALUE;
+  }
+  if (bufcount == 1) {
+    return write(bufs[0].data, bufs[0].size, bytes_written);
+  }
+
+  auto tmp = gather(bufs, bufcount);
+  return write(tmp.data(), tmp.size(), bytes_written);
+}
+
+
+
+error_t
+connector_interface::receive_batch(datagram_message * messages, size_t count,
+    size_t & received)
+{
+  if (!messages || !count) {
+    return ERR_INVALID_VALUE;
+  }
+
+  received = 0;
+  for ( ; received < count ; ++received) {
+    auto & msg = messages[received];
+    auto err = receive(msg.buffer.data, msg.buffer.size, msg.length,
+        msg.address);
+    if (ERR_SUCCESS != err) {
+      // Report only the first message's error; otherwise the caller will
+      // see it on the next call.
+      return received ? ERR_SUCCESS : err;
+    }
+  }
+  return ERR_SUCCESS;
+}
+
+
+
+error_t
+connector_interface::send_batch(const_datagram_message * messages,
+    size_t count, size_t & sent)
+{
+  if (!messages || !count) {
+    return ERR_INVALID_VALUE;
+  }
+
+  sent = 0;
+  for ( ; sent < count ; ++sent) {
+    auto & msg = messages[sent];
+    auto err = send(msg.buffer.data, msg.buffer.size, msg.length,
+        msg.address);
+    if (ERR_SUCCESS != err) {
+      return sent ? ERR_SUCCESS : err;
+    }
+  }
+  return ERR_SUCCESS;
+}
+
+
+
+error_t
+connector_interface::receive(void * buf, size_t bufsize, size_t & bytes_read,
+    ::liberate::net::socket_address & sender, size_t & segment_size)
+{
+  auto err = receive(buf, bufsize, bytes_read, sender);
+  if (ERR_SUCCESS == err) {
+    segment_size = bytes_read;
+  }
+  return err;
+}
+
+
+
+error_t
+connector_interface::send(void const * buf, size_t bufsize,
+    size_t & bytes_written, ::liberate::net::socket_address const & recipient,
+    size_t segment_size)
+{
+  if (!segment_size || segment_size >= bufsize) {
+    return send(buf, bufsize, bytes_written, recipient);
+  }
+
+  auto start = static_cast<char const *>(buf);
+  bytes_written = 0;
+  while (bytes_written < bufsize) {
+    size_t amount = 0;
+    auto err = send(start + bytes_written,
+        std::min(segment_size, bufsize - bytes_written), amount, recipient);
+    if (ERR_SUCCESS != err) {
+      return bytes_written ? ERR_SUCCESS : err;
+    }
+    bytes_written += amount;
+  }
+  return ERR_SUCCESS;
+}
+
+
+
+error_t
+connector_interface::write_zerocopy(void const *, size_t, size_t &,
+    uint32_t &)
+{
+  return ERR_UNSUPPORTED_ACTION;
+}
+
+
+
+error_t
+connector_interface::zerocopy_completions(zerocopy_completion *, size_t,
+    size_t &)
+{
+  return ERR_UNSUPPORTED_ACTION;
+}
+
+
+
+error_t
+connector_interface::collect_zerocopy_completions(size_t &)
+{
+  return ERR_UNSUPPORTED_ACTION;
+}
+
+
+
+error_t
+connector_interface::read(read_lease & lease)
+{
+  // Reuse the buffer of a previously released lease, if there is one.
+  std::unique_ptr<char[]> buf = std::move(m_lease_buffer);
+  if (!buf) {
+    buf.reset(new char[PACKETEER_READ_LEASE_SIZE]);
+  }
+
+  size_t amount = 0;
+  auto err = read(buf.get(), PACKETEER_READ_LEASE_SIZE, amount);
+  if (ERR_SUCCESS != err) {
+    m_lease_buffer = std::move(buf);
+    return err;
+  }
+
+  lease.data = buf.get();
+  lease.size = amount;
+  lease.context = buf.release();
+  return ERR_SUCCESS;
+}
+
+
+
+error_t
+connector_interface::release(read_lease & lease)
+{
+  if (!lease.context) {
+    return ERR_INVALID_VALUE;
+  }
+
+  std::unique_ptr<char[]> buf{static_cast<char *>(lease.context)};
+  if (!m_lease_buffer) {
+    m_lease_buffer = std::move(buf);
+  }
+  lease = read_lease{};
+  return ERR_SUCCESS;
+}
+
+
+
+error_t
+connector_interface::connect_with_data(void const * buf, size_t bufsize,
+    size_t & bytes_written)
+{
+  bytes_written = 0;
+
+  // If the connection is still being established, the caller has to write
+  // the data once it is.
+  auto err = connect();
+  if (ERR_SUCCESS != err || !bufsize) {
+    return err;
+  }
+  return write(buf, bufsize, bytes_written);
+}
+
+
+
+error_t
+connector_interface::splice_to(connector_interface &, size_t, size_t &,
+    splice_flags)
+{
+  return ERR_UNSUPPORTED_ACTION;
+}
+
+} // namespace packeteer
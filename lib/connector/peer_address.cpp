@@ -23,7 +23,9 @@
 #include <packeteer/registry.h>
 
 #include <unordered_map>
+#include <unordered_set>
 #include <algorithm>
+#include <mutex>
 
 #include <liberate/cpp/hash.h>
 
@@ -103,8 +105,10 @@ best_match(connector_type const & ct_type,
       break;
 
     case CT_ANON:
+    case CT_SIGNAL:
     case CT_UNSPEC:
-      // Anonymous pipes need unspecified address; so does CT_UNSPEC
+      // Anonymous pipes and signal connectors need unspecified address; so
+      // does CT_UNSPEC
       if (liberate::net::AT_UNSPEC == sa_type) {
         return ct_type;
       }
@@ -174,12 +178,28 @@ initialize_from_url(
 }
 
 
+
+/**
+ * Schemes are few, so they're interned for the lifetime of the process. The
+ * set's elements never move, so the pointers stay valid.
+ **/
+char const *
+intern_scheme(std::string const & scheme)
+{
+  static std::mutex mutex;
+  static std::unordered_set<std::string> schemes;
+
+  std::lock_guard<std::mutex> lock{mutex};
+  return schemes.insert(scheme).first->c_str();
+}
+
+
 } // anonymous namespace
 
 peer_address::peer_address()
   : m_sockaddr()
   , m_connector_type(CT_UNSPEC)
-  , m_scheme()
+  , m_scheme("")
 {
 }
 
@@ -188,6 +208,7 @@ peer_address::peer_address()
 peer_address::peer_address(std::shared_ptr<api> api, std::string const & address)
   : m_sockaddr()
   , m_connector_type(CT_UNSPEC)
+  , m_scheme("")
 {
   // Try to get the best content type from the scheme, and how the address parses
   auto url = liberate::net::url::parse(address);
@@ -197,7 +218,7 @@ peer_address::peer_address(std::shared_ptr<api> api, std::string const & address
 
   // Try again, this time with the determined content type
   info = api->reg().info_for_type(m_connector_type);
-  m_scheme = info.scheme;
+  m_scheme = intern_scheme(info.scheme);
 }
 
 
@@ -205,6 +226,7 @@ peer_address::peer_address(std::shared_ptr<api> api, std::string const & address
 peer_address::peer_address(std::shared_ptr<api> api, liberate::net::url const & url)
   : m_sockaddr()
   , m_connector_type(CT_UNSPEC)
+  , m_scheme("")
 {
   // Try to get the best content type from the scheme, and how the address parses
   auto info = api->reg().info_for_scheme(url.scheme);
@@ -213,7 +235,19 @@ peer_address::peer_address(std::shared_ptr<api> api, liberate::net::url const &
 
   // Try again, this time with the determined content type
   info = api->reg().info_for_type(m_connector_type);
-  m_scheme = info.scheme;
+  m_scheme = intern_scheme(info.scheme);
+}
+
+
+
+peer_address::peer_address(std::shared_ptr<api> api, connector_type type,
+    liberate::net::socket_address const & address)
+  : m_sockaddr(address)
+  , m_connector_type(verify_best(type, address.type()))
+  , m_scheme("")
+{
+  auto info = api->reg().info_for_type(m_connector_type);
+  m_scheme = intern_scheme(info.scheme);
 }
 
 
@@ -242,6 +276,23 @@ peer_address::scheme() const
 
 
 
+char const *
+peer_address::scheme_cstr() const
+{
+  return m_scheme;
+}
+
+
+
+void
+peer_address::assign_type(peer_address const & other)
+{
+  m_connector_type = other.m_connector_type;
+  m_scheme = other.m_scheme;
+}
+
+
+
 std::string
 peer_address::str() const
 {
@@ -252,7 +303,7 @@ peer_address::str() const
       str = tmp + (str.c_str() + 1);
     }
   }
-  return m_scheme + "://" + str;
+  return std::string{m_scheme} + "://" + str;
 }
 
 
@@ -288,6 +339,7 @@ peer_address::swap(peer_address & other)
 {
   std::swap(m_sockaddr, other.m_sockaddr);
   std::swap(m_connector_type, other.m_connector_type);
+  std::swap(m_scheme, other.m_scheme);
 }
 
 
@@ -23,19 +23,23 @@
 #include <packeteer/connector/interface.h>
 
 #include "common.h"
+#include "splice.h"
 
 #include "../../macros.h"
+#include "../../globals.h"
 #include "../../net/netincludes.h"
 
 #include <unistd.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 
-namespace packeteer::detail {
-
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
 
-namespace {
+namespace packeteer::detail {
 
-inline error_t
+error_t
 translate_errno()
   OCLINT_SUPPRESS("high cyclomatic complexity]")
 {
@@ -77,6 +81,126 @@ translate_errno()
 
 }
 
+
+
+error_t
+translate_receive_errno()
+{
+  switch (errno) {
+    case EDESTADDRREQ: // Nont connection-mode socket, but no peer given.
+    case EISCONN: // Connection-mode socket.
+      return ERR_INVALID_OPTION;
+
+    case EMSGSIZE: // Message size is too large
+      return ERR_INVALID_VALUE;
+
+    case ENOBUFS: // Send buffer overflow
+      return ERR_NUM_ITEMS;
+
+    default:
+      return translate_errno();
+  }
+}
+
+
+
+namespace {
+
+// Our buffer types must be interchangeable with iovec.
+static_assert(sizeof(io_buffer) == sizeof(::iovec));
+static_assert(offsetof(io_buffer, data) == offsetof(::iovec, iov_base));
+static_assert(offsetof(io_buffer, size) == offsetof(::iovec, iov_len));
+static_assert(sizeof(const_io_buffer) == sizeof(::iovec));
+static_assert(offsetof(const_io_buffer, data) == offsetof(::iovec, iov_base));
+static_assert(offsetof(const_io_buffer, size) == offsetof(::iovec, iov_len));
+
+
+
+template <typename readT>
+inline error_t
+read_loop(readT && read_func, size_t & bytes_read)
+  OCLINT_SUPPRESS("high cyclomatic complexity")
+{
+  while (true) {
+    ssize_t read = read_func();
+    if (-1 != read) {
+      bytes_read = read;
+      return ERR_SUCCESS;
+    }
+
+    bytes_read = 0;
+
+    if (errno == EAGAIN) {
+      return ERR_ASYNC;
+    }
+
+    ERRNO_LOG("Error reading from file descriptor");
+    switch (errno) {
+      case EINTR: // handle signal interrupts
+        continue;
+
+      case EBADF:
+      case EINVAL:
+        // The file descriptor is invalid for some reason.
+        return ERR_INVALID_VALUE;
+
+      case EFAULT:
+        // Technically, OOM and out of disk space/file size.
+        return ERR_OUT_OF_MEMORY;
+
+      case EIO:
+      case EISDIR:
+      default:
+        return ERR_UNEXPECTED;
+    }
+  }
+
+  PACKETEER_FLOW_CONTROL_GUARD;
+}
+
+
+
+template <typename writeT>
+inline error_t
+write_loop(writeT && write_func, size_t & bytes_written)
+  OCLINT_SUPPRESS("high cyclomatic complexity")
+{
+  while (true) {
+    ssize_t written = write_func();
+    if (-1 != written) {
+      bytes_written = written;
+      return ERR_SUCCESS;
+    }
+
+    bytes_written = 0;
+
+    ERRNO_LOG("Error writing to file descriptor");
+    switch (errno) {
+      case EINTR: // handle signal interrupts
+        continue;
+
+      case EBADF:
+      case EINVAL:
+      case EDESTADDRREQ:
+      case EPIPE:
+        // The file descriptor is invalid for some reason.
+        return ERR_INVALID_VALUE;
+
+      case EFAULT:
+      case EFBIG:
+      case ENOSPC:
+        // Technically, OOM and out of disk space/file size.
+        return ERR_OUT_OF_MEMORY;
+
+      case EIO:
+      default:
+        return ERR_UNEXPECTED;
+    }
+  }
+
+  PACKETEER_FLOW_CONTROL_GUARD;
+}
+
 } // anonymous namespace
 
 
@@ -96,9 +220,6 @@ connector_common::~connector_common()
 }
 
 
-// XXX how about handling multiple receive calls for different peers in one
-//     iovec style call?
-
 error_t
 connector_common::receive(void * buf, size_t bufsize, size_t & bytes_read,
       liberate::net::socket_address & sender)
@@ -109,20 +230,7 @@ connector_common::receive(void * buf, size_t bufsize, size_t & bytes_read,
 
   if (amount < 0) {
     ERRNO_LOG("recvfrom failed!");
-    switch (errno) {
-      case EDESTADDRREQ: // Nont connection-mode socket, but no peer given.
-      case EISCONN: // Connection-mode socket.
-        return ERR_INVALID_OPTION;
-
-      case EMSGSIZE: // Message size is too large
-        return ERR_INVALID_VALUE;
-
-      case ENOBUFS: // Send buffer overflow
-        return ERR_NUM_ITEMS;
-
-      default:
-        return translate_errno();
-    }
+    return translate_receive_errno();
   }
 
   bytes_read = amount;
@@ -149,6 +257,165 @@ connector_common::send(void const * buf, size_t bufsize,
 
 
 
+error_t
+connector_common::receive(io_buffer const * bufs, size_t bufcount,
+    size_t & bytes_read, liberate::net::socket_address & sender)
+{
+  if (!bufs || !bufcount) {
+    return ERR_INVALID_VALUE;
+  }
+
+  ::msghdr msg{};
+  msg.msg_name = sender.buffer();
+  msg.msg_namelen = sender.bufsize_available();
+  msg.msg_iov = const_cast<::iovec *>(reinterpret_cast<::iovec const *>(bufs));
+  msg.msg_iovlen = bufcount;
+
+  ssize_t amount = ::recvmsg(get_read_handle().sys_handle(), &msg,
+      MSG_DONTWAIT);
+  if (amount < 0) {
+    ERRNO_LOG("recvmsg failed!");
+    return translate_receive_errno();
+  }
+
+  bytes_read = amount;
+  return ERR_SUCCESS;
+}
+
+
+
+error_t
+connector_common::send(const_io_buffer const * bufs, size_t bufcount,
+    size_t & bytes_written, liberate::net::socket_address const & recipient)
+{
+  if (!bufs || !bufcount) {
+    return ERR_INVALID_VALUE;
+  }
+
+  ::msghdr msg{};
+  msg.msg_name = const_cast<void *>(recipient.buffer());
+  msg.msg_namelen = recipient.bufsize();
+  msg.msg_iov = const_cast<::iovec *>(reinterpret_cast<::iovec const *>(bufs));
+  msg.msg_iovlen = bufcount;
+
+  ssize_t amount = ::sendmsg(get_write_handle().sys_handle(), &msg,
+      MSG_DONTWAIT);
+  if (amount < 0) {
+    ERRNO_LOG("sendmsg failed!");
+    return translate_errno();
+  }
+
+  bytes_written = amount;
+  return ERR_SUCCESS;
+}
+
+
+
+#if defined(PACKETEER_HAVE_RECVMMSG)
+error_t
+connector_common::receive_batch(datagram_message * messages, size_t count,
+    size_t & received)
+{
+  if (!messages || !count) {
+    return ERR_INVALID_VALUE;
+  }
+
+  ::mmsghdr msgs[PACKETEER_MMSG_BATCH_SIZE];
+  received = 0;
+  while (received < count) {
+    size_t chunk = std::min<size_t>(count - received,
+        PACKETEER_MMSG_BATCH_SIZE);
+
+    std::memset(msgs, 0, sizeof(::mmsghdr) * chunk);
+    for (size_t i = 0 ; i < chunk ; ++i) {
+      auto & msg = messages[received + i];
+      auto & hdr = msgs[i].msg_hdr;
+      hdr.msg_name = msg.address.buffer();
+      hdr.msg_namelen = msg.address.bufsize_available();
+      hdr.msg_iov = reinterpret_cast<::iovec *>(&msg.buffer);
+      hdr.msg_iovlen = 1;
+    }
+
+    int amount = ::recvmmsg(get_read_handle().sys_handle(), msgs, chunk,
+        MSG_DONTWAIT, nullptr);
+    if (amount < 0) {
+      if (received) {
+        // Report the error on the next call instead.
+        break;
+      }
+      ERRNO_LOG("recvmmsg failed!");
+      return translate_receive_errno();
+    }
+
+    for (int i = 0 ; i < amount ; ++i) {
+      messages[received + i].length = msgs[i].msg_len;
+    }
+    received += amount;
+
+    if (static_cast<size_t>(amount) < chunk) {
+      // Nothing more is pending.
+      break;
+    }
+  }
+
+  return ERR_SUCCESS;
+}
+#endif // PACKETEER_HAVE_RECVMMSG
+
+
+
+#if defined(PACKETEER_HAVE_SENDMMSG)
+error_t
+connector_common::send_batch(const_datagram_message * messages, size_t count,
+    size_t & sent)
+{
+  if (!messages || !count) {
+    return ERR_INVALID_VALUE;
+  }
+
+  ::mmsghdr msgs[PACKETEER_MMSG_BATCH_SIZE];
+  sent = 0;
+  while (sent < count) {
+    size_t chunk = std::min<size_t>(count - sent, PACKETEER_MMSG_BATCH_SIZE);
+
+    std::memset(msgs, 0, sizeof(::mmsghdr) * chunk);
+    for (size_t i = 0 ; i < chunk ; ++i) {
+      auto & msg = messages[sent + i];
+      auto & hdr = msgs[i].msg_hdr;
+      hdr.msg_name = const_cast<void *>(msg.address.buffer());
+      hdr.msg_namelen = msg.address.bufsize();
+      hdr.msg_iov = const_cast<::iovec *>(
+          reinterpret_cast<::iovec const *>(&msg.buffer));
+      hdr.msg_iovlen = 1;
+    }
+
+    int amount = ::sendmmsg(get_write_handle().sys_handle(), msgs, chunk,
+        MSG_DONTWAIT);
+    if (amount < 0) {
+      if (sent) {
+        break;
+      }
+      ERRNO_LOG("sendmmsg failed!");
+      return translate_errno();
+    }
+
+    for (int i = 0 ; i < amount ; ++i) {
+      messages[sent + i].length = msgs[i].msg_len;
+    }
+    sent += amount;
+
+    if (static_cast<size_t>(amount) < chunk) {
+      // The socket buffer is full.
+      break;
+    }
+  }
+
+  return ERR_SUCCESS;
+}
+#endif // PACKETEER_HAVE_SENDMMSG
+
+
+
 size_t
 connector_common::peek() const
 {
@@ -185,97 +452,100 @@ connector_common::peek() const
 
 error_t
 connector_common::read(void * buf, size_t bufsize, size_t & bytes_read)
-  OCLINT_SUPPRESS("high cyclomatic complexity")
 {
   if (!connected() && !listening()) {
     return ERR_INITIALIZATION;
   }
 
-  while (true) {
-    ssize_t read = ::read(get_read_handle().sys_handle(), buf, bufsize);
-    if (-1 != read) {
-      bytes_read = read;
-      return ERR_SUCCESS;
-    }
+  auto fd = get_read_handle().sys_handle();
+  return read_loop([fd, buf, bufsize]() -> ssize_t
+  {
+    return ::read(fd, buf, bufsize);
+  }, bytes_read);
+}
 
-    bytes_read = 0;
 
-    if (errno == EAGAIN) {
-      return ERR_ASYNC;
-    }
 
-    ERRNO_LOG("Error reading from file descriptor");
-    switch (errno) {
-      case EINTR: // handle signal interrupts
-        continue;
+error_t
+connector_common::write(void const * buf, size_t bufsize,
+    size_t & bytes_written)
+{
+  if (!connected() && !listening()) {
+    return ERR_INITIALIZATION;
+  }
 
-      case EBADF:
-      case EINVAL:
-        // The file descriptor is invalid for some reason.
-        return ERR_INVALID_VALUE;
+  auto fd = get_write_handle().sys_handle();
+  return write_loop([fd, buf, bufsize]() -> ssize_t
+  {
+    return ::write(fd, buf, bufsize);
+  }, bytes_written);
+}
 
-      case EFAULT:
-        // Technically, OOM and out of disk space/file size.
-        return ERR_OUT_OF_MEMORY;
 
-      case EIO:
-      case EISDIR:
-      default:
-        return ERR_UNEXPECTED;
-    }
+
+error_t
+connector_common::read(io_buffer const * bufs, size_t bufcount,
+    size_t & bytes_read)
+{
+  if (!connected() && !listening()) {
+    return ERR_INITIALIZATION;
+  }
+  if (!bufs || !bufcount) {
+    return ERR_INVALID_VALUE;
   }
 
-  PACKETEER_FLOW_CONTROL_GUARD;
+  auto fd = get_read_handle().sys_handle();
+  auto iov = reinterpret_cast<::iovec const *>(bufs);
+  return read_loop([fd, iov, bufcount]() -> ssize_t
+  {
+    return ::readv(fd, iov, bufcount);
+  }, bytes_read);
 }
 
 
 
 error_t
-connector_common::write(void const * buf, size_t bufsize,
+connector_common::write(const_io_buffer const * bufs, size_t bufcount,
     size_t & bytes_written)
-  OCLINT_SUPPRESS("high cyclomatic complexity")
 {
   if (!connected() && !listening()) {
     return ERR_INITIALIZATION;
   }
+  if (!bufs || !bufcount) {
+    return ERR_INVALID_VALUE;
+  }
 
-  while (true) {
-    ssize_t written = ::write(get_write_handle().sys_handle(), buf, bufsize);
-    if (-1 != written) {
-      bytes_written = written;
-      return ERR_SUCCESS;
-    }
-
-    bytes_written = 0;
-
-    ERRNO_LOG("Error writing to file descriptor");
-    switch (errno) {
-      case EINTR: // handle signal interrupts
-        continue;
+  auto fd = get_write_handle().sys_handle();
+  auto iov = reinterpret_cast<::iovec const *>(bufs);
+  return write_loop([fd, iov, bufcount]() -> ssize_t
+  {
+    return ::writev(fd, iov, bufcount);
+  }, bytes_written);
+}
 
-      case EBADF:
-      case EINVAL:
-      case EDESTADDRREQ:
-      case EPIPE:
-        // The file descriptor is invalid for some reason.
-        return ERR_INVALID_VALUE;
 
-      case EFAULT:
-      case EFBIG:
-      case ENOSPC:
-        // Technically, OOM and out of disk space/file size.
-        return ERR_OUT_OF_MEMORY;
 
-      case EIO:
-      default:
-        return ERR_UNEXPECTED;
-    }
+error_t
+connector_common::splice_to(connector_interface & dst, size_t max,
+    size_t & transferred, splice_flags flags)
+{
+  transferred = 0;
+  if (!connected() && !listening()) {
+    return ERR_INITIALIZATION;
+  }
+  if (!dst.connected() && !dst.listening()) {
+    return ERR_INVALID_VALUE;
   }
 
-  PACKETEER_FLOW_CONTROL_GUARD;
+  if (!m_splice) {
+    m_splice = std::make_unique<splice_state>();
+  }
+  return m_splice->transfer(get_read_handle().sys_handle(),
+      dst.get_write_handle().sys_handle(), max, transferred, flags);
 }
 
 
+
 connector_options
 connector_common::get_options() const
 {
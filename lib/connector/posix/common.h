@@ -24,12 +24,25 @@
 #error You are trying to include a C++ only header file
 #endif
 
+#include <build-config.h>
+
 #include <packeteer.h>
 
 #include <packeteer/connector/interface.h>
 
+#include <memory>
+
 namespace packeteer::detail {
 
+struct splice_state;
+
+/**
+ * Translate errno after failed socket calls to error_t. The receive variant
+ * maps a few errors differently.
+ **/
+error_t translate_errno();
+error_t translate_receive_errno();
+
 /**
  * TCP connector
  **/
@@ -50,6 +63,29 @@ public:
   error_t read(void * buf, size_t bufsize, size_t & bytes_read) override;
   error_t write(void const * buf, size_t bufsize, size_t & bytes_written) override;
 
+  error_t receive(io_buffer const * bufs, size_t bufcount, size_t & bytes_read,
+      ::liberate::net::socket_address & sender) override;
+  error_t send(const_io_buffer const * bufs, size_t bufcount,
+      size_t & bytes_written,
+      ::liberate::net::socket_address const & recipient) override;
+
+  error_t read(io_buffer const * bufs, size_t bufcount,
+      size_t & bytes_read) override;
+  error_t write(const_io_buffer const * bufs, size_t bufcount,
+      size_t & bytes_written) override;
+
+#if defined(PACKETEER_HAVE_RECVMMSG)
+  error_t receive_batch(datagram_message * messages, size_t count,
+      size_t & received) override;
+#endif
+#if defined(PACKETEER_HAVE_SENDMMSG)
+  error_t send_batch(const_datagram_message * messages, size_t count,
+      size_t & sent) override;
+#endif
+
+  error_t splice_to(connector_interface & dst, size_t max,
+      size_t & transferred, splice_flags flags) override;
+
   connector_options get_options() const override;
   peer_address peer_addr() const override;
 protected:
@@ -59,6 +95,9 @@ protected:
 
 private:
   connector_common();
+
+  // Created on the first splice_to() call.
+  std::unique_ptr<splice_state> m_splice;
 };
 
 } // namespace packeteer::detail
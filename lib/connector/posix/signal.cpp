@@ -0,0 +1,194 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <build-config.h>
+
+#include "signal.h"
+
+#include "fd.h"
+#include "../../macros.h"
+
+#include <packeteer/handle.h>
+
+#include <sys/signalfd.h>
+#include <unistd.h>
+#include <errno.h>
+
+
+namespace packeteer::detail {
+
+connector_signal::connector_signal(peer_address const & addr,
+    connector_options const & options)
+  : connector_common{addr, options}
+{
+}
+
+
+
+connector_signal::~connector_signal()
+{
+  connector_signal::close();
+}
+
+
+
+error_t
+connector_signal::create_signalfd()
+{
+  if (connected()) {
+    return ERR_INITIALIZATION;
+  }
+
+  sigset_t mask;
+  sigemptyset(&mask);
+
+  int flags = SFD_CLOEXEC;
+  if (!(m_options & CO_BLOCKING)) {
+    flags |= SFD_NONBLOCK;
+  }
+
+  int fd = ::signalfd(-1, &mask, flags);
+  if (-1 == fd) {
+    ERRNO_LOG("connector_signal signalfd failed!");
+    switch (errno) {
+      case EMFILE:
+      case ENFILE:
+        return ERR_NUM_FILES;
+
+      case ENOMEM:
+        return ERR_OUT_OF_MEMORY;
+
+      default:
+        return ERR_UNEXPECTED;
+    }
+  }
+
+  m_handle = handle{fd};
+
+  return ERR_SUCCESS;
+}
+
+
+
+error_t
+connector_signal::listen()
+{
+  return create_signalfd();
+}
+
+
+
+bool
+connector_signal::listening() const
+{
+  return connected();
+}
+
+
+
+error_t
+connector_signal::connect()
+{
+  return create_signalfd();
+}
+
+
+
+bool
+connector_signal::connected() const
+{
+  return m_handle.valid();
+}
+
+
+
+connector_interface *
+connector_signal::accept(liberate::net::socket_address & /* unused */)
+{
+  if (!connected()) {
+    return nullptr;
+  }
+  return this;
+}
+
+
+
+handle
+connector_signal::get_read_handle() const
+{
+  return m_handle;
+}
+
+
+
+handle
+connector_signal::get_write_handle() const
+{
+  // Writing is not possible, but I/O subsystems expect a valid handle here.
+  return m_handle;
+}
+
+
+
+error_t
+connector_signal::close()
+{
+  if (!connected()) {
+    return ERR_INITIALIZATION;
+  }
+
+  ::close(m_handle.sys_handle());
+  m_handle = handle{};
+
+  return ERR_SUCCESS;
+}
+
+
+
+bool
+connector_signal::is_blocking() const
+{
+  bool state = false;
+  error_t err = detail::get_blocking_mode(m_handle.sys_handle(), state);
+  if (ERR_SUCCESS != err) {
+    throw exception(err, "Could not determine blocking mode from file "
+        "descriptor!");
+  }
+  return state;
+}
+
+
+
+error_t
+set_signal_mask(handle const & handle, sigset_t const & mask)
+{
+  if (!handle.valid()) {
+    return ERR_INVALID_VALUE;
+  }
+
+  // Passing an existing descriptor replaces its mask; the flags are ignored.
+  int ret = ::signalfd(handle.sys_handle(), &mask, 0);
+  if (-1 == ret) {
+    ERRNO_LOG("Could not update signal mask");
+    return ERR_INVALID_VALUE;
+  }
+  return ERR_SUCCESS;
+}
+
+} // namespace packeteer::detail
@@ -0,0 +1,83 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef PACKETEER_CONNECTOR_POSIX_SIGNAL_H
+#define PACKETEER_CONNECTOR_POSIX_SIGNAL_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <packeteer.h>
+
+#include <build-config.h>
+
+#if !defined(PACKETEER_HAVE_SIGNALFD)
+#error signalfd not detected
+#endif
+
+#include <signal.h>
+
+#include "common.h"
+
+namespace packeteer::detail {
+
+/**
+ * Signal file descriptor (Linux). The signal mask starts out empty; use
+ * set_signal_mask() to change it.
+ **/
+struct connector_signal : public connector_common
+{
+public:
+  explicit connector_signal(peer_address const & addr, connector_options const & options);
+  ~connector_signal();
+
+  error_t listen() override;
+  bool listening() const override;
+
+  error_t connect() override;
+  bool connected() const override;
+
+  connector_interface * accept(liberate::net::socket_address & addr) override;
+
+  handle get_read_handle() const override;
+  handle get_write_handle() const override;
+
+  error_t close() override;
+
+  bool is_blocking() const override;
+
+private:
+  error_t create_signalfd();
+
+  handle  m_handle;
+};
+
+
+/**
+ * Replace the signal mask of a signal connector's handle. Note that signals
+ * must also be blocked with pthread_sigmask() in all threads, or they are
+ * delivered normally instead of via the handle.
+ **/
+error_t
+set_signal_mask(handle const & handle, sigset_t const & mask);
+
+} // namespace packeteer::detail
+
+#endif // guard
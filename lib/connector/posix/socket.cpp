@@ -31,6 +31,10 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 
+#if defined(PACKETEER_HAVE_REUSEPORT_CBPF)
+#include <linux/filter.h>
+#endif
+
 #include <unistd.h>
 #include <errno.h>
 #include <string.h>
@@ -112,20 +116,97 @@ create_socket(int domain, int type, int & fd, bool blocking)
 }
 
 
+
 } // anonymous namespace
 
 
 
+error_t
+steer_reuseport_group(handle const & member, size_t group_size)
+{
+  if (!member.valid() || !group_size) {
+    return ERR_INVALID_VALUE;
+  }
+
+#if defined(PACKETEER_HAVE_REUSEPORT_CBPF)
+  // The program's result is the index of the socket in the group to pick,
+  // in the order the sockets joined it. Pick the one for the current CPU.
+  ::sock_filter code[] = {
+    { BPF_LD | BPF_W | BPF_ABS, 0, 0, uint32_t(SKF_AD_OFF + SKF_AD_CPU) },
+    { BPF_ALU | BPF_MOD | BPF_K, 0, 0, uint32_t(group_size) },
+    { BPF_RET | BPF_A, 0, 0, 0 },
+  };
+  ::sock_fprog prog{};
+  prog.len = sizeof(code) / sizeof(code[0]);
+  prog.filter = code;
+
+  int ret = ::setsockopt(member.sys_handle(), SOL_SOCKET,
+      SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog));
+  if (ret >= 0) {
+    return ERR_SUCCESS;
+  }
+
+  ERRNO_LOG("Could not attach reuseport steering program");
+  switch (errno) {
+    case ENOPROTOOPT:
+    case EOPNOTSUPP:
+      return ERR_UNSUPPORTED_ACTION;
+
+    default:
+      return ERR_INVALID_OPTION;
+  }
+#else
+  ELOG("Steering connections to reuseport group members is not supported on "
+      "this platform.");
+  return ERR_UNSUPPORTED_ACTION;
+#endif
+}
+
+
+
 connector_socket::connector_socket(peer_address const & addr,
     connector_options const & options)
   : connector_common{addr, options}
+  , m_backlog{PACKETEER_LISTEN_BACKLOG}
+{
+}
+
+
+
+void
+connector_socket::set_tunables(registry::tunable_list && tunables,
+    int backlog)
 {
+  m_tunables = std::move(tunables);
+  m_backlog = backlog;
 }
 
 
 
 error_t
-connector_socket::socket_connect(int domain, int type)
+connector_socket::create_tuned_socket(int domain, int type, int & fd)
+{
+  error_t err = create_socket(domain, type, fd, m_options & CO_BLOCKING);
+  if (fd < 0) {
+    return err;
+  }
+
+  for (auto & tunable : m_tunables) {
+    err = tunable(fd);
+    if (ERR_SUCCESS != err) {
+      ::close(fd);
+      fd = -1;
+      return err;
+    }
+  }
+  return err;
+}
+
+
+
+error_t
+connector_socket::socket_connect(int domain, int type, void const * data,
+    size_t size, size_t * written)
   OCLINT_SUPPRESS("high ncss method")
   OCLINT_SUPPRESS("high npath complexity")
   OCLINT_SUPPRESS("high cyclomatic complexity")
@@ -143,17 +224,38 @@ connector_socket::socket_connect(int domain, int type)
 
   // First, create socket
   int fd = -1;
-  error_t err = create_socket(domain, type, fd, m_options & CO_BLOCKING);
+  error_t err = create_tuned_socket(domain, type, fd);
   if (fd < 0) {
     return err;
   }
 
+  if (written) {
+    *written = 0;
+  }
+
   // Now try to connect the socket with the path
   while (true) {
-    int ret = ::connect(fd,
-        reinterpret_cast<struct sockaddr const *>(
-          m_address.socket_address().buffer()),
-          m_address.socket_address().bufsize());
+    auto addr = reinterpret_cast<struct sockaddr const *>(
+        m_address.socket_address().buffer());
+    auto addrlen = m_address.socket_address().bufsize();
+
+    int ret = -1;
+#if defined(PACKETEER_HAVE_MSG_FASTOPEN)
+    if (data && written) {
+      // Connect and send in one go; without a cookie for the peer, the
+      // kernel only connects and reports EINPROGRESS.
+      auto sent = ::sendto(fd, data, size, MSG_FASTOPEN, addr, addrlen);
+      if (sent >= 0) {
+        *written = sent;
+        ret = 0;
+      }
+    }
+    else {
+      ret = ::connect(fd, addr, addrlen);
+    }
+#else
+    ret = ::connect(fd, addr, addrlen);
+#endif
     if (ret >= 0) {
       // Finally, set the fd
       m_fd = fd;
@@ -231,7 +333,7 @@ connector_socket::socket_create(int domain, int type, int & fd)
   }
 
   fd = -1;
-  error_t err = create_socket(domain, type, fd, m_options & CO_BLOCKING);
+  error_t err = create_tuned_socket(domain, type, fd);
   if (fd < 0) {
     return err;
   }
@@ -257,7 +359,7 @@ connector_socket::socket_bind(int domain, int type, int & fd)
 
   // First, create socket
   fd = -1;
-  error_t err = create_socket(domain, type, fd, m_options & CO_BLOCKING);
+  error_t err = create_tuned_socket(domain, type, fd);
   if (fd < 0) {
     return err;
   }
@@ -329,7 +431,7 @@ connector_socket::socket_listen(int fd)
   }
 
   // Turn the socket into a listening socket.
-  int ret = ::listen(fd, PACKETEER_LISTEN_BACKLOG);
+  int ret = ::listen(fd, m_backlog);
   if (ret >= 0) {
     return ERR_SUCCESS;
   }
@@ -428,7 +530,16 @@ connector_socket::socket_accept(int & new_fd, liberate::net::socket_address & ad
   ::socklen_t len = sizeof(buf);
 
   while (true) {
+#if defined(PACKETEER_HAVE_ACCEPT4)
+    // Set the blocking mode and close-on-exec flag in the same system call.
+    int flags = SOCK_CLOEXEC;
+    if (!(m_options & CO_BLOCKING)) {
+      flags |= SOCK_NONBLOCK;
+    }
+    new_fd = ::accept4(m_fd, reinterpret_cast<sockaddr *>(&buf), &len, flags);
+#else
     new_fd = ::accept(m_fd, reinterpret_cast<sockaddr *>(&buf), &len);
+#endif
     if (new_fd >= 0) {
       break;
     }
@@ -482,6 +593,7 @@ connector_socket::socket_accept(int & new_fd, liberate::net::socket_address & ad
     }
   }
 
+#if !defined(PACKETEER_HAVE_ACCEPT4)
   // Make new socket nonblocking
   error_t err = detail::set_blocking_mode(new_fd, m_options & CO_BLOCKING);
   if (ERR_SUCCESS != err) {
@@ -489,6 +601,7 @@ connector_socket::socket_accept(int & new_fd, liberate::net::socket_address & ad
     new_fd = -1;
     return err;
   }
+#endif
 
   // Keep address and return success.
   addr = liberate::net::socket_address(&buf, len);
@@ -26,6 +26,8 @@
 
 #include <packeteer.h>
 
+#include <packeteer/registry.h>
+
 #include "common.h"
 
 namespace packeteer::detail {
@@ -48,11 +50,18 @@ public:
 
   bool is_blocking() const override;
 
+  // Tunables are applied to every socket this connector creates; the
+  // backlog is used in socket_listen().
+  void set_tunables(registry::tunable_list && tunables, int backlog);
+
   // Socket-specific versions of connect() and accept()
   error_t socket_create(int domain, int type, int & fd);
   error_t socket_bind(int domain, int type, int & fd);
   error_t socket_listen(int fd);
-  error_t socket_connect(int domain, int type);
+  // With data, the connection request carries it via TCP Fast Open where
+  // available; written is set to the amount sent.
+  error_t socket_connect(int domain, int type, void const * data = nullptr,
+      size_t size = 0, size_t * written = nullptr);
   error_t socket_accept(int & new_fd, liberate::net::socket_address & addr);
   error_t socket_close();
 
@@ -60,8 +69,22 @@ protected:
   bool                              m_server = false;
   bool                              m_connected = false;
   int                               m_fd = -1;
+
+private:
+  error_t create_tuned_socket(int domain, int type, int & fd);
+
+  registry::tunable_list            m_tunables = {};
+  int                               m_backlog;
 };
 
+
+/**
+ * Attach a program to the SO_REUSEPORT group the member belongs to, which
+ * hands each new connection or datagram to the group_size sockets in turn,
+ * by the CPU it was received on. See listen_group().
+ **/
+error_t steer_reuseport_group(handle const & member, size_t group_size);
+
 } // namespace packeteer::detail
 
 #endif // guard
@@ -0,0 +1,289 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <build-config.h>
+
+#include "splice.h"
+#include "common.h"
+
+#include "../../globals.h"
+#include "../../macros.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#if defined(PACKETEER_HAVE_SPLICE)
+#include <sys/sendfile.h>
+#endif
+
+#include <algorithm>
+
+namespace packeteer::detail {
+
+namespace {
+
+inline error_t
+transfer_error(char const * what, bool to_destination)
+{
+  if (EAGAIN == errno || EWOULDBLOCK == errno) {
+    return to_destination ? ERR_ASYNC : ERR_REPEAT_ACTION;
+  }
+  ERRNO_LOG(what);
+  return translate_errno();
+}
+
+
+#if defined(PACKETEER_HAVE_SPLICE)
+// The internal pipe never blocks, as we only ever splice as much into it as
+// it holds, and out of it as much as it contains. Whether the call blocks is
+// up to the connectors' blocking mode.
+inline unsigned int
+splice_os_flags(splice_flags flags)
+{
+  unsigned int result = SPLICE_F_MOVE;
+  if (flags & SF_MORE) {
+    result |= SPLICE_F_MORE;
+  }
+  return result;
+}
+#endif // PACKETEER_HAVE_SPLICE
+
+} // anonymous namespace
+
+
+
+splice_state::~splice_state()
+{
+  if (m_pipe[0] >= 0) {
+    ::close(m_pipe[0]);
+    ::close(m_pipe[1]);
+  }
+}
+
+
+
+error_t
+splice_state::transfer(int in, int out, size_t max, size_t & transferred,
+    splice_flags flags)
+{
+  transferred = 0;
+  if (!max) {
+    return ERR_INVALID_VALUE;
+  }
+
+  // Deliver whatever previous calls could not.
+  auto err = flush(out, transferred, flags);
+  if (ERR_SUCCESS != err || transferred >= max) {
+    return err;
+  }
+
+  if (out != m_out) {
+    m_out = out;
+    m_mode = select_mode(in);
+  }
+
+  size_t moved = 0;
+  err = move(in, out, max - transferred, moved, flags);
+  transferred += moved;
+
+  // Having delivered leftovers is a success, even if the source is empty.
+  if (ERR_REPEAT_ACTION == err && transferred) {
+    return ERR_SUCCESS;
+  }
+  return err;
+}
+
+
+
+splice_state::transfer_mode
+splice_state::select_mode(int in) const
+{
+#if defined(PACKETEER_HAVE_SPLICE)
+  struct stat sb;
+  if (::fstat(in, &sb) >= 0 && S_ISREG(sb.st_mode)) {
+    return MODE_SENDFILE;
+  }
+  return MODE_PIPE;
+#else
+  (void) in;
+  return MODE_COPY;
+#endif
+}
+
+
+
+error_t
+splice_state::move(int in, int out, size_t max, size_t & moved,
+    splice_flags flags)
+{
+  moved = 0;
+  max = std::min<size_t>(max, PACKETEER_SPLICE_CHUNK_SIZE);
+
+#if defined(PACKETEER_HAVE_SPLICE)
+  if (MODE_SENDFILE == m_mode) {
+    while (true) {
+      ssize_t ret = ::sendfile(out, in, nullptr, max);
+      if (ret >= 0) {
+        moved = ret;
+        return ERR_SUCCESS;
+      }
+      if (EINTR == errno) {
+        continue;
+      }
+      if (EINVAL != errno && ENOSYS != errno) {
+        // A regular file is always readable, so only the destination can
+        // block.
+        return transfer_error("sendfile() failed", true);
+      }
+      DLOG("Cannot sendfile() to " << out << ", falling back to copying.");
+      m_mode = MODE_COPY;
+      break;
+    }
+  }
+
+  if (MODE_PIPE == m_mode && open_pipe()) {
+    while (true) {
+      ssize_t ret = ::splice(in, nullptr, m_pipe[1], nullptr, max,
+          splice_os_flags(flags));
+      if (ret > 0) {
+        m_in_pipe = ret;
+        return flush(out, moved, flags);
+      }
+      if (0 == ret) {
+        // End of data.
+        return ERR_SUCCESS;
+      }
+      if (EINTR == errno) {
+        continue;
+      }
+      if (EINVAL != errno) {
+        // The pipe is empty, so only the source can block.
+        return transfer_error("splice() failed", false);
+      }
+      DLOG("Cannot splice() from " << in << ", falling back to copying.");
+      m_mode = MODE_COPY;
+      break;
+    }
+  }
+#endif // PACKETEER_HAVE_SPLICE
+
+  m_mode = MODE_COPY;
+  m_buffer.resize(PACKETEER_SPLICE_CHUNK_SIZE);
+  while (true) {
+    ssize_t ret = ::read(in, m_buffer.data(), max);
+    if (ret > 0) {
+      m_offset = 0;
+      m_pending = ret;
+      return flush(out, moved, flags);
+    }
+    if (0 == ret) {
+      return ERR_SUCCESS;
+    }
+    if (EINTR == errno) {
+      continue;
+    }
+    return transfer_error("read() failed", false);
+  }
+}
+
+
+
+error_t
+splice_state::flush(int out, size_t & moved, splice_flags flags)
+{
+  moved = 0;
+
+#if defined(PACKETEER_HAVE_SPLICE)
+  while (m_in_pipe) {
+    ssize_t ret = ::splice(m_pipe[0], nullptr, out, nullptr, m_in_pipe,
+        splice_os_flags(flags));
+    if (ret > 0) {
+      m_in_pipe -= ret;
+      moved += ret;
+      continue;
+    }
+    if (ret < 0 && EINTR == errno) {
+      continue;
+    }
+    if (ret < 0 && EINVAL == errno) {
+      // The destination does not accept spliced data; move what is in the
+      // pipe into the buffer, and copy from now on.
+      DLOG("Cannot splice() to " << out << ", falling back to copying.");
+      m_mode = MODE_COPY;
+      m_buffer.resize(PACKETEER_SPLICE_CHUNK_SIZE);
+      ssize_t amount = ::read(m_pipe[0], m_buffer.data(), m_in_pipe);
+      if (amount < 0) {
+        ERRNO_LOG("Could not drain splice pipe");
+        return translate_errno();
+      }
+      m_offset = 0;
+      m_pending = amount;
+      m_in_pipe = 0;
+      break;
+    }
+    if (0 == ret) {
+      return ERR_UNEXPECTED;
+    }
+    return transfer_error("splice() failed", true);
+  }
+#else
+  (void) flags;
+#endif // PACKETEER_HAVE_SPLICE
+
+  while (m_pending) {
+    ssize_t ret = ::write(out, m_buffer.data() + m_offset, m_pending);
+    if (ret >= 0) {
+      m_offset += ret;
+      m_pending -= ret;
+      moved += ret;
+      continue;
+    }
+    if (EINTR == errno) {
+      continue;
+    }
+    return transfer_error("write() failed", true);
+  }
+
+  return ERR_SUCCESS;
+}
+
+
+
+bool
+splice_state::open_pipe()
+{
+#if defined(PACKETEER_HAVE_SPLICE)
+  if (m_pipe[0] >= 0) {
+    return true;
+  }
+  if (::pipe2(m_pipe, O_CLOEXEC | O_NONBLOCK) < 0) {
+    ERRNO_LOG("Could not create splice pipe, falling back to copying");
+    m_pipe[0] = m_pipe[1] = -1;
+    return false;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+} // namespace packeteer::detail
@@ -0,0 +1,88 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef PACKETEER_CONNECTOR_POSIX_SPLICE_H
+#define PACKETEER_CONNECTOR_POSIX_SPLICE_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <build-config.h>
+
+#include <packeteer.h>
+
+#include <packeteer/connector/types.h>
+#include <packeteer/error.h>
+
+#include <vector>
+
+namespace packeteer::detail {
+
+/**
+ * State for connector_common::splice_to(); see connector::splice_to() for
+ * the semantics.
+ *
+ * Data that was read from the source, but not yet accepted by the
+ * destination, is either kept in an internal pipe (splice), or in a buffer
+ * (read/write fallback). The transfer mode is picked per destination; if
+ * the OS refuses to splice or sendfile between a pair of file descriptors,
+ * we fall back to copying for that destination.
+ **/
+struct splice_state
+{
+  splice_state() = default;
+  ~splice_state();
+
+  error_t transfer(int in, int out, size_t max, size_t & transferred,
+      splice_flags flags);
+
+private:
+  enum transfer_mode : int8_t
+  {
+    MODE_SENDFILE = 0,
+    MODE_PIPE     = 1,
+    MODE_COPY     = 2,
+  };
+
+  transfer_mode select_mode(int in) const;
+
+  // Move data from in to out, or into pending storage.
+  error_t move(int in, int out, size_t max, size_t & moved,
+      splice_flags flags);
+
+  // Deliver pending data. Returns ERR_ASYNC if some remains.
+  error_t flush(int out, size_t & moved, splice_flags flags);
+
+  bool open_pipe();
+
+  int               m_out = -1;
+  transfer_mode     m_mode = MODE_COPY;
+
+  int               m_pipe[2] = { -1, -1 };
+  size_t            m_in_pipe = 0;
+
+  std::vector<char> m_buffer = {};
+  size_t            m_offset = 0;
+  size_t            m_pending = 0;
+};
+
+} // namespace packeteer::detail
+
+#endif // guard
@@ -29,10 +29,24 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 
+#if defined(PACKETEER_HAVE_MSG_ZEROCOPY)
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+#endif
+
+#if defined(PACKETEER_HAVE_TCP_ZEROCOPY_RECEIVE)
+#include <sys/mman.h>
+#include <netinet/in.h>
+#include <linux/tcp.h>
+#endif
+
 #include <unistd.h>
 #include <errno.h>
 #include <string.h>
 
+#include <algorithm>
+#include <cstring>
+
 
 namespace packeteer::detail {
 
@@ -66,6 +80,9 @@ connector_tcp::connector_tcp(peer_address const & addr,
 connector_tcp::~connector_tcp()
 {
   connector_tcp::close();
+#if defined(PACKETEER_HAVE_TCP_ZEROCOPY_RECEIVE)
+  unmap_lease_slots(false);
+#endif
 }
 
 
@@ -73,13 +90,46 @@ connector_tcp::~connector_tcp()
 error_t
 connector_tcp::connect()
 {
-  return connector_socket::socket_connect(
+  auto err = connector_socket::socket_connect(
       select_domain(m_address.socket_address()),
       SOCK_STREAM);
+  if (ERR_SUCCESS != err && ERR_ASYNC != err) {
+    return err;
+  }
+
+  auto cerr = configure_socket(m_fd);
+  if (ERR_SUCCESS != cerr) {
+    socket_close();
+    return cerr;
+  }
+  return err;
 }
 
 
 
+#if defined(PACKETEER_HAVE_MSG_FASTOPEN)
+error_t
+connector_tcp::connect_with_data(void const * buf, size_t bufsize,
+    size_t & bytes_written)
+{
+  auto err = connector_socket::socket_connect(
+      select_domain(m_address.socket_address()),
+      SOCK_STREAM, buf, bufsize, &bytes_written);
+  if (ERR_SUCCESS != err && ERR_ASYNC != err) {
+    return err;
+  }
+
+  auto cerr = configure_socket(m_fd);
+  if (ERR_SUCCESS != cerr) {
+    socket_close();
+    return cerr;
+  }
+  return err;
+}
+#endif
+
+
+
 error_t
 connector_tcp::listen()
 {
@@ -110,6 +160,9 @@ connector_tcp::listen()
 error_t
 connector_tcp::close()
 {
+#if defined(PACKETEER_HAVE_TCP_ZEROCOPY_RECEIVE)
+  unmap_lease_slots(true);
+#endif
   return connector_socket::socket_close();
 }
 
@@ -123,6 +176,12 @@ connector_tcp::accept(liberate::net::socket_address & addr)
     return nullptr;
   }
 
+  err = configure_socket(fd);
+  if (ERR_SUCCESS != err) {
+    ::close(fd);
+    return nullptr;
+  }
+
   // Create & return connector with accepted FD
   auto res_addr = m_address;
   res_addr.socket_address() = addr;
@@ -135,4 +194,340 @@ connector_tcp::accept(liberate::net::socket_address & addr)
 }
 
 
+
+error_t
+connector_tcp::configure_socket(int fd)
+{
+#if !defined(PACKETEER_HAVE_TCP_ZEROCOPY_RECEIVE)
+  if (m_options & CO_ZEROCOPY_RECEIVE) {
+    ELOG("Zero-copy receives are not supported on this platform.");
+    return ERR_UNSUPPORTED_ACTION;
+  }
+#endif
+
+  if (!(m_options & CO_ZEROCOPY)) {
+    return ERR_SUCCESS;
+  }
+
+#if defined(PACKETEER_HAVE_MSG_ZEROCOPY)
+  int enable = 1;
+  int ret = ::setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &enable,
+      sizeof(enable));
+  if (ret >= 0) {
+    return ERR_SUCCESS;
+  }
+
+  ERRNO_LOG("Could not enable SO_ZEROCOPY");
+  switch (errno) {
+    case ENOPROTOOPT:
+    case EOPNOTSUPP:
+      return ERR_UNSUPPORTED_ACTION;
+
+    default:
+      return ERR_INVALID_OPTION;
+  }
+#else
+  (void) fd;
+  ELOG("Zero-copy sends are not supported on this platform.");
+  return ERR_UNSUPPORTED_ACTION;
+#endif
+}
+
+
+
+#if defined(PACKETEER_HAVE_MSG_ZEROCOPY)
+error_t
+connector_tcp::write_zerocopy(void const * buf, size_t bufsize,
+    size_t & bytes_written, uint32_t & sequence)
+{
+  if (!(m_options & CO_ZEROCOPY)) {
+    return ERR_UNSUPPORTED_ACTION;
+  }
+  if (!connected()) {
+    return ERR_INITIALIZATION;
+  }
+  if (!buf || !bufsize) {
+    return ERR_INVALID_VALUE;
+  }
+
+  while (true) {
+    ssize_t amount = ::send(m_fd, buf, bufsize, MSG_ZEROCOPY);
+    if (amount >= 0) {
+      bytes_written = amount;
+      sequence = m_zerocopy_sequence++;
+      return ERR_SUCCESS;
+    }
+
+    if (EINTR == errno) {
+      continue;
+    }
+    bytes_written = 0;
+    if (ENOBUFS == errno) {
+      // Too much memory is pinned by pending sends.
+      return ERR_NUM_ITEMS;
+    }
+    ERRNO_LOG("Zero-copy send failed!");
+    return translate_errno();
+  }
+}
+
+
+
+error_t
+connector_tcp::zerocopy_completions(zerocopy_completion * completions,
+    size_t count, size_t & received)
+{
+  if (!(m_options & CO_ZEROCOPY)) {
+    return ERR_UNSUPPORTED_ACTION;
+  }
+  if (!completions || !count) {
+    return ERR_INVALID_VALUE;
+  }
+
+  std::lock_guard<std::mutex> lock(m_zerocopy_mutex);
+
+  // Completions the scheduler has not collected yet come after those it has.
+  size_t collected = 0;
+  auto err = read_error_queue(collected);
+  if (m_zerocopy_pending.empty()) {
+    return ERR_SUCCESS == err ? ERR_REPEAT_ACTION : err;
+  }
+
+  received = std::min(count, m_zerocopy_pending.size());
+  std::copy_n(m_zerocopy_pending.begin(), received, completions);
+  m_zerocopy_pending.erase(m_zerocopy_pending.begin(),
+      m_zerocopy_pending.begin() + received);
+  return ERR_SUCCESS;
+}
+
+
+
+error_t
+connector_tcp::collect_zerocopy_completions(size_t & collected)
+{
+  if (!(m_options & CO_ZEROCOPY)) {
+    return ERR_UNSUPPORTED_ACTION;
+  }
+
+  std::lock_guard<std::mutex> lock(m_zerocopy_mutex);
+  auto err = read_error_queue(collected);
+  if (ERR_SUCCESS != err) {
+    return err;
+  }
+  return collected ? ERR_SUCCESS : ERR_REPEAT_ACTION;
+}
+
+
+
+error_t
+connector_tcp::read_error_queue(size_t & collected)
+{
+  collected = 0;
+  while (true) {
+    alignas(::cmsghdr) char control[CMSG_SPACE(sizeof(::sock_extended_err))];
+
+    ::msghdr msg{};
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    // Reading the error queue never blocks, and leaves a pending socket
+    // error alone.
+    ssize_t ret = ::recvmsg(m_fd, &msg, MSG_ERRQUEUE);
+    if (ret < 0) {
+      if (EINTR == errno) {
+        continue;
+      }
+      if (collected || EAGAIN == errno || EWOULDBLOCK == errno) {
+        return ERR_SUCCESS;
+      }
+      ERRNO_LOG("Reading zero-copy completions failed!");
+      return translate_errno();
+    }
+
+    for (auto cmsg = CMSG_FIRSTHDR(&msg) ; cmsg ;
+        cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+      bool recverr = (SOL_IP == cmsg->cmsg_level
+            && IP_RECVERR == cmsg->cmsg_type)
+        || (SOL_IPV6 == cmsg->cmsg_level
+            && IPV6_RECVERR == cmsg->cmsg_type);
+      if (!recverr) {
+        continue;
+      }
+
+      ::sock_extended_err err;
+      std::memcpy(&err, CMSG_DATA(cmsg), sizeof(err));
+      if (SO_EE_ORIGIN_ZEROCOPY != err.ee_origin || err.ee_errno) {
+        continue;
+      }
+
+      zerocopy_completion completion{err.ee_info, err.ee_data,
+        0 != (err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED)};
+      ++collected;
+
+      // The kernel merges ranges while they wait in the queue; we do the
+      // same, so that uncollected completions take little space.
+      if (!m_zerocopy_pending.empty()) {
+        auto & last = m_zerocopy_pending.back();
+        if (last.last + 1 == completion.first
+            && last.copied == completion.copied)
+        {
+          last.last = completion.last;
+          break;
+        }
+      }
+      m_zerocopy_pending.push_back(completion);
+      break;
+    }
+  }
+}
+#endif // PACKETEER_HAVE_MSG_ZEROCOPY
+
+
+
+#if defined(PACKETEER_HAVE_TCP_ZEROCOPY_RECEIVE)
+error_t
+connector_tcp::read(read_lease & lease)
+{
+  if (!(m_options & CO_ZEROCOPY_RECEIVE)) {
+    return connector_interface::read(lease);
+  }
+  if (!connected()) {
+    return ERR_INITIALIZATION;
+  }
+
+  if (m_lease_slots.empty()) {
+    m_lease_slots.resize(PACKETEER_READ_LEASE_SLOTS);
+  }
+  auto slot = std::find_if(m_lease_slots.begin(), m_lease_slots.end(),
+      [](lease_slot const & s) { return !s.in_use; });
+  if (slot == m_lease_slots.end()) {
+    return ERR_NUM_ITEMS;
+  }
+
+  // Reserve address space for the slot; the kernel maps the socket's pages
+  // into it.
+  if (!slot->region) {
+    void * region = ::mmap(nullptr, PACKETEER_READ_LEASE_SIZE, PROT_READ,
+        MAP_SHARED, m_fd, 0);
+    if (MAP_FAILED == region) {
+      ERRNO_LOG("Could not map socket for zero-copy receives!");
+      return translate_errno();
+    }
+    slot->region = region;
+  }
+
+  ::tcp_zerocopy_receive zc{};
+  zc.address = reinterpret_cast<uintptr_t>(slot->region);
+  zc.length = PACKETEER_READ_LEASE_SIZE;
+  ::socklen_t len = sizeof(zc);
+  int ret = -1;
+  do {
+    ret = ::getsockopt(m_fd, IPPROTO_TCP, TCP_ZEROCOPY_RECEIVE, &zc, &len);
+  } while (ret < 0 && EINTR == errno);
+  if (ret < 0) {
+    ERRNO_LOG("Zero-copy receive failed!");
+    return translate_errno();
+  }
+  if (zc.err) {
+    // A pending socket error was consumed by the call.
+    errno = -zc.err;
+    ERRNO_LOG("Zero-copy receive failed!");
+    return translate_errno();
+  }
+
+  if (zc.length) {
+    slot->in_use = true;
+    lease.data = slot->region;
+    lease.size = zc.length;
+    lease.context = &*slot;
+    return ERR_SUCCESS;
+  }
+
+  // Nothing could be mapped, because the data does not fill a page. Copy
+  // exactly what the kernel asks us to skip, so that the next call starts at
+  // a page boundary again. If there is no data, this reads, or blocks, as
+  // read() does.
+  size_t want = PACKETEER_READ_LEASE_SIZE;
+  if (zc.recv_skip_hint) {
+    want = std::min<size_t>(want, zc.recv_skip_hint);
+  }
+  slot->copy.resize(PACKETEER_READ_LEASE_SIZE);
+  size_t amount = 0;
+  auto err = connector_socket::read(slot->copy.data(), want, amount);
+  if (ERR_SUCCESS != err) {
+    return err;
+  }
+
+  slot->in_use = true;
+  lease.data = slot->copy.data();
+  lease.size = amount;
+  lease.context = &*slot;
+  return ERR_SUCCESS;
+}
+
+
+
+error_t
+connector_tcp::release(read_lease & lease)
+{
+  if (!(m_options & CO_ZEROCOPY_RECEIVE)) {
+    return connector_interface::release(lease);
+  }
+
+  auto slot = std::find_if(m_lease_slots.begin(), m_lease_slots.end(),
+      [&lease](lease_slot const & s) { return &s == lease.context; });
+  if (slot == m_lease_slots.end() || !slot->in_use) {
+    return ERR_INVALID_VALUE;
+  }
+
+  slot->in_use = false;
+  if (slot->closed) {
+    // The connector was closed while the lease was out; the region belongs
+    // to the old socket.
+    unmap_lease_slot(*slot);
+  }
+  else if (lease.data == slot->region && lease.size) {
+    // Hand the pages back to the kernel now, rather than when the region
+    // gets mapped again.
+    if (::madvise(slot->region, lease.size, MADV_DONTNEED) < 0) {
+      ERRNO_LOG("Could not release zero-copy receive pages.");
+    }
+  }
+
+  lease = read_lease{};
+  return ERR_SUCCESS;
+}
+
+
+
+void
+connector_tcp::unmap_lease_slots(bool keep_leased)
+{
+  // Leases point into the slots, so the slots themselves stay.
+  for (auto & slot : m_lease_slots) {
+    if (slot.in_use && keep_leased) {
+      slot.closed = true;
+      continue;
+    }
+    unmap_lease_slot(slot);
+  }
+}
+
+
+
+void
+connector_tcp::unmap_lease_slot(lease_slot & slot)
+{
+  if (slot.region) {
+    ::munmap(slot.region, PACKETEER_READ_LEASE_SIZE);
+    slot.region = nullptr;
+  }
+  slot.copy = std::vector<char>{};
+  slot.in_use = false;
+  slot.closed = false;
+}
+#endif // PACKETEER_HAVE_TCP_ZEROCOPY_RECEIVE
+
+
 } // namespace packeteer::detail
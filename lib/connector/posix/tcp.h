@@ -24,10 +24,15 @@
 #error You are trying to include a C++ only header file
 #endif
 
+#include <build-config.h>
+
 #include <packeteer.h>
 
 #include <packeteer/connector/interface.h>
 
+#include <mutex>
+#include <vector>
+
 #include "socket.h"
 
 namespace packeteer::detail {
@@ -46,12 +51,68 @@ public:
 
   error_t connect() override;
 
+#if defined(PACKETEER_HAVE_MSG_FASTOPEN)
+  error_t connect_with_data(void const * buf, size_t bufsize,
+      size_t & bytes_written) override;
+#endif
+
   connector_interface * accept(liberate::net::socket_address & addr) override;
 
   error_t close() override;
 
+#if defined(PACKETEER_HAVE_MSG_ZEROCOPY)
+  error_t write_zerocopy(void const * buf, size_t bufsize,
+      size_t & bytes_written, uint32_t & sequence) override;
+  error_t zerocopy_completions(zerocopy_completion * completions,
+      size_t count, size_t & received) override;
+  error_t collect_zerocopy_completions(size_t & collected) override;
+#endif
+
+#if defined(PACKETEER_HAVE_TCP_ZEROCOPY_RECEIVE)
+  using connector_socket::read;
+  error_t read(read_lease & lease) override;
+  error_t release(read_lease & lease) override;
+#endif
+
 private:
   connector_tcp();
+
+  // Apply socket options requested via connector options to the given fd.
+  error_t configure_socket(int fd);
+
+  // Sequence number of the next zero-copy send.
+  uint32_t  m_zerocopy_sequence = 0;
+
+#if defined(PACKETEER_HAVE_MSG_ZEROCOPY)
+  // Read completions from the socket's error queue into m_zerocopy_pending,
+  // merging adjacent ranges. Requires m_zerocopy_mutex to be held.
+  error_t read_error_queue(size_t & collected);
+
+  // Completions read from the error queue, but not retrieved yet. The
+  // scheduler collects them while callbacks may retrieve them.
+  std::mutex                        m_zerocopy_mutex;
+  std::vector<zerocopy_completion>  m_zerocopy_pending;
+#endif
+
+#if defined(PACKETEER_HAVE_TCP_ZEROCOPY_RECEIVE)
+  // Read leases. Each slot has a region that the socket's pages get mapped
+  // into, and a buffer for data that cannot be mapped. The slots are
+  // allocated on first use, and the regions unmapped on close(). Regions
+  // still leased out at that point are unmapped on release() instead.
+  struct lease_slot
+  {
+    void *            region = nullptr;
+    std::vector<char> copy = {};
+    bool              in_use = false;
+    bool              closed = false;
+  };
+  std::vector<lease_slot> m_lease_slots = {};
+
+  // Unmap all slots; if keep_leased is set, slots in use are only marked
+  // closed.
+  void unmap_lease_slots(bool keep_leased);
+  void unmap_lease_slot(lease_slot & slot);
+#endif
 };
 
 } // namespace packeteer::detail
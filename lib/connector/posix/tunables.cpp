@@ -0,0 +1,291 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <build-config.h>
+
+#include "tunables.h"
+
+#include "../../globals.h"
+#include "../../macros.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include <climits>
+#include <cstdint>
+#include <stdexcept>
+
+#include <errno.h>
+
+
+namespace packeteer::detail {
+
+namespace {
+
+error_t
+set_int_option(handle const & h, int level, int name, int value)
+{
+  int ret = ::setsockopt(h.sys_handle(), level, name, &value, sizeof(value));
+  if (ret >= 0) {
+    return ERR_SUCCESS;
+  }
+
+  ERRNO_LOG("Could not set socket tunable!");
+  switch (errno) {
+    case EBADF:
+    case EFAULT:
+    case EINVAL:
+      return ERR_INVALID_VALUE;
+
+    case EACCES:
+    case EPERM:
+      return ERR_ACCESS_VIOLATION;
+
+    case ENOPROTOOPT:
+    case ENOTSOCK:
+    case EOPNOTSUPP:
+      return ERR_UNSUPPORTED_ACTION;
+
+    default:
+      return ERR_UNEXPECTED;
+  }
+}
+
+
+
+error_t
+parse_int(std::string const & value, int & result)
+{
+  size_t size = 0;
+  auto err = parse_tunable_size(value, size);
+  if (ERR_SUCCESS != err) {
+    return err;
+  }
+  if (size > INT_MAX) {
+    ELOG("Tunable value out of range: " << value);
+    return ERR_INVALID_VALUE;
+  }
+  result = static_cast<int>(size);
+  return ERR_SUCCESS;
+}
+
+
+
+/**
+ * Appliers for integer and flag valued socket options.
+ **/
+inline registry::tunable_applier
+int_option(int level, int name)
+{
+  return [level, name](handle const & h, std::string const & value) -> error_t
+  {
+    int parsed = 0;
+    auto err = parse_int(value, parsed);
+    if (ERR_SUCCESS != err) {
+      return err;
+    }
+    return set_int_option(h, level, name, parsed);
+  };
+}
+
+
+
+inline registry::tunable_applier
+flag_option(int level, int name)
+{
+  return [level, name](handle const & h, std::string const & value) -> error_t
+  {
+    bool parsed = false;
+    auto err = parse_tunable_flag(value, parsed);
+    if (ERR_SUCCESS != err) {
+      return err;
+    }
+    return set_int_option(h, level, name, parsed ? 1 : 0);
+  };
+}
+
+
+
+inline registry::tunable_applier
+unsupported_option(char const * name)
+{
+  return [name](handle const &, std::string const &) -> error_t
+  {
+    ELOG("Socket tunable not supported on this platform: " << name);
+    return ERR_UNSUPPORTED_ACTION;
+  };
+}
+
+} // anonymous namespace
+
+
+
+error_t
+parse_tunable_size(std::string const & value, size_t & result)
+{
+  if (value.empty()) {
+    ELOG("Tunable requires a value.");
+    return ERR_INVALID_VALUE;
+  }
+
+  size_t parsed = 0;
+  size_t consumed = 0;
+  try {
+    if ('-' == value[0]) {
+      throw std::invalid_argument{"negative"};
+    }
+    parsed = std::stoull(value, &consumed);
+  } catch (std::exception const &) {
+    ELOG("Tunable value is not a size: " << value);
+    return ERR_INVALID_VALUE;
+  }
+
+  size_t multiplier = 1;
+  if (consumed + 1 == value.size()) {
+    switch (value[consumed]) {
+      case 'k':
+      case 'K':
+        multiplier = size_t{1} << 10;
+        break;
+
+      case 'm':
+      case 'M':
+        multiplier = size_t{1} << 20;
+        break;
+
+      case 'g':
+      case 'G':
+        multiplier = size_t{1} << 30;
+        break;
+
+      default:
+        ELOG("Unknown tunable size suffix: " << value);
+        return ERR_INVALID_VALUE;
+    }
+  }
+  else if (consumed != value.size()) {
+    ELOG("Tunable value is not a size: " << value);
+    return ERR_INVALID_VALUE;
+  }
+
+  if (parsed > SIZE_MAX / multiplier) {
+    ELOG("Tunable value out of range: " << value);
+    return ERR_INVALID_VALUE;
+  }
+  result = parsed * multiplier;
+  return ERR_SUCCESS;
+}
+
+
+
+error_t
+parse_tunable_flag(std::string const & value, bool & result)
+{
+  if ("1" == value) {
+    result = true;
+    return ERR_SUCCESS;
+  }
+  if ("0" == value) {
+    result = false;
+    return ERR_SUCCESS;
+  }
+  ELOG("Tunable value is not a flag: " << value);
+  return ERR_INVALID_VALUE;
+}
+
+
+
+std::map<std::string, registry::tunable_applier>
+socket_tunables()
+{
+  std::map<std::string, registry::tunable_applier> result;
+
+  result["rcvbuf"] = int_option(SOL_SOCKET, SO_RCVBUF);
+  result["sndbuf"] = int_option(SOL_SOCKET, SO_SNDBUF);
+  result["rcvlowat"] = int_option(SOL_SOCKET, SO_RCVLOWAT);
+  result["nodelay"] = flag_option(IPPROTO_TCP, TCP_NODELAY);
+
+#if defined(TCP_QUICKACK)
+  result["quickack"] = flag_option(IPPROTO_TCP, TCP_QUICKACK);
+#else
+  result["quickack"] = unsupported_option("quickack");
+#endif
+
+#if defined(TCP_NOTSENT_LOWAT)
+  result["notsent_lowat"] = int_option(IPPROTO_TCP, TCP_NOTSENT_LOWAT);
+#else
+  result["notsent_lowat"] = unsupported_option("notsent_lowat");
+#endif
+
+#if defined(TCP_FASTOPEN)
+  result["fastopen"] = int_option(IPPROTO_TCP, TCP_FASTOPEN);
+#else
+  result["fastopen"] = unsupported_option("fastopen");
+#endif
+
+#if defined(TCP_FASTOPEN_CONNECT)
+  result["fastopen_connect"] = flag_option(IPPROTO_TCP, TCP_FASTOPEN_CONNECT);
+#else
+  result["fastopen_connect"] = unsupported_option("fastopen_connect");
+#endif
+
+#if defined(SO_BUSY_POLL)
+  result["busy_poll"] = int_option(SOL_SOCKET, SO_BUSY_POLL);
+#else
+  result["busy_poll"] = unsupported_option("busy_poll");
+#endif
+
+#if defined(PACKETEER_HAVE_SO_REUSEPORT)
+  result["reuseport"] = flag_option(SOL_SOCKET, SO_REUSEPORT);
+#else
+  result["reuseport"] = unsupported_option("reuseport");
+#endif
+
+#if defined(SO_INCOMING_CPU)
+  result["incoming_cpu"] = int_option(SOL_SOCKET, SO_INCOMING_CPU);
+#else
+  result["incoming_cpu"] = unsupported_option("incoming_cpu");
+#endif
+
+  result["backlog"] = [](handle const &, std::string const & value) -> error_t
+  {
+    int parsed = 0;
+    return parse_int(value, parsed);
+  };
+
+  return result;
+}
+
+
+
+error_t
+backlog_from_query(std::map<std::string, std::string> const & query,
+    int & backlog)
+{
+  auto iter = query.find("backlog");
+  if (iter == query.end()) {
+    backlog = PACKETEER_LISTEN_BACKLOG;
+    return ERR_SUCCESS;
+  }
+  return parse_int(iter->second, backlog);
+}
+
+} // namespace packeteer::detail
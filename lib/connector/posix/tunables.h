@@ -0,0 +1,79 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef PACKETEER_CONNECTOR_POSIX_TUNABLES_H
+#define PACKETEER_CONNECTOR_POSIX_TUNABLES_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <build-config.h>
+
+#include <packeteer.h>
+
+#include <packeteer/registry.h>
+#include <packeteer/error.h>
+
+#include <map>
+#include <string>
+
+namespace packeteer::detail {
+
+/**
+ * Parse tunable values. Sizes are given in Bytes, optionally with a K, M or
+ * G suffix for binary multiples; flags are "1" or "0".
+ **/
+error_t parse_tunable_size(std::string const & value, size_t & result);
+error_t parse_tunable_flag(std::string const & value, bool & result);
+
+/**
+ * The built-in socket tunables by URL parameter, for registration with the
+ * registry. Each sets a socket option:
+ *
+ * - rcvbuf, sndbuf: SO_RCVBUF and SO_SNDBUF, as sizes.
+ * - rcvlowat: SO_RCVLOWAT, as size.
+ * - nodelay, quickack: TCP_NODELAY and TCP_QUICKACK, as flags. Note that
+ *   Linux may switch TCP_QUICKACK off again in the course of a connection.
+ * - notsent_lowat: TCP_NOTSENT_LOWAT, as size.
+ * - fastopen: TCP_FASTOPEN, as the queue length for listeners.
+ * - fastopen_connect: TCP_FASTOPEN_CONNECT, as flag.
+ * - busy_poll: SO_BUSY_POLL, in microseconds.
+ * - incoming_cpu: SO_INCOMING_CPU, as CPU number.
+ * - reuseport: SO_REUSEPORT, as flag. See listen_group().
+ *
+ * Options the platform does not know fail with ERR_UNSUPPORTED_ACTION when
+ * applied.
+ *
+ * The list also contains "backlog", which is not a socket option but the
+ * argument to listen(). Its applier only validates the value; connectors
+ * pick it up via backlog_from_query().
+ **/
+std::map<std::string, registry::tunable_applier> socket_tunables();
+
+/**
+ * Read the listen backlog from the query, or return PACKETEER_LISTEN_BACKLOG
+ * if it is not specified.
+ **/
+error_t backlog_from_query(std::map<std::string, std::string> const & query,
+    int & backlog);
+
+} // namespace packeteer::detail
+
+#endif // guard
@@ -24,14 +24,21 @@
 #include <packeteer/error.h>
 
 #include "../../globals.h"
+#include "../../macros.h"
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
 
 #include <unistd.h>
 #include <errno.h>
 #include <string.h>
 
+#include <algorithm>
+#include <cstring>
+
 
 namespace packeteer::detail {
 
@@ -72,9 +79,19 @@ connector_udp::~connector_udp()
 error_t
 connector_udp::connect()
 {
-  return connector_socket::socket_connect(
+  auto err = connector_socket::socket_connect(
       select_domain(m_address.socket_address()),
       SOCK_DGRAM);
+  if (ERR_SUCCESS != err && ERR_ASYNC != err) {
+    return err;
+  }
+
+  auto cerr = configure_socket();
+  if (ERR_SUCCESS != cerr) {
+    socket_close();
+    return cerr;
+  }
+  return err;
 }
 
 
@@ -95,7 +112,11 @@ connector_udp::listen()
   m_fd = fd;
   m_server = true;
 
-  return ERR_SUCCESS;
+  err = configure_socket();
+  if (ERR_SUCCESS != err) {
+    socket_close();
+  }
+  return err;
 }
 
 
@@ -117,4 +138,152 @@ connector_udp::accept(liberate::net::socket_address & /* addr*/)
 }
 
 
+
+error_t
+connector_udp::configure_socket()
+{
+  if (!(m_options & CO_UDP_GRO)) {
+    return ERR_SUCCESS;
+  }
+
+#if defined(PACKETEER_HAVE_UDP_GRO)
+  int enable = 1;
+  int ret = ::setsockopt(m_fd, SOL_UDP, UDP_GRO, &enable, sizeof(enable));
+  if (ret >= 0) {
+    return ERR_SUCCESS;
+  }
+
+  ERRNO_LOG("Could not enable UDP_GRO");
+  switch (errno) {
+    case ENOPROTOOPT:
+      return ERR_UNSUPPORTED_ACTION;
+
+    default:
+      return ERR_INVALID_OPTION;
+  }
+#else
+  ELOG("UDP receive offload is not supported on this platform.");
+  return ERR_UNSUPPORTED_ACTION;
+#endif
+}
+
+
+
+#if defined(PACKETEER_HAVE_UDP_GRO)
+error_t
+connector_udp::receive(void * buf, size_t bufsize, size_t & bytes_read,
+    liberate::net::socket_address & sender, size_t & segment_size)
+{
+  if (!(m_options & CO_UDP_GRO)) {
+    // The kernel won't coalesce datagrams, so we need no control messages.
+    return connector_interface::receive(buf, bufsize, bytes_read, sender,
+        segment_size);
+  }
+
+  ::iovec iov{buf, bufsize};
+  alignas(::cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+
+  ::msghdr msg{};
+  msg.msg_name = sender.buffer();
+  msg.msg_namelen = sender.bufsize_available();
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  ssize_t amount = ::recvmsg(m_fd, &msg, MSG_DONTWAIT);
+  if (amount < 0) {
+    ERRNO_LOG("recvmsg failed!");
+    return translate_receive_errno();
+  }
+
+  bytes_read = amount;
+  segment_size = amount;
+
+  for (auto cmsg = CMSG_FIRSTHDR(&msg) ; cmsg ; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (SOL_UDP == cmsg->cmsg_level && UDP_GRO == cmsg->cmsg_type) {
+      int gso_size = 0;
+      std::memcpy(&gso_size, CMSG_DATA(cmsg), sizeof(gso_size));
+      segment_size = gso_size;
+      break;
+    }
+  }
+
+  return ERR_SUCCESS;
+}
+#endif // PACKETEER_HAVE_UDP_GRO
+
+
+
+#if defined(PACKETEER_HAVE_UDP_GSO)
+error_t
+connector_udp::send(void const * buf, size_t bufsize, size_t & bytes_written,
+    liberate::net::socket_address const & recipient, size_t segment_size)
+{
+  if (!segment_size || segment_size >= bufsize) {
+    return send(buf, bufsize, bytes_written, recipient);
+  }
+
+  // The kernel limits how many segments it accepts at once.
+  size_t per_send = std::min<size_t>(PACKETEER_UDP_MAX_SEGMENTS,
+      PACKETEER_UDP_MAX_GSO_SIZE / segment_size);
+  if (!per_send) {
+    return ERR_INVALID_VALUE;
+  }
+  size_t chunk_size = per_send * segment_size;
+
+  auto start = static_cast<char const *>(buf);
+  bytes_written = 0;
+  while (bytes_written < bufsize) {
+    ::iovec iov{
+      const_cast<char *>(start + bytes_written),
+      std::min(chunk_size, bufsize - bytes_written),
+    };
+
+    alignas(::cmsghdr) char control[CMSG_SPACE(sizeof(uint16_t))] = {};
+
+    ::msghdr msg{};
+    msg.msg_name = const_cast<void *>(recipient.buffer());
+    msg.msg_namelen = recipient.bufsize();
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    // A single segment needs no offload.
+    if (iov.iov_len > segment_size) {
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+
+      auto cmsg = CMSG_FIRSTHDR(&msg);
+      cmsg->cmsg_level = SOL_UDP;
+      cmsg->cmsg_type = UDP_SEGMENT;
+      cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+      uint16_t size = segment_size;
+      std::memcpy(CMSG_DATA(cmsg), &size, sizeof(size));
+    }
+
+    ssize_t amount = ::sendmsg(m_fd, &msg, MSG_DONTWAIT);
+    if (amount < 0) {
+      if (bytes_written) {
+        // Report the error on the next call instead.
+        break;
+      }
+      if (EIO == errno || EOPNOTSUPP == errno) {
+        // The route's device does not support segmentation; send one
+        // datagram at a time instead.
+        DLOG("UDP_SEGMENT unsupported, falling back to single datagrams.");
+        return connector_interface::send(buf, bufsize, bytes_written,
+            recipient, segment_size);
+      }
+      ERRNO_LOG("sendmsg with UDP_SEGMENT failed!");
+      return translate_errno();
+    }
+
+    bytes_written += amount;
+  }
+
+  return ERR_SUCCESS;
+}
+#endif // PACKETEER_HAVE_UDP_GSO
+
+
 } // namespace packeteer::detail
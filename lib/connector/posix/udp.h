@@ -24,6 +24,8 @@
 #error You are trying to include a C++ only header file
 #endif
 
+#include <build-config.h>
+
 #include <packeteer.h>
 
 #include <packeteer/connector/interface.h>
@@ -50,8 +52,26 @@ public:
 
   error_t close() override;
 
+  // Segmentation and receive offloads
+  using connector_common::receive;
+  using connector_common::send;
+
+#if defined(PACKETEER_HAVE_UDP_GRO)
+  error_t receive(void * buf, size_t bufsize, size_t & bytes_read,
+      ::liberate::net::socket_address & sender,
+      size_t & segment_size) override;
+#endif
+#if defined(PACKETEER_HAVE_UDP_GSO)
+  error_t send(void const * buf, size_t bufsize, size_t & bytes_written,
+      ::liberate::net::socket_address const & recipient,
+      size_t segment_size) override;
+#endif
+
 private:
   connector_udp();
+
+  // Apply socket options requested via connector options to m_fd.
+  error_t configure_socket();
 };
 
 } // namespace packeteer::detail
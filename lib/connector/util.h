@@ -104,6 +104,9 @@ sanitize_options(connector_options const & input,
   }
   //std::cout << "result #2: " << std::bitset<16>(result) << std::endl;
 
+  // Any further flags are kept if the connector supports them.
+  result |= input & others & ~(CO_BLOCKING|CO_NON_BLOCKING);
+
 
   // In single behaviour situations, we can just force the behaviour
   // and be done with it.
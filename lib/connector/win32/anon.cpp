@@ -242,6 +242,28 @@ connector_anon::send(void const * buf, size_t bufsize, size_t & bytes_written,
 
 
 
+error_t
+connector_anon::receive(io_buffer const * bufs, size_t bufcount,
+    size_t & bytes_read, liberate::net::socket_address & sender)
+{
+  auto err = read(bufs, bufcount, bytes_read);
+  if (ERR_SUCCESS == err) {
+    sender = liberate::net::socket_address{m_addr};
+  }
+  return err;
+}
+
+
+
+error_t
+connector_anon::send(const_io_buffer const * bufs, size_t bufcount,
+    size_t & bytes_written, liberate::net::socket_address const & recipient)
+{
+  return write(bufs, bufcount, bytes_written);
+}
+
+
+
 size_t
 connector_anon::peek() const
 {
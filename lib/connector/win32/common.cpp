@@ -77,6 +77,42 @@ connector_common::write(void const * buf, size_t bufsize, size_t & bytes_written
 
 
 
+error_t
+connector_common::read(io_buffer const * bufs, size_t bufcount,
+    size_t & bytes_read)
+{
+  if (!connected() && !listening()) {
+    return ERR_INITIALIZATION;
+  }
+
+  ssize_t read = -1;
+  auto err = detail::read(get_read_handle(), bufs, bufcount, read);
+  if (ERR_SUCCESS == err) {
+    bytes_read = read;
+  }
+  return err;
+}
+
+
+
+error_t
+connector_common::write(const_io_buffer const * bufs, size_t bufcount,
+    size_t & bytes_written)
+{
+  if (!connected() && !listening()) {
+    return ERR_INITIALIZATION;
+  }
+
+  ssize_t written = -1;
+  auto err = detail::write(get_write_handle(), bufs, bufcount, written);
+  if (ERR_SUCCESS == err) {
+    bytes_written = written;
+  }
+  return err;
+}
+
+
+
 connector_options
 connector_common::get_options() const
 {
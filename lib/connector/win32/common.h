@@ -44,6 +44,11 @@ public:
   error_t read(void * buf, size_t bufsize, size_t & bytes_read) override;
   error_t write(void const * buf, size_t bufsize, size_t & bytes_written) override;
 
+  error_t read(io_buffer const * bufs, size_t bufcount,
+      size_t & bytes_read) override;
+  error_t write(const_io_buffer const * bufs, size_t bufcount,
+      size_t & bytes_written) override;
+
   connector_options get_options() const override;
   peer_address peer_addr() const override;
 protected:
@@ -23,6 +23,8 @@
 #include "../../macros.h"
 #include "../../win32/sys_handle.h"
 
+#include <algorithm>
+
 namespace packeteer::detail {
 
 namespace {
@@ -112,17 +114,47 @@ translate_error()
 
 
 
+inline size_t
+total_size(io_buffer const * bufs, size_t bufcount)
+{
+  size_t total = 0;
+  for (size_t i = 0 ; i < bufcount ; ++i) {
+    total += bufs[i].size;
+  }
+  return total;
+}
+
+
+
+inline size_t
+total_size(const_io_buffer const * bufs, size_t bufcount)
+{
+  size_t total = 0;
+  for (size_t i = 0 ; i < bufcount ; ++i) {
+    total += bufs[i].size;
+  }
+  return total;
+}
+
+
+
+// The overlapped context owns the buffer the OS reads into or writes from,
+// as the caller's buffers may be gone by the time the I/O completes. We
+// scatter from, and gather into, that buffer.
 error_t
 read_op(::packeteer::handle handle,
-    void * dest, size_t amount, ssize_t & read,
+    io_buffer const * bufs, size_t bufcount, ssize_t & read,
     liberate::net::socket_address * addr)
 {
   if (!handle.valid()) {
     return ERR_INVALID_VALUE;
   }
 
-  if (amount > 0 && !dest) {
-    return ERR_INVALID_VALUE;
+  size_t amount = total_size(bufs, bufcount);
+  for (size_t i = 0 ; i < bufcount ; ++i) {
+    if (bufs[i].size > 0 && !bufs[i].data) {
+      return ERR_INVALID_VALUE;
+    }
   }
 
   // Initialize to error
@@ -203,8 +235,11 @@ read_op(::packeteer::handle handle,
     if (res) {
       // Success; copy buffer
       read = have_read;
-      if (read > 0) {
-        ::memcpy(dest, ctx.buf, read);
+      size_t offset = 0;
+      for (size_t i = 0 ; i < bufcount && offset < size_t(read) ; ++i) {
+        size_t chunk = std::min(bufs[i].size, size_t(read) - offset);
+        ::memcpy(bufs[i].data, static_cast<char *>(ctx.buf) + offset, chunk);
+        offset += chunk;
       }
       if (addr) {
         // Also store address
@@ -229,16 +264,22 @@ read_op(::packeteer::handle handle,
 
 error_t
 write_op(::packeteer::handle handle,
-    void const * source, size_t amount, ssize_t & written,
+    const_io_buffer const * bufs, size_t bufcount, ssize_t & written,
     liberate::net::socket_address const * addr)
 {
   if (!handle.valid()) {
     return ERR_INVALID_VALUE;
   }
 
-  if (!source || !amount) {
+  size_t amount = total_size(bufs, bufcount);
+  if (!amount) {
     return ERR_INVALID_VALUE;
   }
+  for (size_t i = 0 ; i < bufcount ; ++i) {
+    if (bufs[i].size > 0 && !bufs[i].data) {
+      return ERR_INVALID_VALUE;
+    }
+  }
 
   // Initialize to error
   written = -1;
@@ -273,8 +314,13 @@ write_op(::packeteer::handle handle,
     else {
       // Preapre the context
       ctx.allocate(amount);
-      if (amount > 0) {
-        ::memcpy(ctx.buf, source, amount);
+      size_t offset = 0;
+      for (size_t i = 0 ; i < bufcount ; ++i) {
+        if (bufs[i].size > 0) {
+          ::memcpy(static_cast<char *>(ctx.buf) + offset, bufs[i].data,
+              bufs[i].size);
+          offset += bufs[i].size;
+        }
       }
 
       // Schedule write
@@ -327,7 +373,8 @@ read(::packeteer::handle handle,
   if (!buf || !amount) {
     return ERR_INVALID_VALUE;
   }
-  return read_op(handle, buf, amount, read, nullptr);
+  io_buffer bufs[1] = { { buf, amount } };
+  return read_op(handle, bufs, 1, read, nullptr);
 }
 
 
@@ -336,7 +383,8 @@ error_t
 write(::packeteer::handle handle,
     void const * buf, size_t amount, ssize_t & written)
 {
-  return write_op(handle, buf, amount, written, nullptr);
+  const_io_buffer bufs[1] = { { buf, amount } };
+  return write_op(handle, bufs, 1, written, nullptr);
 }
 
 
@@ -347,7 +395,8 @@ receive(::packeteer::handle handle,
     void * buf, size_t amount, ssize_t & read,
     liberate::net::socket_address & sender)
 {
-  return read_op(handle, buf, amount, read, &sender);
+  io_buffer bufs[1] = { { buf, amount } };
+  return read_op(handle, bufs, 1, read, &sender);
 }
 
 
@@ -357,7 +406,58 @@ send(::packeteer::handle handle,
     void const * buf, size_t amount, ssize_t & written,
     liberate::net::socket_address const & recipient)
 {
-  return write_op(handle, buf, amount, written, &recipient);
+  const_io_buffer bufs[1] = { { buf, amount } };
+  return write_op(handle, bufs, 1, written, &recipient);
+}
+
+
+
+error_t
+read(::packeteer::handle handle,
+    io_buffer const * bufs, size_t bufcount, ssize_t & read)
+{
+  if (!bufs || !bufcount || !total_size(bufs, bufcount)) {
+    return ERR_INVALID_VALUE;
+  }
+  return read_op(handle, bufs, bufcount, read, nullptr);
+}
+
+
+
+error_t
+write(::packeteer::handle handle,
+    const_io_buffer const * bufs, size_t bufcount, ssize_t & written)
+{
+  if (!bufs || !bufcount) {
+    return ERR_INVALID_VALUE;
+  }
+  return write_op(handle, bufs, bufcount, written, nullptr);
+}
+
+
+
+error_t
+receive(::packeteer::handle handle,
+    io_buffer const * bufs, size_t bufcount, ssize_t & read,
+    liberate::net::socket_address & sender)
+{
+  if (!bufs || !bufcount) {
+    return ERR_INVALID_VALUE;
+  }
+  return read_op(handle, bufs, bufcount, read, &sender);
+}
+
+
+
+error_t
+send(::packeteer::handle handle,
+    const_io_buffer const * bufs, size_t bufcount, ssize_t & written,
+    liberate::net::socket_address const & recipient)
+{
+  if (!bufs || !bufcount) {
+    return ERR_INVALID_VALUE;
+  }
+  return write_op(handle, bufs, bufcount, written, &recipient);
 }
 
 
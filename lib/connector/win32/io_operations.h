@@ -29,6 +29,7 @@
 #include <liberate/net/socket_address.h>
 
 #include <packeteer/handle.h>
+#include <packeteer/connector/types.h>
 
 
 namespace packeteer::detail {
@@ -65,6 +66,32 @@ error_t send(
     ::liberate::net::socket_address const & recipient);
 
 
+/**
+ * Scatter/gather variants of the above.
+ */
+PACKETEER_PRIVATE
+error_t read(
+    ::packeteer::handle handle,
+    io_buffer const * bufs, size_t bufcount, ssize_t & read);
+
+PACKETEER_PRIVATE
+error_t write(
+    ::packeteer::handle handle,
+    const_io_buffer const * bufs, size_t bufcount, ssize_t & written);
+
+PACKETEER_PRIVATE
+error_t receive(
+    ::packeteer::handle handle,
+    io_buffer const * bufs, size_t bufcount, ssize_t & read,
+    ::liberate::net::socket_address & sender);
+
+PACKETEER_PRIVATE
+error_t send(
+    ::packeteer::handle handle,
+    const_io_buffer const * bufs, size_t bufcount, ssize_t & written,
+    ::liberate::net::socket_address const & recipient);
+
+
 
 /**
  * Peek a named pipe handle or socket. Uses the simple peek semantics of our
@@ -60,6 +60,11 @@ public:
       ::liberate::net::socket_address & sender) override;
   error_t send(void const * buf, size_t bufsize, size_t & bytes_written,
       ::liberate::net::socket_address const & recipient) override;
+  error_t receive(io_buffer const * bufs, size_t bufcount,
+      size_t & bytes_read, ::liberate::net::socket_address & sender) override;
+  error_t send(const_io_buffer const * bufs, size_t bufcount,
+      size_t & bytes_written,
+      ::liberate::net::socket_address const & recipient) override;
   size_t peek() const override;
 
 
@@ -529,6 +529,46 @@ connector_socket::send(void const * buf, size_t bufsize, size_t & bytes_written,
 
 
 
+error_t
+connector_socket::receive(io_buffer const * bufs, size_t bufcount,
+    size_t & bytes_read, liberate::net::socket_address & sender)
+{
+  if (!connected() && !listening()) {
+    return ERR_INITIALIZATION;
+  }
+
+  ssize_t have_read = -1;
+  liberate::net::socket_address addr;
+  auto err = detail::receive(get_read_handle(), bufs, bufcount, have_read,
+      addr);
+  if (ERR_SUCCESS == err) {
+    bytes_read = have_read;
+    sender = addr;
+  }
+  return err;
+}
+
+
+
+error_t
+connector_socket::send(const_io_buffer const * bufs, size_t bufcount,
+    size_t & bytes_written, liberate::net::socket_address const & recipient)
+{
+  if (!connected() && !listening()) {
+    return ERR_INITIALIZATION;
+  }
+
+  ssize_t written = -1;
+  auto err = detail::send(get_write_handle(), bufs, bufcount, written,
+      recipient);
+  if (ERR_SUCCESS == err) {
+    bytes_written = written;
+  }
+  return err;
+}
+
+
+
 size_t
 connector_socket::peek() const
 {
@@ -45,4 +45,89 @@
 #define PACKETEER_KQUEUE_MAXEVENTS  PACKETEER_EVENT_MAX
 #define PACKETEER_IOCP_MAXEVENTS    PACKETEER_EVENT_MAX
 
+
+/**
+ * Number of pollfd entries the poll() I/O subsystem checks for events at
+ * once; chunks without any events are skipped as a whole.
+ **/
+#define PACKETEER_POLL_SCAN_CHUNK   8
+
+
+/**
+ * Maximum number of buffers the scheduler's write queues hand to a single
+ * writev()/sendmmsg() call. This is well below IOV_MAX everywhere.
+ **/
+#define PACKETEER_WRITE_QUEUE_IOV_MAX 64
+
+
+/**
+ * Maximum number of messages connectors hand to a single recvmmsg() or
+ * sendmmsg() call in receive_batch()/send_batch(); larger batches are split.
+ **/
+#define PACKETEER_MMSG_BATCH_SIZE 64
+
+
+/**
+ * Limits for UDP segmentation offload; the kernel accepts at most this many
+ * segments per send, and the combined size must fit into a single IPv6
+ * datagram.
+ **/
+#define PACKETEER_UDP_MAX_SEGMENTS  64
+#define PACKETEER_UDP_MAX_GSO_SIZE  (65535 - 40 - 8)
+
+
+/**
+ * Size of and number of read leases; see connector::read(). The size must be
+ * a multiple of the page size for zero-copy receives to map whole pages.
+ **/
+#define PACKETEER_READ_LEASE_SIZE   (256 * 1024)
+#define PACKETEER_READ_LEASE_SLOTS  8
+
+
+/**
+ * Maximum amount connector::splice_to() moves through its internal pipe or
+ * buffer at a time. This matches the default pipe capacity on Linux.
+ **/
+#define PACKETEER_SPLICE_CHUNK_SIZE (64 * 1024)
+
+
+/**
+ * Number of chunks a scheduler pump forwards per readiness event before
+ * turning to other connectors.
+ **/
+#define PACKETEER_PUMP_ROUNDS       16
+
+
+/**
+ * Receive buffer pools; see scheduler::start_reading(). Reads fill blocks of
+ * the given size in slices, until less than the minimum slice size is left;
+ * datagrams need room for the largest possible datagram instead. Each pool
+ * keeps a number of free blocks for reuse.
+ **/
+#define PACKETEER_RECEIVE_BLOCK_SIZE      (256 * 1024)
+#define PACKETEER_RECEIVE_SLICE_MIN       (16 * 1024)
+#define PACKETEER_RECEIVE_DATAGRAM_MAX    (64 * 1024)
+#define PACKETEER_RECEIVE_POOL_BLOCKS     16
+
+
+/**
+ * Number of reads the scheduler performs for a reader per readiness event
+ * before turning to other connectors.
+ **/
+#define PACKETEER_READ_ROUNDS             16
+
+
+/**
+ * Number of signals the scheduler reads from its signal connector with a
+ * single read() call.
+ **/
+#define PACKETEER_SIGNAL_BATCH_SIZE 16
+
+
+/**
+ * Number of event slots in the ring an I/O thread hands events to its
+ * consumer with. Rounded up to a power of two.
+ **/
+#define PACKETEER_IO_THREAD_RING_SIZE 1024
+
 #endif // guard
@@ -0,0 +1,367 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <build-config.h>
+
+#include <packeteer/happy_eyeballs.h>
+
+#include <mutex>
+#include <vector>
+
+#include <packeteer/error.h>
+#include <packeteer/resolver.h>
+
+#include "macros.h"
+
+#if defined(PACKETEER_POSIX)
+#include <sys/types.h>
+#include <sys/socket.h>
+#endif
+
+namespace packeteer {
+
+namespace {
+
+// Events that indicate a connection attempt failed.
+constexpr events_t FAILURE_EVENTS = PEV_IO_ERROR | PEV_IO_CLOSE;
+
+constexpr events_t ATTEMPT_EVENTS = PEV_IO_WRITE | FAILURE_EVENTS;
+
+
+/**
+ * Some I/O subsystems, e.g. select(), only report a refused connection as
+ * writable. The socket's pending error tells whether the attempt failed.
+ */
+bool
+connect_failed(connector const & conn)
+{
+#if defined(PACKETEER_POSIX)
+  int err = 0;
+  ::socklen_t len = sizeof(err);
+  if (::getsockopt(conn.get_write_handle().sys_handle(), SOL_SOCKET, SO_ERROR,
+        &err, &len) < 0)
+  {
+    ERRNO_LOG("Could not check connection attempt.");
+    return true;
+  }
+  return 0 != err;
+#else
+  (void) conn;
+  return false;
+#endif
+}
+
+
+/**
+ * Interleave address families, starting with IPv6 (RFC 8305, Section 4).
+ */
+std::vector<liberate::net::url>
+order_candidates(std::set<liberate::net::url> const & candidates)
+{
+  std::vector<liberate::net::url> inet6;
+  std::vector<liberate::net::url> others;
+  for (auto & candidate : candidates) {
+    if (!candidate.scheme.empty() && candidate.scheme.back() == '6') {
+      inet6.push_back(candidate);
+    }
+    else {
+      others.push_back(candidate);
+    }
+  }
+
+  std::vector<liberate::net::url> ordered;
+  ordered.reserve(candidates.size());
+  for (size_t i = 0 ; i < inet6.size() || i < others.size() ; ++i) {
+    if (i < inet6.size()) {
+      ordered.push_back(inet6[i]);
+    }
+    if (i < others.size()) {
+      ordered.push_back(others[i]);
+    }
+  }
+
+  // Attempts must not block.
+  for (auto & url : ordered) {
+    url.query["blocking"] = "0";
+  }
+  return ordered;
+}
+
+
+
+/**
+ * State of one race. The race keeps itself alive until the callback was
+ * invoked; scheduler callbacks only hold weak references.
+ */
+struct race
+{
+  std::shared_ptr<api>            m_api;
+  scheduler &                     m_scheduler;
+  std::vector<liberate::net::url> m_candidates;
+  duration                        m_attempt_delay;
+  happy_eyeballs_callback         m_callback;
+
+  std::mutex                      m_mutex = {};
+  std::shared_ptr<race>           m_self = {};
+  size_t                          m_next = 0;
+  std::vector<connector>          m_attempts = {};
+  error_t                         m_last_error = ERR_CONNECTION_REFUSED;
+
+  callback                        m_attempt_callback = {};
+  callback                        m_timer_callback = {};
+
+
+  race(std::shared_ptr<api> api, scheduler & sched,
+      std::vector<liberate::net::url> && candidates,
+      duration const & attempt_delay, happy_eyeballs_callback && cb)
+    : m_api{api}
+    , m_scheduler{sched}
+    , m_candidates{std::move(candidates)}
+    , m_attempt_delay{attempt_delay}
+    , m_callback{std::move(cb)}
+  {
+  }
+
+
+
+  error_t start(std::shared_ptr<race> self)
+  {
+    std::weak_ptr<race> weak{self};
+
+    m_attempt_callback = [weak](time_point const &, events_t events,
+        connector * conn) -> error_t
+    {
+      auto r = weak.lock();
+      if (r && conn) {
+        r->on_attempt_event(*conn, events);
+      }
+      return ERR_SUCCESS;
+    };
+
+    m_timer_callback = [weak](time_point const &, events_t, connector *)
+      -> error_t
+    {
+      auto r = weak.lock();
+      if (r) {
+        r->on_timer();
+      }
+      return ERR_SUCCESS;
+    };
+
+    // The first attempt is started from the scheduler as well, so that the
+    // callback is never invoked from within this function.
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_self = self;
+    auto err = m_scheduler.schedule_once(duration{0}, m_timer_callback);
+    if (ERR_SUCCESS != err) {
+      m_self.reset();
+    }
+    return err;
+  }
+
+
+
+  /**
+   * Helpers; all expect the mutex to be held.
+   **/
+  void start_next()
+  {
+    while (m_next < m_candidates.size()) {
+      auto const & url = m_candidates[m_next++];
+
+      connector conn;
+      error_t err = ERR_SUCCESS;
+      try {
+        conn = connector{m_api, url};
+        err = conn.connect();
+      } catch (exception const & ex) {
+        EXC_LOG("Could not create connector", ex);
+        err = ex.code();
+      }
+
+      if (ERR_SUCCESS == err) {
+        win(conn);
+        return;
+      }
+
+      if (ERR_ASYNC == err) {
+        DLOG("Connection attempt to " << url << " started.");
+        m_attempts.push_back(conn);
+        m_scheduler.register_connector(ATTEMPT_EVENTS, conn,
+            m_attempt_callback);
+        if (m_next < m_candidates.size()) {
+          m_scheduler.schedule_once(m_attempt_delay, m_timer_callback);
+        }
+        return;
+      }
+
+      // Synchronous failures move on to the next candidate right away.
+      DLOG("Connection attempt to " << url << " failed: " << error_name(err));
+      m_last_error = err;
+    }
+
+    if (m_attempts.empty()) {
+      finish(m_last_error, connector{});
+    }
+  }
+
+
+
+  void win(connector const & winner)
+  {
+    for (auto & attempt : m_attempts) {
+      m_scheduler.unregister_connector(ATTEMPT_EVENTS, attempt,
+          m_attempt_callback);
+      if (attempt != winner) {
+        attempt.close();
+      }
+    }
+    m_attempts.clear();
+
+    finish(ERR_SUCCESS, winner);
+  }
+
+
+
+  void finish(error_t err, connector const & conn)
+  {
+    m_scheduler.unschedule(m_timer_callback);
+    m_next = m_candidates.size();
+
+    m_callback(err, conn);
+
+    // This may destroy the race once the scheduler callback returns.
+    m_self.reset();
+  }
+
+
+
+  /**
+   * Callbacks
+   **/
+  void on_timer()
+  {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (!m_self) {
+      return;
+    }
+    start_next();
+  }
+
+
+
+  void on_attempt_event(connector const & conn, events_t events)
+  {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (!m_self) {
+      return;
+    }
+
+    auto iter = m_attempts.begin();
+    for ( ; iter != m_attempts.end() ; ++iter) {
+      if (*iter == conn) {
+        break;
+      }
+    }
+    if (iter == m_attempts.end()) {
+      return;
+    }
+
+    if (!(events & FAILURE_EVENTS) && !connect_failed(*iter)) {
+      win(*iter);
+      return;
+    }
+
+    // A failed attempt starts the next one without waiting for the delay.
+    DLOG("Connection attempt failed asynchronously.");
+    auto failed = *iter;
+    m_attempts.erase(iter);
+    m_scheduler.unregister_connector(ATTEMPT_EVENTS, failed,
+        m_attempt_callback);
+    failed.close();
+    m_last_error = ERR_CONNECTION_REFUSED;
+
+    if (m_next < m_candidates.size()) {
+      m_scheduler.unschedule(m_timer_callback);
+      start_next();
+    }
+    else if (m_attempts.empty()) {
+      finish(m_last_error, connector{});
+    }
+  }
+};
+
+} // anonymous namespace
+
+
+
+error_t
+happy_eyeballs_connect(std::shared_ptr<api> api, scheduler & sched,
+    std::set<liberate::net::url> const & candidates,
+    happy_eyeballs_callback && callback,
+    duration const & attempt_delay)
+{
+  if (candidates.empty()) {
+    ELOG("No candidates to connect to.");
+    return ERR_INVALID_VALUE;
+  }
+  if (!callback) {
+    ELOG("No callback provided!");
+    return ERR_EMPTY_CALLBACK;
+  }
+
+  auto state = std::make_shared<race>(api, sched,
+      order_candidates(candidates), attempt_delay, std::move(callback));
+  return state->start(state);
+}
+
+
+
+error_t
+happy_eyeballs_connect(std::shared_ptr<api> api, scheduler & sched,
+    liberate::net::url const & query,
+    happy_eyeballs_callback && callback,
+    duration const & attempt_delay)
+{
+  if (!callback) {
+    ELOG("No callback provided!");
+    return ERR_EMPTY_CALLBACK;
+  }
+
+  auto shared_cb = std::make_shared<happy_eyeballs_callback>(
+      std::move(callback));
+  return api->resolver().resolve_async(sched, query,
+      [api, &sched, shared_cb, attempt_delay](error_t err,
+        std::set<liberate::net::url> const & results)
+      {
+        if (ERR_SUCCESS == err && results.empty()) {
+          err = ERR_ADDRESS_NOT_AVAILABLE;
+        }
+        if (ERR_SUCCESS == err) {
+          auto cb = *shared_cb;
+          err = happy_eyeballs_connect(api, sched, results, std::move(cb),
+              attempt_delay);
+        }
+        if (ERR_SUCCESS != err) {
+          (*shared_cb)(err, connector{});
+        }
+      });
+}
+
+} // namespace packeteer
@@ -29,6 +29,10 @@
 #include "connector/connectors.h"
 #include "connector/util.h"
 
+#if defined(PACKETEER_POSIX)
+#include "connector/posix/tunables.h"
+#endif
+
 
 #define FAIL_FAST(expr) { \
     auto err = expr; \
@@ -42,20 +46,39 @@ namespace packeteer {
 
 namespace {
 
+#if defined(PACKETEER_POSIX)
+/**
+ * Hand the tunables in the URL to a freshly created socket connector.
+ **/
+detail::connector_socket *
+with_tunables(std::shared_ptr<api> api, liberate::net::url const & url,
+    detail::connector_socket * conn)
+{
+  std::unique_ptr<detail::connector_socket> guard{conn};
+
+  int backlog = 0;
+  auto err = detail::backlog_from_query(url.query, backlog);
+  if (ERR_SUCCESS != err) {
+    throw exception(err, "Invalid listen backlog.");
+  }
+
+  guard->set_tunables(api->reg().tunables_from_query(url.query), backlog);
+  return guard.release();
+}
+#endif
+
+
+
+/**
+ * Create TCP and UDP connectors for an already parsed address; ctype is the
+ * type associated with the scheme.
+ **/
 connector_interface *
-inet_creator(std::shared_ptr<api> api,
-    liberate::net::url const & url, connector_type const & ctype,
+create_inet(peer_address const & addr, connector_type const & ctype,
     connector_options const & options, registry::connector_info const * info)
   OCLINT_SUPPRESS("high cyclomatic complexity")
   OCLINT_SUPPRESS("long method")
 {
-  if (url.authority.empty()) {
-    throw exception(ERR_FORMAT, "Require address part in address string.");
-  }
-
-  // Parse socket address.
-  auto addr = peer_address{api, url};
-
   // Make sure the parsed address type matches the protocol.
   if (liberate::net::AT_INET4 == addr.socket_address().type()) {
     if (CT_TCP4 != ctype
@@ -103,6 +126,42 @@ inet_creator(std::shared_ptr<api> api,
 }
 
 
+
+connector_interface *
+inet_creator(std::shared_ptr<api> api,
+    liberate::net::url const & url, connector_type const & ctype,
+    connector_options const & options, registry::connector_info const * info)
+{
+  if (url.authority.empty()) {
+    throw exception(ERR_FORMAT, "Require address part in address string.");
+  }
+
+  // Parse socket address.
+  auto addr = peer_address{api, url};
+
+  auto conn = create_inet(addr, ctype, options, info);
+#if defined(PACKETEER_POSIX)
+  return with_tunables(api, url, static_cast<detail::connector_socket *>(conn));
+#else
+  return conn;
+#endif
+}
+
+
+
+/**
+ * Addresses carry no URL parameters, so connectors created from them use
+ * the default tunables.
+ **/
+connector_interface *
+inet_address_creator(std::shared_ptr<api> api [[maybe_unused]],
+    peer_address const & addr, connector_options const & options,
+    registry::connector_info const * info)
+{
+  return create_inet(addr, info->type, options, info);
+}
+
+
 } // anonymous namespace
 
 
@@ -113,6 +172,7 @@ struct registry::registry_impl
     : m_api(api)
   {
     init_params();
+    init_tunables();
     init_schemes();
   }
 
@@ -157,6 +217,36 @@ struct registry::registry_impl
         }
     ));
 
+    FAIL_FAST(add_parameter("gro",
+        [](std::string const & value, bool) -> connector_options
+        {
+          if (value == "1") {
+            return CO_UDP_GRO;
+          }
+          return CO_DEFAULT;
+        }
+    ));
+
+    FAIL_FAST(add_parameter("zerocopy",
+        [](std::string const & value, bool) -> connector_options
+        {
+          if (value == "1") {
+            return CO_ZEROCOPY;
+          }
+          return CO_DEFAULT;
+        }
+    ));
+
+    FAIL_FAST(add_parameter("zerocopy_receive",
+        [](std::string const & value, bool) -> connector_options
+        {
+          if (value == "1") {
+            return CO_ZEROCOPY_RECEIVE;
+          }
+          return CO_DEFAULT;
+        }
+    ));
+
   }
 
 
@@ -175,8 +265,7 @@ struct registry::registry_impl
 
     auto normalized = liberate::string::to_lower(parameter);
 
-    auto option = option_mappers.find(normalized);
-    if (option != option_mappers.end()) {
+    if (is_registered(normalized)) {
       ELOG("URL parameter already registered!");
       return ERR_INVALID_VALUE;
     }
@@ -218,6 +307,89 @@ struct registry::registry_impl
   }
 
 
+  /***************************************************************************
+   * Tunable registry
+   */
+  std::unordered_map<std::string, registry::tunable_applier> tunable_appliers;
+
+
+  void init_tunables()
+  {
+    if (!tunable_appliers.empty()) {
+      return;
+    }
+
+#if defined(PACKETEER_POSIX)
+    DLOG("Initializing default connector URL tunables.");
+    for (auto & [parameter, applier] : detail::socket_tunables()) {
+      FAIL_FAST(add_tunable(parameter, std::move(applier)));
+    }
+#endif
+  }
+
+
+
+  bool
+  is_registered(std::string const & normalized) const
+  {
+    return option_mappers.find(normalized) != option_mappers.end()
+      || tunable_appliers.find(normalized) != tunable_appliers.end();
+  }
+
+
+
+  error_t
+  add_tunable(std::string const & parameter, tunable_applier && applier)
+  {
+    if (parameter.empty()) {
+      ELOG("Must specify a URL parameter!");
+      return ERR_INVALID_VALUE;
+    }
+    if (!applier) {
+      ELOG("No applier function provided!");
+      return ERR_EMPTY_CALLBACK;
+    }
+
+    auto normalized = liberate::string::to_lower(parameter);
+    if (is_registered(normalized)) {
+      ELOG("URL parameter already registered!");
+      return ERR_INVALID_VALUE;
+    }
+
+    // All good, so keep this.
+    tunable_appliers[normalized] = std::move(applier);
+
+    return ERR_SUCCESS;
+  }
+
+
+
+  tunable_list
+  tunables_from_query(std::map<std::string, std::string> const & query) const
+  {
+    tunable_list result;
+    for (auto const & [key, value] : query) {
+      auto applier = tunable_appliers.find(key);
+      if (applier == tunable_appliers.end()) {
+        continue;
+      }
+
+      DLOG("Found tunable parameter: " << key << "=" << value);
+      result.push_back(
+          [func = applier->second, key = key, value = value](handle const & h)
+            -> error_t
+          {
+            auto err = func(h, value);
+            if (ERR_SUCCESS != err) {
+              ELOG("Could not apply tunable " << key << "=" << value);
+            }
+            return err;
+          });
+    }
+    return result;
+  }
+
+
   /***************************************************************************
    * Scheme registry
    */
@@ -235,29 +407,32 @@ struct registry::registry_impl
   // Register TCP and UDP schemes.
   FAIL_FAST(add_scheme("tcp4", connector_info{CT_TCP4,
       CO_STREAM|CO_NON_BLOCKING,
-      CO_STREAM|CO_BLOCKING|CO_NON_BLOCKING,
-      inet_creator}));
+      CO_STREAM|CO_BLOCKING|CO_NON_BLOCKING|CO_ZEROCOPY
+        |CO_ZEROCOPY_RECEIVE,
+      inet_creator, {}, inet_address_creator}));
   FAIL_FAST(add_scheme("tcp6", connector_info{CT_TCP6,
       CO_STREAM|CO_NON_BLOCKING,
-      CO_STREAM|CO_BLOCKING|CO_NON_BLOCKING,
-      inet_creator}));
+      CO_STREAM|CO_BLOCKING|CO_NON_BLOCKING|CO_ZEROCOPY
+        |CO_ZEROCOPY_RECEIVE,
+      inet_creator, {}, inet_address_creator}));
   FAIL_FAST(add_scheme("tcp", connector_info{CT_TCP,
       CO_STREAM|CO_NON_BLOCKING,
-      CO_STREAM|CO_BLOCKING|CO_NON_BLOCKING,
-      inet_creator}));
+      CO_STREAM|CO_BLOCKING|CO_NON_BLOCKING|CO_ZEROCOPY
+        |CO_ZEROCOPY_RECEIVE,
+      inet_creator, {}, inet_address_creator}));
 
   FAIL_FAST(add_scheme("udp4", connector_info{CT_UDP4,
       CO_DATAGRAM|CO_NON_BLOCKING,
-      CO_DATAGRAM|CO_BLOCKING|CO_NON_BLOCKING,
-      inet_creator}));
+      CO_DATAGRAM|CO_BLOCKING|CO_NON_BLOCKING|CO_UDP_GRO,
+      inet_creator, {}, inet_address_creator}));
   FAIL_FAST(add_scheme("udp6", connector_info{CT_UDP6,
       CO_DATAGRAM|CO_NON_BLOCKING,
-      CO_DATAGRAM|CO_BLOCKING|CO_NON_BLOCKING,
-      inet_creator}));
+      CO_DATAGRAM|CO_BLOCKING|CO_NON_BLOCKING|CO_UDP_GRO,
+      inet_creator, {}, inet_address_creator}));
   FAIL_FAST(add_scheme("udp", connector_info{CT_UDP,
       CO_DATAGRAM|CO_NON_BLOCKING,
-      CO_DATAGRAM|CO_BLOCKING|CO_NON_BLOCKING,
-      inet_creator}));
+      CO_DATAGRAM|CO_BLOCKING|CO_NON_BLOCKING|CO_UDP_GRO,
+      inet_creator, {}, inet_address_creator}));
 
   // Register anonymous scheme
   FAIL_FAST(add_scheme("anon", connector_info{CT_ANON,
@@ -324,6 +499,29 @@ struct registry::registry_impl
       }}));
 #endif
 
+#if defined(PACKETEER_HAVE_SIGNALFD)
+  // Register signal scheme
+  FAIL_FAST(add_scheme("signal", connector_info{CT_SIGNAL,
+      CO_STREAM|CO_NON_BLOCKING,
+      CO_STREAM|CO_BLOCKING|CO_NON_BLOCKING,
+      [] (std::shared_ptr<api> api [[maybe_unused]],
+          liberate::net::url const & url, connector_type const &,
+          connector_options const & options, connector_info const * info)
+        -> connector_interface *
+      {
+        if (!url.path.empty()) {
+          throw exception(ERR_FORMAT,
+              "Path component makes no sense for signal:// connectors.");
+        }
+
+        // Sanitize options
+        auto opts = detail::sanitize_options(options, info->default_options,
+            info->possible_options);
+
+        return new detail::connector_signal{peer_address{api, url}, opts};
+      }}));
+#endif
+
 #if defined(PACKETEER_POSIX) || defined(PACKETEER_HAVE_AFUNIX_H)
   // Register posix local addresses, if possible.
   FAIL_FAST(add_scheme("local", connector_info{CT_LOCAL,
@@ -338,7 +536,23 @@ struct registry::registry_impl
         auto opts = detail::sanitize_options(options, info->default_options,
             info->possible_options);
 
+#if defined(PACKETEER_POSIX)
+        return with_tunables(api, url,
+            new detail::connector_local{peer_address{api, url}, opts});
+#else
         return new detail::connector_local{peer_address{api, url}, opts};
+#endif
+      },
+      {},
+      [] (std::shared_ptr<api> api [[maybe_unused]],
+          peer_address const & addr, connector_options const & options,
+          connector_info const * info) -> connector_interface *
+      {
+        // Sanitize options
+        auto opts = detail::sanitize_options(options, info->default_options,
+            info->possible_options);
+
+        return new detail::connector_local{addr, opts};
       }}));
 #endif
   }
@@ -445,6 +659,24 @@ registry::options_from_query(
 
 
 
+error_t
+registry::add_tunable(std::string const & parameter,
+    registry::tunable_applier && applier)
+{
+  return m_impl->add_tunable(parameter, std::move(applier));
+}
+
+
+
+registry::tunable_list
+registry::tunables_from_query(
+      std::map<std::string, std::string> const & query) const
+{
+  return m_impl->tunables_from_query(query);
+}
+
+
+
 error_t
 registry::add_scheme(std::string const & scheme, connector_info const & info)
 {
@@ -19,7 +19,14 @@
  **/
 #include <packeteer/resolver.h>
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
+#include <vector>
+
+#include <packeteer/scheduler.h>
 
 #include <liberate/string/util.h>
 #include <liberate/net/address_type.h>
@@ -141,17 +148,240 @@ inet_resolver(std::shared_ptr<api> api,
 }
 
 
+
+/*****************************************************************************
+ * Cache and asynchronous lookups
+ **/
+
+// Lookups beyond this many in parallel are queued.
+constexpr size_t MAX_LOOKUP_THREADS = 4;
+
+// Expired cache entries are pruned when the cache grows beyond this size.
+constexpr size_t CACHE_PRUNE_SIZE = 1024;
+
+using url_set = std::set<liberate::net::url>;
+
+struct cache_entry
+{
+  error_t     error;
+  url_set     result;
+  time_point  expires;
+};
+
+struct lookup_waiter
+{
+  scheduler *                   sched;
+  resolver::resolution_callback callback;
+};
+
+struct lookup_job
+{
+  liberate::net::url            query;
+  resolver::resolution_function func;
+};
+
+/**
+ * Lookup threads share this state with the resolver; if the last reference
+ * to the API is dropped on a lookup thread, that thread can finish after
+ * the resolver is gone.
+ */
+struct lookup_state
+{
+  std::weak_ptr<api>                                  weak_api;
+
+  std::mutex                                          mutex = {};
+  std::condition_variable                             condition = {};
+  bool                                                shutdown = false;
+
+  duration                                            positive_ttl;
+  duration                                            negative_ttl;
+  std::unordered_map<liberate::net::url, cache_entry> cache = {};
+
+  std::unordered_map<
+    liberate::net::url, std::vector<lookup_waiter>
+  >                                                   in_flight = {};
+  std::deque<lookup_job>                              jobs = {};
+  std::vector<std::thread>                            threads = {};
+  size_t                                              idle_threads = 0;
+};
+
+
+
+/**
+ * Cache helpers; these expect the state mutex to be held.
+ **/
+cache_entry const *
+cache_find(lookup_state & state, liberate::net::url const & key)
+{
+  auto iter = state.cache.find(key);
+  if (iter == state.cache.end()) {
+    return nullptr;
+  }
+  if (iter->second.expires <= clock::now()) {
+    state.cache.erase(iter);
+    return nullptr;
+  }
+  return &iter->second;
+}
+
+
+
+void
+cache_store(lookup_state & state, liberate::net::url const & key,
+    error_t error, url_set const & result)
+{
+  auto ttl = (ERR_SUCCESS == error) ? state.positive_ttl : state.negative_ttl;
+  if (ttl <= duration{0}) {
+    return;
+  }
+
+  auto now = clock::now();
+  if (state.cache.size() >= CACHE_PRUNE_SIZE) {
+    for (auto iter = state.cache.begin() ; iter != state.cache.end() ; ) {
+      if (iter->second.expires <= now) {
+        iter = state.cache.erase(iter);
+      }
+      else {
+        ++iter;
+      }
+    }
+  }
+
+  state.cache[key] = cache_entry{error, result, now + ttl};
+}
+
+
+
+void
+deliver(scheduler & sched, resolver::resolution_callback const & cb,
+    error_t error, std::shared_ptr<url_set const> const & result)
+{
+  callback completion = [cb, error, result](time_point const &, events_t,
+      connector *) -> error_t
+  {
+    cb(error, *result);
+    return ERR_SUCCESS;
+  };
+
+  auto err = sched.schedule_once(duration{0}, completion);
+  if (ERR_SUCCESS != err) {
+    ELOG("Could not schedule resolution callback: " << error_name(err));
+  }
+}
+
+
+
+error_t
+run_resolution(std::weak_ptr<api> const & weak_api,
+    resolver::resolution_function const & func,
+    url_set & result, liberate::net::url const & query)
+{
+  auto locked = weak_api.lock();
+  if (!locked) {
+    ELOG("API is already being destroyed.");
+    return ERR_UNEXPECTED;
+  }
+
+  // Resolution functions are user code; an exception escaping into the
+  // lookup threads would terminate the process, and leave waiters hanging.
+  try {
+    return func(locked, result, query);
+  } catch (exception const & ex) {
+    EXC_LOG("Error in resolution function", ex);
+    result.clear();
+    return ex.code();
+  } catch (std::exception const & ex) {
+    EXC_LOG("Error in resolution function", ex);
+  } catch (...) {
+    ELOG("Unknown error in resolution function.");
+  }
+  result.clear();
+  return ERR_UNEXPECTED;
+}
+
+
+
+void
+lookup_loop(std::shared_ptr<lookup_state> state)
+{
+  std::unique_lock<std::mutex> lock{state->mutex};
+  while (true) {
+    ++state->idle_threads;
+    state->condition.wait(lock, [&state]() {
+        return state->shutdown || !state->jobs.empty();
+    });
+    --state->idle_threads;
+    if (state->shutdown) {
+      return;
+    }
+
+    auto job = std::move(state->jobs.front());
+    state->jobs.pop_front();
+    lock.unlock();
+
+    url_set result;
+    auto err = run_resolution(state->weak_api, job.func, result, job.query);
+
+    lock.lock();
+    if (state->shutdown) {
+      return;
+    }
+
+    cache_store(*state, job.query, err, result);
+
+    auto waiters = state->in_flight.find(job.query);
+    if (waiters == state->in_flight.end()) {
+      continue;
+    }
+    auto shared = std::make_shared<url_set const>(std::move(result));
+    for (auto & waiter : waiters->second) {
+      deliver(*waiter.sched, waiter.callback, err, shared);
+    }
+    state->in_flight.erase(waiters);
+  }
+}
+
+
 } // anonymous namespace
 
 struct resolver::resolver_impl
 {
   resolver_impl(std::weak_ptr<api> api)
     : m_api(api)
+    , m_state{std::make_shared<lookup_state>()}
   {
+    m_state->weak_api = api;
+    m_state->positive_ttl = std::chrono::seconds{30};
+    m_state->negative_ttl = std::chrono::seconds{5};
+
     init_resolution_funcs();
   }
 
+
+
+  ~resolver_impl()
+  {
+    // Pending lookups are abandoned without invoking their callbacks.
+    std::vector<std::thread> threads;
+    {
+      std::lock_guard<std::mutex> lock{m_state->mutex};
+      m_state->shutdown = true;
+      threads.swap(m_state->threads);
+    }
+    m_state->condition.notify_all();
+
+    for (auto & thread : threads) {
+      if (thread.get_id() == std::this_thread::get_id()) {
+        thread.detach();
+      }
+      else {
+        thread.join();
+      }
+    }
+  }
+
   std::weak_ptr<api> m_api;
+  std::shared_ptr<lookup_state> m_state;
 
   resolver_impl() = delete;
 
@@ -212,28 +442,115 @@ struct resolver::resolver_impl
 
 
 
+  resolver::resolution_function const *
+  find_function(liberate::net::url & normalized_query,
+      liberate::net::url const & query)
+  {
+    normalized_query = query;
+    normalized_query.scheme = liberate::string::to_lower(query.scheme);
+
+    auto func_iter = resolution_functions.find(normalized_query.scheme);
+    if (func_iter == resolution_functions.end()) {
+      ELOG("Scheme not recognized!");
+      return nullptr;
+    }
+    return &func_iter->second;
+  }
+
+
+
   error_t
   resolve(std::set<liberate::net::url> & result,
         liberate::net::url const & query)
   {
-    auto normalized = liberate::string::to_lower(query.scheme);
-
     // Try to find resolution function
-    auto func_iter = resolution_functions.find(normalized);
-    if (func_iter == resolution_functions.end()) {
-      ELOG("Scheme not recognized!");
+    liberate::net::url query_copy;
+    auto func = find_function(query_copy, query);
+    if (!func) {
       return ERR_INVALID_VALUE;
     }
 
-    // Create temporary shared_ptr for API, then call function with that.
-    try {
-      liberate::net::url query_copy{query};
-      query_copy.scheme = normalized;
-      return func_iter->second(std::shared_ptr<api>{m_api}, result, query_copy);
-    } catch (std::bad_weak_ptr const & ex) {
-      ELOG("API is already being destroyed.");
-      return ERR_UNEXPECTED;
+    {
+      std::lock_guard<std::mutex> lock{m_state->mutex};
+      auto entry = cache_find(*m_state, query_copy);
+      if (entry) {
+        result.insert(entry->result.begin(), entry->result.end());
+        return entry->error;
+      }
+    }
+
+    url_set resolved;
+    auto err = run_resolution(m_api, *func, resolved, query_copy);
+
+    {
+      std::lock_guard<std::mutex> lock{m_state->mutex};
+      cache_store(*m_state, query_copy, err, resolved);
     }
+
+    result.insert(resolved.begin(), resolved.end());
+    return err;
+  }
+
+
+
+  error_t
+  resolve_async(scheduler & sched, liberate::net::url const & query,
+      resolver::resolution_callback && callback)
+  {
+    if (!callback) {
+      ELOG("No resolution callback provided!");
+      return ERR_EMPTY_CALLBACK;
+    }
+
+    liberate::net::url query_copy;
+    auto func = find_function(query_copy, query);
+    if (!func) {
+      return ERR_INVALID_VALUE;
+    }
+
+    std::lock_guard<std::mutex> lock{m_state->mutex};
+
+    auto entry = cache_find(*m_state, query_copy);
+    if (entry) {
+      deliver(sched, callback, entry->error,
+          std::make_shared<url_set const>(entry->result));
+      return ERR_SUCCESS;
+    }
+
+    // Identical queries in flight only get another waiter.
+    auto & waiters = m_state->in_flight[query_copy];
+    waiters.push_back({&sched, std::move(callback)});
+    if (waiters.size() > 1) {
+      return ERR_SUCCESS;
+    }
+
+    m_state->jobs.push_back({query_copy, *func});
+    if (!m_state->idle_threads
+        && m_state->threads.size() < MAX_LOOKUP_THREADS)
+    {
+      m_state->threads.emplace_back(lookup_loop, m_state);
+    }
+    m_state->condition.notify_one();
+    return ERR_SUCCESS;
+  }
+
+
+
+  void
+  set_cache_ttl(duration const & positive, duration const & negative)
+  {
+    std::lock_guard<std::mutex> lock{m_state->mutex};
+    m_state->positive_ttl = positive;
+    m_state->negative_ttl = negative;
+  }
+
+
+
+  void
+  clear_cache()
+  {
+    std::lock_guard<std::mutex> lock{m_state->mutex};
+    m_state->cache.clear();
   }
 };
 
@@ -272,5 +589,30 @@ resolver::resolve(std::set<liberate::net::url> & result,
 
 
 
+error_t
+resolver::resolve_async(scheduler & sched, liberate::net::url const & query,
+      resolver::resolution_callback && callback)
+{
+  return m_impl->resolve_async(sched, query, std::move(callback));
+}
+
+
+
+void
+resolver::set_cache_ttl(duration const & positive, duration const & negative)
+{
+  m_impl->set_cache_ttl(positive, negative);
+}
+
+
+
+void
+resolver::clear_cache()
+{
+  m_impl->clear_cache();
+}
+
+
+
 
 } // namespace packeteer
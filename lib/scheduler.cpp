@@ -25,6 +25,10 @@
 
 #include <stdexcept>
 
+#if defined(PACKETEER_HAVE_SIGNALFD)
+#include <signal.h>
+#endif
+
 #include "scheduler/scheduler_impl.h"
 #include "scheduler/worker.h"
 
@@ -38,8 +42,9 @@ namespace packeteer {
  **/
 
 scheduler::scheduler(std::shared_ptr<api> api, ssize_t num_workers,
-    scheduler_type type /* = TYPE_AUTOMATIC */)
-  : m_impl{std::make_unique<scheduler_impl>(api, num_workers, type)}
+    scheduler_type type /* = TYPE_AUTOMATIC */,
+    dispatch_mode mode /* = DISPATCH_MAIN_LOOP */)
+  : m_impl{std::make_unique<scheduler_impl>(api, num_workers, type, mode)}
 {
 }
 
@@ -130,6 +135,97 @@ scheduler::unregister_connectors(connector const * conns, size_t amount)
 
 
 
+error_t
+scheduler::enqueue_write(connector const & conn, void const * buf,
+    size_t bufsize)
+{
+  return m_impl->enqueue_write(conn, buf, bufsize);
+}
+
+
+
+error_t
+scheduler::enqueue_write(connector const & conn, buffer data)
+{
+  return m_impl->enqueue_write(conn, std::move(data));
+}
+
+
+
+error_t
+scheduler::set_write_watermarks(connector const & conn, size_t low_watermark,
+    size_t high_watermark, size_t notsent_lowat /* = 0 */)
+{
+  return m_impl->set_write_watermarks(conn, low_watermark, high_watermark,
+      notsent_lowat);
+}
+
+
+
+size_t
+scheduler::write_queue_size(connector const & conn) const
+{
+  return m_impl->write_queue_size(conn);
+}
+
+
+
+error_t
+scheduler::add_pump(connector const & source, connector const & destination)
+{
+  return m_impl->add_pump(source, destination);
+}
+
+
+
+error_t
+scheduler::remove_pump(connector const & source)
+{
+  return m_impl->remove_pump(source);
+}
+
+
+
+error_t
+scheduler::start_reading(connector const & conn,
+    data_callback const & callback)
+{
+  return m_impl->start_reading(conn, callback);
+}
+
+
+
+error_t
+scheduler::stop_reading(connector const & conn)
+{
+  return m_impl->stop_reading(conn);
+}
+
+
+
+handle
+scheduler::poll_handle() const
+{
+  if (m_impl->num_workers() > 0) {
+    return {};
+  }
+  return m_impl->poll_handle();
+}
+
+
+
+time_point
+scheduler::next_deadline() const
+{
+  if (m_impl->num_workers() > 0) {
+    return time_point::max();
+  }
+  return m_impl->next_deadline();
+}
+
+
+
+
 error_t
 scheduler::schedule_once(duration const & delay, callback const & callback)
 {
@@ -217,6 +313,48 @@ scheduler::unregister_event(events_t const & events, callback const & callback)
 
 
 
+error_t
+scheduler::register_signal(int signal, callback const & callback)
+{
+#if defined(PACKETEER_HAVE_SIGNALFD)
+  if (signal <= 0 || signal >= NSIG || SIGKILL == signal || SIGSTOP == signal)
+  {
+    return ERR_INVALID_VALUE;
+  }
+
+  // Block the signal in the calling thread, so it does not get delivered
+  // before the scheduler picks up the registration.
+  ::sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, signal);
+  ::pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+
+  auto entry = new detail::signal_callback_entry(callback, signal);
+  m_impl->commands().enqueue(CMD_ADD, entry);
+  m_impl->commands().commit();
+  return ERR_SUCCESS;
+#else
+  return ERR_UNSUPPORTED_ACTION;
+#endif
+}
+
+
+
+error_t
+scheduler::unregister_signal(int signal, callback const & callback)
+{
+#if defined(PACKETEER_HAVE_SIGNALFD)
+  auto entry = new detail::signal_callback_entry(callback, signal);
+  m_impl->commands().enqueue(CMD_REMOVE, entry);
+  m_impl->commands().commit();
+  return ERR_SUCCESS;
+#else
+  return ERR_UNSUPPORTED_ACTION;
+#endif
+}
+
+
+
 error_t
 scheduler::fire_events(events_t const & events)
 {
@@ -262,9 +400,16 @@ scheduler::process_events(duration const & timeout,
     return ERR_UNSUPPORTED_ACTION;
   }
 
-  // First, get events to schedule to workers.
+  // First, get events to schedule to workers. Committed commands wake up the
+  // I/O subsystem without necessarily producing callbacks to run, so keep
+  // waiting for the remainder of the timeout in that case.
   entry_list_t to_schedule;
-  m_impl->wait_for_events(timeout, soft_timeout, to_schedule);
+  auto deadline = clock::now() + timeout;
+  auto remaining = timeout;
+  do {
+    m_impl->wait_for_events(remaining, soft_timeout, to_schedule);
+    remaining = deadline - clock::now();
+  } while (to_schedule.empty() && remaining > duration{0});
 
   if (to_schedule.empty()) {
     // No events
@@ -0,0 +1,251 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <build-config.h>
+
+#include "buffer_pool.h"
+
+#include <algorithm>
+#include <new>
+
+#include "../globals.h"
+#include "../macros.h"
+
+namespace packeteer::detail {
+
+namespace {
+
+// Slices start at this alignment, so that callers may read structured data
+// from them.
+constexpr size_t SLICE_ALIGNMENT = alignof(std::max_align_t);
+
+/**
+ * Detaches the thread's pool when the thread exits.
+ **/
+struct local_pool
+{
+  buffer_pool * pool = nullptr;
+
+  ~local_pool()
+  {
+    if (pool) {
+      pool->detach();
+    }
+  }
+};
+
+thread_local local_pool tls_pool;
+
+
+inline void
+destroy_block(buffer_block * block)
+{
+  block->~buffer_block();
+  ::operator delete(block);
+}
+
+} // anonymous namespace
+
+
+
+void
+buffer_block::unref(buffer_block * block)
+{
+  if (!block) {
+    return;
+  }
+  if (1 == block->refcount.fetch_sub(1, std::memory_order_acq_rel)) {
+    block->pool->recycle(block);
+  }
+}
+
+
+
+buffer_pool *
+buffer_pool::create(size_t block_size, size_t max_free)
+{
+  return new buffer_pool{block_size, max_free};
+}
+
+
+
+buffer_pool &
+buffer_pool::local()
+{
+  if (!tls_pool.pool) {
+    tls_pool.pool = create(PACKETEER_RECEIVE_BLOCK_SIZE,
+        PACKETEER_RECEIVE_POOL_BLOCKS);
+  }
+  return *tls_pool.pool;
+}
+
+
+
+buffer_pool::buffer_pool(size_t block_size, size_t max_free)
+  : m_block_size{block_size}
+  , m_max_free{max_free}
+{
+}
+
+
+
+buffer_pool::~buffer_pool()
+{
+  for (auto block : m_free) {
+    destroy_block(block);
+  }
+}
+
+
+
+void
+buffer_pool::detach()
+{
+  // Dropping the current block may recycle it, which takes the lock.
+  auto current = m_current;
+  m_current = nullptr;
+  buffer_block::unref(current);
+
+  bool last = false;
+  {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_detached = true;
+    last = !m_outstanding;
+  }
+
+  if (last) {
+    delete this;
+  }
+}
+
+
+
+error_t
+buffer_pool::read(connector & conn, buffer & result)
+{
+  // Start a new block if the current one can't hold a reasonable amount.
+  size_t wanted = min_space(conn);
+  if (m_current && m_block_size - m_used < wanted) {
+    buffer_block::unref(m_current);
+    m_current = nullptr;
+  }
+  if (!m_current) {
+    m_current = take_block();
+    m_used = 0;
+  }
+
+  char * start = m_current->data() + m_used;
+  size_t amount = 0;
+  auto err = conn.read(start, m_block_size - m_used, amount);
+  if (ERR_SUCCESS != err) {
+    return err;
+  }
+  if (!amount) {
+    result.reset();
+    return ERR_SUCCESS;
+  }
+
+  result = buffer{buffer_block::ref(m_current), start, amount};
+  m_used = std::min(m_block_size,
+      (m_used + amount + SLICE_ALIGNMENT - 1) & ~(SLICE_ALIGNMENT - 1));
+  return ERR_SUCCESS;
+}
+
+
+
+void
+buffer_pool::recycle(buffer_block * block)
+{
+  bool last = false;
+  {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    --m_outstanding;
+    if (!m_detached && m_free.size() < m_max_free) {
+      m_free.push_back(block);
+      return;
+    }
+    last = m_detached && !m_outstanding;
+  }
+
+  destroy_block(block);
+  if (last) {
+    delete this;
+  }
+}
+
+
+
+size_t
+buffer_pool::free_blocks() const
+{
+  std::lock_guard<std::mutex> lock{m_mutex};
+  return m_free.size();
+}
+
+
+
+size_t
+buffer_pool::used_blocks() const
+{
+  std::lock_guard<std::mutex> lock{m_mutex};
+  return m_outstanding;
+}
+
+
+
+size_t
+buffer_pool::min_space(connector const & conn) const
+{
+  // A datagram that does not fit is truncated, so it needs all the space it
+  // could possibly need.
+  size_t wanted = PACKETEER_RECEIVE_SLICE_MIN;
+  if (conn.get_options() & CO_DATAGRAM) {
+    wanted = PACKETEER_RECEIVE_DATAGRAM_MAX;
+  }
+  return std::min(wanted, m_block_size);
+}
+
+
+
+buffer_block *
+buffer_pool::take_block()
+{
+  buffer_block * block = nullptr;
+  {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    ++m_outstanding;
+    if (!m_free.empty()) {
+      block = m_free.back();
+      m_free.pop_back();
+    }
+  }
+
+  if (block) {
+    block->refcount.store(1, std::memory_order_relaxed);
+    return block;
+  }
+
+  void * mem = ::operator new(sizeof(buffer_block) + m_block_size);
+  block = new (mem) buffer_block{};
+  block->pool = this;
+  block->capacity = m_block_size;
+  return block;
+}
+
+} // namespace packeteer::detail
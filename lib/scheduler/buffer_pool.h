@@ -0,0 +1,144 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef PACKETEER_SCHEDULER_BUFFER_POOL_H
+#define PACKETEER_SCHEDULER_BUFFER_POOL_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <packeteer.h>
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include <packeteer/buffer.h>
+#include <packeteer/connector.h>
+
+namespace packeteer::detail {
+
+/**
+ * Memory blocks are allocated with their payload directly following them.
+ * Each buffer referring to a block holds a reference, as does the pool
+ * while it is still reading into the block.
+ **/
+struct PACKETEER_PRIVATE buffer_block
+{
+  std::atomic<size_t> refcount = 1;
+  buffer_pool *       pool = nullptr;
+  size_t              capacity = 0;
+
+  inline char * data()
+  {
+    return reinterpret_cast<char *>(this + 1);
+  }
+
+  static inline buffer_block * ref(buffer_block * block)
+  {
+    if (block) {
+      block->refcount.fetch_add(1, std::memory_order_relaxed);
+    }
+    return block;
+  }
+
+  /**
+   * Drop a reference; the last one hands the block back to its pool.
+   **/
+  static void unref(buffer_block * block);
+};
+
+
+
+/**
+ * The buffer_pool reads from connectors into slices of recycled memory
+ * blocks. Successive reads fill the same block until too little space is
+ * left in it, so small reads do not cost a block each.
+ *
+ * Only one thread - the owner - may read() through the pool; the scheduler
+ * keeps one pool per thread executing callbacks, see local(). Blocks can be
+ * released from any thread, however. The owner never deletes the pool, but
+ * detach()es from it instead; the pool then lives on until the last
+ * outstanding block is released.
+ **/
+class PACKETEER_PRIVATE buffer_pool
+{
+public:
+  /**
+   * Create a pool with the given block size, which keeps at most max_free
+   * blocks for reuse.
+   **/
+  static buffer_pool * create(size_t block_size, size_t max_free);
+
+  /**
+   * The calling thread's pool, created with the default sizes on first use,
+   * and detached when the thread exits.
+   **/
+  static buffer_pool & local();
+
+  /**
+   * Give up ownership of the pool.
+   **/
+  void detach();
+
+  /**
+   * Read from the connector. On success, the result refers to the data that
+   * was read; it is empty if the connector reached the end of its data.
+   * Other return values are those of connector::read().
+   **/
+  error_t read(connector & conn, buffer & result);
+
+  /**
+   * Take back a block when the last reference to it is dropped.
+   **/
+  void recycle(buffer_block * block);
+
+  /**
+   * Number of blocks kept for reuse, and the number of blocks in use.
+   **/
+  size_t free_blocks() const;
+  size_t used_blocks() const;
+
+private:
+  buffer_pool(size_t block_size, size_t max_free);
+  ~buffer_pool();
+
+  // Space a read into the current block needs for the connector.
+  size_t min_space(connector const & conn) const;
+
+  buffer_block * take_block();
+
+  size_t                        m_block_size;
+  size_t                        m_max_free;
+
+  // Owner side.
+  buffer_block *                m_current = nullptr;
+  size_t                        m_used = 0;
+
+  // Shared with whoever releases blocks.
+  mutable std::mutex            m_mutex;
+  std::vector<buffer_block *>   m_free;
+  size_t                        m_outstanding = 0;
+  bool                          m_detached = false;
+};
+
+} // namespace packeteer::detail
+
+#endif // guard
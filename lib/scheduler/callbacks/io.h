@@ -52,6 +52,10 @@ struct io_callback_entry : public callback_entry
   events_t      m_events;
   io_flags_t    m_flags;
 
+  // In leader/follower mode, the leader holds the connector while this copy
+  // runs in a follower; it must be released afterwards.
+  bool          m_held = false;
+
   io_callback_entry(callback const & cb, connector const & conn,
       events_t const & events, io_flags_t flags = IO_FLAGS_NONE)
     : callback_entry(CB_ENTRY_IO, cb)
@@ -202,6 +206,24 @@ struct io_callbacks_t
   }
 
 
+  /**
+   * Return the union of events any callback is registered for on the given
+   * connector.
+   **/
+  events_t
+  registered_events(connector const & conn) const
+  {
+    events_t result = 0;
+
+    auto range = m_callback_map.equal_range(conn);
+    for (auto iter = range.first ; iter != range.second ; ++iter) {
+      result |= iter->second->m_events;
+    }
+
+    return result;
+  }
+
+
 private:
   // For the same file descriptor, we may have multiple callback entries.
   std::unordered_multimap<connector, io_callback_entry *> m_callback_map;
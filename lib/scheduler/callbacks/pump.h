@@ -0,0 +1,201 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef PACKETEER_SCHEDULER_CALLBACKS_PUMP_H
+#define PACKETEER_SCHEDULER_CALLBACKS_PUMP_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <packeteer.h>
+
+#include <packeteer/connector.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "../../macros.h"
+
+namespace packeteer::detail {
+
+// Pumps forward data between connectors without invoking callbacks; see
+// scheduler::add_pump(). They travel through the command queue like the
+// callback entries, but never reach workers.
+//
+//  - The lookup occurs via the source connector when it becomes readable.
+//  - A pump that waits for its destination to become writable is looked up
+//    via the destination; several pumps may feed the same destination.
+//  - Each source feeds at most one pump.
+
+struct pump_entry : public callback_entry
+{
+  connector m_source;
+  connector m_destination;
+
+  // Set while the pump waits for the destination rather than the source.
+  bool      m_waiting = false;
+
+  pump_entry(connector const & source, connector const & destination)
+    : callback_entry(CB_ENTRY_PUMP)
+    , m_source(source)
+    , m_destination(destination)
+  {
+  }
+};
+
+
+struct pumps_t
+{
+  pumps_t()
+  {
+  }
+
+
+  ~pumps_t()
+  {
+    DLOG("Clearing pumps.");
+    for (auto & entry : m_sources) {
+      delete entry.second;
+    }
+  }
+
+
+
+  /**
+   * Takes ownership of the passed entry. Returns the entry it replaces for
+   * the same source, if any; ownership of that goes to the caller.
+   **/
+  inline pump_entry *
+  add(pump_entry * pump)
+  {
+    auto previous = remove(pump->m_source);
+    m_sources[pump->m_source] = pump;
+    return previous;
+  }
+
+
+
+  /**
+   * Removes the pump for the given source, and returns it; ownership goes
+   * to the caller. The pump's m_waiting flag is left as it was.
+   **/
+  inline pump_entry *
+  remove(connector const & source)
+  {
+    auto iter = m_sources.find(source);
+    if (iter == m_sources.end()) {
+      return nullptr;
+    }
+
+    auto pump = iter->second;
+    m_sources.erase(iter);
+    if (pump->m_waiting) {
+      erase_waiting(*pump);
+    }
+    return pump;
+  }
+
+
+
+  /**
+   * Find the pump for the given source.
+   **/
+  inline pump_entry *
+  find(connector const & source) const
+  {
+    auto iter = m_sources.find(source);
+    if (iter == m_sources.end()) {
+      return nullptr;
+    }
+    return iter->second;
+  }
+
+
+
+  /**
+   * Mark a pump as waiting for its destination, or not.
+   **/
+  inline void
+  set_waiting(pump_entry & pump, bool waiting)
+  {
+    if (pump.m_waiting == waiting) {
+      return;
+    }
+    pump.m_waiting = waiting;
+
+    if (waiting) {
+      m_waiting.insert(std::make_pair(pump.m_destination, &pump));
+    }
+    else {
+      erase_waiting(pump);
+    }
+  }
+
+
+
+  /**
+   * Return the pumps waiting for the given destination. The result is a
+   * copy, so pumps may be modified while iterating over it.
+   **/
+  inline std::vector<pump_entry *>
+  waiting_for(connector const & destination) const
+  {
+    std::vector<pump_entry *> result;
+    auto range = m_waiting.equal_range(destination);
+    for (auto iter = range.first ; iter != range.second ; ++iter) {
+      result.push_back(iter->second);
+    }
+    return result;
+  }
+
+
+  inline bool
+  is_waited_for(connector const & destination) const
+  {
+    return m_waiting.find(destination) != m_waiting.end();
+  }
+
+
+  inline bool
+  empty() const
+  {
+    return m_sources.empty();
+  }
+
+private:
+  inline void
+  erase_waiting(pump_entry const & pump)
+  {
+    auto range = m_waiting.equal_range(pump.m_destination);
+    for (auto iter = range.first ; iter != range.second ; ++iter) {
+      if (iter->second == &pump) {
+        m_waiting.erase(iter);
+        return;
+      }
+    }
+  }
+
+  std::unordered_map<connector, pump_entry *>       m_sources;
+  std::unordered_multimap<connector, pump_entry *>  m_waiting;
+};
+
+} // namespace packeteer::detail
+
+#endif // guard
@@ -0,0 +1,149 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef PACKETEER_SCHEDULER_CALLBACKS_READER_H
+#define PACKETEER_SCHEDULER_CALLBACKS_READER_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <packeteer.h>
+
+#include <packeteer/connector.h>
+#include <packeteer/scheduler/callback.h>
+
+#include <unordered_map>
+
+#include "../../macros.h"
+
+namespace packeteer::detail {
+
+// Readers read data from a connector on a worker, and pass it to their
+// callback; see scheduler::start_reading().
+//
+//  - The lookup occurs via the connector when it becomes readable.
+//  - Each connector has at most one reader.
+//  - While a worker reads, the main loop stops polling the connector for
+//    reading. The worker hands its copy of the entry back via the command
+//    queue when it's done, which resumes polling.
+
+struct reader_entry : public callback_entry
+{
+  connector     m_connector;
+  data_callback m_data_callback;
+
+  // Identifies the start_reading() call; a worker's copy that comes back
+  // after the reader was stopped or replaced must be ignored.
+  size_t        m_id = 0;
+
+  // Set in the main loop's entry while a worker reads.
+  bool          m_in_flight = false;
+
+  // Set by the worker if reading ended with PEV_IO_CLOSE or PEV_IO_ERROR.
+  events_t      m_events = 0;
+
+  reader_entry(connector const & conn, data_callback const & callback,
+      size_t id)
+    : callback_entry(CB_ENTRY_READER)
+    , m_connector(conn)
+    , m_data_callback(callback)
+    , m_id(id)
+  {
+  }
+};
+
+
+struct readers_t
+{
+  readers_t()
+  {
+  }
+
+
+  ~readers_t()
+  {
+    DLOG("Clearing readers.");
+    for (auto & entry : m_readers) {
+      delete entry.second;
+    }
+  }
+
+
+
+  /**
+   * Takes ownership of the passed entry. Returns the entry it replaces for
+   * the same connector, if any; ownership of that goes to the caller.
+   **/
+  inline reader_entry *
+  add(reader_entry * reader)
+  {
+    auto previous = remove(reader->m_connector);
+    m_readers[reader->m_connector] = reader;
+    return previous;
+  }
+
+
+
+  /**
+   * Removes the reader for the given connector, and returns it; ownership
+   * goes to the caller.
+   **/
+  inline reader_entry *
+  remove(connector const & conn)
+  {
+    auto iter = m_readers.find(conn);
+    if (iter == m_readers.end()) {
+      return nullptr;
+    }
+
+    auto reader = iter->second;
+    m_readers.erase(iter);
+    return reader;
+  }
+
+
+
+  /**
+   * Find the reader for the given connector.
+   **/
+  inline reader_entry *
+  find(connector const & conn) const
+  {
+    auto iter = m_readers.find(conn);
+    if (iter == m_readers.end()) {
+      return nullptr;
+    }
+    return iter->second;
+  }
+
+
+  inline bool
+  empty() const
+  {
+    return m_readers.empty();
+  }
+
+private:
+  std::unordered_map<connector, reader_entry *> m_readers;
+};
+
+} // namespace packeteer::detail
+
+#endif // guard
@@ -0,0 +1,169 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef PACKETEER_SCHEDULER_CALLBACKS_SIGNAL_H
+#define PACKETEER_SCHEDULER_CALLBACKS_SIGNAL_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <packeteer.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "../../macros.h"
+
+namespace packeteer::detail {
+
+// Signal callbacks:
+//
+//  - The lookup occurs via the signal number, when the scheduler reads
+//    pending signals from its signal connector.
+//  - The same signal can be associated with multiple callbacks, and the same
+//    callback with multiple signals.
+//  - Whether any callback is registered for a signal at all determines the
+//    signal mask, so that needs to be cheap to find out.
+
+struct signal_callback_entry : public callback_entry
+{
+  int           m_signal;
+
+  signal_callback_entry(callback const & cb, int signal)
+    : callback_entry(CB_ENTRY_SIGNAL, cb)
+    , m_signal(signal)
+  {
+  }
+
+  // Automatic copy constructor is used
+};
+
+
+struct signal_callbacks_t
+{
+  signal_callbacks_t()
+  {
+  }
+
+
+  ~signal_callbacks_t()
+  {
+    DLOG("Clearing signal callbacks.");
+    for (auto & entry : m_callback_map) {
+      delete entry.second;
+    }
+  }
+
+
+
+  /**
+   * Takes ownership of the passed entry. Adding the same callback for the
+   * same signal twice has no effect.
+   **/
+  inline void
+  add(signal_callback_entry * cb)
+  {
+    auto range = m_callback_map.equal_range(cb->m_signal);
+    for (auto iter = range.first ; iter != range.second ; ++iter) {
+      if (cb->m_callback == iter->second->m_callback) {
+        delete cb;
+        return;
+      }
+    }
+
+    m_callback_map.insert(std::make_pair(cb->m_signal, cb));
+  }
+
+
+
+  /**
+   * Removes any entry matching the passed entry's callback and signal. The
+   * passed entry remains owned by the caller.
+   **/
+  inline void
+  remove(signal_callback_entry const * cb)
+  {
+    auto range = m_callback_map.equal_range(cb->m_signal);
+    for (auto iter = range.first ; iter != range.second ; ++iter) {
+      if (cb->m_callback == iter->second->m_callback) {
+        delete iter->second;
+        m_callback_map.erase(iter);
+        return;
+      }
+    }
+  }
+
+
+
+  /**
+   * Returns true if any callback is registered for the signal.
+   **/
+  inline bool
+  has(int signal) const
+  {
+    return m_callback_map.find(signal) != m_callback_map.end();
+  }
+
+
+
+  /**
+   * Create copies (ownership goes to the caller) of all entries for the given
+   * signal.
+   **/
+  std::vector<signal_callback_entry *>
+  copy_matching(int signal) const
+  {
+    std::vector<signal_callback_entry *> result;
+
+    auto range = m_callback_map.equal_range(signal);
+    for (auto iter = range.first ; iter != range.second ; ++iter) {
+      result.push_back(new signal_callback_entry(*(iter->second)));
+    }
+
+    return result;
+  }
+
+
+
+  /**
+   * Iterate over all signals with registered callbacks.
+   **/
+  template <typename funcT>
+  inline void
+  for_each_signal(funcT && func) const
+  {
+    for (auto & entry : m_callback_map) {
+      func(entry.first);
+    }
+  }
+
+private:
+  using callback_map_t = std::unordered_multimap<
+    int,
+    signal_callback_entry *
+  >;
+
+  callback_map_t  m_callback_map;
+};
+
+
+} // namespace packeteer::detail
+
+#endif // guard
@@ -0,0 +1,204 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef PACKETEER_SCHEDULER_EVENT_RING_H
+#define PACKETEER_SCHEDULER_EVENT_RING_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <packeteer.h>
+
+#include <atomic>
+#include <vector>
+
+#include "io.h"
+#include "../globals.h"
+
+namespace packeteer::detail {
+
+/**
+ * A single-producer/single-consumer ring of preallocated I/O event slots.
+ *
+ * The producer is an I/O thread, the consumer is whoever dispatches the
+ * events. Neither side takes a lock; each index is only ever written by
+ * one side.
+ *
+ * The ring also tracks whether the consumer is idle, so that the producer
+ * only needs to wake it up when it is about to sleep:
+ * - The consumer calls prepare_wait() before it blocks. If that returns
+ *   false, events arrived in the meantime and it must not block.
+ * - The producer calls wake_consumer() after pushing events. If that
+ *   returns true, the consumer was (about to be) idle, and the producer must
+ *   interrupt it.
+ * Both flags and indices use sequentially consistent operations, so either
+ * the consumer sees the new events, or the producer sees the idle flag.
+ *
+ * The consumer starts out idle.
+ **/
+class PACKETEER_PRIVATE event_ring
+{
+public:
+  explicit event_ring(size_t capacity = PACKETEER_IO_THREAD_RING_SIZE)
+  {
+    size_t size = 1;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    m_slots.resize(size);
+    m_mask = size - 1;
+  }
+
+
+  /**
+   * Producer side: append an event. Returns false if the ring is full.
+   **/
+  inline bool push(io_event const & event)
+  {
+    auto tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_head.load(std::memory_order_acquire) > m_mask) {
+      return false;
+    }
+    m_slots[tail & m_mask] = event;
+    m_tail.store(tail + 1);
+    return true;
+  }
+
+
+  /**
+   * Producer side: returns true if the consumer was idle and needs an
+   * interrupt. The idle flag is reset, so only one interrupt gets sent per
+   * idle period.
+   **/
+  inline bool wake_consumer()
+  {
+    return m_idle.exchange(false);
+  }
+
+
+  /**
+   * Consumer side: take a single event. Returns false if the ring is empty.
+   **/
+  inline bool pop(io_event & event)
+  {
+    auto head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail.load()) {
+      return false;
+    }
+    // Move out of the slot, so the ring does not keep connectors alive.
+    event = std::move(m_slots[head & m_mask]);
+    m_slots[head & m_mask] = {};
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+
+  /**
+   * Consumer side: replace the contents of the events vector with all events
+   * currently in the ring. Returns false if there were none.
+   **/
+  inline bool pop(io_events & events)
+  {
+    events.clear();
+    return pop_into(events) > 0;
+  }
+
+
+  /**
+   * Consumer side: append all events currently in the ring to the events
+   * vector, returning the number of events appended.
+   **/
+  inline size_t pop_into(io_events & events)
+  {
+    size_t count = 0;
+    io_event event;
+    while (pop(event)) {
+      events.push_back(std::move(event));
+      ++count;
+    }
+    return count;
+  }
+
+
+  /**
+   * Consumer side: mark the consumer as idle. Returns false if there are
+   * events to consume, in which case the consumer is not marked idle.
+   **/
+  inline bool prepare_wait()
+  {
+    m_idle.store(true);
+    if (m_head.load(std::memory_order_relaxed) != m_tail.load()) {
+      m_idle.store(false);
+      return false;
+    }
+    return true;
+  }
+
+
+  /**
+   * Consumer side: the consumer is no longer idle.
+   **/
+  inline void cancel_wait()
+  {
+    m_idle.store(false);
+  }
+
+
+  inline bool empty() const
+  {
+    return m_head.load() == m_tail.load();
+  }
+
+
+  inline size_t capacity() const
+  {
+    return m_slots.size();
+  }
+
+
+  /**
+   * The number of events pushed and popped so far, respectively. An event
+   * pushed when produced() returned n has been popped once consumed() is
+   * greater than n.
+   **/
+  inline size_t produced() const
+  {
+    return m_tail.load(std::memory_order_acquire);
+  }
+
+  inline size_t consumed() const
+  {
+    return m_head.load(std::memory_order_acquire);
+  }
+
+private:
+  std::vector<io_event>             m_slots;
+  size_t                            m_mask = 0;
+
+  // Indices grow without bounds; the slot is index & m_mask. Keep them on
+  // separate cache lines, as they're written by different threads.
+  alignas(64) std::atomic<size_t>   m_head = 0;
+  alignas(64) std::atomic<size_t>   m_tail = 0;
+  alignas(64) std::atomic<bool>     m_idle = true;
+};
+
+} // namespace packeteer::detail
+
+#endif // guard
@@ -68,6 +68,8 @@ public:
   virtual void
   register_connector(connector const & conn, events_t const & events)
   {
+    drop_stale_handles(conn);
+
     m_sys_handles[conn.get_read_handle().sys_handle()] |= events & ~PEV_IO_WRITE;
     m_sys_handles[conn.get_write_handle().sys_handle()] |= events & ~PEV_IO_READ;
 
@@ -82,6 +84,8 @@ public:
       events_t const & events)
   {
     for (size_t i = 0 ; i < size ; ++i) {
+      drop_stale_handles(conns[i]);
+
       m_sys_handles[conns[i].get_read_handle().sys_handle()] |= events & ~PEV_IO_WRITE;
       m_sys_handles[conns[i].get_write_handle().sys_handle()] |= events & ~PEV_IO_READ;
 
@@ -118,6 +122,35 @@ public:
   virtual void wait_for_events(io_events & events,
       packeteer::duration const & timeout) = 0;
 
+  /**
+   * In one-shot mode, wait_for_events() stops reporting a connector once it
+   * reported it, until rearm() is called for it. It then also reports at
+   * most max_events events per call, unless max_events is zero. Unlike all
+   * other functions, rearm() may be called from any thread.
+   *
+   * Returns false if the I/O subsystem does not support the mode; the
+   * default implementation does not.
+   **/
+  virtual bool set_oneshot(bool enable [[maybe_unused]],
+      size_t max_events [[maybe_unused]])
+  {
+    return false;
+  }
+
+  virtual void rearm(connector const & conn [[maybe_unused]])
+  {
+  }
+
+  /**
+   * If the I/O subsystem is itself based on a pollable handle, return it.
+   * The handle becomes readable when wait_for_events() would report events.
+   * The default implementation returns an invalid handle.
+   **/
+  virtual handle get_poll_handle() const
+  {
+    return {};
+  }
+
 
   typedef std::unordered_map<handle::sys_handle_t, events_t> sys_events_map;
 
@@ -127,7 +160,34 @@ protected:
   sys_events_map                                      m_sys_handles;
   std::unordered_map<handle::sys_handle_t, connector> m_connectors;
 
+  /**
+   * A handle is stale if it is registered for a different connector. That
+   * happens when a connector is closed before its unregistration is
+   * processed, and the OS re-uses the handle for a new connector.
+   **/
+  inline bool
+  is_stale(handle::sys_handle_t sys_handle, connector const & conn) const
+  {
+    auto iter = m_connectors.find(sys_handle);
+    return iter != m_connectors.end() && iter->second != conn;
+  }
+
 private:
+  inline void
+  drop_stale_handles(connector const & conn)
+  {
+    for (auto sys_handle : { conn.get_read_handle().sys_handle(),
+        conn.get_write_handle().sys_handle() })
+    {
+      if (is_stale(sys_handle, conn)) {
+        m_sys_handles.erase(sys_handle);
+        m_connectors.erase(sys_handle);
+      }
+    }
+  }
+
+
+
   inline void
   clear_sys_handle_events(handle::sys_handle_t sys_handle, events_t const & events)
   {
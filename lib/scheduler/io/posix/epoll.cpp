@@ -56,7 +56,8 @@ translate_events_to_os(events_t const & events)
   if (events & PEV_IO_CLOSE) {
     ret |= EPOLLRDHUP | EPOLLHUP;
   }
-  if (events & PEV_IO_ERROR) {
+  // Zero-copy completions are signalled like errors.
+  if (events & (PEV_IO_ERROR | PEV_IO_ZEROCOPY)) {
     ret |= EPOLLERR;
   }
 
@@ -91,12 +92,14 @@ translate_os_to_events(int os)
 
 
 inline void
-update_fd_registration_single(int epoll_fd, int action, int fd, events_t events)
+update_fd_registration_single(int epoll_fd, int action, int fd, int os_events,
+    size_t & ctl_calls)
 {
   ::epoll_event event;
-  event.events = translate_events_to_os(events);
+  event.events = os_events;
   event.data.fd = fd;
 
+  ++ctl_calls;
   int ret = ::epoll_ctl(epoll_fd, action, fd, &event);
   if (ret >= 0) {
     return;
@@ -106,7 +109,10 @@ update_fd_registration_single(int epoll_fd, int action, int fd, events_t events)
   switch (errno) {
     case EEXIST:
       if (EPOLL_CTL_ADD == action) {
-        update_fd_registration_single(epoll_fd, EPOLL_CTL_MOD, fd, events);
+        // The kernel knows the descriptor, though we did not; e.g. because
+        // it was closed and re-used without unregistering.
+        update_fd_registration_single(epoll_fd, EPOLL_CTL_MOD, fd, os_events,
+            ctl_calls);
       }
       else {
         throw exception(ERR_UNEXPECTED, errno);
@@ -118,10 +124,10 @@ update_fd_registration_single(int epoll_fd, int action, int fd, events_t events)
         // silently ignore
       }
       else if (EPOLL_CTL_MOD == action) {
-        // Can only be reached via the call above, so we are safe to just bail
-        // out.
-        throw exception(ERR_INVALID_VALUE, errno, "Cannot modify event mask "
-            "for unknown file descriptor.");
+        // The kernel dropped the descriptor, though we did not know; e.g.
+        // because it was closed without unregistering. Add it again.
+        update_fd_registration_single(epoll_fd, EPOLL_CTL_ADD, fd, os_events,
+            ctl_calls);
       }
       else {
         throw exception(ERR_UNEXPECTED, errno);
@@ -150,37 +156,6 @@ update_fd_registration_single(int epoll_fd, int action, int fd, events_t events)
   }
 }
 
-
-inline void
-update_syshandle_registration(int epoll_fd, int fd, io::sys_events_map const & events)
-{
-  auto iter = events.find(fd);
-  if (iter == events.end()) {
-    // No events? Need to remove FD entirely.
-    update_fd_registration_single(epoll_fd, EPOLL_CTL_DEL, fd, 0);
-  }
-  else {
-    // We have events? Then translate the ones currently registered.
-    update_fd_registration_single(epoll_fd, EPOLL_CTL_ADD, fd, iter->second);
-  }
-}
-
-
-
-inline void
-update_conn_registration(int epoll_fd, connector const * conns, size_t size,
-    io::sys_events_map const & sys_events)
-{
-  for (size_t i = 0 ; i < size ; ++i) {
-    update_syshandle_registration(epoll_fd, conns[i].get_read_handle().sys_handle(),
-        sys_events);
-    update_syshandle_registration(epoll_fd, conns[i].get_write_handle().sys_handle(),
-        sys_events);
-  }
-}
-
-
-
 } // anonymous namespace
 
 
@@ -188,6 +163,7 @@ update_conn_registration(int epoll_fd, connector const * conns, size_t size,
 io_epoll::io_epoll(std::shared_ptr<api> api)
   : io(api)
   , m_epoll_fd(-1)
+  , m_max_events(PACKETEER_EPOLL_MAXEVENTS)
 {
   int res = ::epoll_create1(EPOLL_CLOEXEC);
   if (res < 0) {
@@ -231,12 +207,9 @@ io_epoll::~io_epoll()
 void
 io_epoll::register_connector(connector const & conn, events_t const & events)
 {
-  connector conns[] = { conn };
-  constexpr auto size = sizeof(conns) / sizeof(connector);
-
-  io::register_connectors(conns, size, events);
-
-  update_conn_registration(m_epoll_fd, conns, size, m_sys_handles);
+  forget_stale_connector(conn);
+  io::register_connector(conn, events);
+  sync_connector(conn);
 }
 
 
@@ -245,9 +218,13 @@ void
 io_epoll::register_connectors(connector const * conns, size_t size,
     events_t const & events)
 {
+  for (size_t i = 0 ; i < size ; ++i) {
+    forget_stale_connector(conns[i]);
+  }
   io::register_connectors(conns, size, events);
-
-  update_conn_registration(m_epoll_fd, conns, size, m_sys_handles);
+  for (size_t i = 0 ; i < size ; ++i) {
+    sync_connector(conns[i]);
+  }
 }
 
 
@@ -256,12 +233,8 @@ io_epoll::register_connectors(connector const * conns, size_t size,
 void
 io_epoll::unregister_connector(connector const & conn, events_t const & events)
 {
-  connector conns[] = { conn };
-  constexpr auto size = sizeof(conns) / sizeof(connector);
-
-  io::unregister_connectors(conns, size, events);
-
-  update_conn_registration(m_epoll_fd, conns, size, m_sys_handles);
+  io::unregister_connector(conn, events);
+  sync_connector(conn);
 }
 
 
@@ -271,8 +244,136 @@ io_epoll::unregister_connectors(connector const * conns, size_t size,
     events_t const & events)
 {
   io::unregister_connectors(conns, size, events);
+  for (size_t i = 0 ; i < size ; ++i) {
+    sync_connector(conns[i]);
+  }
+}
+
+
+
+void
+io_epoll::sync_connector(connector const & conn)
+{
+  auto read_fd = conn.get_read_handle().sys_handle();
+  auto write_fd = conn.get_write_handle().sys_handle();
+
+  sync_fd(read_fd);
+  if (write_fd != read_fd) {
+    sync_fd(write_fd);
+  }
+}
+
+
+
+void
+io_epoll::forget_stale_connector(connector const & conn)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  // The kernel dropped stale descriptors when they were closed, whatever
+  // mask we remember for them.
+  for (auto fd : { conn.get_read_handle().sys_handle(),
+      conn.get_write_handle().sys_handle() })
+  {
+    if (is_stale(fd, conn)) {
+      m_kernel_masks.erase(fd);
+      m_disarmed.erase(fd);
+    }
+  }
+}
+
+
+
+void
+io_epoll::sync_fd(int fd)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  auto wanted = m_sys_handles.find(fd);
+  auto current = m_kernel_masks.find(fd);
+
+  if (wanted == m_sys_handles.end()) {
+    // No longer registered; remove it from the kernel if it's there.
+    if (current != m_kernel_masks.end()) {
+      m_kernel_masks.erase(current);
+      m_disarmed.erase(fd);
+      update_fd_registration_single(m_epoll_fd, EPOLL_CTL_DEL, fd, 0,
+          m_ctl_calls);
+    }
+    return;
+  }
+
+  int os_events = translate_events_to_os(wanted->second);
+  if (m_oneshot) {
+    os_events |= EPOLLONESHOT;
+  }
+  if (current == m_kernel_masks.end()) {
+    update_fd_registration_single(m_epoll_fd, EPOLL_CTL_ADD, fd, os_events,
+        m_ctl_calls);
+    m_kernel_masks[fd] = os_events;
+    return;
+  }
 
-  update_conn_registration(m_epoll_fd, conns, size, m_sys_handles);
+  // Only modify the kernel's mask if it changes. Modifying a disabled
+  // descriptor would enable it again; it picks up the mask in rearm().
+  if (current->second != os_events) {
+    current->second = os_events;
+    if (m_disarmed.find(fd) == m_disarmed.end()) {
+      update_fd_registration_single(m_epoll_fd, EPOLL_CTL_MOD, fd, os_events,
+          m_ctl_calls);
+    }
+  }
+}
+
+
+
+bool
+io_epoll::set_oneshot(bool enable, size_t max_events)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_max_events = PACKETEER_EPOLL_MAXEVENTS;
+  if (enable && max_events && max_events < PACKETEER_EPOLL_MAXEVENTS) {
+    m_max_events = static_cast<int>(max_events);
+  }
+  if (enable == m_oneshot) {
+    return true;
+  }
+  m_oneshot = enable;
+
+  // Re-register everything, which also enables disabled descriptors.
+  for (auto & [fd, os_events] : m_kernel_masks) {
+    if (enable) {
+      os_events |= EPOLLONESHOT;
+    }
+    else {
+      os_events &= ~EPOLLONESHOT;
+    }
+    update_fd_registration_single(m_epoll_fd, EPOLL_CTL_MOD, fd, os_events,
+        m_ctl_calls);
+  }
+  m_disarmed.clear();
+  return true;
+}
+
+
+
+void
+io_epoll::rearm(connector const & conn)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  for (auto fd : { conn.get_read_handle().sys_handle(),
+      conn.get_write_handle().sys_handle() })
+  {
+    if (!m_disarmed.erase(fd)) {
+      continue;
+    }
+    auto current = m_kernel_masks.find(fd);
+    if (current != m_kernel_masks.end()) {
+      update_fd_registration_single(m_epoll_fd, EPOLL_CTL_MOD, fd,
+          current->second, m_ctl_calls);
+    }
+  }
 }
 
 
@@ -289,7 +390,7 @@ io_epoll::wait_for_events(io_events & events,
   int ready = -1;
 
   while (cur_timeout.count() > 0) {
-    ready = ::epoll_pwait(m_epoll_fd, epoll_events, PACKETEER_EPOLL_MAXEVENTS,
+    ready = ::epoll_pwait(m_epoll_fd, epoll_events, m_max_events,
         sc::ceil<sc::milliseconds>(cur_timeout).count(), nullptr);
     if (-1 != ready) {
       break;
@@ -317,6 +418,13 @@ io_epoll::wait_for_events(io_events & events,
     }
   }
 
+  if (m_oneshot && ready > 0) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (int i = 0 ; i < ready ; ++i) {
+      m_disarmed.insert(epoll_events[i].data.fd);
+    }
+  }
+
   // Translate events
   for (int i = 0 ; i < ready ; ++i) {
     io_event data = {
@@ -34,6 +34,10 @@
 
 #include <packeteer/scheduler/events.h>
 
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+
 #include "../../io.h"
 
 namespace packeteer::detail {
@@ -54,11 +58,49 @@ public:
   virtual void wait_for_events(io_events & events,
       duration const & timeout) override;
 
+  virtual bool set_oneshot(bool enable, size_t max_events) override;
+  virtual void rearm(connector const & conn) override;
+
+  virtual handle get_poll_handle() const override
+  {
+    return m_epoll_fd;
+  }
+
+  /**
+   * Number of epoll_ctl() calls made so far; mostly of interest to tests.
+   **/
+  inline size_t ctl_calls() const
+  {
+    return m_ctl_calls;
+  }
+
 private:
+  // Issue at most one epoll_ctl() call to bring the kernel's event mask for
+  // the file descriptor in line with m_sys_handles.
+  void sync_fd(int fd);
+  void sync_connector(connector const & conn);
+
+  // Forget the kernel's mask for descriptors that were re-used by a new
+  // connector; see io::is_stale().
+  void forget_stale_connector(connector const & conn);
+
   /***************************************************************************
    * Data
    **/
   int m_epoll_fd;
+
+  // The event mask (in epoll terms) the kernel holds for each file
+  // descriptor.
+  std::unordered_map<int, int>  m_kernel_masks;
+  size_t                        m_ctl_calls = 0;
+
+  // In one-shot mode, descriptors are registered with EPOLLONESHOT; the
+  // kernel disables them once reported, until rearm(). As rearm() runs on
+  // other threads, the mutex guards the kernel masks.
+  bool                          m_oneshot = false;
+  int                           m_max_events;
+  std::unordered_set<int>       m_disarmed;
+  std::mutex                    m_mutex;
 };
 
 
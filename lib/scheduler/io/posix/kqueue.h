@@ -56,6 +56,11 @@ public:
   virtual void wait_for_events(io_events & events,
       packeteer::duration const & timeout) override;
 
+  virtual handle get_poll_handle() const override
+  {
+    return m_kqueue_fd;
+  }
+
 private:
   /***************************************************************************
    * Data
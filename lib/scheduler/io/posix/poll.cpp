@@ -27,12 +27,12 @@
 
 #include "../../scheduler_impl.h"
 #include "../../../chrono.h"
+#include "../../../globals.h"
 
 // Posix
-#include <poll.h>
-
 #include <errno.h>
 
+#include <algorithm>
 #include <chrono>
 
 
@@ -59,7 +59,8 @@ translate_events_to_os(events_t const & events)
     ret |= POLLRDHUP;
 #endif
   }
-  if (events & PEV_IO_ERROR) {
+  // Zero-copy completions are signalled like errors.
+  if (events & (PEV_IO_ERROR | PEV_IO_ZEROCOPY)) {
     ret |= POLLERR | POLLNVAL;
   }
 
@@ -112,6 +113,98 @@ io_poll::~io_poll()
 
 
 
+void
+io_poll::register_connector(connector const & conn, events_t const & events)
+{
+  io::register_connector(conn, events);
+  update_slots(conn);
+}
+
+
+
+void
+io_poll::register_connectors(connector const * conns, size_t amount,
+    events_t const & events)
+{
+  io::register_connectors(conns, amount, events);
+  for (size_t i = 0 ; i < amount ; ++i) {
+    update_slots(conns[i]);
+  }
+}
+
+
+
+void
+io_poll::unregister_connector(connector const & conn, events_t const & events)
+{
+  io::unregister_connector(conn, events);
+  update_slots(conn);
+}
+
+
+
+void
+io_poll::unregister_connectors(connector const * conns, size_t amount,
+    events_t const & events)
+{
+  io::unregister_connectors(conns, amount, events);
+  for (size_t i = 0 ; i < amount ; ++i) {
+    update_slots(conns[i]);
+  }
+}
+
+
+
+void
+io_poll::update_slots(connector const & conn)
+{
+  update_slot(conn.get_read_handle().sys_handle());
+  update_slot(conn.get_write_handle().sys_handle());
+}
+
+
+
+void
+io_poll::update_slot(int fd)
+{
+  auto slot = m_slots.find(fd);
+  auto registered = m_sys_handles.find(fd);
+
+  if (registered == m_sys_handles.end()) {
+    // Not (or no longer) registered; swap-remove the slot, if any.
+    if (slot == m_slots.end()) {
+      return;
+    }
+
+    size_t idx = slot->second;
+    size_t last = m_fds.size() - 1;
+    if (idx != last) {
+      m_fds[idx] = m_fds[last];
+      m_slot_connectors[idx] = std::move(m_slot_connectors[last]);
+      m_slots[m_fds[idx].fd] = idx;
+    }
+    m_fds.pop_back();
+    m_slot_connectors.pop_back();
+    m_slots.erase(slot);
+    return;
+  }
+
+  short os_events = translate_events_to_os(registered->second);
+  if (slot != m_slots.end()) {
+    // Update in place
+    m_fds[slot->second].events = os_events;
+    m_slot_connectors[slot->second] = m_connectors[fd];
+    return;
+  }
+
+  // New slot
+  m_slots[fd] = m_fds.size();
+  m_fds.push_back(::pollfd{fd, os_events, 0});
+  m_slot_connectors.push_back(m_connectors[fd]);
+}
+
+
+
 void
 io_poll::wait_for_events(io_events & events,
       duration const & timeout)
@@ -119,32 +212,23 @@ io_poll::wait_for_events(io_events & events,
   auto before = clock::now();
   auto cur_timeout = timeout;
 
-  // Prepare FD set
-  size_t size = m_sys_handles.size();
-  std::vector<::pollfd> fds;
-  fds.resize(size);
-
-  size_t idx = 0;
-  for (auto entry : m_sys_handles) {
-    fds[idx].fd = entry.first;
-    fds[idx].events = translate_events_to_os(entry.second);
-    fds[idx].revents = 0;
-    ++idx;
-  }
+  size_t size = m_fds.size();
 
   // Wait for events
+  int ready = 0;
   while (cur_timeout.count() > 0) {
 #if defined(PACKETEER_HAVE_PPOLL)
     ::timespec ts;
     ::packeteer::thread::chrono::convert(cur_timeout, ts);
 
-    int ret = ::ppoll(&fds[0], size, &ts, nullptr);
+    int ret = ::ppoll(m_fds.data(), size, &ts, nullptr);
 #else
-    int ret = ::poll(&fds[0], size,
+    int ret = ::poll(m_fds.data(), size,
         sc::ceil<sc::milliseconds>(cur_timeout).count());
 #endif
 
     if (ret >= 0) {
+      ready = ret;
       break;
     }
 
@@ -174,17 +258,35 @@ io_poll::wait_for_events(io_events & events,
     }
   }
 
-  // Map events; we'll need to iterate over the available file descriptors again
-  // (conceivably, we could just use the subset in the FD sets, but that uses
-  // additional memory).
-  for (idx = 0 ; idx < size ; ++idx) {
-    events_t translated = translate_os_to_events(fds[idx].revents);
-    if (translated) {
-      io_event ev = {
-        m_connectors[fds[idx].fd],
-        translated
-      };
-      events.push_back(ev);
+  // Map events. poll() tells us how many entries have events, so we can stop
+  // once we've found all of them. Entries are checked in fixed size chunks,
+  // which lets the compiler test all of a chunk's revents at once; chunks
+  // without any events are skipped.
+  size_t idx = 0;
+  while (ready > 0 && idx < size) {
+    size_t chunk_end = std::min(idx + PACKETEER_POLL_SCAN_CHUNK, size);
+
+    if (chunk_end - idx == PACKETEER_POLL_SCAN_CHUNK) {
+      short any = 0;
+      for (size_t i = idx ; i < chunk_end ; ++i) {
+        any |= m_fds[i].revents;
+      }
+      if (!any) {
+        idx = chunk_end;
+        continue;
+      }
+    }
+
+    for ( ; idx < chunk_end ; ++idx) {
+      if (!m_fds[idx].revents) {
+        continue;
+      }
+      --ready;
+
+      events_t translated = translate_os_to_events(m_fds[idx].revents);
+      if (translated) {
+        events.push_back(io_event{m_slot_connectors[idx], translated});
+      }
     }
   }
 }
@@ -34,18 +34,44 @@
 
 #include <packeteer/scheduler/events.h>
 
+#include <poll.h>
+
+#include <vector>
+#include <unordered_map>
+
 #include "../../io.h"
 
 namespace packeteer::detail {
 
-// I/O subsystem based on select.
+// I/O subsystem based on poll.
+//
+// The pollfd array is maintained incrementally as connectors are
+// (un-)registered, rather than rebuilt on every wait. Each slot in m_fds has
+// a corresponding connector in m_slot_connectors; m_slots maps file
+// descriptors back to their slot. Removal swaps the last slot into the
+// removed one, so the array stays dense.
 struct io_poll : public io
 {
 public:
   explicit io_poll(std::shared_ptr<api> api);
   ~io_poll();
 
+  void register_connector(connector const & conn, events_t const & events) override;
+  void register_connectors(connector const * conns, size_t amount, events_t const & events) override;
+
+  void unregister_connector(connector const & conn, events_t const & events) override;
+  void unregister_connectors(connector const * conns, size_t amount, events_t const & events) override;
+
   virtual void wait_for_events(io_events & events, duration const & timeout) override;
+
+private:
+  // Bring the slot for the file descriptor in line with m_sys_handles.
+  void update_slot(int fd);
+  void update_slots(connector const & conn);
+
+  std::vector<::pollfd>           m_fds;
+  std::vector<connector>          m_slot_connectors;
+  std::unordered_map<int, size_t> m_slots;
 };
 
 
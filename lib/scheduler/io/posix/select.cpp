@@ -39,13 +39,90 @@
 #include <errno.h>
 
 #include <chrono>
+#include <cstring>
+#include <type_traits>
 
 namespace sc = std::chrono;
 
 namespace packeteer::detail {
 
+namespace {
+
+// The fd_set type is an array of fd_mask words. We keep the same layout, so
+// that our word vectors can be passed to select() directly.
+inline constexpr size_t WORD_BITS = NFDBITS;
+
+// Words are scanned as unsigned long, which is at least as wide as fd_mask on
+// all supported platforms. Go via the unsigned word type so that negative
+// masks do not sign-extend.
+inline unsigned long
+to_ulong(::fd_mask word)
+{
+  return static_cast<std::make_unsigned_t<::fd_mask>>(word);
+}
+
+// The minimum number of words we keep, so that any buffer passed to select()
+// is at least as large as an fd_set.
+inline constexpr size_t MIN_WORDS = (sizeof(::fd_set) + sizeof(::fd_mask) - 1)
+  / sizeof(::fd_mask);
+
+
+inline size_t
+word_index(int fd)
+{
+  return static_cast<size_t>(fd) / WORD_BITS;
+}
+
+
+
+inline ::fd_mask
+bit_mask(int fd)
+{
+  return static_cast<::fd_mask>(1) << (static_cast<size_t>(fd) % WORD_BITS);
+}
+
+
+
+inline void
+set_bit(std::vector<::fd_mask> & words, int fd, bool value)
+{
+  if (value) {
+    words[word_index(fd)] |= bit_mask(fd);
+  }
+  else {
+    words[word_index(fd)] &= ~bit_mask(fd);
+  }
+}
+
+
+
+inline size_t
+lowest_bit(unsigned long word)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctzl(word);
+#else
+  size_t bit = 0;
+  while (!(word & 1)) {
+    word >>= 1;
+    ++bit;
+  }
+  return bit;
+#endif
+}
+
+} // anonymous namespace
+
+
+
 io_select::io_select(std::shared_ptr<api> const & api)
   : io(api)
+  , m_read_master(MIN_WORDS, 0)
+  , m_write_master(MIN_WORDS, 0)
+  , m_err_master(MIN_WORDS, 0)
+  , m_read_work(MIN_WORDS, 0)
+  , m_write_work(MIN_WORDS, 0)
+  , m_err_work(MIN_WORDS, 0)
 {
   DLOG("Select based I/O subsystem created.");
 }
@@ -59,6 +136,123 @@ io_select::~io_select()
 
 
 
+void
+io_select::register_connector(connector const & conn, events_t const & events)
+{
+  io::register_connector(conn, events);
+  update_fds(conn);
+}
+
+
+
+void
+io_select::register_connectors(connector const * conns, size_t amount,
+    events_t const & events)
+{
+  io::register_connectors(conns, amount, events);
+  for (size_t i = 0 ; i < amount ; ++i) {
+    update_fds(conns[i]);
+  }
+}
+
+
+
+void
+io_select::unregister_connector(connector const & conn, events_t const & events)
+{
+  io::unregister_connector(conn, events);
+  update_fds(conn);
+}
+
+
+
+void
+io_select::unregister_connectors(connector const * conns, size_t amount,
+    events_t const & events)
+{
+  io::unregister_connectors(conns, amount, events);
+  for (size_t i = 0 ; i < amount ; ++i) {
+    update_fds(conns[i]);
+  }
+}
+
+
+
+void
+io_select::update_fds(connector const & conn)
+{
+  update_fd(conn.get_read_handle().sys_handle());
+  update_fd(conn.get_write_handle().sys_handle());
+}
+
+
+
+void
+io_select::update_fd(int fd)
+{
+  if (fd < 0) {
+    return;
+  }
+
+  auto registered = m_sys_handles.find(fd);
+  if (registered == m_sys_handles.end()) {
+    // Not (or no longer) registered; clear bits, if we ever had them.
+    if (fd > m_max_fd) {
+      return;
+    }
+    set_bit(m_read_master, fd, false);
+    set_bit(m_write_master, fd, false);
+    set_bit(m_err_master, fd, false);
+
+    // Find the new highest file descriptor; error bits are set for every
+    // registered file descriptor.
+    if (fd == m_max_fd) {
+      m_max_fd = -1;
+      for (size_t idx = word_index(fd) + 1 ; idx > 0 ; --idx) {
+        auto word = to_ulong(m_err_master[idx - 1]);
+        if (!word) {
+          continue;
+        }
+        size_t bit = WORD_BITS - 1;
+        while (!(word & (1UL << bit))) {
+          --bit;
+        }
+        m_max_fd = static_cast<int>((idx - 1) * WORD_BITS + bit);
+        break;
+      }
+    }
+    return;
+  }
+
+#if !defined(PACKETEER_HAVE_UNLIMITED_SELECT)
+  if (fd >= FD_SETSIZE) {
+    throw exception(ERR_NUM_FILES, "File descriptor exceeds FD_SETSIZE, and "
+        "select() cannot handle it on this platform.");
+  }
+#endif
+
+  // Grow all sets as needed.
+  size_t needed = word_index(fd) + 1;
+  if (needed > m_err_master.size()) {
+    m_read_master.resize(needed, 0);
+    m_write_master.resize(needed, 0);
+    m_err_master.resize(needed, 0);
+    m_read_work.resize(needed, 0);
+    m_write_work.resize(needed, 0);
+    m_err_work.resize(needed, 0);
+  }
+
+  set_bit(m_read_master, fd, registered->second & PEV_IO_READ);
+  set_bit(m_write_master, fd, registered->second & PEV_IO_WRITE);
+  set_bit(m_err_master, fd, true);
+
+  if (fd > m_max_fd) {
+    m_max_fd = fd;
+  }
+}
+
+
+
 void
 io_select::wait_for_events(io_events & events,
       duration const & timeout)
@@ -68,31 +262,21 @@ io_select::wait_for_events(io_events & events,
   auto before = clock::now();
   auto cur_timeout = timeout;
 
-  // FD sets
-  ::fd_set read_fds;
-  ::fd_set write_fds;
-  ::fd_set err_fds;
+  // Only the words up to the highest registered file descriptor are of
+  // interest.
+  size_t num_words = m_max_fd < 0 ? 0 : word_index(m_max_fd) + 1;
+  size_t num_bytes = num_words * sizeof(::fd_mask);
 
-  while (cur_timeout.count() > 0) {
-    // Prepare FD sets.
-    FD_ZERO(&read_fds);
-    FD_ZERO(&write_fds);
-    FD_ZERO(&err_fds);
-
-    // Populate FD sets.
-    int max_fd = 0;
-    for (auto entry : m_sys_handles) {
-      if (entry.first > max_fd) {
-        max_fd = entry.first;
-      }
+  auto read_fds = reinterpret_cast<::fd_set *>(m_read_work.data());
+  auto write_fds = reinterpret_cast<::fd_set *>(m_write_work.data());
+  auto err_fds = reinterpret_cast<::fd_set *>(m_err_work.data());
 
-      if (entry.second & PEV_IO_READ) {
-        FD_SET(entry.first, &read_fds);
-      }
-      if (entry.second & PEV_IO_WRITE) {
-        FD_SET(entry.first, &write_fds);
-      }
-      FD_SET(entry.first, &err_fds);
+  while (cur_timeout.count() > 0) {
+    // Copy FD sets; select() modifies them.
+    if (num_bytes) {
+      std::memcpy(m_read_work.data(), m_read_master.data(), num_bytes);
+      std::memcpy(m_write_work.data(), m_write_master.data(), num_bytes);
+      std::memcpy(m_err_work.data(), m_err_master.data(), num_bytes);
     }
 
     // Wait for events
@@ -100,18 +284,22 @@ io_select::wait_for_events(io_events & events,
     ::timespec ts;
     ::packeteer::thread::chrono::convert(cur_timeout, ts);
 
-    int ret = ::pselect(max_fd + 1, &read_fds, &write_fds, &err_fds, &ts,
+    int ret = ::pselect(m_max_fd + 1, read_fds, write_fds, err_fds, &ts,
         nullptr);
 #else
     ::timeval tv;
     ::packeteer::thread::chrono::convert(cur_timeout, tv);
 
-    int ret = ::select(max_fd + 1, &read_fds, &write_fds, &err_fds, &tv);
+    int ret = ::select(m_max_fd + 1, read_fds, write_fds, err_fds, &tv);
 #endif
 
-    if (ret >= 0) {
+    if (ret > 0) {
       break;
     }
+    if (ret == 0) {
+      // Timeout; nothing to scan.
+      return;
+    }
 
     // Error handling
     switch (errno) {
@@ -137,29 +325,43 @@ io_select::wait_for_events(io_events & events,
     }
   }
 
-  // Map events; we'll need to iterate over the available file descriptors again
-  // (conceivably, we could just use the subset in the FD sets, but that uses
-  // additional memory).
+  if (cur_timeout.count() <= 0) {
+    // Interrupted until the timeout expired.
+    return;
+  }
+
+  // Map events; we scan the result sets a word at a time, and only visit
+  // the file descriptors with any bit set.
   std::map<connector, events_t> tmp_events;
-  for (auto entry : m_sys_handles) {
-    events_t mask = 0;
-    if (FD_ISSET(entry.first, &read_fds)) { //!OCLINT(in FD_ISSET)
-      mask |= PEV_IO_READ;
-    }
-    if (FD_ISSET(entry.first, &write_fds)) { //!OCLINT(in FD_ISSET)
-      mask |= PEV_IO_WRITE;
-    }
-    if (FD_ISSET(entry.first, &err_fds)) { //!OCLINT(in FD_ISSET)
-      mask |= PEV_IO_ERROR;
-    }
+  for (size_t idx = 0 ; idx < num_words ; ++idx) {
+    auto read_word = to_ulong(m_read_work[idx]);
+    auto write_word = to_ulong(m_write_work[idx]);
+    auto err_word = to_ulong(m_err_work[idx]);
+
+    auto any = read_word | write_word | err_word;
+    while (any) {
+      size_t bit = lowest_bit(any);
+      unsigned long mask_bit = 1UL << bit;
+      any &= ~mask_bit;
+
+      events_t mask = 0;
+      if (read_word & mask_bit) {
+        mask |= PEV_IO_READ;
+      }
+      if (write_word & mask_bit) {
+        mask |= PEV_IO_WRITE;
+      }
+      if (err_word & mask_bit) {
+        mask |= PEV_IO_ERROR;
+      }
 
-    if (mask) {
-      auto & conn = m_connectors[entry.first];
-      if (!conn) {
-        ELOG("Got event for unregistered connector with handle: " << handle{entry.first});
+      int fd = static_cast<int>(idx * WORD_BITS + bit);
+      auto conn = m_connectors.find(fd);
+      if (conn == m_connectors.end() || !conn->second) {
+        ELOG("Got event for unregistered connector with handle: " << handle{fd});
         continue;
       }
-      tmp_events[conn] |= mask;
+      tmp_events[conn->second] |= mask;
     }
   }
 
@@ -34,19 +34,52 @@
 
 #include <packeteer/scheduler/events.h>
 
+#include <sys/select.h>
+
+#include <vector>
+
 #include "../../io.h"
 
 namespace packeteer::detail {
 
 // I/O subsystem based on select.
+//
+// Master bitsets for reading, writing and errors are maintained as connectors
+// are (un-)registered; each wait only copies the words up to the highest
+// registered file descriptor into working sets. Where the platform permits,
+// the sets grow beyond FD_SETSIZE.
 struct io_select : public io
 {
 public:
   explicit io_select(std::shared_ptr<api> const & api);
   ~io_select();
 
+  void register_connector(connector const & conn, events_t const & events) override;
+  void register_connectors(connector const * conns, size_t amount, events_t const & events) override;
+
+  void unregister_connector(connector const & conn, events_t const & events) override;
+  void unregister_connectors(connector const * conns, size_t amount, events_t const & events) override;
+
   virtual void wait_for_events(io_events & events,
       duration const & timeout) override;
+
+private:
+  using fd_words = std::vector<::fd_mask>;
+
+  // Bring the master sets' bits for the file descriptor in line with
+  // m_sys_handles.
+  void update_fd(int fd);
+  void update_fds(connector const & conn);
+
+  fd_words  m_read_master;
+  fd_words  m_write_master;
+  fd_words  m_err_master;
+
+  fd_words  m_read_work;
+  fd_words  m_write_work;
+  fd_words  m_err_work;
+
+  int       m_max_fd = -1;
 };
 
 
@@ -0,0 +1,198 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <build-config.h>
+
+#include "threaded.h"
+
+#include <packeteer/error.h>
+
+#include "../../scheduler_impl.h"
+
+namespace packeteer::detail {
+
+io_threaded::io_threaded(std::shared_ptr<api> const & api,
+    std::unique_ptr<io> poller)
+  : io{api}
+{
+  connector poller_interrupt{api, "anon://"};
+  auto err = poller_interrupt.connect();
+  if (ERR_SUCCESS != err) {
+    throw exception{err, "Unable to create poller interrupt."};
+  }
+
+  auto th = std::make_unique<io_thread>(
+    std::move(poller),
+    poller_interrupt,
+    m_queue,
+    connector{}, // paced consumers wait on the poller thread instead
+    false, // do not report the poller interrupt
+    true); // paced
+
+  err = th->start();
+  if (ERR_SUCCESS != err) {
+    throw exception{err, "Unable to start poller thread."};
+  }
+
+  m_poller_thread = std::move(th);
+
+  DLOG("Threaded I/O subsystem created.");
+}
+
+
+
+io_threaded::~io_threaded()
+{
+  DLOG("Threaded I/O subsystem shutting down.");
+  m_poller_thread->stop();
+}
+
+
+
+void
+io_threaded::register_connector(connector const & conn, events_t const & events)
+{
+  register_connectors(&conn, 1, events);
+}
+
+
+
+void
+io_threaded::register_connectors(connector const * conns, size_t amount,
+    events_t const & events)
+{
+  io::register_connectors(conns, amount, events);
+  m_poller_thread->register_connectors(conns, amount, events);
+}
+
+
+
+void
+io_threaded::unregister_connector(connector const & conn,
+    events_t const & events)
+{
+  unregister_connectors(&conn, 1, events);
+}
+
+
+
+void
+io_threaded::unregister_connectors(connector const * conns, size_t amount,
+    events_t const & events)
+{
+  io::unregister_connectors(conns, amount, events);
+  m_poller_thread->unregister_connectors(conns, amount, events);
+}
+
+
+
+void
+io_threaded::wait_for_events(io_events & events,
+      duration const & timeout)
+{
+  auto before = clock::now();
+  auto cur_timeout = timeout;
+
+  // Whatever we handed out previously has been dispatched, so the poller
+  // may poll those connectors again. In one-shot mode, that's up to the
+  // caller.
+  if (!m_oneshot) {
+    m_poller_thread->resume(m_dispatched);
+    m_dispatched.clear();
+  }
+  auto first = events.size();
+
+  // Take all events from the ring, or at most m_max_events.
+  auto pop = [this, &events, first]() -> bool
+  {
+    if (!m_max_events) {
+      return m_queue.pop_into(events) > 0;
+    }
+    io_event event;
+    while (events.size() - first < m_max_events && m_queue.pop(event)) {
+      events.push_back(std::move(event));
+    }
+    return events.size() > first;
+  };
+
+  do {
+    // Consume whatever the poller has for us first; we only block if
+    // there is nothing.
+    if (pop()) {
+      break;
+    }
+
+    auto err = m_poller_thread->error();
+    if (err) {
+      std::rethrow_exception(err);
+    }
+
+    m_poller_thread->wait_for_events(cur_timeout);
+
+    cur_timeout = timeout - (clock::now() - before);
+  } while (cur_timeout.count() > 0);
+
+  if (events.size() == first) {
+    pop();
+  }
+
+  if (!m_oneshot) {
+    for (auto i = first ; i < events.size() ; ++i) {
+      m_dispatched.push_back(events[i].connector);
+    }
+  }
+
+  if (!events.empty()) {
+    DLOG("Threaded I/O got " << events.size() << " event entries to report.");
+  }
+}
+
+
+
+bool
+io_threaded::set_oneshot(bool enable, size_t max_events)
+{
+  if (!m_poller_thread->oneshot()) {
+    return false;
+  }
+
+  if (enable && !m_oneshot) {
+    // Nothing handed out so far will be re-armed by the caller.
+    m_poller_thread->resume(m_dispatched);
+    m_dispatched.clear();
+  }
+  else if (!enable && m_oneshot) {
+    m_poller_thread->rearm_all();
+  }
+
+  m_oneshot = enable;
+  m_max_events = enable ? max_events : 0;
+  return true;
+}
+
+
+
+void
+io_threaded::rearm(connector const & conn)
+{
+  m_poller_thread->rearm(conn);
+}
+
+
+} // namespace packeteer::detail
@@ -0,0 +1,85 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef PACKETEER_SCHEDULER_IO_POSIX_THREADED_H
+#define PACKETEER_SCHEDULER_IO_POSIX_THREADED_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <packeteer.h>
+
+#if !defined(PACKETEER_HAVE_POLL)
+#error poll not detected
+#endif
+
+#include <packeteer/scheduler/events.h>
+
+#include <memory>
+#include <vector>
+
+#include "../../io.h"
+#include "../../io_thread.h"
+
+namespace packeteer::detail {
+
+// I/O subsystem that runs another I/O subsystem in a dedicated poller thread
+// via io_thread. The poller thread does nothing but wait for events and hand
+// them over through an event ring; the thread calling wait_for_events() only
+// picks them up, and blocks on the poller thread when there are none.
+//
+// This splits polling and dispatching across two threads (and cores), at the
+// cost of registrations taking effect asynchronously.
+struct PACKETEER_PRIVATE io_threaded : public io
+{
+public:
+  io_threaded(std::shared_ptr<api> const & api, std::unique_ptr<io> poller);
+  ~io_threaded();
+
+  void register_connector(connector const & conn, events_t const & events) override;
+  void register_connectors(connector const * conns, size_t amount, events_t const & events) override;
+
+  void unregister_connector(connector const & conn, events_t const & events) override;
+  void unregister_connectors(connector const * conns, size_t amount, events_t const & events) override;
+
+  virtual void wait_for_events(io_events & events,
+      duration const & timeout) override;
+
+  // Supported if the poller is; the caller then re-arms connectors instead
+  // of the next wait_for_events().
+  bool set_oneshot(bool enable, size_t max_events) override;
+  void rearm(connector const & conn) override;
+
+private:
+  out_queue_t                 m_queue;
+  std::unique_ptr<io_thread>  m_poller_thread;
+
+  // Connectors of the events handed out by the last wait_for_events(), if
+  // not in one-shot mode.
+  std::vector<connector>      m_dispatched;
+
+  bool                        m_oneshot = false;
+  size_t                      m_max_events = 0;
+};
+
+
+} // namespace packeteer::detail
+
+#endif // guard
@@ -204,8 +204,13 @@ io_win32::wait_for_events(io_events & events,
   bool process_queue = false;
   do {
     // Things are *fairly* simple here. Since we mainly use the IOCP loop and
-    // treat the select loop as supplemental, we wait in the IOCP loop.
-    m_iocp->wait_for_events(events, cur_timeout);
+    // treat the select loop as supplemental, we wait in the IOCP loop. The
+    // select thread only interrupts us if we marked ourselves idle, so we
+    // must not wait if it already handed us events.
+    if (m_queue.prepare_wait()) {
+      m_iocp->wait_for_events(events, cur_timeout);
+      m_queue.cancel_wait();
+    }
     auto after = clock::now();
     auto tdiff = after - before;
     cur_timeout = timeout - tdiff;
@@ -223,6 +228,9 @@ io_win32::wait_for_events(io_events & events,
         break;
       }
     }
+    if (!m_queue.empty()) {
+      process_queue = true;
+    }
 
     if (process_queue) {
       auto before = events.size();
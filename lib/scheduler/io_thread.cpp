@@ -25,6 +25,13 @@
 
 #include "../interrupt.h"
 
+#include <algorithm>
+
+#if defined(PACKETEER_POSIX)
+#include <signal.h>
+#include <pthread.h>
+#endif
+
 
 namespace packeteer::detail {
 
@@ -33,12 +40,15 @@ io_thread::io_thread(std::unique_ptr<io> io,
     connector io_interrupt,
     out_queue_t & out_queue,
     connector queue_interrupt,
-    bool report_self /* = false */)
+    bool report_self /* = false */,
+    bool paced /* = false */)
   : m_io(std::move(io))
   , m_io_interrupt(io_interrupt)
   , m_out_queue(out_queue)
   , m_queue_interrupt(queue_interrupt)
   , m_report_self(report_self)
+  , m_paced(paced)
+  , m_oneshot(paced && m_io->set_oneshot(true, 0))
 {
 }
 
@@ -97,6 +107,10 @@ io_thread::stop()
 
   if (was_running) {
     set_interrupt(m_io_interrupt);
+    if (m_paced) {
+      std::lock_guard<std::mutex> lock{m_consumer_mutex};
+      m_consumer_condition.notify_one();
+    }
   }
 
   if (m_thread.joinable()) {
@@ -106,6 +120,94 @@ io_thread::stop()
 
 
 
+void
+io_thread::resume(std::vector<connector> const & dispatched)
+{
+  if (!m_paced) {
+    return;
+  }
+
+  // One-shot I/O subsystems re-arm connectors from any thread; this costs a
+  // single call per connector, and the thread need not know.
+  if (m_oneshot) {
+    for (auto & conn : dispatched) {
+      rearm(conn);
+    }
+    return;
+  }
+
+  // Only wake the thread if it suspended connectors since the last time;
+  // it may not have consumed all of those yet, but then the next resume()
+  // wakes it again.
+  auto upto = m_out_queue.consumed();
+  auto prev = m_resumed_upto.exchange(upto, std::memory_order_acq_rel);
+  if (m_suspended_upto.load(std::memory_order_acquire) > prev) {
+    wakeup();
+  }
+}
+
+
+
+bool
+io_thread::oneshot() const
+{
+  return m_oneshot;
+}
+
+
+
+void
+io_thread::rearm(connector const & conn)
+{
+  if (!m_oneshot) {
+    return;
+  }
+
+  if (m_pending_registrations.load(std::memory_order_acquire) > 0) {
+    m_registration_queue.push({ REARM, conn, 0 });
+    wakeup();
+    return;
+  }
+  m_io->rearm(conn);
+}
+
+
+
+void
+io_thread::rearm_all()
+{
+  // Leaving one-shot mode enables all disabled connectors; we go straight
+  // back to it.
+  if (m_oneshot) {
+    m_io->set_oneshot(false, 0);
+    m_io->set_oneshot(true, 0);
+  }
+}
+
+
+
+bool
+io_thread::wait_for_events(duration const & timeout)
+{
+  if (!m_paced) {
+    return !m_out_queue.empty();
+  }
+
+  // Condition variables do not cope with durations that overflow the clock.
+  auto capped = std::min(timeout, duration{std::chrono::hours(24)});
+
+  std::unique_lock<std::mutex> lock{m_consumer_mutex};
+  if (m_out_queue.prepare_wait()) {
+    m_consumer_condition.wait_for(lock, capped, [this] {
+      return !m_out_queue.empty() || !m_running;
+    });
+  }
+  m_out_queue.cancel_wait();
+  return !m_out_queue.empty();
+}
+
+
+
 std::exception_ptr
 io_thread::error() const
 {
@@ -126,6 +228,7 @@ void
 io_thread::register_connectors(connector const * conns, size_t amount,
     events_t events)
 {
+  m_pending_registrations.fetch_add(amount, std::memory_order_release);
   for (size_t i = 0 ; i < amount ; ++i) {
     m_registration_queue.push({ REGISTER, conns[i], events});
   }
@@ -146,6 +249,7 @@ void
 io_thread::unregister_connectors(connector const * conns, size_t amount,
     events_t events)
 {
+  m_pending_registrations.fetch_add(amount, std::memory_order_release);
   for (size_t i = 0 ; i < amount ; ++i) {
     m_registration_queue.push({ UNREGISTER, conns[i], events});
   }
@@ -158,18 +262,39 @@ void
 io_thread::thread_loop()
 {
   try {
+#if defined(PACKETEER_POSIX)
+    // The I/O thread must not handle any signals; they're meant for the
+    // threads that block them and read them via signalfd or similar.
+    ::sigset_t all;
+    ::sigfillset(&all);
+    ::pthread_sigmask(SIG_BLOCK, &all, nullptr);
+#endif
+
     // Register I/O interrupt with I/O subsystem.
     m_io->register_connector(m_io_interrupt, PEV_IO_READ);
 
     DLOG("I/O loop started: " << m_running);
 
     while (m_running) {
+      // When paced, poll connectors again whose events were consumed.
+      if (m_paced && !m_oneshot) {
+        unsuspend();
+      }
+
       // Before we wait for events, we need to process the registration queue.
       // For the sake of predictability, we do them in strict order, even if
       // that may not be very efficient.
       register_item item;
       while (m_registration_queue.pop(item)) {
-        if (item.action == REGISTER) {
+        if (item.action == REARM) {
+          m_io->rearm(item.conn);
+          continue;
+        }
+
+        if (m_paced && !m_oneshot) {
+          apply_registration(item);
+        }
+        else if (item.action == REGISTER) {
           m_io->register_connector(item.conn, item.events);
         }
         else if (item.action == UNREGISTER) {
@@ -178,6 +303,7 @@ io_thread::thread_loop()
         else {
           PACKETEER_FLOW_CONTROL_GUARD;
         }
+        m_pending_registrations.fetch_sub(1, std::memory_order_release);
       }
 
       // Wait for events. We want to wait forever until an event, aka a really
@@ -198,6 +324,9 @@ io_thread::thread_loop()
           auto & ev = *iter;
           if (ev.connector == m_io_interrupt) {
             clear_interrupt(m_io_interrupt);
+            if (m_oneshot) {
+              m_io->rearm(m_io_interrupt);
+            }
             events.erase(iter); // Only do that in the loop because we exit.
             break;
           }
@@ -206,8 +335,7 @@ io_thread::thread_loop()
 
       if (!events.empty()) {
         DLOG("Got " << events.size() << " I/O events.");
-        m_out_queue.push(events);
-        set_interrupt(m_queue_interrupt);
+        publish(events);
       }
     }
 
@@ -232,6 +360,131 @@ io_thread::thread_loop()
 
 
 
+void
+io_thread::publish(io_events const & events)
+{
+  for (auto & event : events) {
+    while (!m_out_queue.push(event)) {
+      // The ring is full; make sure the consumer knows, and give it a chance
+      // to catch up. If we're asked to stop meanwhile, the remaining events
+      // are lost, which is fine as nobody consumes them anyway.
+      wake_consumer();
+      if (!m_running) {
+        return;
+      }
+      std::this_thread::yield();
+    }
+
+    if (m_paced && !m_oneshot) {
+      suspend(event.connector);
+    }
+  }
+
+  wake_consumer();
+}
+
+
+
+void
+io_thread::wake_consumer()
+{
+  if (!m_out_queue.wake_consumer()) {
+    return;
+  }
+
+  if (m_paced) {
+    // Taking the lock ensures the consumer is either waiting already, or
+    // sees the events before it starts to.
+    std::lock_guard<std::mutex> lock{m_consumer_mutex};
+    m_consumer_condition.notify_one();
+  }
+  else {
+    set_interrupt(m_queue_interrupt);
+  }
+}
+
+
+
+void
+io_thread::apply_registration(register_item const & item)
+{
+  auto & interest = m_interest[item.conn];
+  if (item.action == REGISTER) {
+    interest |= item.events;
+  }
+  else if (item.action == UNREGISTER) {
+    interest &= ~item.events;
+  }
+  else {
+    PACKETEER_FLOW_CONTROL_GUARD;
+  }
+
+  // Suspended connectors are registered again with their current interest
+  // once they're re-armed.
+  bool suspended = m_suspended.find(item.conn) != m_suspended.end();
+  if (!interest) {
+    m_interest.erase(item.conn);
+    m_suspended.erase(item.conn);
+  }
+  if (suspended) {
+    return;
+  }
+
+  if (item.action == REGISTER) {
+    m_io->register_connector(item.conn, item.events);
+  }
+  else {
+    m_io->unregister_connector(item.conn, item.events);
+  }
+}
+
+
+
+void
+io_thread::suspend(connector const & conn)
+{
+  auto iter = m_interest.find(conn);
+  if (iter == m_interest.end()) {
+    return;
+  }
+
+  // The event just pushed is consumed once the ring's consumed() count
+  // reaches the produced() count.
+  auto upto = m_out_queue.produced();
+  auto & suspended = m_suspended[conn];
+  if (!suspended) {
+    m_io->unregister_connector(conn, iter->second);
+  }
+  suspended = upto;
+  m_suspended_upto.store(upto, std::memory_order_release);
+}
+
+
+
+void
+io_thread::unsuspend()
+{
+  if (m_suspended.empty()) {
+    return;
+  }
+
+  auto upto = m_resumed_upto.load(std::memory_order_acquire);
+  for (auto iter = m_suspended.begin() ; iter != m_suspended.end() ; ) {
+    if (iter->second > upto) {
+      ++iter;
+      continue;
+    }
+
+    auto interest = m_interest.find(iter->first);
+    if (interest != m_interest.end()) {
+      m_io->register_connector(iter->first, interest->second);
+    }
+    iter = m_suspended.erase(iter);
+  }
+}
+
+
+
 bool
 io_thread::is_running() const
 {
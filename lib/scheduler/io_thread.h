@@ -28,11 +28,16 @@
 
 #include <build-config.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <thread>
+#include <unordered_map>
 
 #include <liberate/concurrency/concurrent_queue.h>
 
 #include "io.h"
+#include "event_ring.h"
 
 namespace packeteer::detail {
 
@@ -44,17 +49,18 @@ namespace packeteer::detail {
  * a) An I/O subsystem instance to use for the I/O loop.
  * b) A connector on which the I/O loop can be interrupted for graceful
  *    shutdown.
- * c) A queue in which to place I/O event data.
- * d) A connector on which it can notify that I/O event data is in the queue.
+ * c) A ring in which to place I/O event data.
+ * d) A connector on which it can notify that I/O event data is in the ring.
  *
- * Note: the queue is a little weird because we want to avoid copying
- *       event_data unnecessarily. For performance reasons, it is a vector
- *       in the io interface. In the thread model, we would have to lock a
- *       vector to append to it, introducing an unwanted bottleneck. So as
- *       a compromise, the queue is a queue of vectors of event_data.
+ * The ring is a single-producer/single-consumer ring of preallocated event
+ * slots (see event_ring.h), so handing events over takes no locks and no
+ * allocations. The queue interrupt is only written to if the consumer marked
+ * itself idle; a busy consumer is expected to poll the ring before waiting.
+ * Paced consumers do not need a queue interrupt; they block in
+ * wait_for_events() instead.
  **/
 
-using out_queue_t = liberate::concurrency::concurrent_queue<io_events>;
+using out_queue_t = event_ring;
 
 class PACKETEER_PRIVATE io_thread
 {
@@ -66,6 +72,7 @@ public:
   {
     REGISTER = 0,
     UNREGISTER = 1,
+    REARM = 2,
   };
 
   struct register_item
@@ -84,11 +91,22 @@ public:
    *
    * If report_self is true, then events on the io_interrupt are
    * also reported.
+   *
+   * If paced is true, the thread keeps polling, but stops polling a
+   * connector once it handed over events for it, until the consumer has
+   * dispatched them (see resume()). This prevents a level-triggered I/O
+   * subsystem from reporting the same events again and again while the
+   * consumer is still dispatching them. Where the I/O subsystem has a
+   * one-shot mode, it disables reported connectors itself, and resume()
+   * re-arms them directly. The consumer is woken through a condition
+   * variable instead of the queue interrupt, and only when the ring goes
+   * from empty to non-empty.
    */
   io_thread(std::unique_ptr<io> io, connector io_interrupt,
       out_queue_t & out_queue,
       connector queue_interrupt,
-      bool report_self = false);
+      bool report_self = false,
+      bool paced = false);
 
   ~io_thread();
 
@@ -107,6 +125,30 @@ public:
    */
   void stop();
 
+  /**
+   * In paced mode, the consumer calls this when it has dispatched all events
+   * it took from the ring so far, passing the connectors they were reported
+   * for. These are then polled again.
+   */
+  void resume(std::vector<connector> const & dispatched);
+
+  /**
+   * Where the I/O subsystem has a one-shot mode, the consumer may instead
+   * re-arm connectors one by one, from any thread, or all of those still
+   * disabled at once. oneshot() tells whether it has; if not, rearm() and
+   * rearm_all() do nothing.
+   */
+  bool oneshot() const;
+  void rearm(connector const & conn);
+  void rearm_all();
+
+  /**
+   * In paced mode, the consumer calls this to block until the ring has
+   * events, the thread stops, or the timeout elapses. Returns true if there
+   * are events to consume.
+   */
+  bool wait_for_events(duration const & timeout);
+
   /**
    * Return true if the thread is running, false otherwise.
    */
@@ -131,14 +173,48 @@ private:
 
   void thread_loop();
 
+  // Push events to the ring, waking the consumer if necessary.
+  void publish(io_events const & events);
+  void wake_consumer();
+
+  // Paced mode without a one-shot I/O subsystem: apply a registration,
+  // taking suspended connectors into account; stop polling a connector whose
+  // events were handed over; and poll the connectors again whose events were
+  // consumed.
+  void apply_registration(register_item const & item);
+  void suspend(connector const & conn);
+  void unsuspend();
+
   std::unique_ptr<io> m_io;
   connector           m_io_interrupt;
   out_queue_t &       m_out_queue;
   connector           m_queue_interrupt;
   bool                m_report_self;
+  bool                m_paced;
+  bool                m_oneshot;
 
   registration_queue_t        m_registration_queue;
 
+  std::mutex                  m_consumer_mutex;
+  std::condition_variable     m_consumer_condition;
+
+  // Paced mode without one-shot mode only. The interest registered per
+  // connector, and for each suspended connector, the ring position its
+  // events must be consumed up to before it is polled again. Both belong to
+  // the thread.
+  std::unordered_map<connector, events_t>  m_interest;
+  std::unordered_map<connector, size_t>    m_suspended;
+
+  // The ring position at which the thread last suspended a connector, and
+  // the position up to which the consumer dispatched events.
+  std::atomic<size_t>         m_suspended_upto = 0;
+  std::atomic<size_t>         m_resumed_upto = 0;
+
+  // One-shot mode only. Registrations not yet applied by the thread; while
+  // there are any, re-arming goes through the queue so it cannot overtake
+  // them.
+  std::atomic<size_t>         m_pending_registrations = 0;
+
   volatile bool               m_running = true;
   std::thread                 m_thread;
   mutable std::exception_ptr  m_error = nullptr;
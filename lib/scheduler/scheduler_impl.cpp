@@ -28,8 +28,10 @@
 #include "scheduler_impl.h"
 
 #include "worker.h"
+#include "buffer_pool.h"
 
 #include "../interrupt.h"
+#include "../globals.h"
 
 #if defined(PACKETEER_HAVE_EPOLL_CREATE1)
 #include "io/posix/epoll.h"
@@ -41,6 +43,7 @@
 
 #if defined(PACKETEER_HAVE_POLL)
 #include "io/posix/poll.h"
+#include "io/posix/threaded.h"
 #endif
 
 #if defined(PACKETEER_HAVE_KQUEUE)
@@ -51,17 +54,66 @@
 #include "io/win32/win32.h"
 #endif
 
+#if defined(PACKETEER_HAVE_SIGNALFD)
+#include <sys/signalfd.h>
+
+#include "../connector/posix/signal.h"
+#endif
+
 namespace pdt = packeteer::detail;
 namespace sc = std::chrono;
 
 namespace packeteer {
 
+namespace {
+
+inline ssize_t
+effective_concurrency(ssize_t num_workers)
+{
+  if (num_workers < 0) {
+    num_workers = std::thread::hardware_concurrency();
+    DLOG("Detected hardware concurrency of " << num_workers);
+    if (num_workers <= 0) {
+      num_workers = PACKETEER_DEFAULT_CONCURRENCY;
+      DLOG("Adjusting to default concurrency of " << num_workers);
+    }
+  }
+  return num_workers;
+}
+
+
+
+/**
+ * Zero-copy completions arrive on the socket error queue, which the OS
+ * reports as an error condition until the queue is empty. Collect them into
+ * the connector, so that the condition clears even if nobody is registered
+ * for PEV_IO_ZEROCOPY, and report them as such. If there were none, the
+ * socket has an actual error. A socket with both is reported again after
+ * collecting, and the error is reported then.
+ **/
+inline events_t
+translate_zerocopy_events(connector const & conn, events_t events)
+{
+  if (!(events & PEV_IO_ERROR) || !(conn.get_options() & CO_ZEROCOPY)) {
+    return events;
+  }
+
+  size_t collected = 0;
+  if (ERR_SUCCESS == conn.collect_zerocopy_completions(collected)) {
+    events &= ~PEV_IO_ERROR;
+    events |= PEV_IO_ZEROCOPY;
+  }
+  return events;
+}
+
+} // anonymous namespace
+
 
 /*****************************************************************************
  * class scheduler::scheduler_impl
  **/
 scheduler::scheduler_impl::scheduler_impl(std::shared_ptr<api> api,
-    ssize_t num_workers, scheduler_type type)
+    ssize_t num_workers, scheduler_type type, dispatch_mode mode)
   OCLINT_SUPPRESS("long method")
   : m_api{api}
   , m_num_workers{num_workers}
@@ -70,6 +122,9 @@ scheduler::scheduler_impl::scheduler_impl(std::shared_ptr<api> api,
   , m_main_loop_continue{true}
   , m_main_loop_thread{}
   , m_main_loop_pipe{m_api, "anon://"}
+  , m_dispatch_mode{mode}
+  , m_leader_mutex{}
+  , m_followers{}
   , m_in_queue{m_main_loop_pipe}
   , m_out_queue{}
   , m_scheduled_callbacks{}
@@ -152,10 +207,34 @@ scheduler::scheduler_impl::scheduler_impl(std::shared_ptr<api> api,
 #endif
       break;
 
+
+    case TYPE_EPOLL_THREADED:
+#if !defined(PACKETEER_HAVE_EPOLL_CREATE1) || !defined(PACKETEER_HAVE_POLL)
+      throw exception(ERR_INVALID_OPTION, "Threaded epoll() is not supported "
+          "on this platform.");
+#else
+      m_io = new detail::io_threaded{m_api,
+        std::make_unique<detail::io_epoll>(m_api)};
+#endif
+      break;
+
     default:
       throw exception(ERR_INVALID_OPTION, "unsupported scheduler type.");
   }
 
+  // The main loop pipe stays registered for the lifetime of the scheduler.
+  // In worker mode it wakes the main loop thread; without workers, it makes
+  // the I/O subsystem's poll handle readable when commands are committed.
+  error_t err = m_main_loop_pipe.connect();
+  if (ERR_SUCCESS != err) {
+    delete m_io;
+    throw exception(err, "Could not connect main loop pipe.");
+  }
+  DLOG("Main loop pipe is " << m_main_loop_pipe);
+
+  m_io->register_connector(m_main_loop_pipe,
+      PEV_IO_READ | PEV_IO_ERROR | PEV_IO_CLOSE);
+
   set_num_workers(num_workers);
 }
 
@@ -166,6 +245,16 @@ scheduler::scheduler_impl::~scheduler_impl()
   DLOG("Scheduler implementation destructor.");
   set_num_workers(0);
 
+  m_io->unregister_connector(m_main_loop_pipe,
+      PEV_IO_READ | PEV_IO_ERROR | PEV_IO_CLOSE);
+  m_main_loop_pipe.close();
+
+  if (m_signal_connector.connected()) {
+    m_io->unregister_connector(m_signal_connector,
+        PEV_IO_READ | PEV_IO_ERROR | PEV_IO_CLOSE);
+    m_signal_connector.close();
+  }
+
   delete m_io;
 
   // There might be a bunch of items still in the in- and out queues.
@@ -196,15 +285,6 @@ scheduler::scheduler_impl::start_main_loop()
 {
   m_main_loop_continue = true;
 
-  error_t err = m_main_loop_pipe.connect();
-  if (ERR_SUCCESS != err) {
-    throw exception(err, "Could not connect main loop pipe.");
-  }
-  DLOG("Main loop pipe is " << m_main_loop_pipe);
-
-  m_io->register_connector(m_main_loop_pipe,
-      PEV_IO_READ | PEV_IO_ERROR | PEV_IO_CLOSE);
-
   m_main_loop_thread = std::thread(&scheduler_impl::main_scheduler_loop, this);
 }
 
@@ -217,17 +297,10 @@ scheduler::scheduler_impl::stop_main_loop()
 
   m_main_loop_continue = false;
 
-  detail::set_interrupt(m_main_loop_pipe);
   if (m_main_loop_thread.joinable()) {
+    detail::set_interrupt(m_main_loop_pipe);
     m_main_loop_thread.join();
   }
-
-  if (m_main_loop_pipe.connected()) {
-    m_io->unregister_connector(m_main_loop_pipe,
-        PEV_IO_READ | PEV_IO_ERROR | PEV_IO_CLOSE);
-
-    m_main_loop_pipe.close();
-  }
 }
 
 
@@ -235,14 +308,7 @@ scheduler::scheduler_impl::stop_main_loop()
 void
 scheduler::scheduler_impl::adjust_workers(ssize_t num_workers)
 {
-  if (num_workers < 0) {
-    num_workers = std::thread::hardware_concurrency();
-    DLOG("Detected hardware concurrency of " << num_workers);
-    if (num_workers <= 0) {
-      num_workers = PACKETEER_DEFAULT_CONCURRENCY;
-      DLOG("Adjusting to default concurrency of " << num_workers);
-    }
-  }
+  num_workers = effective_concurrency(num_workers);
 
   ssize_t have = m_workers.size();
 
@@ -267,7 +333,7 @@ scheduler::scheduler_impl::adjust_workers(ssize_t num_workers)
         << num_workers << ".");
     for (ssize_t i = have ; i < num_workers ; ++i) {
       auto worker = new pdt::worker(&m_worker_condition,
-          m_out_queue, m_in_queue);
+          m_out_queue, m_in_queue, m_signal_mask);
       worker->start();
       m_workers.push_back(worker);
     }
@@ -276,9 +342,307 @@ scheduler::scheduler_impl::adjust_workers(ssize_t num_workers)
 
 
 
+void
+scheduler::scheduler_impl::start_followers(ssize_t num_workers)
+{
+  stop_followers();
+
+  num_workers = effective_concurrency(num_workers);
+  DLOG("Starting " << num_workers << " leader/follower threads.");
+
+  m_main_loop_continue = true;
+  m_oneshot = true;
+  // Each leader takes a single event, and runs its callbacks directly.
+  m_native_oneshot = m_io->set_oneshot(true, 1);
+  for (ssize_t i = 0 ; i < num_workers ; ++i) {
+    m_followers.push_back(std::thread(&scheduler_impl::leader_follower_loop,
+          this));
+  }
+}
+
+
+
+void
+scheduler::scheduler_impl::stop_followers()
+{
+  if (m_followers.empty()) {
+    return;
+  }
+
+  DLOG("Stopping leader/follower threads.");
+  {
+    std::lock_guard<std::mutex> lock(m_leader_mutex);
+    m_main_loop_continue = false;
+  }
+
+  // Wake the current leader and all followers.
+  m_leader_condition.notify_all();
+  detail::set_interrupt(m_main_loop_pipe);
+  for (auto & thread : m_followers) {
+    thread.join();
+  }
+  m_followers.clear();
+
+  // Callbacks left in the out queue no longer hold their connectors.
+  if (m_native_oneshot) {
+    m_io->set_oneshot(false, 0);
+  }
+  else {
+    restore_held_io();
+  }
+  m_oneshot = false;
+  m_native_oneshot = false;
+}
+
+
+
+void
+scheduler::scheduler_impl::leader_follower_loop()
+{
+  DLOG("Leader/follower thread " << std::this_thread::get_id() << " started.");
+
+  // Steps down as leader, even if waiting for events throws.
+  struct step_down
+  {
+    scheduler_impl & impl;
+
+    ~step_down()
+    {
+      {
+        std::lock_guard<std::mutex> lock(impl.m_leader_mutex);
+        impl.m_has_leader = false;
+      }
+      impl.m_leader_condition.notify_one();
+    }
+  };
+
+  size_t mask_applied = 0;
+  try {
+    while (true) {
+      entry_list_t to_schedule;
+
+      {
+        // Followers wait for the leader to step down; the first to notice is
+        // promoted. They also wake up to block signals registered meanwhile.
+        std::unique_lock<std::mutex> lock(m_leader_mutex);
+        m_signal_mask.apply(mask_applied);
+        while (m_has_leader && m_main_loop_continue) {
+          m_leader_condition.wait(lock);
+          m_signal_mask.apply(mask_applied);
+        }
+        if (!m_main_loop_continue) {
+          break;
+        }
+        m_has_leader = true;
+      }
+
+      {
+        // The leader alone touches the callback containers and the I/O
+        // subsystem, exactly like the main loop in the other mode.
+        step_down leader{*this};
+
+        // Callbacks left over by a previous leader take priority. Otherwise,
+        // wait for events, keep the callbacks for the connector this thread
+        // holds, and leave the rest to the next leaders, so that they still
+        // run in parallel.
+        detail::callback_entry * entry = nullptr;
+        if (m_out_queue.pop(entry)) {
+          to_schedule.push_back(entry);
+        }
+        else {
+          wait_for_events(sc::nanoseconds(PACKETEER_EVENT_WAIT_INTERVAL_USEC),
+              true, // Soft timeout
+              to_schedule);
+          size_t keep = 1;
+          while (keep < to_schedule.size()
+              && detail::CB_ENTRY_IO == to_schedule[keep]->m_type
+              && detail::CB_ENTRY_IO == to_schedule[0]->m_type)
+          {
+            auto first = reinterpret_cast<detail::io_callback_entry *>(
+                to_schedule[0]);
+            auto next = reinterpret_cast<detail::io_callback_entry *>(
+                to_schedule[keep]);
+            if (!first->m_held || !next->m_held
+                || first->m_connector != next->m_connector)
+            {
+              break;
+            }
+            ++keep;
+          }
+          if (to_schedule.size() > keep) {
+            m_out_queue.push_range(to_schedule.begin() + keep,
+                to_schedule.end());
+            to_schedule.resize(keep);
+          }
+        }
+      }
+
+      // Stepping down promoted the next follower; run the callbacks we
+      // found in this thread, then release the connectors they held.
+      std::vector<connector> held;
+      for (auto entry : to_schedule) {
+        if (detail::CB_ENTRY_IO != entry->m_type) {
+          continue;
+        }
+        auto io = reinterpret_cast<detail::io_callback_entry *>(entry);
+        if (io->m_held) {
+          held.push_back(io->m_connector);
+          io->m_held = false;
+        }
+      }
+      if (!to_schedule.empty()) {
+        drain_work_queue(to_schedule, false, m_in_queue);
+      }
+      for (auto & conn : held) {
+        release_io(conn);
+      }
+      if (!held.empty() && !m_native_oneshot) {
+        m_in_queue.commit();
+      }
+    }
+  } catch (exception const & ex) {
+    EXC_LOG("Error in leader/follower loop", ex);
+  } catch (std::exception const & ex) {
+    EXC_LOG("Error in leader/follower loop: ", ex);
+  } catch (std::string const & str) {
+    ELOG("Error in leader/follower loop: " << str);
+  } catch (...) {
+    ELOG("Error in leader/follower loop.");
+  }
+
+  DLOG("Leader/follower thread " << std::this_thread::get_id() << " stopped.");
+}
+
+
+
+void
+scheduler::scheduler_impl::hold_io(connector const & conn,
+    std::vector<detail::io_callback_entry *> const & callbacks)
+{
+  if (callbacks.empty()) {
+    // Nothing runs elsewhere; the connector may be reported again.
+    if (m_native_oneshot) {
+      m_io->rearm(conn);
+    }
+    return;
+  }
+
+  events_t events = 0;
+  for (auto io : callbacks) {
+    io->m_held = true;
+    events |= io->m_events;
+  }
+  if (m_native_oneshot) {
+    return;
+  }
+
+  // Only interest callbacks registered for can be dropped.
+  events &= m_io_callbacks.registered_events(conn)
+    & (PEV_IO_READ | PEV_IO_WRITE);
+  auto & held = m_held_io[conn];
+  held.events |= events;
+  held.holders += callbacks.size();
+  unregister_held(conn, events);
+}
+
+
+
+void
+scheduler::scheduler_impl::release_io(connector const & conn)
+{
+  // Called from followers; the I/O subsystem re-arms thread-safely.
+  if (m_native_oneshot) {
+    m_io->rearm(conn);
+    return;
+  }
+  m_in_queue.enqueue(CMD_REARM, new detail::io_callback_entry{nullptr,
+      conn, 0});
+}
+
+
+
+void
+scheduler::scheduler_impl::rearm_held_io(connector const & conn)
+{
+  auto iter = m_held_io.find(conn);
+  if (iter == m_held_io.end() || --iter->second.holders) {
+    return;
+  }
+  auto events = iter->second.events;
+  m_held_io.erase(iter);
+
+  // Callbacks may have been removed in the meantime, and pumps or readers
+  // may have taken over reading.
+  events &= m_io_callbacks.registered_events(conn);
+  auto pump = m_pumps.find(conn);
+  auto reader = m_readers.find(conn);
+  if ((pump && pump->m_waiting) || (reader && reader->m_in_flight)) {
+    events &= ~PEV_IO_READ;
+  }
+  if (events) {
+    m_io->register_connector(conn, events);
+  }
+}
+
+
+
+void
+scheduler::scheduler_impl::restore_held_io()
+{
+  while (!m_held_io.empty()) {
+    auto conn = m_held_io.begin()->first;
+    m_held_io.begin()->second.holders = 1;
+    rearm_held_io(conn);
+  }
+}
+
+
+
+events_t
+scheduler::scheduler_impl::held_io_events(connector const & conn) const
+{
+  auto iter = m_held_io.find(conn);
+  if (iter == m_held_io.end()) {
+    return 0;
+  }
+  return iter->second.events;
+}
+
+
+
+void
+scheduler::scheduler_impl::unregister_held(connector const & conn,
+    events_t events)
+{
+  // Write queues, pumps and readers are not callbacks; they keep their
+  // interest.
+  if (events & PEV_IO_WRITE) {
+    auto queue = find_write_queue(conn);
+    if ((queue && queue->m_interest) || m_pumps.is_waited_for(conn)) {
+      events &= ~PEV_IO_WRITE;
+    }
+  }
+  if (events & PEV_IO_READ) {
+    auto pump = m_pumps.find(conn);
+    auto reader = m_readers.find(conn);
+    if ((pump && !pump->m_waiting) || (reader && !reader->m_in_flight)) {
+      events &= ~PEV_IO_READ;
+    }
+  }
+
+  if (events) {
+    m_io->unregister_connector(conn, events);
+  }
+}
+
+
+
 size_t
 scheduler::scheduler_impl::num_workers() const
 {
+  if (DISPATCH_LEADER_FOLLOWER == m_dispatch_mode) {
+    return m_followers.size();
+  }
   return m_workers.size();
 }
 
@@ -288,6 +652,17 @@ void
 scheduler::scheduler_impl::set_num_workers(ssize_t num_workers)
 {
   m_num_workers = num_workers;
+
+  if (DISPATCH_LEADER_FOLLOWER == m_dispatch_mode) {
+    if (num_workers == 0) {
+      stop_followers();
+    }
+    else {
+      start_followers(num_workers);
+    }
+    return;
+  }
+
   if (num_workers == 0) {
     stop_main_loop();
   }
@@ -300,6 +675,22 @@ scheduler::scheduler_impl::set_num_workers(ssize_t num_workers)
 
 
 
+handle
+scheduler::scheduler_impl::poll_handle() const
+{
+  return m_io->get_poll_handle();
+}
+
+
+
+time_point
+scheduler::scheduler_impl::next_deadline() const
+{
+  return m_scheduled_callbacks.get_first_timeout();
+}
+
+
+
 void
 scheduler::scheduler_impl::process_in_queue(entry_list_t & triggered)
 {
@@ -315,7 +706,7 @@ scheduler::scheduler_impl::process_in_queue(entry_list_t & triggered)
     switch (entry->m_type) {
       case pdt::CB_ENTRY_IO:
         process_in_queue_io(command,
-            reinterpret_cast<pdt::io_callback_entry *>(entry));
+            reinterpret_cast<pdt::io_callback_entry *>(entry), triggered);
         break;
 
       case pdt::CB_ENTRY_SCHEDULED:
@@ -329,6 +720,21 @@ scheduler::scheduler_impl::process_in_queue(entry_list_t & triggered)
             triggered);
         break;
 
+      case pdt::CB_ENTRY_SIGNAL:
+        process_in_queue_signal(command,
+            reinterpret_cast<pdt::signal_callback_entry *>(entry));
+        break;
+
+      case pdt::CB_ENTRY_PUMP:
+        process_in_queue_pump(command,
+            reinterpret_cast<pdt::pump_entry *>(entry));
+        break;
+
+      case pdt::CB_ENTRY_READER:
+        process_in_queue_reader(command,
+            reinterpret_cast<pdt::reader_entry *>(entry));
+        break;
+
       default:
         delete entry;
         PACKETEER_FLOW_CONTROL_GUARD_WITH("Bad callback entry type");
@@ -341,7 +747,7 @@ scheduler::scheduler_impl::process_in_queue(entry_list_t & triggered)
 
 void
 scheduler::scheduler_impl::process_in_queue_io(command_type command,
-    pdt::io_callback_entry * io)
+    pdt::io_callback_entry * io, entry_list_t & triggered)
 {
   switch (command) {
     case CMD_ADD:
@@ -349,74 +755,226 @@ scheduler::scheduler_impl::process_in_queue_io(command_type command,
         // Add the callback for the event mask
         auto updated = m_io_callbacks.add(io);
         m_io->register_connector(updated->m_connector, updated->m_events);
+
+        // A pump waiting to write what it read from the connector must not
+        // be woken up by more data, and neither must a connector a worker is
+        // reading from.
+        auto pump = m_pumps.find(updated->m_connector);
+        auto reader = m_readers.find(updated->m_connector);
+        if ((pump && pump->m_waiting) || (reader && reader->m_in_flight)) {
+          m_io->unregister_connector(updated->m_connector, PEV_IO_READ);
+        }
+
+        // Nor must callbacks still running in a follower.
+        if (!m_held_io.empty()) {
+          unregister_held(updated->m_connector,
+              held_io_events(updated->m_connector));
+        }
       }
       break;
 
 
     case CMD_REMOVE:
       {
+        // Removing all events without a callback also discards the
+        // connector's write queue.
+        bool remove_all = !io->m_callback
+          && (PEV_ALL_BUILTIN == (io->m_events & PEV_ALL_BUILTIN));
+
         // Remove the callback from the event mask
         auto updated = m_io_callbacks.remove(io);
         m_io->unregister_connector(updated->m_connector, updated->m_events);
+
+        if (remove_all) {
+          remove_write_queue(io->m_connector);
+          stop_pump(m_pumps.remove(io->m_connector));
+          stop_reader(m_readers.remove(io->m_connector));
+        }
+        else {
+          // If the write queue or a pump is waiting for the connector to
+          // become writable, we must not lose that interest. Neither must a
+          // pump or reader reading from it.
+          auto queue = find_write_queue(io->m_connector);
+          if ((queue && queue->m_interest)
+              || m_pumps.is_waited_for(io->m_connector))
+          {
+            m_io->register_connector(io->m_connector, PEV_IO_WRITE);
+          }
+          auto pump = m_pumps.find(io->m_connector);
+          auto reader = m_readers.find(io->m_connector);
+          if ((pump && !pump->m_waiting)
+              || (reader && !reader->m_in_flight))
+          {
+            m_io->register_connector(io->m_connector, PEV_IO_READ);
+          }
+        }
         delete io;
       }
       break;
 
 
     case CMD_TRIGGER:
-    default:
+      {
+        // Triggers for I/O entries come from write queues. PEV_IO_WRITE means
+        // the queue's ownership was handed to us, and we need to continue
+        // flushing it. Any other events are for reporting to callbacks.
+        if (io->m_events & PEV_IO_WRITE) {
+          io->m_events &= ~PEV_IO_WRITE;
+          auto queue = find_write_queue(io->m_connector);
+          if (queue) {
+            io->m_events |= flush_write_queue(io->m_connector, *queue);
+            if (!queue->m_interest) {
+              queue.reset();
+              prune_write_queue(io->m_connector);
+            }
+          }
+        }
+
+        if (io->m_events) {
+          // Remember it for a later processing stage; triggered takes
+          // ownership
+          triggered.push_back(io);
+        }
+        else {
+          delete io;
+        }
+      }
+      break;
+
+
+    case CMD_REARM:
+      // A follower finished running a callback; its interest is restored.
+      rearm_held_io(io->m_connector);
       delete io;
-      DLOG("Ignoring invalid TRIGGER command for I/O callback.");
       break;
+
+
+    default:
+      delete io;
+      PACKETEER_FLOW_CONTROL_GUARD_WITH("Bad command for I/O callback");
   }
 }
 
 
 
 void
-scheduler::scheduler_impl::process_in_queue_scheduled(command_type command,
-    pdt::scheduled_callback_entry * scheduled)
+scheduler::scheduler_impl::process_in_queue_pump(command_type command,
+    pdt::pump_entry * pump)
 {
   switch (command) {
     case CMD_ADD:
       {
-        // When adding, we simply add scheduled entries. It's entirely
-        // possible that the same (callback, timeout) combination is added
-        // multiple times, but that might be the caller's intent.
-        m_scheduled_callbacks.add(scheduled);
+        // A new pump for the same source replaces the old one. The I/O
+        // subsystem is level-triggered, so any data already waiting is
+        // picked up with the next poll.
+        stop_pump(m_pumps.add(pump));
+        m_io->register_connector(pump->m_source, PEV_IO_READ);
       }
       break;
 
 
     case CMD_REMOVE:
-      {
-        // When deleting, we need to delete *all* (callback, timeout)
-        // combinations that match. That might not be what the caller
-        // intends, but we have no way of distinguishing between them.
-        m_scheduled_callbacks.remove(scheduled);
-        delete scheduled;
-      }
+      stop_pump(m_pumps.remove(pump->m_source));
+      delete pump;
       break;
 
 
-    case CMD_TRIGGER:
     default:
-      delete scheduled;
-      DLOG("Ignoring invalid TRIGGER command for scheduled callback.");
-      break;
+      delete pump;
+      PACKETEER_FLOW_CONTROL_GUARD_WITH("Bad command for pump");
   }
 }
 
 
 
 void
-scheduler::scheduler_impl::process_in_queue_user(command_type command,
-    pdt::user_callback_entry * entry, entry_list_t & triggered)
+scheduler::scheduler_impl::process_in_queue_reader(command_type command,
+    pdt::reader_entry * reader)
 {
   switch (command) {
     case CMD_ADD:
-      // Add the callback/entry mask; container takes ownership
-      m_user_callbacks.add(entry);
+      stop_reader(m_readers.add(reader));
+      m_io->register_connector(reader->m_connector, PEV_IO_READ);
+      break;
+
+
+    case CMD_REMOVE:
+      stop_reader(m_readers.remove(reader->m_connector));
+      delete reader;
+      break;
+
+
+    case CMD_TRIGGER:
+      {
+        // A worker is done reading, and hands its copy back. If the reader
+        // was stopped or replaced in the meantime, there is nothing to do.
+        auto current = m_readers.find(reader->m_connector);
+        if (current && current->m_id == reader->m_id) {
+          current->m_in_flight = false;
+          if (reader->m_events) {
+            stop_reader(m_readers.remove(reader->m_connector));
+          }
+          else {
+            m_io->register_connector(reader->m_connector, PEV_IO_READ);
+          }
+        }
+        delete reader;
+      }
+      break;
+
+
+    default:
+      delete reader;
+      PACKETEER_FLOW_CONTROL_GUARD_WITH("Bad command for reader");
+  }
+}
+
+
+
+void
+scheduler::scheduler_impl::process_in_queue_scheduled(command_type command,
+    pdt::scheduled_callback_entry * scheduled)
+{
+  switch (command) {
+    case CMD_ADD:
+      {
+        // When adding, we simply add scheduled entries. It's entirely
+        // possible that the same (callback, timeout) combination is added
+        // multiple times, but that might be the caller's intent.
+        m_scheduled_callbacks.add(scheduled);
+      }
+      break;
+
+
+    case CMD_REMOVE:
+      {
+        // When deleting, we need to delete *all* (callback, timeout)
+        // combinations that match. That might not be what the caller
+        // intends, but we have no way of distinguishing between them.
+        m_scheduled_callbacks.remove(scheduled);
+        delete scheduled;
+      }
+      break;
+
+
+    case CMD_TRIGGER:
+    default:
+      delete scheduled;
+      DLOG("Ignoring invalid TRIGGER command for scheduled callback.");
+      break;
+  }
+}
+
+
+
+void
+scheduler::scheduler_impl::process_in_queue_user(command_type command,
+    pdt::user_callback_entry * entry, entry_list_t & triggered)
+{
+  switch (command) {
+    case CMD_ADD:
+      // Add the callback/entry mask; container takes ownership
+      m_user_callbacks.add(entry);
       break;
 
 
@@ -441,6 +999,99 @@ scheduler::scheduler_impl::process_in_queue_user(command_type command,
 
 
 
+void
+scheduler::scheduler_impl::process_in_queue_signal(command_type command,
+    pdt::signal_callback_entry * entry)
+{
+  int signal = entry->m_signal;
+  bool had_signal = m_signal_callbacks.has(signal);
+
+  switch (command) {
+    case CMD_ADD:
+      // Container takes ownership
+      m_signal_callbacks.add(entry);
+      break;
+
+
+    case CMD_REMOVE:
+      m_signal_callbacks.remove(entry);
+      delete entry;
+      break;
+
+
+    default:
+      delete entry;
+      PACKETEER_FLOW_CONTROL_GUARD_WITH("Bad command for signal callback");
+  }
+
+  // Only touch the signal mask if the set of signals changed.
+  if (had_signal != m_signal_callbacks.has(signal)) {
+    update_signal_mask();
+  }
+}
+
+
+
+void
+scheduler::scheduler_impl::update_signal_mask()
+{
+#if defined(PACKETEER_HAVE_SIGNALFD)
+  sigset_t mask;
+  sigemptyset(&mask);
+  bool empty = true;
+  m_signal_callbacks.for_each_signal([&mask, &empty](int signal)
+  {
+    sigaddset(&mask, signal);
+    empty = false;
+  });
+
+  if (empty) {
+    if (m_signal_connector.connected()) {
+      DLOG("No more signals registered, closing signal connector.");
+      m_io->unregister_connector(m_signal_connector,
+          PEV_IO_READ | PEV_IO_ERROR | PEV_IO_CLOSE);
+      m_signal_connector.close();
+    }
+    return;
+  }
+
+  if (!m_signal_connector) {
+    m_signal_connector = connector{m_api, "signal://"};
+  }
+  if (!m_signal_connector.connected()) {
+    auto err = m_signal_connector.connect();
+    if (ERR_SUCCESS != err) {
+      ET_LOG("Could not create signal connector", err);
+      return;
+    }
+    m_io->register_connector(m_signal_connector,
+        PEV_IO_READ | PEV_IO_ERROR | PEV_IO_CLOSE);
+  }
+
+  // The thread processing the in-queue also needs the signals blocked, or
+  // they may get delivered to it instead of the connector. Workers and
+  // followers block them when they wake up, so wake them all.
+  ::pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+  m_signal_mask.update(mask);
+  {
+    std::lock_guard<std::mutex> lock(m_worker_condition.mutex);
+  }
+  m_worker_condition.condition.notify_all();
+  {
+    std::lock_guard<std::mutex> lock(m_leader_mutex);
+  }
+  m_leader_condition.notify_all();
+
+  auto err = detail::set_signal_mask(m_signal_connector.get_read_handle(),
+      mask);
+  if (ERR_SUCCESS != err) {
+    ET_LOG("Could not update signal mask", err);
+  }
+#endif // PACKETEER_HAVE_SIGNALFD
+}
+
+
+
 void
 scheduler::scheduler_impl::dispatch_io_callbacks(
     detail::io_events const & events,
@@ -451,14 +1102,56 @@ scheduler::scheduler_impl::dispatch_io_callbacks(
     if (m_main_loop_pipe == event.connector) {
       // We just got interrupted; clear the interrupt
       detail::clear_interrupt(m_main_loop_pipe);
+      if (m_oneshot) {
+        hold_io(event.connector, {});
+      }
       continue;
     }
 
-    // Find callback(s).
-    auto callbacks = m_io_callbacks.copy_matching(event.connector,
+    if (m_signal_connector == event.connector) {
+      dispatch_signal_callbacks(to_schedule);
+      if (m_oneshot) {
+        hold_io(event.connector, {});
+      }
+      continue;
+    }
+
+    events_t events = translate_zerocopy_events(event.connector,
         event.events);
+
+    // Pumps forward data without involving callbacks.
+    if (!m_pumps.empty()) {
+      events = dispatch_pumps(event.connector, events, to_schedule);
+    }
+
+    // Readers take over readability before other callbacks see it.
+    if (!m_readers.empty()) {
+      events = dispatch_readers(event.connector, events, to_schedule);
+    }
+
+    // If the connector has a write queue waiting for it, flush that first;
+    // it may produce further events to report.
+    if (events & PEV_IO_WRITE) {
+      auto queue = find_write_queue(event.connector);
+      if (queue && queue->m_interest) {
+        events |= flush_write_queue(event.connector, *queue);
+        if (!queue->m_interest) {
+          queue.reset();
+          prune_write_queue(event.connector);
+        }
+      }
+    }
+
+    // Find callback(s).
+    auto callbacks = m_io_callbacks.copy_matching(event.connector, events);
     to_schedule.insert(to_schedule.end(), callbacks.begin(), callbacks.end());
 
+    // In leader/follower mode, the connector is not reported again until
+    // the follower running the callbacks is done.
+    if (m_oneshot) {
+      hold_io(event.connector, callbacks);
+    }
+
     // If any of the callbacks have IO_FLAGS_ONESHOT or IO_FLAGS_REPEAT set,
     // remove them from the I/O subsystem now. We just insert the approriate
     // entry into the command queue here, and the next iteration waiting for
@@ -532,6 +1225,17 @@ scheduler::scheduler_impl::dispatch_user_callbacks(
     entry_list_t & to_schedule)
 {
   for (auto & e : triggered) {
+    if (pdt::CB_ENTRY_IO == e->m_type) {
+      // Write queue events are reported to the connector's callbacks.
+      auto io = reinterpret_cast<pdt::io_callback_entry *>(e);
+      auto callbacks = m_io_callbacks.copy_matching(io->m_connector,
+          io->m_events);
+      to_schedule.insert(to_schedule.end(), callbacks.begin(), callbacks.end());
+
+      delete io;
+      continue;
+    }
+
     if (pdt::CB_ENTRY_USER != e->m_type) {
       ELOG("Invalid user callback!");
       continue;
@@ -553,6 +1257,546 @@ scheduler::scheduler_impl::dispatch_user_callbacks(
 
 
 
+void
+scheduler::scheduler_impl::dispatch_signal_callbacks(
+    entry_list_t & to_schedule)
+{
+#if defined(PACKETEER_HAVE_SIGNALFD)
+  // Read all pending signals in as few system calls as possible. The same
+  // signal may be pending several times; callbacks are invoked once per
+  // wakeup regardless.
+  ::sigset_t received;
+  sigemptyset(&received);
+
+  ::signalfd_siginfo infos[PACKETEER_SIGNAL_BATCH_SIZE];
+  while (true) {
+    size_t amount = 0;
+    auto err = m_signal_connector.read(infos, sizeof(infos), amount);
+    if (ERR_SUCCESS != err) {
+      if (ERR_ASYNC != err) {
+        ET_LOG("Error reading signals", err);
+      }
+      break;
+    }
+
+    size_t count = amount / sizeof(::signalfd_siginfo);
+    for (size_t i = 0 ; i < count ; ++i) {
+      sigaddset(&received, infos[i].ssi_signo);
+    }
+
+    if (count < PACKETEER_SIGNAL_BATCH_SIZE) {
+      break;
+    }
+  }
+
+  for (int signal = 1 ; signal < NSIG ; ++signal) {
+    if (1 != sigismember(&received, signal)) {
+      continue;
+    }
+    DLOG("Received signal " << signal);
+    auto callbacks = m_signal_callbacks.copy_matching(signal);
+    to_schedule.insert(to_schedule.end(), callbacks.begin(), callbacks.end());
+  }
+#endif // PACKETEER_HAVE_SIGNALFD
+}
+
+
+
+template <typename pushT>
+error_t
+scheduler::scheduler_impl::enqueue_and_flush(connector const & conn,
+    pushT && push)
+{
+  if (conn.is_blocking()) {
+    return ERR_INVALID_OPTION;
+  }
+  if (!conn.communicating()) {
+    return ERR_INVALID_VALUE;
+  }
+
+  auto queue = get_write_queue(conn);
+  push(*queue);
+
+  // If we can become the queue's consumer, try writing right away. Only if
+  // the connector would block do we involve the main loop.
+  events_t events = 0;
+  error_t err = ERR_SUCCESS;
+  if (queue->acquire()) {
+    connector tmp{conn};
+    while (true) {
+      err = queue->flush(tmp);
+      if (ERR_REPEAT_ACTION == err) {
+        events |= PEV_IO_WRITE;
+        err = ERR_SUCCESS;
+        break;
+      }
+      if (ERR_SUCCESS != err) {
+        events |= PEV_IO_ERROR;
+      }
+      if (queue->release()) {
+        break;
+      }
+    }
+  }
+
+  events |= queue->check_watermarks();
+  if (events) {
+    m_in_queue.enqueue(CMD_TRIGGER,
+        new detail::io_callback_entry{nullptr, conn, events});
+    m_in_queue.commit();
+  }
+
+  // If the main loop does not take over, the queue may be done with.
+  if (!(events & PEV_IO_WRITE) && !queue->size()) {
+    queue.reset();
+    prune_write_queue(conn);
+  }
+
+  return err;
+}
+
+
+
+error_t
+scheduler::scheduler_impl::enqueue_write(connector const & conn,
+    void const * buf, size_t bufsize)
+{
+  if (!conn || !buf || !bufsize) {
+    return ERR_INVALID_VALUE;
+  }
+  return enqueue_and_flush(conn, [buf, bufsize](detail::write_queue & queue)
+  {
+    queue.push(buf, bufsize);
+  });
+}
+
+
+
+error_t
+scheduler::scheduler_impl::enqueue_write(connector const & conn, buffer data)
+{
+  if (!conn || data.empty()) {
+    return ERR_INVALID_VALUE;
+  }
+  return enqueue_and_flush(conn, [&data](detail::write_queue & queue)
+  {
+    queue.push(std::move(data));
+  });
+}
+
+
+
+error_t
+scheduler::scheduler_impl::set_write_watermarks(connector const & conn,
+    size_t low_watermark, size_t high_watermark, size_t notsent_lowat)
+{
+  if (!conn) {
+    return ERR_INVALID_VALUE;
+  }
+  if (high_watermark && low_watermark >= high_watermark) {
+    return ERR_INVALID_VALUE;
+  }
+
+  if (notsent_lowat) {
+    auto err = detail::write_queue::set_notsent_lowat(conn, notsent_lowat);
+    if (ERR_SUCCESS != err) {
+      return err;
+    }
+  }
+
+  get_write_queue(conn)->set_watermarks(low_watermark, high_watermark);
+  return ERR_SUCCESS;
+}
+
+
+
+size_t
+scheduler::scheduler_impl::write_queue_size(connector const & conn) const
+{
+  auto queue = find_write_queue(conn);
+  if (!queue) {
+    return 0;
+  }
+  return queue->size();
+}
+
+
+
+std::shared_ptr<detail::write_queue>
+scheduler::scheduler_impl::get_write_queue(connector const & conn)
+{
+  auto queue = find_write_queue(conn);
+  if (queue) {
+    return queue;
+  }
+
+  std::unique_lock<std::shared_mutex> lock{m_write_queues_mutex};
+  auto & entry = m_write_queues[conn];
+  if (!entry) {
+    entry = std::make_shared<detail::write_queue>();
+  }
+  return entry;
+}
+
+
+
+std::shared_ptr<detail::write_queue>
+scheduler::scheduler_impl::find_write_queue(connector const & conn) const
+{
+  std::shared_lock<std::shared_mutex> lock{m_write_queues_mutex};
+  auto iter = m_write_queues.find(conn);
+  if (iter == m_write_queues.end()) {
+    return {};
+  }
+  return iter->second;
+}
+
+
+
+void
+scheduler::scheduler_impl::remove_write_queue(connector const & conn)
+{
+  std::unique_lock<std::shared_mutex> lock{m_write_queues_mutex};
+  m_write_queues.erase(conn);
+}
+
+
+
+void
+scheduler::scheduler_impl::prune_write_queue(connector const & conn)
+{
+  std::unique_lock<std::shared_mutex> lock{m_write_queues_mutex};
+  auto iter = m_write_queues.find(conn);
+  if (iter == m_write_queues.end()) {
+    return;
+  }
+
+  // New references are only handed out under the lock, so if the map holds
+  // the only one, no producer can push to the queue any longer.
+  auto const & queue = iter->second;
+  if (queue.use_count() > 1 || queue->size() || queue->m_interest
+      || queue->has_watermarks())
+  {
+    return;
+  }
+  m_write_queues.erase(iter);
+}
+
+
+
+events_t
+scheduler::scheduler_impl::flush_write_queue(connector const & conn,
+    detail::write_queue & queue)
+{
+  events_t events = 0;
+  connector tmp{conn};
+
+  while (true) {
+    auto err = queue.flush(tmp);
+    if (ERR_REPEAT_ACTION == err) {
+      // We keep ownership until the connector becomes writable again.
+      if (!queue.m_interest) {
+        queue.m_interest = true;
+        m_io->register_connector(conn, PEV_IO_WRITE);
+      }
+      break;
+    }
+
+    if (ERR_SUCCESS != err) {
+      events |= PEV_IO_ERROR;
+    }
+
+    // The queue is drained (or broken). Drop write interest, unless
+    // something else still wants it.
+    if (queue.m_interest) {
+      queue.m_interest = false;
+      release_write_interest(conn);
+    }
+
+    if (queue.release()) {
+      break;
+    }
+  }
+
+  return events | queue.check_watermarks();
+}
+
+
+
+void
+scheduler::scheduler_impl::release_write_interest(connector const & conn)
+{
+  if (m_io_callbacks.registered_events(conn) & PEV_IO_WRITE) {
+    return;
+  }
+  auto queue = find_write_queue(conn);
+  if (queue && queue->m_interest) {
+    return;
+  }
+  if (m_pumps.is_waited_for(conn)) {
+    return;
+  }
+  m_io->unregister_connector(conn, PEV_IO_WRITE);
+}
+
+
+
+error_t
+scheduler::scheduler_impl::add_pump(connector const & source,
+    connector const & destination)
+{
+  if (!source || !destination || source == destination) {
+    return ERR_INVALID_VALUE;
+  }
+  if (source.is_blocking() || destination.is_blocking()) {
+    return ERR_INVALID_OPTION;
+  }
+  if (!source.communicating() || !destination.communicating()) {
+    return ERR_INVALID_VALUE;
+  }
+
+  m_in_queue.enqueue(CMD_ADD, new detail::pump_entry{source, destination});
+  m_in_queue.commit();
+  return ERR_SUCCESS;
+}
+
+
+
+error_t
+scheduler::scheduler_impl::remove_pump(connector const & source)
+{
+  if (!source) {
+    return ERR_INVALID_VALUE;
+  }
+
+  m_in_queue.enqueue(CMD_REMOVE, new detail::pump_entry{source, connector{}});
+  m_in_queue.commit();
+  return ERR_SUCCESS;
+}
+
+
+
+events_t
+scheduler::scheduler_impl::dispatch_pumps(connector const & conn,
+    events_t events, entry_list_t & to_schedule)
+{
+  // Pumps waiting for this connector can continue. If they finish, that is
+  // reported to callbacks on their source.
+  if (events & PEV_IO_WRITE) {
+    for (auto pump : m_pumps.waiting_for(conn)) {
+      auto report = run_pump(*pump);
+      if (!report) {
+        continue;
+      }
+
+      if (pump->m_source == conn) {
+        events |= report;
+      }
+      else {
+        auto callbacks = m_io_callbacks.copy_matching(pump->m_source, report);
+        to_schedule.insert(to_schedule.end(), callbacks.begin(),
+            callbacks.end());
+      }
+      stop_pump(m_pumps.remove(pump->m_source));
+    }
+  }
+
+  // If this connector is a pump's source, the pump consumes its readability.
+  auto pump = m_pumps.find(conn);
+  if (pump && (events & PEV_IO_READ)) {
+    events &= ~PEV_IO_READ;
+    if (pump->m_waiting) {
+      return events;
+    }
+    auto report = run_pump(*pump);
+    if (report) {
+      events |= report;
+      stop_pump(m_pumps.remove(conn));
+    }
+  }
+
+  return events;
+}
+
+
+
+events_t
+scheduler::scheduler_impl::run_pump(detail::pump_entry & pump)
+{
+  // Don't starve other connectors; the I/O subsystem reports the source
+  // again if more data is waiting.
+  for (size_t round = 0 ; round < PACKETEER_PUMP_ROUNDS ; ++round) {
+    size_t transferred = 0;
+    auto err = pump.m_source.splice_to(pump.m_destination,
+        PACKETEER_SPLICE_CHUNK_SIZE, transferred);
+    switch (err) {
+      case ERR_SUCCESS:
+        if (!transferred) {
+          DLOG("Pump source " << pump.m_source << " closed.");
+          return PEV_IO_CLOSE;
+        }
+        set_pump_waiting(pump, false);
+        break;
+
+      case ERR_REPEAT_ACTION:
+        set_pump_waiting(pump, false);
+        return 0;
+
+      case ERR_ASYNC:
+        set_pump_waiting(pump, true);
+        return 0;
+
+      case ERR_CONNECTION_ABORTED:
+        // Sockets are closed forcibly, so this is how peers usually leave.
+        DLOG("Pump connection closed.");
+        return PEV_IO_CLOSE;
+
+      default:
+        ET_LOG("Pump failed", err);
+        return PEV_IO_ERROR;
+    }
+  }
+  return 0;
+}
+
+
+
+void
+scheduler::scheduler_impl::set_pump_waiting(detail::pump_entry & pump,
+    bool waiting)
+{
+  if (pump.m_waiting == waiting) {
+    return;
+  }
+
+  // While waiting for the destination, stop reading from the source. The
+  // pump owns the source's read interest, even if callbacks want it, too.
+  m_pumps.set_waiting(pump, waiting);
+  if (waiting) {
+    m_io->register_connector(pump.m_destination, PEV_IO_WRITE);
+    m_io->unregister_connector(pump.m_source, PEV_IO_READ);
+  }
+  else {
+    release_write_interest(pump.m_destination);
+    m_io->register_connector(pump.m_source, PEV_IO_READ);
+  }
+}
+
+
+
+void
+scheduler::scheduler_impl::stop_pump(detail::pump_entry * pump)
+{
+  if (!pump) {
+    return;
+  }
+
+  // m_pumps no longer knows the pump, so it does not count as waiting.
+  if (pump->m_waiting) {
+    release_write_interest(pump->m_destination);
+  }
+
+  // Hand read interest in the source back to a reader or callbacks.
+  auto reader = m_readers.find(pump->m_source);
+  bool wanted = reader ? !reader->m_in_flight
+    : (m_io_callbacks.registered_events(pump->m_source)
+        & ~held_io_events(pump->m_source) & PEV_IO_READ);
+  if (wanted) {
+    m_io->register_connector(pump->m_source, PEV_IO_READ);
+  }
+  else if (!pump->m_waiting) {
+    m_io->unregister_connector(pump->m_source, PEV_IO_READ);
+  }
+  delete pump;
+}
+
+
+
+error_t
+scheduler::scheduler_impl::start_reading(connector const & conn,
+    data_callback const & callback)
+{
+  if (!conn || !callback) {
+    return ERR_INVALID_VALUE;
+  }
+  if (conn.is_blocking()) {
+    return ERR_INVALID_OPTION;
+  }
+  if (!conn.communicating()) {
+    return ERR_INVALID_VALUE;
+  }
+
+  m_in_queue.enqueue(CMD_ADD, new detail::reader_entry{conn, callback,
+      ++m_reader_ids});
+  m_in_queue.commit();
+  return ERR_SUCCESS;
+}
+
+
+
+error_t
+scheduler::scheduler_impl::stop_reading(connector const & conn)
+{
+  if (!conn) {
+    return ERR_INVALID_VALUE;
+  }
+
+  m_in_queue.enqueue(CMD_REMOVE, new detail::reader_entry{conn, {}, 0});
+  m_in_queue.commit();
+  return ERR_SUCCESS;
+}
+
+
+
+events_t
+scheduler::scheduler_impl::dispatch_readers(connector const & conn,
+    events_t events, entry_list_t & to_schedule)
+{
+  auto reader = m_readers.find(conn);
+  if (!reader) {
+    return events;
+  }
+
+  // The end of data or errors are discovered by reading, too.
+  bool wake = events & (PEV_IO_READ | PEV_IO_CLOSE | PEV_IO_ERROR);
+  events &= ~PEV_IO_READ;
+  if (!wake || reader->m_in_flight) {
+    return events;
+  }
+
+  // Only one worker reads at a time; the copy comes back through the
+  // command queue when it's done.
+  reader->m_in_flight = true;
+  m_io->unregister_connector(conn, PEV_IO_READ);
+  to_schedule.push_back(new detail::reader_entry{*reader});
+  return events;
+}
+
+
+
+void
+scheduler::scheduler_impl::stop_reader(detail::reader_entry * reader)
+{
+  if (!reader) {
+    return;
+  }
+
+  // Hand read interest back to a pump or callbacks.
+  auto pump = m_pumps.find(reader->m_connector);
+  bool wanted = pump ? !pump->m_waiting
+    : (m_io_callbacks.registered_events(reader->m_connector)
+        & ~held_io_events(reader->m_connector) & PEV_IO_READ);
+  if (wanted) {
+    m_io->register_connector(reader->m_connector, PEV_IO_READ);
+  }
+  else {
+    m_io->unregister_connector(reader->m_connector, PEV_IO_READ);
+  }
+  delete reader;
+}
+
+
+
 void
 scheduler::scheduler_impl::main_scheduler_loop()
   OCLINT_SUPPRESS("deep nested block")
@@ -660,12 +1904,77 @@ scheduler::scheduler_impl::wait_for_events(duration const & timeout,
 }
 
 
+/*****************************************************************************
+ * class thread_signal_mask
+ **/
+#if defined(PACKETEER_HAVE_SIGNALFD)
+void
+detail::thread_signal_mask::update(::sigset_t const & mask)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_mask = mask;
+  ++m_generation;
+}
+#endif // PACKETEER_HAVE_SIGNALFD
+
+
+
+void
+detail::thread_signal_mask::apply(size_t & applied)
+{
+  if (m_generation.load() == applied) {
+    return;
+  }
+
+#if defined(PACKETEER_HAVE_SIGNALFD)
+  std::lock_guard<std::mutex> lock(m_mutex);
+  ::pthread_sigmask(SIG_BLOCK, &m_mask, nullptr);
+#endif // PACKETEER_HAVE_SIGNALFD
+  applied = m_generation.load();
+}
+
+
 /*****************************************************************************
  * Free functions
  **/
 
 namespace {
 
+inline error_t
+run_reader(detail::reader_entry * reader)
+{
+  // Read into the pool of the thread we're running on; the callback takes
+  // ownership of the data.
+  auto & pool = detail::buffer_pool::local();
+  error_t result = ERR_SUCCESS;
+  for (size_t round = 0 ; round < PACKETEER_READ_ROUNDS ; ++round) {
+    buffer data;
+    auto err = pool.read(reader->m_connector, data);
+    if (ERR_ASYNC == err || ERR_REPEAT_ACTION == err) {
+      break;
+    }
+
+    events_t events = PEV_IO_READ;
+    if (ERR_SUCCESS != err) {
+      ET_LOG("Reader failed", err);
+      events = PEV_IO_ERROR;
+    }
+    else if (data.empty()) {
+      events = PEV_IO_CLOSE;
+    }
+
+    result = reader->m_data_callback(reader->m_timestamp, events,
+        &(reader->m_connector), std::move(data));
+    if (PEV_IO_READ != events) {
+      reader->m_events = events;
+      break;
+    }
+  }
+  return result;
+}
+
+
+
 inline error_t
 run_callback_type(detail::callback_entry * entry)
 {
@@ -676,6 +1985,10 @@ run_callback_type(detail::callback_entry * entry)
       err = entry->m_callback(entry->m_timestamp, PEV_TIMEOUT, nullptr);
       break;
 
+    case detail::CB_ENTRY_SIGNAL:
+      err = entry->m_callback(entry->m_timestamp, PEV_SIGNAL, nullptr);
+      break;
+
     case detail::CB_ENTRY_USER:
       {
         auto user = reinterpret_cast<detail::user_callback_entry *>(entry);
@@ -691,6 +2004,10 @@ run_callback_type(detail::callback_entry * entry)
       }
       break;
 
+    case detail::CB_ENTRY_READER:
+      err = run_reader(reinterpret_cast<detail::reader_entry *>(entry));
+      break;
+
     default:
       // Unknown type. Signal an error on the callback.
       err = entry->m_callback(entry->m_timestamp, PEV_ERROR, nullptr);
@@ -756,6 +2073,11 @@ drain_work_queue_loop(
     // the command queue.
     command_queue.enqueue(CMD_ADD, entry);
   }
+  else if (detail::CB_ENTRY_READER == entry->m_type) {
+    // Readers are resumed by the main loop; it must learn about it quickly.
+    command_queue.enqueue(CMD_TRIGGER, entry);
+    command_queue.commit();
+  }
   else {
     // We're done with this entry, delete it.
     delete entry;
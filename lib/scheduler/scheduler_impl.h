@@ -26,14 +26,22 @@
 #error You are trying to include a C++ only header file
 #endif
 
+#include <build-config.h>
+
 #include <packeteer/scheduler.h>
 
+#if defined(PACKETEER_HAVE_SIGNALFD)
+#include <signal.h>
+#endif
+
 #include <atomic>
 #include <vector>
 #include <chrono>
 #include <condition_variable>
 #include <mutex>
+#include <shared_mutex>
 #include <thread>
+#include <unordered_map>
 
 #include <liberate/concurrency/concurrent_queue.h>
 #include <liberate/concurrency/tasklet.h>
@@ -45,6 +53,7 @@
 #include "../command_queue.h"
 
 #include "io.h"
+#include "write_queue.h"
 
 namespace packeteer {
 
@@ -79,6 +88,9 @@ enum callback_type : int8_t
   CB_ENTRY_IO         = 0,
   CB_ENTRY_SCHEDULED  = 1,
   CB_ENTRY_USER       = 2,
+  CB_ENTRY_SIGNAL     = 3,
+  CB_ENTRY_PUMP       = 4,
+  CB_ENTRY_READER     = 5,
 };
 
 struct callback_entry
@@ -106,11 +118,37 @@ struct callback_entry
   virtual ~callback_entry() {}
 };
 
+
+// The signals that signal callbacks are registered for. Every thread the
+// scheduler runs must block them, or the kernel may deliver them to that
+// thread instead of the signal connector. Threads apply() the mask when they
+// start and whenever they wake up; the generation tells them whether it
+// changed since. Signals are never unblocked again.
+class thread_signal_mask
+{
+public:
+#if defined(PACKETEER_HAVE_SIGNALFD)
+  void update(::sigset_t const & mask);
+#endif
+
+  void apply(size_t & applied);
+
+private:
+#if defined(PACKETEER_HAVE_SIGNALFD)
+  std::mutex          m_mutex;
+  ::sigset_t          m_mask;
+#endif
+  std::atomic<size_t> m_generation = 0;
+};
+
 }} // namespace packeteer::detail
 
 #include "callbacks/io.h"
 #include "callbacks/scheduled.h"
 #include "callbacks/user_defined.h"
+#include "callbacks/signal.h"
+#include "callbacks/pump.h"
+#include "callbacks/reader.h"
 
 namespace packeteer {
 
@@ -130,6 +168,7 @@ enum command_type : int8_t
   CMD_ADD      = 0,
   CMD_REMOVE   = 1,
   CMD_TRIGGER  = 2,
+  CMD_REARM    = 3,
 };
 
 // The in queue is a command queue with associated signal
@@ -153,7 +192,7 @@ struct scheduler::scheduler_impl
    * Interface
    **/
   scheduler_impl(std::shared_ptr<api> api, ssize_t num_workers,
-      scheduler_type type);
+      scheduler_type type, dispatch_mode mode);
   ~scheduler_impl();
 
   /**
@@ -184,6 +223,35 @@ struct scheduler::scheduler_impl
    */
   void process_in_queue(entry_list_t & triggered);
 
+  /**
+   * See scheduler::enqueue_write() and friends.
+   **/
+  error_t enqueue_write(connector const & conn, void const * buf,
+      size_t bufsize);
+  error_t enqueue_write(connector const & conn, buffer data);
+  error_t set_write_watermarks(connector const & conn, size_t low_watermark,
+      size_t high_watermark, size_t notsent_lowat);
+  size_t write_queue_size(connector const & conn) const;
+
+  /**
+   * See scheduler::add_pump()
+   **/
+  error_t add_pump(connector const & source, connector const & destination);
+  error_t remove_pump(connector const & source);
+
+  /**
+   * See scheduler::start_reading()
+   **/
+  error_t start_reading(connector const & conn,
+      data_callback const & callback);
+  error_t stop_reading(connector const & conn);
+
+  /**
+   * See scheduler::poll_handle() and scheduler::next_deadline()
+   **/
+  handle poll_handle() const;
+  time_point next_deadline() const;
+
 private:
   /***************************************************************************
    * Generic private functions
@@ -198,12 +266,37 @@ private:
   // Main loop
   void main_scheduler_loop();
 
+  // Leader/follower mode; starting replaces any running threads.
+  void start_followers(ssize_t num_workers);
+  void stop_followers();
+  void leader_follower_loop();
+
+  // Level-triggered events would be reported again to the next leader while
+  // a follower still runs the callbacks for them, so the connector is held
+  // until they return. Where the I/O subsystem supports one-shot mode, the
+  // kernel disables reported descriptors, and the follower re-arms them
+  // itself. Otherwise, the leader drops the callbacks' interest, and
+  // CMD_REARM hands it back.
+  void hold_io(connector const & conn,
+      std::vector<detail::io_callback_entry *> const & callbacks);
+  void release_io(connector const & conn);
+  void rearm_held_io(connector const & conn);
+  void restore_held_io();
+  events_t held_io_events(connector const & conn) const;
+  void unregister_held(connector const & conn, events_t events);
+
   inline void process_in_queue_io(command_type command,
-      detail::io_callback_entry * entry);
+      detail::io_callback_entry * entry, entry_list_t & triggered);
   inline void process_in_queue_scheduled(command_type command,
       detail::scheduled_callback_entry * entry);
   inline void process_in_queue_user(command_type command,
       detail::user_callback_entry * entry, entry_list_t & triggered);
+  inline void process_in_queue_signal(command_type command,
+      detail::signal_callback_entry * entry);
+  inline void process_in_queue_pump(command_type command,
+      detail::pump_entry * entry);
+  inline void process_in_queue_reader(command_type command,
+      detail::reader_entry * entry);
 
   inline void dispatch_io_callbacks(detail::io_events const & events,
       entry_list_t & to_schedule);
@@ -211,6 +304,54 @@ private:
       time_point const & now, entry_list_t & to_schedule);
   inline void dispatch_user_callbacks(entry_list_t const & triggered,
       entry_list_t & to_schedule);
+  inline void dispatch_signal_callbacks(entry_list_t & to_schedule);
+  inline events_t dispatch_pumps(connector const & conn, events_t events,
+      entry_list_t & to_schedule);
+  inline events_t dispatch_readers(connector const & conn, events_t events,
+      entry_list_t & to_schedule);
+
+  // Update the signal connector's mask to match the registered signal
+  // callbacks; the connector is created and registered with the I/O
+  // subsystem when the first signal is added.
+  void update_signal_mask();
+
+  // Write queues; get_write_queue() creates one if necessary,
+  // find_write_queue() does not.
+  std::shared_ptr<detail::write_queue> get_write_queue(
+      connector const & conn);
+  std::shared_ptr<detail::write_queue> find_write_queue(
+      connector const & conn) const;
+  void remove_write_queue(connector const & conn);
+
+  // The map holds a copy of the connector, so queues must not outlive their
+  // use. Drop the queue if it is drained, has no watermarks set, and nobody
+  // else refers to it; it is re-created by the next enqueue_write().
+  void prune_write_queue(connector const & conn);
+
+  // Check whether enqueue_write() may write, and push data to the queue via
+  // push. Then flush it right away if possible.
+  template <typename pushT>
+  error_t enqueue_and_flush(connector const & conn, pushT && push);
+
+  // Flush the write queue from the main loop, which must own it. Updates
+  // write interest as necessary, and returns any events to report.
+  events_t flush_write_queue(connector const & conn,
+      detail::write_queue & queue);
+
+  // Drop write interest in the connector, unless a callback, write queue or
+  // pump still needs it.
+  void release_write_interest(connector const & conn);
+
+  // Forward data for a pump until the source is drained or the destination
+  // blocks. Returns PEV_IO_CLOSE or PEV_IO_ERROR if the pump is finished.
+  events_t run_pump(detail::pump_entry & pump);
+  void set_pump_waiting(detail::pump_entry & pump, bool waiting);
+
+  // Unregister a pump that was removed from m_pumps, and delete it.
+  void stop_pump(detail::pump_entry * pump);
+
+  // Unregister a reader that was removed from m_readers, and delete it.
+  void stop_reader(detail::reader_entry * reader);
 
 
   /***************************************************************************
@@ -237,6 +378,33 @@ private:
   std::thread                     m_main_loop_thread;
   connector                       m_main_loop_pipe;
 
+  // Leader/follower state. The thread that sets m_has_leader acts as the
+  // main loop; all other threads in m_followers wait on the condition for it
+  // to step down.
+  dispatch_mode                   m_dispatch_mode;
+  std::mutex                      m_leader_mutex;
+  std::condition_variable         m_leader_condition;
+  bool                            m_has_leader = false;
+  std::vector<std::thread>        m_followers;
+
+  // Signals all of the above threads block.
+  detail::thread_signal_mask      m_signal_mask;
+
+  // Set while leader/follower threads run, and whether the I/O subsystem
+  // holds connectors for them in one-shot mode.
+  bool                            m_oneshot = false;
+  bool                            m_native_oneshot = false;
+
+  // Without one-shot mode, the read or write interest the leader dropped per
+  // connector, and the number of dispatched callbacks holding it. Only the
+  // leader or main loop touches this.
+  struct held_io
+  {
+    events_t  events = 0;
+    size_t    holders = 0;
+  };
+  std::unordered_map<connector, held_io> m_held_io;
+
   // We use a weird scheme for moving things to/from the internal containers
   // defined above.
   // - There's an in-queue that scheduler's public functions write to. The
@@ -260,6 +428,23 @@ private:
   detail::io_callbacks_t          m_io_callbacks;
   detail::scheduled_callbacks_t   m_scheduled_callbacks;
   detail::user_callbacks_t        m_user_callbacks;
+  detail::signal_callbacks_t      m_signal_callbacks;
+  detail::pumps_t                 m_pumps;
+  detail::readers_t               m_readers;
+  std::atomic<size_t>             m_reader_ids = 0;
+
+  // Signals are read from this connector, if any are registered.
+  connector                       m_signal_connector;
+
+  // Write queues are looked up from any thread, but only added or removed
+  // rarely, so a shared lock on the map is sufficient. Appending to the
+  // queue itself is lock-free.
+  using write_queues_t = std::unordered_map<
+    connector,
+    std::shared_ptr<detail::write_queue>
+  >;
+  mutable std::shared_mutex       m_write_queues_mutex;
+  write_queues_t                  m_write_queues;
 
   // IO subsystem
   detail::io *                    m_io;
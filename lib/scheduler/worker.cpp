@@ -45,13 +45,15 @@ using namespace std::placeholders;
 worker::worker(
     liberate::concurrency::tasklet::sleep_condition * condition,
     work_queue_t & work_queue,
-    scheduler_command_queue_t & command_queue)
+    scheduler_command_queue_t & command_queue,
+    thread_signal_mask & signal_mask)
   : liberate::concurrency::tasklet{
       std::bind(&worker::worker_loop, this, _1),
       condition
     }
   , m_work_queue(work_queue)
   , m_command_queue(command_queue)
+  , m_signal_mask(signal_mask)
 {
 }
 
@@ -67,8 +69,10 @@ void
 worker::worker_loop(liberate::concurrency::tasklet::context & ctx)
 {
   DLOG("Worker " << std::this_thread::get_id() << " started");
+  size_t mask_applied = 0;
   do {
     DLOG("Worker " << std::this_thread::get_id() << " woke up");
+    m_signal_mask.apply(mask_applied);
     drain_work_queue(m_work_queue, false, m_command_queue);
     DLOG("Worker " << std::this_thread::get_id() << " going to sleep");
   } while (ctx.sleep());
@@ -49,12 +49,14 @@ public:
    **/
   /**
    * The worker thread sleeps waiting for an event on the condition, and wakes
-   * up to check the work queue for work to execute.
+   * up to check the work queue for work to execute. It also blocks the
+   * signals in the signal mask whenever that changes.
    **/
   worker(
       liberate::concurrency::tasklet::sleep_condition * condition,
       work_queue_t & work_queue,
-      scheduler_command_queue_t & command_queue);
+      scheduler_command_queue_t & command_queue,
+      thread_signal_mask & signal_mask);
   ~worker();
 
 
@@ -66,6 +68,7 @@ private:
 
   work_queue_t &              m_work_queue;
   scheduler_command_queue_t & m_command_queue;
+  thread_signal_mask &        m_signal_mask;
 };
 
 } // namespace packeteer::detail
@@ -0,0 +1,552 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <build-config.h>
+
+#include "write_queue.h"
+
+#include <cstring>
+#include <new>
+
+#if defined(PACKETEER_HAVE_SYS_UIO_H)
+#include <sys/uio.h>
+#endif
+
+#if defined(PACKETEER_HAVE_NETINET_TCP_H)
+#include <netinet/tcp.h>
+#endif
+
+#include "../globals.h"
+#include "../macros.h"
+#include "../net/netincludes.h"
+
+namespace packeteer::detail {
+
+/**
+ * Nodes are allocated with their payload directly following them in memory,
+ * so each push() costs a single allocation. Pushed buffers are referenced
+ * instead.
+ **/
+struct write_queue::node
+{
+  std::atomic<node *> next = nullptr;
+  size_t              size = 0;
+  size_t              offset = 0;
+  buffer              held = {};
+
+  inline char * data()
+  {
+    if (held) {
+      return const_cast<char *>(static_cast<char const *>(held.data()));
+    }
+    return reinterpret_cast<char *>(this + 1);
+  }
+
+  static node * create(void const * buf, size_t bufsize)
+  {
+    void * mem = ::operator new(sizeof(node) + bufsize);
+    auto ret = new (mem) node{};
+    ret->size = bufsize;
+    if (bufsize) {
+      std::memcpy(ret->data(), buf, bufsize);
+    }
+    return ret;
+  }
+
+  static node * create(buffer && data)
+  {
+    void * mem = ::operator new(sizeof(node));
+    auto ret = new (mem) node{};
+    ret->size = data.size();
+    ret->held = std::move(data);
+    return ret;
+  }
+
+  static void destroy(node * n)
+  {
+    n->~node();
+    ::operator delete(n);
+  }
+};
+
+
+namespace {
+
+#if defined(PACKETEER_HAVE_SYS_UIO_H)
+inline error_t
+translate_write_errno()
+{
+  switch (errno) {
+    case EAGAIN:
+#if EAGAIN != EWOULDBLOCK
+    case EWOULDBLOCK:
+#endif
+    case ENOBUFS:
+      return ERR_REPEAT_ACTION;
+
+    case EBADF:
+    case EINVAL:
+    case EDESTADDRREQ:
+    case ENOTSOCK:
+      return ERR_INVALID_VALUE;
+
+    case ENOTCONN:
+      return ERR_NO_CONNECTION;
+
+    case ECONNRESET:
+    case EPIPE:
+      return ERR_CONNECTION_ABORTED;
+
+    case ECONNREFUSED:
+      return ERR_CONNECTION_REFUSED;
+
+    case EFAULT:
+      return ERR_ACCESS_VIOLATION;
+
+    case EFBIG:
+    case ENOSPC:
+    case ENOMEM:
+      return ERR_OUT_OF_MEMORY;
+
+    case EMSGSIZE:
+      return ERR_INVALID_VALUE;
+
+    default:
+      return ERR_UNEXPECTED;
+  }
+}
+#endif // PACKETEER_HAVE_SYS_UIO_H
+
+} // anonymous namespace
+
+
+
+write_queue::write_queue()
+  : m_head{nullptr}
+  , m_tail{nullptr}
+  , m_stub{node::create(nullptr, 0)}
+{
+  m_head = m_stub;
+  m_tail = m_stub;
+}
+
+
+
+write_queue::~write_queue()
+{
+  clear();
+  node::destroy(m_stub);
+}
+
+
+
+size_t
+write_queue::push(void const * buf, size_t bufsize)
+{
+  return push_node(node::create(buf, bufsize));
+}
+
+
+
+size_t
+write_queue::push(buffer && data)
+{
+  return push_node(node::create(std::move(data)));
+}
+
+
+
+size_t
+write_queue::push_node(node * n)
+{
+  // Count the bytes before publishing the node. Otherwise a consumer could
+  // flush the node and subtract its size first, and the count would wrap.
+  // The consumer copes with bytes it cannot collect yet; see flush().
+  auto size = n->size;
+  auto bytes = m_bytes.fetch_add(size, std::memory_order_acq_rel) + size;
+
+  node * prev = m_head.exchange(n, std::memory_order_acq_rel);
+  prev->next.store(n, std::memory_order_release);
+
+  return bytes;
+}
+
+
+
+bool
+write_queue::acquire()
+{
+  bool expected = false;
+  return m_owned.compare_exchange_strong(expected, true,
+      std::memory_order_acq_rel);
+}
+
+
+
+bool
+write_queue::release()
+{
+  m_owned.store(false, std::memory_order_release);
+
+  // If nothing is pending, we're done. If there is data, someone pushed it
+  // after our last flush, and may have seen us still owning the queue. So we
+  // need to take ownership back - unless they were faster.
+  if (!m_bytes.load(std::memory_order_acquire)) {
+    return true;
+  }
+  return !acquire();
+}
+
+
+
+void
+write_queue::collect()
+{
+  // This is the consumer half of Dmitry Vyukov's intrusive MPSC queue. The
+  // stub node is re-inserted whenever the queue runs dry, which means that
+  // whatever precedes it can be detached.
+  while (true) {
+    node * tail = m_tail;
+    node * next = tail->next.load(std::memory_order_acquire);
+
+    if (tail == m_stub) {
+      if (!next) {
+        return;
+      }
+      m_tail = next;
+      tail = next;
+      next = next->next.load(std::memory_order_acquire);
+    }
+
+    if (next) {
+      m_tail = next;
+      m_pending.push_back(tail);
+      continue;
+    }
+
+    if (tail != m_head.load(std::memory_order_acquire)) {
+      // A producer is in the middle of linking a node; we'll pick it up on
+      // the next flush.
+      return;
+    }
+
+    m_stub->next.store(nullptr, std::memory_order_relaxed);
+    node * prev = m_head.exchange(m_stub, std::memory_order_acq_rel);
+    prev->next.store(m_stub, std::memory_order_release);
+
+    next = tail->next.load(std::memory_order_acquire);
+    if (!next) {
+      return;
+    }
+    m_tail = next;
+    m_pending.push_back(tail);
+  }
+}
+
+
+
+void
+write_queue::consume(size_t amount)
+{
+  m_bytes.fetch_sub(amount, std::memory_order_acq_rel);
+
+  while (amount && !m_pending.empty()) {
+    auto n = m_pending.front();
+    auto remaining = n->size - n->offset;
+    if (amount < remaining) {
+      n->offset += amount;
+      return;
+    }
+
+    amount -= remaining;
+    m_pending.pop_front();
+    node::destroy(n);
+  }
+}
+
+
+
+error_t
+write_queue::flush(connector & conn)
+{
+  error_t err = ERR_SUCCESS;
+  while (true) {
+    collect();
+
+    if (conn.get_options() & CO_DATAGRAM) {
+      err = flush_datagram(conn);
+    }
+    else {
+      err = flush_stream(conn);
+    }
+
+    if (ERR_SUCCESS != err || !m_bytes.load(std::memory_order_acquire)) {
+      break;
+    }
+
+    // Data was pushed after we last looked. If a producer is still in the
+    // middle of linking its node, we can't see it yet; report that we'd like
+    // to be called again.
+    collect();
+    if (m_pending.empty()) {
+      return ERR_REPEAT_ACTION;
+    }
+  }
+
+  // Connectors report a full buffer as ERR_ASYNC; that is no reason to drop
+  // the queue.
+  if (ERR_ASYNC == err) {
+    err = ERR_REPEAT_ACTION;
+  }
+
+  if (ERR_SUCCESS != err && ERR_REPEAT_ACTION != err) {
+    ET_LOG("Flushing write queue failed, discarding pending data", err);
+    clear();
+  }
+  return err;
+}
+
+
+
+error_t
+write_queue::flush_stream(connector & conn)
+{
+  while (!m_pending.empty()) {
+#if defined(PACKETEER_HAVE_SYS_UIO_H)
+    // Gather as many buffers as we can into a single writev() call.
+    ::iovec iov[PACKETEER_WRITE_QUEUE_IOV_MAX];
+    int count = 0;
+    size_t total = 0;
+    for (auto n : m_pending) {
+      if (count >= PACKETEER_WRITE_QUEUE_IOV_MAX) {
+        break;
+      }
+      iov[count].iov_base = n->data() + n->offset;
+      iov[count].iov_len = n->size - n->offset;
+      total += iov[count].iov_len;
+      ++count;
+    }
+
+    ssize_t written = ::writev(conn.get_write_handle().sys_handle(), iov,
+        count);
+    if (written < 0) {
+      if (EINTR == errno) {
+        continue;
+      }
+      auto err = translate_write_errno();
+      if (ERR_REPEAT_ACTION != err) {
+        ERRNO_LOG("writev() failed");
+      }
+      return err;
+    }
+
+    consume(written);
+    if (static_cast<size_t>(written) < total) {
+      // The connector accepted less than we offered; it would block.
+      return ERR_REPEAT_ACTION;
+    }
+#else
+    auto n = m_pending.front();
+    size_t written = 0;
+    auto err = conn.write(n->data() + n->offset, n->size - n->offset,
+        written);
+    if (ERR_ASYNC == err || ERR_REPEAT_ACTION == err) {
+      return ERR_REPEAT_ACTION;
+    }
+    if (ERR_SUCCESS != err) {
+      return err;
+    }
+
+    consume(written);
+    if (written < n->size - n->offset) {
+      return ERR_REPEAT_ACTION;
+    }
+#endif
+
+    collect();
+  }
+
+  return ERR_SUCCESS;
+}
+
+
+
+error_t
+write_queue::flush_datagram(connector & conn)
+{
+  // Each queued buffer is a message of its own.
+  while (!m_pending.empty()) {
+#if defined(PACKETEER_HAVE_SENDMMSG)
+    ::mmsghdr msgs[PACKETEER_WRITE_QUEUE_IOV_MAX];
+    ::iovec iov[PACKETEER_WRITE_QUEUE_IOV_MAX];
+    std::memset(msgs, 0, sizeof(msgs));
+
+    unsigned int count = 0;
+    for (auto n : m_pending) {
+      if (count >= PACKETEER_WRITE_QUEUE_IOV_MAX) {
+        break;
+      }
+      iov[count].iov_base = n->data();
+      iov[count].iov_len = n->size;
+      msgs[count].msg_hdr.msg_iov = &iov[count];
+      msgs[count].msg_hdr.msg_iovlen = 1;
+      ++count;
+    }
+
+    int sent = ::sendmmsg(conn.get_write_handle().sys_handle(), msgs, count,
+        MSG_DONTWAIT);
+    if (sent < 0) {
+      if (EINTR == errno) {
+        continue;
+      }
+      if (ENOTSOCK != errno) {
+        auto err = translate_write_errno();
+        if (ERR_REPEAT_ACTION != err) {
+          ERRNO_LOG("sendmmsg() failed");
+        }
+        return err;
+      }
+      // Not a socket; fall through to plain writes below.
+    }
+    else {
+      size_t amount = 0;
+      for (int i = 0 ; i < sent ; ++i) {
+        amount += m_pending[i]->size;
+      }
+      consume(amount);
+      if (static_cast<unsigned int>(sent) < count) {
+        return ERR_REPEAT_ACTION;
+      }
+      collect();
+      continue;
+    }
+#endif
+
+    auto n = m_pending.front();
+    size_t written = 0;
+    auto err = conn.write(n->data(), n->size, written);
+    if (ERR_ASYNC == err || ERR_REPEAT_ACTION == err) {
+      return ERR_REPEAT_ACTION;
+    }
+    if (ERR_SUCCESS != err) {
+      return err;
+    }
+
+    // Datagrams are either written in full or not at all.
+    consume(n->size);
+    collect();
+  }
+
+  return ERR_SUCCESS;
+}
+
+
+
+void
+write_queue::clear()
+{
+  collect();
+
+  size_t amount = 0;
+  for (auto n : m_pending) {
+    amount += n->size - n->offset;
+    node::destroy(n);
+  }
+  m_pending.clear();
+
+  m_bytes.fetch_sub(amount, std::memory_order_acq_rel);
+}
+
+
+
+void
+write_queue::set_watermarks(size_t low, size_t high)
+{
+  m_low = low;
+  m_high = high;
+}
+
+
+
+events_t
+write_queue::check_watermarks()
+{
+  size_t high = m_high.load(std::memory_order_acquire);
+  if (!high) {
+    return 0;
+  }
+
+  size_t bytes = m_bytes.load(std::memory_order_acquire);
+  if (bytes >= high) {
+    if (!m_above_high.exchange(true, std::memory_order_acq_rel)) {
+      return PEV_IO_HIGH_WATERMARK;
+    }
+  }
+  else if (bytes <= m_low.load(std::memory_order_acquire)) {
+    if (m_above_high.exchange(false, std::memory_order_acq_rel)) {
+      return PEV_IO_LOW_WATERMARK;
+    }
+  }
+  return 0;
+}
+
+
+
+error_t
+write_queue::set_notsent_lowat(connector const & conn, size_t lowat)
+{
+#if defined(TCP_NOTSENT_LOWAT)
+  switch (conn.type()) {
+    case CT_TCP4:
+    case CT_TCP6:
+    case CT_TCP:
+      break;
+
+    default:
+      return ERR_INVALID_OPTION;
+  }
+
+  int value = static_cast<int>(lowat);
+  int ret = ::setsockopt(conn.get_write_handle().sys_handle(), IPPROTO_TCP,
+      TCP_NOTSENT_LOWAT, &value, sizeof(value));
+  if (ret >= 0) {
+    return ERR_SUCCESS;
+  }
+
+  ERRNO_LOG("Could not set TCP_NOTSENT_LOWAT");
+  switch (errno) {
+    case EBADF:
+    case ENOTSOCK:
+    case EINVAL:
+      return ERR_INVALID_VALUE;
+
+    case ENOPROTOOPT:
+      return ERR_UNSUPPORTED_ACTION;
+
+    default:
+      return ERR_UNEXPECTED;
+  }
+#else
+  (void) conn;
+  (void) lowat;
+  return ERR_UNSUPPORTED_ACTION;
+#endif
+}
+
+} // namespace packeteer::detail
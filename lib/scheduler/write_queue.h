@@ -0,0 +1,177 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef PACKETEER_SCHEDULER_WRITE_QUEUE_H
+#define PACKETEER_SCHEDULER_WRITE_QUEUE_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <packeteer.h>
+
+#include <build-config.h>
+
+#include <atomic>
+#include <deque>
+
+#include <packeteer/buffer.h>
+#include <packeteer/connector.h>
+#include <packeteer/scheduler/events.h>
+
+namespace packeteer::detail {
+
+/**
+ * The write_queue holds outbound data for a single connector.
+ *
+ * Any number of threads may push() to the queue; the queue itself is an
+ * intrusive, lock-free multi-producer/single-consumer list. At most one
+ * thread at a time flushes the queue to the connector. Which thread that is
+ * gets decided by the ownership flag: whoever manages to acquire() the queue
+ * is the consumer until they release() it again.
+ *
+ * The intended protocol is:
+ * - A producer push()es data, then tries to acquire() the queue. If that
+ *   succeeds, it may flush() directly.
+ * - If flush() would block, ownership is handed to the scheduler's main
+ *   loop, which registers write interest and keeps flushing whenever the
+ *   connector becomes writable.
+ * - Whoever drains the queue calls release(). That returns false if more
+ *   data arrived in the meantime and ownership was re-acquired; in that case
+ *   the caller must continue flushing.
+ *
+ * The queue also tracks the number of pending bytes, and whether this number
+ * has crossed the high or low watermark.
+ **/
+class PACKETEER_PRIVATE write_queue
+{
+public:
+  write_queue();
+  ~write_queue();
+
+  /**
+   * Copy the buffer into the queue. Returns the number of bytes queued
+   * after the push. Safe to call from any thread.
+   **/
+  size_t push(void const * buf, size_t bufsize);
+
+  /**
+   * As above, but the queue keeps a reference to the buffer rather than
+   * copying its contents.
+   **/
+  size_t push(buffer && data);
+
+  /**
+   * Try to become the consumer; returns true on success. Safe to call from
+   * any thread.
+   **/
+  bool acquire();
+
+  /**
+   * Give up being the consumer. If new data was pushed in the meantime,
+   * ownership is re-acquired and false is returned.
+   **/
+  bool release();
+
+  /**
+   * Flush as much of the queue as the connector accepts. Only the consumer
+   * may call this.
+   *
+   * Returns ERR_SUCCESS if the queue was drained, ERR_REPEAT_ACTION if the
+   * connector would block, or another error if writing failed. In the last
+   * case, the pending data is discarded.
+   **/
+  error_t flush(connector & conn);
+
+  /**
+   * Discard all pending data. Only the consumer may call this.
+   **/
+  void clear();
+
+  /**
+   * Pending bytes; may be slightly out of date with respect to concurrent
+   * push() calls.
+   **/
+  inline size_t size() const
+  {
+    return m_bytes;
+  }
+
+  /**
+   * Watermarks. A high watermark of zero disables watermark events.
+   **/
+  void set_watermarks(size_t low, size_t high);
+
+  inline bool has_watermarks() const
+  {
+    return m_high.load(std::memory_order_acquire);
+  }
+
+  /**
+   * Check whether the queue crossed the high or low watermark since the last
+   * call. Returns PEV_IO_HIGH_WATERMARK, PEV_IO_LOW_WATERMARK or zero. Each
+   * crossing is reported exactly once.
+   **/
+  events_t check_watermarks();
+
+  /**
+   * Set TCP_NOTSENT_LOWAT on the connector's write handle, where supported.
+   * The kernel then reports writability only when fewer than the given
+   * number of bytes are unsent, which keeps data in this queue rather than
+   * in the socket buffer - and makes the watermarks above meaningful.
+   **/
+  static error_t set_notsent_lowat(connector const & conn, size_t lowat);
+
+  /**
+   * Whether the scheduler has registered PEV_IO_WRITE with the I/O subsystem
+   * on behalf of this queue. Only touched by the scheduler's main loop.
+   **/
+  bool                    m_interest = false;
+
+private:
+  struct node;
+
+  size_t push_node(node * n);
+
+  // Move everything producers have linked so far into m_pending.
+  void collect();
+
+  error_t flush_stream(connector & conn);
+  error_t flush_datagram(connector & conn);
+
+  void consume(size_t amount);
+
+  // Producer side.
+  std::atomic<node *>     m_head;
+  // Consumer side.
+  node *                  m_tail;
+  node *                  m_stub;
+  std::deque<node *>      m_pending;
+
+  std::atomic<size_t>     m_bytes = 0;
+  std::atomic<bool>       m_owned = false;
+
+  std::atomic<size_t>     m_low = 0;
+  std::atomic<size_t>     m_high = 0;
+  std::atomic<bool>       m_above_high = false;
+};
+
+} // namespace packeteer::detail
+
+#endif // guard
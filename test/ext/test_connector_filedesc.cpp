@@ -22,6 +22,9 @@
 #include <packeteer/ext/connector/filedesc.h>
 #include <packeteer/connector.h>
 
+#include <stdlib.h>
+#include <unistd.h>
+
 namespace p7r = packeteer;
 
 TEST(ExtConnectorFileDesc, raise_without_registration)
@@ -74,5 +77,40 @@ TEST(ExtConnectorFileDesc, duplicate_anon)
   ASSERT_EQ("Hello, world!", res);
 }
 
+TEST(ExtConnectorFileDesc, splice_from_file)
+{
+  auto api = packeteer::api::create();
+  p7r::ext::register_connector_filedesc(api);
+
+  char path[] = "/tmp/packeteer-splice-XXXXXX";
+  int file = ::mkstemp(path);
+  ASSERT_GE(file, 0);
+  ::unlink(path);
+
+  std::string content{"Hello, world!"};
+  ASSERT_EQ(static_cast<ssize_t>(content.length()),
+      ::write(file, content.c_str(), content.length()));
+  ASSERT_EQ(0, ::lseek(file, 0, SEEK_SET));
+
+  auto fd = p7r::connector{api, "fd:///" + std::to_string(file)
+    + "?blocking=true"};
+  auto anon = p7r::connector{api, "anon://?blocking=true"};
+  anon.connect();
+
+  // The whole file gets forwarded, then the end is reported.
+  size_t transferred = 0;
+  ASSERT_EQ(p7r::ERR_SUCCESS, fd.splice_to(anon, 100, transferred));
+  ASSERT_EQ(content.length(), transferred);
+  ASSERT_EQ(p7r::ERR_SUCCESS, fd.splice_to(anon, 100, transferred));
+  ASSERT_EQ(0, transferred);
+
+  char rb[200] = { 0 };
+  size_t did_read = 0;
+  ASSERT_EQ(p7r::ERR_SUCCESS, anon.read(rb, sizeof(rb), did_read));
+  ASSERT_EQ(content, std::string(rb, rb + did_read));
+
+  ::close(file);
+}
+
 // TODO test with wrapping a pipe descriptor; we should
 // just be able to use them interchangeably
@@ -0,0 +1,154 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <build-config.h>
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <thread>
+
+#include "../env.h"
+
+#include "../../lib/scheduler/buffer_pool.h"
+
+namespace p7r = packeteer;
+namespace pd = packeteer::detail;
+
+namespace {
+
+void
+write_string(p7r::connector & conn, char const * str)
+{
+  size_t amount = 0;
+  ASSERT_EQ(p7r::ERR_SUCCESS, conn.write(str, std::strlen(str), amount));
+  ASSERT_EQ(std::strlen(str), amount);
+}
+
+} // anonymous namespace
+
+
+TEST(BufferPool, slices_share_blocks)
+{
+  auto pool = pd::buffer_pool::create(64 * 1024, 2);
+  p7r::connector conn{test_env->api, "anon://"};
+  ASSERT_EQ(p7r::ERR_SUCCESS, conn.connect());
+
+  write_string(conn, "hello");
+  p7r::buffer first;
+  ASSERT_EQ(p7r::ERR_SUCCESS, pool->read(conn, first));
+  ASSERT_EQ(5, first.size());
+  ASSERT_EQ(0, std::memcmp("hello", first.data(), 5));
+
+  write_string(conn, "world");
+  p7r::buffer second;
+  ASSERT_EQ(p7r::ERR_SUCCESS, pool->read(conn, second));
+  ASSERT_EQ(5, second.size());
+  ASSERT_EQ(0, std::memcmp("world", second.data(), 5));
+
+  // Both reads fit into the same block, without overlapping.
+  ASSERT_EQ(1, pool->used_blocks());
+  ASSERT_LE(static_cast<char const *>(first.data()) + first.size(),
+      static_cast<char const *>(second.data()));
+
+  // Nothing to read.
+  p7r::buffer third;
+  ASSERT_EQ(p7r::ERR_ASYNC, pool->read(conn, third));
+  ASSERT_TRUE(third.empty());
+
+  // The block outlives the pool's owner, and is freed with the last buffer.
+  pool->detach();
+  first.reset();
+  ASSERT_EQ(0, std::memcmp("world", second.data(), 5));
+  second.reset();
+}
+
+
+
+TEST(BufferPool, recycling)
+{
+  // Blocks that can't hold the minimum read size are only used once.
+  auto pool = pd::buffer_pool::create(1024, 1);
+  p7r::connector conn{test_env->api, "anon://"};
+  ASSERT_EQ(p7r::ERR_SUCCESS, conn.connect());
+
+  std::vector<p7r::buffer> bufs;
+  for (int i = 0 ; i < 3 ; ++i) {
+    write_string(conn, "test");
+    p7r::buffer buf;
+    ASSERT_EQ(p7r::ERR_SUCCESS, pool->read(conn, buf));
+    bufs.push_back(std::move(buf));
+  }
+  ASSERT_EQ(3, pool->used_blocks());
+  ASSERT_EQ(0, pool->free_blocks());
+
+  // The last block is still held by the pool itself; the others are kept
+  // for reuse up to the limit.
+  bufs.clear();
+  ASSERT_EQ(1, pool->used_blocks());
+  ASSERT_EQ(1, pool->free_blocks());
+
+  // The next read moves on to the free block.
+  write_string(conn, "again");
+  p7r::buffer buf;
+  ASSERT_EQ(p7r::ERR_SUCCESS, pool->read(conn, buf));
+  ASSERT_EQ(1, pool->used_blocks());
+  ASSERT_EQ(0, pool->free_blocks());
+
+  pool->detach();
+}
+
+
+
+TEST(Buffer, copy_move_and_slice)
+{
+  auto pool = pd::buffer_pool::create(64 * 1024, 2);
+  p7r::connector conn{test_env->api, "anon://"};
+  ASSERT_EQ(p7r::ERR_SUCCESS, conn.connect());
+
+  write_string(conn, "hello, world");
+  p7r::buffer buf;
+  ASSERT_EQ(p7r::ERR_SUCCESS, pool->read(conn, buf));
+  ASSERT_EQ(12, buf.size());
+
+  auto copy = buf;
+  ASSERT_EQ(buf.data(), copy.data());
+
+  auto moved = std::move(copy);
+  ASSERT_TRUE(copy.empty());
+  ASSERT_EQ(buf.data(), moved.data());
+
+  auto world = buf.slice(7);
+  ASSERT_EQ(5, world.size());
+  ASSERT_EQ(0, std::memcmp("world", world.data(), 5));
+  ASSERT_EQ(3, buf.slice(7, 3).size());
+  ASSERT_TRUE(buf.slice(12).empty());
+
+  // Releasing buffers in another thread is fine.
+  std::thread releaser([b = std::move(buf), m = std::move(moved)]() mutable
+  {
+    b.reset();
+    m.reset();
+  });
+  releaser.join();
+  ASSERT_EQ(1, pool->used_blocks());
+
+  world.reset();
+  pool->detach();
+}
@@ -34,6 +34,10 @@
 
 #include "../lib/connector/util.h"
 
+#if defined(PACKETEER_POSIX)
+#include "../lib/connector/posix/tunables.h"
+#endif
+
 namespace p7r = packeteer;
 
 TEST(ConnectorUtil, sanitize_options_good)
@@ -74,6 +78,33 @@ TEST(ConnectorUtil, sanitize_options_good)
 
 
 
+TEST(ConnectorUtil, sanitize_options_other_flags)
+{
+  auto defaults = p7r::CO_BLOCKING|p7r::CO_DATAGRAM;
+  auto possible = p7r::CO_DATAGRAM|p7r::CO_BLOCKING|p7r::CO_NON_BLOCKING
+    |p7r::CO_UDP_GRO;
+
+  // Supported flags are kept
+  {
+    auto sanitized = p7r::detail::sanitize_options(
+        p7r::CO_NON_BLOCKING|p7r::CO_UDP_GRO, defaults, possible);
+    ASSERT_TRUE(p7r::CO_NON_BLOCKING & sanitized);
+    ASSERT_TRUE(p7r::CO_DATAGRAM & sanitized);
+    ASSERT_TRUE(p7r::CO_UDP_GRO & sanitized);
+  }
+
+  // Unsupported flags are dropped
+  {
+    auto sanitized = p7r::detail::sanitize_options(
+        p7r::CO_NON_BLOCKING|p7r::CO_UDP_GRO, defaults,
+        possible & ~p7r::CO_UDP_GRO);
+    ASSERT_TRUE(p7r::CO_NON_BLOCKING & sanitized);
+    ASSERT_FALSE(p7r::CO_UDP_GRO & sanitized);
+  }
+}
+
+
+
 TEST(ConnectorUtil, sanitize_options_bad_defaults)
 {
   auto defaults = p7r::CO_BLOCKING|p7r::CO_STREAM;
@@ -151,3 +182,43 @@ TEST(ConnectorUtil, sanitize_options_multi_behaviour)
           p7r::CO_BLOCKING, possible), p7r::exception);
   }
 }
+
+
+
+#if defined(PACKETEER_POSIX)
+TEST(ConnectorUtil, parse_tunable_size)
+{
+  size_t size = 0;
+  ASSERT_EQ(p7r::ERR_SUCCESS, p7r::detail::parse_tunable_size("123", size));
+  ASSERT_EQ(123, size);
+  ASSERT_EQ(p7r::ERR_SUCCESS, p7r::detail::parse_tunable_size("4k", size));
+  ASSERT_EQ(4096, size);
+  ASSERT_EQ(p7r::ERR_SUCCESS, p7r::detail::parse_tunable_size("4M", size));
+  ASSERT_EQ(4 * 1024 * 1024, size);
+  ASSERT_EQ(p7r::ERR_SUCCESS, p7r::detail::parse_tunable_size("1G", size));
+  ASSERT_EQ(1024 * 1024 * 1024, size);
+
+  ASSERT_EQ(p7r::ERR_INVALID_VALUE, p7r::detail::parse_tunable_size("", size));
+  ASSERT_EQ(p7r::ERR_INVALID_VALUE, p7r::detail::parse_tunable_size("-1",
+        size));
+  ASSERT_EQ(p7r::ERR_INVALID_VALUE, p7r::detail::parse_tunable_size("4T",
+        size));
+  ASSERT_EQ(p7r::ERR_INVALID_VALUE, p7r::detail::parse_tunable_size("4MB",
+        size));
+  ASSERT_EQ(p7r::ERR_INVALID_VALUE, p7r::detail::parse_tunable_size("M",
+        size));
+}
+
+
+
+TEST(ConnectorUtil, parse_tunable_flag)
+{
+  bool flag = false;
+  ASSERT_EQ(p7r::ERR_SUCCESS, p7r::detail::parse_tunable_flag("1", flag));
+  ASSERT_TRUE(flag);
+  ASSERT_EQ(p7r::ERR_SUCCESS, p7r::detail::parse_tunable_flag("0", flag));
+  ASSERT_FALSE(flag);
+  ASSERT_EQ(p7r::ERR_INVALID_VALUE, p7r::detail::parse_tunable_flag("yes",
+        flag));
+}
+#endif // PACKETEER_POSIX
@@ -0,0 +1,128 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <build-config.h>
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include "../env.h"
+
+#include "../../lib/scheduler/event_ring.h"
+
+namespace p7r = packeteer;
+namespace pd = packeteer::detail;
+
+
+TEST(EventRing, capacity)
+{
+  pd::event_ring ring{5};
+  ASSERT_EQ(8, ring.capacity());
+  ASSERT_TRUE(ring.empty());
+}
+
+
+
+TEST(EventRing, push_pop_wraparound)
+{
+  pd::event_ring ring{4};
+  p7r::connector conn{test_env->api, "anon://"};
+
+  // Go round the ring a few times.
+  for (p7r::events_t i = 0 ; i < 10 ; ++i) {
+    for (p7r::events_t j = 0 ; j < 4 ; ++j) {
+      ASSERT_TRUE(ring.push({conn, i * 4 + j}));
+    }
+    ASSERT_FALSE(ring.push({conn, 0}));
+
+    pd::io_events events;
+    ASSERT_TRUE(ring.pop(events));
+    ASSERT_EQ(4, events.size());
+    for (p7r::events_t j = 0 ; j < 4 ; ++j) {
+      ASSERT_EQ(conn, events[j].connector);
+      ASSERT_EQ(i * 4 + j, events[j].events);
+    }
+    ASSERT_TRUE(ring.empty());
+    ASSERT_FALSE(ring.pop(events));
+  }
+}
+
+
+
+TEST(EventRing, idle_consumer)
+{
+  pd::event_ring ring{4};
+  p7r::connector conn{test_env->api, "anon://"};
+
+  // The consumer starts idle, so the first push requires a wakeup, but not
+  // the second.
+  ASSERT_TRUE(ring.push({conn, p7r::PEV_IO_READ}));
+  ASSERT_TRUE(ring.wake_consumer());
+  ASSERT_TRUE(ring.push({conn, p7r::PEV_IO_READ}));
+  ASSERT_FALSE(ring.wake_consumer());
+
+  // With events in the ring, the consumer must not go idle.
+  ASSERT_FALSE(ring.prepare_wait());
+  ASSERT_FALSE(ring.wake_consumer());
+
+  // Once drained, it can.
+  pd::io_events events;
+  ASSERT_TRUE(ring.pop(events));
+  ASSERT_TRUE(ring.prepare_wait());
+  ASSERT_TRUE(ring.wake_consumer());
+
+  // Cancelling means no wakeup is necessary.
+  ASSERT_TRUE(ring.prepare_wait());
+  ring.cancel_wait();
+  ASSERT_FALSE(ring.wake_consumer());
+}
+
+
+
+TEST(EventRing, threaded)
+{
+  pd::event_ring ring{16};
+  p7r::connector conn{test_env->api, "anon://"};
+
+  constexpr p7r::events_t AMOUNT = 10000;
+
+  std::thread producer{[&ring, &conn]()
+  {
+    for (p7r::events_t i = 0 ; i < AMOUNT ; ++i) {
+      while (!ring.push({conn, i})) {
+        std::this_thread::yield();
+      }
+    }
+  }};
+
+  p7r::events_t expected = 0;
+  pd::io_event event;
+  while (expected < AMOUNT) {
+    if (!ring.pop(event)) {
+      std::this_thread::yield();
+      continue;
+    }
+    ASSERT_EQ(expected, event.events);
+    ++expected;
+  }
+
+  producer.join();
+  ASSERT_TRUE(ring.empty());
+}
@@ -0,0 +1,163 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <build-config.h>
+
+#include <gtest/gtest.h>
+
+#include "../env.h"
+
+#if defined(PACKETEER_HAVE_EPOLL_CREATE1)
+#include "../../lib/scheduler/io/posix/epoll.h"
+
+namespace p7r = packeteer;
+namespace pd = packeteer::detail;
+
+
+TEST(IOEpoll, minimal_ctl_calls)
+{
+  pd::io_epoll io{test_env->api};
+
+  // An anonymous pipe has two file descriptors; registering for reading
+  // must add both (the write handle still receives error and close events).
+  p7r::connector pipe{test_env->api, "anon://"};
+  ASSERT_EQ(p7r::ERR_SUCCESS, pipe.connect());
+
+  io.register_connector(pipe, p7r::PEV_IO_READ | p7r::PEV_IO_ERROR);
+  ASSERT_EQ(2, io.ctl_calls());
+
+  // Registering the same events again changes nothing.
+  io.register_connector(pipe, p7r::PEV_IO_READ | p7r::PEV_IO_ERROR);
+  ASSERT_EQ(2, io.ctl_calls());
+
+  // Adding write interest only affects the write handle.
+  io.register_connector(pipe, p7r::PEV_IO_WRITE);
+  ASSERT_EQ(3, io.ctl_calls());
+
+  // Removing it again, likewise.
+  io.unregister_connector(pipe, p7r::PEV_IO_WRITE);
+  ASSERT_EQ(4, io.ctl_calls());
+
+  // Unregistering everything removes both handles.
+  io.unregister_connector(pipe, p7r::PEV_IO_READ | p7r::PEV_IO_ERROR);
+  ASSERT_EQ(6, io.ctl_calls());
+
+  // Unregistering unknown connectors does not call into the kernel at all.
+  io.unregister_connector(pipe, p7r::PEV_IO_READ);
+  ASSERT_EQ(6, io.ctl_calls());
+}
+
+
+
+TEST(IOEpoll, single_handle_connector)
+{
+  pd::io_epoll io{test_env->api};
+
+  // Sockets use the same handle for reading and writing; that must result
+  // in a single epoll_ctl() call.
+  p7r::connector server{test_env->api, "tcp4://127.0.0.1:0"};
+  ASSERT_EQ(p7r::ERR_SUCCESS, server.listen());
+
+  io.register_connector(server, p7r::PEV_IO_READ);
+  ASSERT_EQ(1, io.ctl_calls());
+
+  io.register_connector(server, p7r::PEV_IO_WRITE);
+  ASSERT_EQ(2, io.ctl_calls());
+
+  io.unregister_connector(server, p7r::PEV_IO_READ | p7r::PEV_IO_WRITE);
+  ASSERT_EQ(3, io.ctl_calls());
+}
+
+
+
+TEST(IOEpoll, reused_handle)
+{
+  pd::io_epoll io{test_env->api};
+
+  p7r::connector first{test_env->api, "tcp4://127.0.0.1:0"};
+  ASSERT_EQ(p7r::ERR_SUCCESS, first.listen());
+  auto fd = first.get_read_handle().sys_handle();
+
+  io.register_connector(first, p7r::PEV_IO_READ);
+  ASSERT_EQ(1, io.ctl_calls());
+
+  // Closing drops the descriptor from the kernel. When a new connector gets
+  // the same descriptor, it must be added again, even though the event mask
+  // is the same.
+  first.close();
+  p7r::connector second{test_env->api, "tcp4://127.0.0.1:0"};
+  ASSERT_EQ(p7r::ERR_SUCCESS, second.listen());
+  if (fd != second.get_read_handle().sys_handle()) {
+    GTEST_SKIP();
+  }
+
+  io.register_connector(second, p7r::PEV_IO_READ);
+  ASSERT_EQ(2, io.ctl_calls());
+}
+
+
+
+TEST(IOEpoll, oneshot)
+{
+  pd::io_epoll io{test_env->api};
+  ASSERT_TRUE(io.set_oneshot(true, 1));
+
+  p7r::connector pipe{test_env->api, "anon://"};
+  ASSERT_EQ(p7r::ERR_SUCCESS, pipe.connect());
+  io.register_connector(pipe, p7r::PEV_IO_READ);
+
+  char buf[] = { 'x' };
+  size_t amount = 0;
+  ASSERT_EQ(p7r::ERR_SUCCESS, pipe.write(buf, sizeof(buf), amount));
+
+  // The readable pipe is reported once, then not until it is re-armed.
+  pd::io_events events;
+  io.wait_for_events(events, std::chrono::milliseconds(50));
+  ASSERT_EQ(1, events.size());
+  ASSERT_EQ(pipe, events[0].connector);
+
+  events.clear();
+  io.wait_for_events(events, std::chrono::milliseconds(20));
+  ASSERT_TRUE(events.empty());
+
+  // Changing the registration of a disabled handle keeps it disabled; only
+  // the write handle, which was not reported, is modified.
+  auto calls = io.ctl_calls();
+  io.register_connector(pipe, p7r::PEV_IO_ERROR);
+  ASSERT_EQ(calls + 1, io.ctl_calls());
+  io.wait_for_events(events, std::chrono::milliseconds(20));
+  ASSERT_TRUE(events.empty());
+
+  // Re-arming takes a single call.
+  io.rearm(pipe);
+  ASSERT_EQ(calls + 2, io.ctl_calls());
+  io.wait_for_events(events, std::chrono::milliseconds(50));
+  ASSERT_EQ(1, events.size());
+
+  // Leaving one-shot mode enables the connector again.
+  events.clear();
+  ASSERT_TRUE(io.set_oneshot(false, 0));
+  io.wait_for_events(events, std::chrono::milliseconds(50));
+  ASSERT_EQ(1, events.size());
+  events.clear();
+  io.wait_for_events(events, std::chrono::milliseconds(50));
+  ASSERT_EQ(1, events.size());
+}
+
+#endif // PACKETEER_HAVE_EPOLL_CREATE1
@@ -0,0 +1,143 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <build-config.h>
+
+#include <gtest/gtest.h>
+
+#include "../env.h"
+
+#if defined(PACKETEER_HAVE_SELECT)
+#include "../../lib/scheduler/io/posix/select.h"
+
+#include <sys/resource.h>
+
+#include <vector>
+
+namespace p7r = packeteer;
+namespace pd = packeteer::detail;
+
+using namespace std::literals::chrono_literals;
+
+namespace {
+
+inline bool
+has_event(pd::io_events const & events, p7r::connector const & conn,
+    p7r::events_t mask)
+{
+  for (auto & ev : events) {
+    if (ev.connector == conn && (ev.events & mask)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // anonymous namespace
+
+
+
+TEST(IOSelect, register_unregister)
+{
+  pd::io_select io{test_env->api};
+
+  p7r::connector first{test_env->api, "anon://"};
+  ASSERT_EQ(p7r::ERR_SUCCESS, first.connect());
+  p7r::connector second{test_env->api, "anon://"};
+  ASSERT_EQ(p7r::ERR_SUCCESS, second.connect());
+
+  io.register_connector(first, p7r::PEV_IO_READ);
+  io.register_connector(second, p7r::PEV_IO_READ);
+
+  char buf[] = "x";
+  size_t amount = 0;
+  ASSERT_EQ(p7r::ERR_SUCCESS, first.write(buf, 1, amount));
+  ASSERT_EQ(p7r::ERR_SUCCESS, second.write(buf, 1, amount));
+
+  pd::io_events events;
+  io.wait_for_events(events, 50ms);
+  ASSERT_TRUE(has_event(events, first, p7r::PEV_IO_READ));
+  ASSERT_TRUE(has_event(events, second, p7r::PEV_IO_READ));
+
+  // After unregistering the second (higher) connector, only the first may
+  // report events.
+  io.unregister_connector(second, p7r::PEV_IO_READ);
+  events.clear();
+  io.wait_for_events(events, 50ms);
+  ASSERT_TRUE(has_event(events, first, p7r::PEV_IO_READ));
+  ASSERT_FALSE(has_event(events, second, p7r::PEV_IO_READ));
+
+  // With nothing registered, we just time out.
+  io.unregister_connector(first, p7r::PEV_IO_READ);
+  events.clear();
+  io.wait_for_events(events, 20ms);
+  ASSERT_TRUE(events.empty());
+}
+
+
+#if defined(PACKETEER_HAVE_UNLIMITED_SELECT)
+TEST(IOSelect, beyond_fd_setsize)
+{
+  // We need more file descriptors than FD_SETSIZE; each pipe uses two.
+  ::rlimit limit;
+  ASSERT_EQ(0, ::getrlimit(RLIMIT_NOFILE, &limit));
+  rlim_t wanted = FD_SETSIZE + 64;
+  if (limit.rlim_cur < wanted) {
+    if (limit.rlim_max < wanted) {
+      GTEST_SKIP() << "RLIMIT_NOFILE too low to exceed FD_SETSIZE.";
+    }
+    ::rlimit raised = limit;
+    raised.rlim_cur = wanted;
+    ASSERT_EQ(0, ::setrlimit(RLIMIT_NOFILE, &raised));
+  }
+
+  std::vector<p7r::connector> pipes;
+  while (true) {
+    p7r::connector pipe{test_env->api, "anon://"};
+    ASSERT_EQ(p7r::ERR_SUCCESS, pipe.connect());
+    pipes.push_back(pipe);
+    if (pipe.get_read_handle().sys_handle() >= FD_SETSIZE) {
+      break;
+    }
+  }
+
+  auto & high = pipes.back();
+
+  pd::io_select io{test_env->api};
+  io.register_connector(pipes.front(), p7r::PEV_IO_READ);
+  io.register_connector(high, p7r::PEV_IO_READ);
+
+  char buf[] = "x";
+  size_t amount = 0;
+  ASSERT_EQ(p7r::ERR_SUCCESS, high.write(buf, 1, amount));
+
+  pd::io_events events;
+  io.wait_for_events(events, 50ms);
+  ASSERT_TRUE(has_event(events, high, p7r::PEV_IO_READ));
+  ASSERT_FALSE(has_event(events, pipes.front(), p7r::PEV_IO_READ));
+
+  io.unregister_connector(high, p7r::PEV_IO_READ);
+  io.unregister_connector(pipes.front(), p7r::PEV_IO_READ);
+
+  pipes.clear();
+  ::setrlimit(RLIMIT_NOFILE, &limit);
+}
+#endif // PACKETEER_HAVE_UNLIMITED_SELECT
+
+#endif // PACKETEER_HAVE_SELECT
@@ -206,6 +206,65 @@ TEST_P(IOThread, with_connector)
 
 
 
+
+TEST_P(IOThread, paced)
+{
+  auto td = GetParam();
+  if (td.name.find("win32") == 0) {
+    GTEST_SKIP() << "Re-reporting events requires a level-triggered I/O subsystem.";
+  }
+
+  // Create I/O subsystem
+  auto io = std::unique_ptr<p7r::detail::io>(td.creator(test_env->api));
+
+  // Start IO interrupt connector
+  p7r::connector io_interrupt{test_env->api, td.io_interrupt_name};
+  auto err = io_interrupt.connect();
+  ASSERT_EQ(p7r::ERR_SUCCESS, err);
+
+  p7r::connector test_conn{test_env->api, td.io_interrupt_name};
+  err = test_conn.connect();
+  ASSERT_EQ(p7r::ERR_SUCCESS, err);
+
+  // Paced threads need no queue interrupt.
+  p7r::detail::out_queue_t results;
+  p7r::detail::io_thread thread{std::move(io),
+    io_interrupt,
+    results,
+    p7r::connector{},
+    false, // do not report events on the I/O interrupt
+    true // paced
+  };
+  err = thread.start();
+  ASSERT_EQ(p7r::ERR_SUCCESS, err);
+
+  // The connector stays readable, as nobody reads from it.
+  char buf[] = { 42 };
+  size_t written = 0;
+  err = test_conn.write(buf, sizeof(buf), written);
+  ASSERT_EQ(p7r::ERR_SUCCESS, err);
+  thread.register_connector(test_conn, p7r::PEV_IO_READ);
+
+  // It's reported once...
+  ASSERT_TRUE(thread.wait_for_events(sc::milliseconds(500)));
+  std::this_thread::sleep_for(sc::milliseconds(20));
+
+  p7r::detail::io_events events;
+  ASSERT_TRUE(results.pop(events));
+  ASSERT_EQ(1, events.size());
+  ASSERT_EQ(test_conn, events[0].connector);
+
+  // ... and not again until the consumer is done with it.
+  ASSERT_FALSE(thread.wait_for_events(sc::milliseconds(20)));
+
+  thread.resume({ test_conn });
+  ASSERT_TRUE(thread.wait_for_events(sc::milliseconds(500)));
+  ASSERT_TRUE(results.pop(events));
+  ASSERT_EQ(test_conn, events[0].connector);
+
+  thread.stop();
+}
+
 namespace {
   test_data test_values[] = {
 #if defined(PACKETEER_HAVE_EPOLL_CREATE1)
@@ -0,0 +1,150 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <build-config.h>
+
+#include "../env.h"
+
+#include <packeteer/connector.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace p7r = packeteer;
+
+/*****************************************************************************
+ * Replace the global allocation functions, so that tests can count the heap
+ * allocations made on their thread.
+ **/
+namespace {
+
+thread_local bool   counting = false;
+thread_local size_t allocations = 0;
+
+
+struct count_allocations
+{
+  count_allocations()
+  {
+    allocations = 0;
+    counting = true;
+  }
+
+  ~count_allocations()
+  {
+    counting = false;
+  }
+};
+
+} // anonymous namespace
+
+
+void *
+operator new(std::size_t size)
+{
+  if (counting) {
+    ++allocations;
+  }
+  auto ret = std::malloc(size ? size : 1);
+  if (!ret) {
+    throw std::bad_alloc{};
+  }
+  return ret;
+}
+
+
+
+// GCC cannot tell that operator new above uses malloc().
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpragmas"
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void
+operator delete(void * ptr) noexcept
+{
+  std::free(ptr);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+
+
+void
+operator delete(void * ptr, std::size_t) noexcept
+{
+  ::operator delete(ptr);
+}
+
+
+
+TEST(Allocations, datagram_echo)
+{
+  p7r::connector first{test_env->api, "udp4://127.0.0.1:54450"};
+  ASSERT_EQ(p7r::ERR_SUCCESS, first.listen());
+  p7r::connector second{test_env->api, "udp4://127.0.0.1:54451"};
+  ASSERT_EQ(p7r::ERR_SUCCESS, second.listen());
+
+  // Destinations and senders are built up front.
+  auto destination = second.peer_addr();
+  p7r::peer_address sender;
+  p7r::peer_address echo_sender;
+
+  char buf[200] = { 0 };
+  size_t failures = 0;
+
+  auto round = [&]() {
+    size_t amount = 0;
+    if (p7r::ERR_SUCCESS != first.send(buf, sizeof(buf), amount,
+          destination)) {
+      ++failures;
+    }
+    if (p7r::ERR_SUCCESS != second.receive(buf, sizeof(buf), amount,
+          sender)) {
+      ++failures;
+    }
+    if (p7r::ERR_SUCCESS != second.send(buf, amount, amount, sender)) {
+      ++failures;
+    }
+    if (p7r::ERR_SUCCESS != first.receive(buf, sizeof(buf), amount,
+          echo_sender)) {
+      ++failures;
+    }
+  };
+
+  // Warm up, then the steady state must not allocate.
+  round();
+  {
+    count_allocations count;
+    for (int i = 0 ; i < 100 ; ++i) {
+      round();
+    }
+  }
+  ASSERT_EQ(0, failures);
+  ASSERT_EQ(0, allocations);
+
+  // The sender addresses are complete, scheme and all.
+  ASSERT_EQ(first.peer_addr(), sender);
+  ASSERT_EQ("udp4", sender.scheme());
+  ASSERT_EQ(destination, echo_sender);
+}
@@ -0,0 +1,205 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <build-config.h>
+
+#include "../env.h"
+
+#include <packeteer/connection_pool.h>
+
+#include <chrono>
+#include <thread>
+
+namespace p7r = packeteer;
+
+namespace {
+
+template <typename predicateT>
+bool
+process_until(p7r::scheduler & sched, predicateT predicate)
+{
+  for (int rounds = 0 ; rounds < 500 && !predicate() ; ++rounds) {
+    sched.process_events(std::chrono::milliseconds(1));
+  }
+  return predicate();
+}
+
+
+
+p7r::connector
+accept_one(p7r::connector & server)
+{
+  p7r::connector conn;
+  for (int rounds = 0 ; rounds < 500 && !conn.communicating() ; ++rounds) {
+    conn = server.accept();
+    if (!conn.communicating()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  return conn;
+}
+
+} // anonymous namespace
+
+
+
+TEST(ConnectionPool, reuse)
+{
+  p7r::connector server{test_env->api, "tcp4://127.0.0.1:54430"};
+  ASSERT_EQ(p7r::ERR_SUCCESS, server.listen());
+  p7r::peer_address peer{test_env->api, "tcp4://127.0.0.1:54430"};
+
+  p7r::scheduler sched{test_env->api, 0};
+  p7r::connection_pool pool{test_env->api, sched};
+
+  p7r::connector first;
+  auto err = pool.acquire(peer, first);
+  ASSERT_TRUE(p7r::ERR_SUCCESS == err || p7r::ERR_ASYNC == err);
+  ASSERT_TRUE(first.connected());
+  ASSERT_EQ(1, pool.in_use(peer));
+  ASSERT_EQ(0, pool.idle(peer));
+
+  ASSERT_EQ(p7r::ERR_SUCCESS, pool.release(first));
+  ASSERT_EQ(0, pool.in_use(peer));
+  ASSERT_EQ(1, pool.idle(peer));
+
+  // The released connector is handed out again.
+  p7r::connector second;
+  ASSERT_EQ(p7r::ERR_SUCCESS, pool.acquire(peer, second));
+  ASSERT_EQ(first, second);
+
+  // Unless it is not reusable.
+  ASSERT_EQ(p7r::ERR_SUCCESS, pool.release(second, false));
+  ASSERT_EQ(0, pool.idle(peer));
+  ASSERT_FALSE(second.connected());
+
+  // Only connectors from the pool can be released.
+  ASSERT_EQ(p7r::ERR_INVALID_VALUE, pool.release(second));
+  ASSERT_EQ(p7r::ERR_INVALID_VALUE, pool.release(server));
+}
+
+
+
+TEST(ConnectionPool, limits)
+{
+  p7r::connector server{test_env->api, "tcp4://127.0.0.1:54431"};
+  ASSERT_EQ(p7r::ERR_SUCCESS, server.listen());
+  p7r::peer_address peer{test_env->api, "tcp4://127.0.0.1:54431"};
+
+  p7r::scheduler sched{test_env->api, 0};
+  p7r::connection_pool::settings settings;
+  settings.max_per_peer = 2;
+  settings.max_idle_per_peer = 1;
+  p7r::connection_pool pool{test_env->api, sched, settings};
+
+  p7r::connector first, second, third;
+  auto err = pool.acquire(peer, first);
+  ASSERT_TRUE(p7r::ERR_SUCCESS == err || p7r::ERR_ASYNC == err);
+  err = pool.acquire(peer, second);
+  ASSERT_TRUE(p7r::ERR_SUCCESS == err || p7r::ERR_ASYNC == err);
+  ASSERT_EQ(p7r::ERR_NUM_ITEMS, pool.acquire(peer, third));
+
+  // Only one connector is kept idle.
+  ASSERT_EQ(p7r::ERR_SUCCESS, pool.release(first));
+  ASSERT_EQ(p7r::ERR_SUCCESS, pool.release(second));
+  ASSERT_EQ(1, pool.idle(peer));
+  ASSERT_FALSE(second.connected());
+
+  // Pools are for stream connectors.
+  p7r::peer_address dgram{test_env->api, "udp4://127.0.0.1:54431"};
+  ASSERT_EQ(p7r::ERR_INVALID_OPTION, pool.acquire(dgram, third));
+}
+
+
+
+TEST(ConnectionPool, idle_timeout)
+{
+  p7r::connector server{test_env->api, "tcp4://127.0.0.1:54432"};
+  ASSERT_EQ(p7r::ERR_SUCCESS, server.listen());
+  p7r::peer_address peer{test_env->api, "tcp4://127.0.0.1:54432"};
+
+  p7r::scheduler sched{test_env->api, 0};
+  p7r::connection_pool::settings settings;
+  settings.idle_timeout = std::chrono::milliseconds(20);
+  p7r::connection_pool pool{test_env->api, sched, settings};
+
+  p7r::connector conn;
+  auto err = pool.acquire(peer, conn);
+  ASSERT_TRUE(p7r::ERR_SUCCESS == err || p7r::ERR_ASYNC == err);
+  ASSERT_EQ(p7r::ERR_SUCCESS, pool.release(conn));
+  ASSERT_EQ(1, pool.idle(peer));
+
+  ASSERT_TRUE(process_until(sched, [&]() { return !pool.idle(peer); }));
+  ASSERT_FALSE(conn.connected());
+}
+
+
+
+TEST(ConnectionPool, health_check)
+{
+  p7r::connector server{test_env->api, "tcp4://127.0.0.1:54433"};
+  ASSERT_EQ(p7r::ERR_SUCCESS, server.listen());
+  p7r::peer_address peer{test_env->api, "tcp4://127.0.0.1:54433"};
+
+  p7r::scheduler sched{test_env->api, 0};
+  p7r::connection_pool pool{test_env->api, sched};
+
+  p7r::connector conn;
+  auto err = pool.acquire(peer, conn);
+  ASSERT_TRUE(p7r::ERR_SUCCESS == err || p7r::ERR_ASYNC == err);
+  auto accepted = accept_one(server);
+  ASSERT_TRUE(accepted.communicating());
+
+  ASSERT_EQ(p7r::ERR_SUCCESS, pool.release(conn));
+  ASSERT_EQ(1, pool.idle(peer));
+
+  // The idle connection is dropped once the server closes its end.
+  ASSERT_EQ(p7r::ERR_SUCCESS, accepted.close());
+  ASSERT_TRUE(process_until(sched, [&]() { return !pool.idle(peer); }));
+}
+
+
+
+TEST(ConnectionPool, prewarm)
+{
+  p7r::connector server{test_env->api, "tcp4://127.0.0.1:54434"};
+  ASSERT_EQ(p7r::ERR_SUCCESS, server.listen());
+  p7r::peer_address peer{test_env->api, "tcp4://127.0.0.1:54434"};
+
+  p7r::scheduler sched{test_env->api, 0};
+  p7r::connection_pool::settings settings;
+  settings.max_per_peer = 3;
+  p7r::connection_pool pool{test_env->api, sched, settings};
+
+  ASSERT_EQ(p7r::ERR_SUCCESS, pool.prewarm(peer, 5));
+  ASSERT_EQ(3, pool.idle(peer) + pool.connecting(peer));
+  ASSERT_EQ(p7r::ERR_NUM_ITEMS, pool.prewarm(peer, 1));
+
+  ASSERT_TRUE(process_until(sched, [&]() { return 3 == pool.idle(peer); }));
+  ASSERT_EQ(0, pool.connecting(peer));
+
+  p7r::connector conn;
+  ASSERT_EQ(p7r::ERR_SUCCESS, pool.acquire(peer, conn));
+  ASSERT_EQ(2, pool.idle(peer));
+  ASSERT_EQ(1, pool.in_use(peer));
+
+  pool.clear();
+  ASSERT_EQ(0, pool.idle(peer));
+  ASSERT_EQ(1, pool.in_use(peer));
+}
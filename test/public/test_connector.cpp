@@ -32,6 +32,14 @@
 
 #include <packeteer/scheduler.h>
 
+#if defined(PACKETEER_POSIX)
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#endif
+
 #include "../value_tests.h"
 #include "../test_name.h"
 
@@ -163,6 +171,10 @@ struct parsing_test_data
 #if defined(PACKETEER_POSIX)
   { "fifo:///foo", true, p7r::CT_FIFO },
 #endif
+
+#if defined(PACKETEER_HAVE_SIGNALFD)
+  { "signal://", true, p7r::CT_SIGNAL },
+#endif
 };
 
 std::string connector_name(testing::TestParamInfo<parsing_test_data> const & info)
@@ -278,6 +290,61 @@ TEST(Connector, default_constructed)
 }
 
 
+TEST(Connector, from_address)
+{
+  // Generic types are narrowed to match the address.
+  liberate::net::socket_address addr{"127.0.0.1:54460"};
+  p7r::connector server{test_env->api, p7r::CT_TCP, addr};
+  ASSERT_EQ(p7r::CT_TCP4, server.type());
+  ASSERT_EQ(p7r::CO_STREAM|p7r::CO_NON_BLOCKING, server.get_options());
+
+  ASSERT_EQ(p7r::ERR_SUCCESS, server.listen());
+  ASSERT_EQ(liberate::net::url::parse("tcp4://127.0.0.1:54460"),
+      server.connect_url());
+
+  // Options are validated as those in URLs.
+  auto peer = server.peer_addr();
+  ASSERT_THROW((p7r::connector{test_env->api, peer, p7r::CO_DATAGRAM}),
+      p7r::exception);
+  ASSERT_THROW((p7r::connector{test_env->api, peer,
+        p7r::CO_STREAM|p7r::CO_BLOCKING|p7r::CO_NON_BLOCKING}),
+      p7r::exception);
+  ASSERT_THROW((p7r::connector{test_env->api, p7r::CT_UDP6, addr}),
+      p7r::exception);
+
+  p7r::connector client{test_env->api, peer, p7r::CO_STREAM|p7r::CO_BLOCKING};
+  ASSERT_EQ(server.type(), client.type());
+  ASSERT_EQ(p7r::CO_STREAM|p7r::CO_BLOCKING, client.get_options());
+  ASSERT_EQ(p7r::ERR_SUCCESS, client.connect());
+
+  // The accepted connector's URL is formatted from its peer on request.
+  p7r::connector accepted;
+  for (int i = 0 ; i < 500 && !accepted ; ++i) {
+    accepted = server.accept();
+    if (!accepted) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  ASSERT_TRUE(accepted);
+  ASSERT_NE(server, accepted);
+  ASSERT_EQ(liberate::net::url::parse(accepted.peer_addr().str()),
+      accepted.connect_url());
+}
+
+
+
+TEST(Connector, from_address_without_address_creator)
+{
+  // Schemes without an address creator are passed the formatted URL.
+  p7r::connector conn{test_env->api, p7r::CT_ANON,
+    liberate::net::socket_address{}};
+  ASSERT_EQ(p7r::CT_ANON, conn.type());
+  ASSERT_EQ(p7r::ERR_SUCCESS, conn.listen());
+  ASSERT_EQ("anon", conn.connect_url().scheme);
+}
+
+
+
 /*****************************************************************************
  * ConnectorStream
  */
@@ -443,6 +510,39 @@ void send_message_streaming(p7r::connector & sender, p7r::connector & receiver,
 
 
 
+void send_message_streaming_vectored(p7r::connector & sender,
+    p7r::connector & receiver)
+{
+  // Send a header and payload in separate buffers, and receive them into
+  // separate buffers of different sizes.
+  std::string header = "HEAD";
+  std::string payload = "Hello, world!";
+  p7r::const_io_buffer out[] = {
+    { header.c_str(), header.size() },
+    { payload.c_str(), payload.size() },
+  };
+  size_t amount = 0;
+  ASSERT_EQ(p7r::ERR_SUCCESS, sender.write(out, 2, amount));
+  ASSERT_EQ(header.size() + payload.size(), amount);
+
+  std::this_thread::sleep_for(TEST_SLEEP_TIME);
+
+  char first[6] = { 0 };
+  char second[100] = { 0 };
+  p7r::io_buffer in[] = {
+    { first, sizeof(first) },
+    { second, sizeof(second) },
+  };
+  ASSERT_EQ(p7r::ERR_SUCCESS, receiver.read(in, 2, amount));
+  ASSERT_EQ(header.size() + payload.size(), amount);
+
+  std::string received{first, first + sizeof(first)};
+  received += std::string{second, second + amount - sizeof(first)};
+  ASSERT_EQ(header + payload, received);
+}
+
+
+
 void send_message_streaming_async(p7r::connector & sender, p7r::connector & receiver,
     p7r::scheduler & sched, int marker = -1)
 {
@@ -799,6 +899,25 @@ TEST_P(ConnectorStream, blocking_messaging)
 
 
 
+TEST_P(ConnectorStream, vectored_messaging)
+{
+  auto td = GetParam();
+
+  auto url = liberate::net::url::parse(td.generator(true));
+  url.query["behaviour"] = "stream";
+
+  auto res = setup_stream_connection(td.type, url);
+  if (res.empty()) GTEST_SKIP();
+
+  auto client = res[0].first;
+  auto server = res[0].second;
+
+  send_message_streaming_vectored(client, server);
+  send_message_streaming_vectored(server, client);
+}
+
+
+
 TEST_P(ConnectorStream, non_blocking_messaging)
 {
   // Tests for "stream" connectors, i.e. connectors that allow synchronous,
@@ -982,6 +1101,746 @@ INSTANTIATE_TEST_SUITE_P(net, ConnectorStream,
     connector_name<streaming_test_data>);
 
 
+
+TEST(ConnectorTCP, zerocopy_write)
+{
+  p7r::connector server{test_env->api, "tcp4://127.0.0.1:54410?blocking=1"};
+  p7r::connector client{test_env->api,
+    "tcp4://127.0.0.1:54410?blocking=1&zerocopy=1"};
+  ASSERT_FALSE(server.get_options() & p7r::CO_ZEROCOPY);
+  ASSERT_TRUE(client.get_options() & p7r::CO_ZEROCOPY);
+
+  ASSERT_EQ(p7r::ERR_SUCCESS, server.listen());
+  auto err = client.connect();
+  if (p7r::ERR_UNSUPPORTED_ACTION == err) {
+    GTEST_SKIP();
+  }
+  ASSERT_EQ(p7r::ERR_SUCCESS, err);
+  auto accepted = server.accept();
+  ASSERT_TRUE(accepted.connected());
+
+  // Zero-copy writes need the mode.
+  size_t amount = 0;
+  uint32_t sequence = 0;
+  char dummy[1] = { 0 };
+  ASSERT_EQ(p7r::ERR_UNSUPPORTED_ACTION, accepted.write_zerocopy(dummy,
+        sizeof(dummy), amount, sequence));
+
+  // Collect completions via the scheduler.
+  p7r::scheduler sched(test_env->api, 0);
+  std::vector<p7r::zerocopy_completion> completions;
+  auto cb = [&completions](p7r::time_point const &, p7r::events_t events,
+      p7r::connector * conn) -> p7r::error_t
+  {
+    EXPECT_EQ(p7r::PEV_IO_ZEROCOPY, events);
+    p7r::zerocopy_completion buf[4];
+    size_t received = 0;
+    while (p7r::ERR_SUCCESS == conn->zerocopy_completions(buf, 4, received)) {
+      completions.insert(completions.end(), buf, buf + received);
+    }
+    return p7r::ERR_SUCCESS;
+  };
+  sched.register_connector(p7r::PEV_IO_ZEROCOPY, client, cb);
+
+  // Write a few large buffers; they need to stay untouched until their
+  // completions arrive.
+  constexpr size_t BUFSIZE = 64 * 1024;
+  constexpr uint32_t COUNT = 4;
+  std::vector<std::vector<char>> bufs;
+  for (uint32_t i = 0 ; i < COUNT ; ++i) {
+    bufs.push_back(std::vector<char>(BUFSIZE, 'a' + i));
+    size_t offset = 0;
+    while (offset < BUFSIZE) {
+      ASSERT_EQ(p7r::ERR_SUCCESS, client.write_zerocopy(&bufs[i][offset],
+            BUFSIZE - offset, amount, sequence));
+      offset += amount;
+    }
+  }
+  ASSERT_LE(COUNT - 1, sequence);
+
+  // Read everything back.
+  std::vector<char> result(BUFSIZE * COUNT);
+  size_t offset = 0;
+  while (offset < result.size()) {
+    ASSERT_EQ(p7r::ERR_SUCCESS, accepted.read(&result[offset],
+          result.size() - offset, amount));
+    offset += amount;
+  }
+  for (uint32_t i = 0 ; i < COUNT ; ++i) {
+    ASSERT_EQ(bufs[i], std::vector<char>(result.begin() + i * BUFSIZE,
+          result.begin() + (i + 1) * BUFSIZE));
+  }
+
+  // All sends must be completed eventually.
+  auto completed = [&]() -> uint32_t
+  {
+    uint32_t total = 0;
+    for (auto & c : completions) {
+      total += c.last - c.first + 1;
+    }
+    return total;
+  };
+  for (int i = 0 ; i < 50 && completed() <= sequence ; ++i) {
+    sched.process_events(TEST_SLEEP_TIME);
+  }
+  ASSERT_EQ(sequence + 1, completed());
+
+  sched.unregister_connector(p7r::PEV_IO_ZEROCOPY, client, cb);
+}
+
+
+
+#if defined(PACKETEER_POSIX)
+TEST(ConnectorTCP, zerocopy_keeps_socket_error)
+{
+  p7r::connector server{test_env->api, "tcp4://127.0.0.1:54412?blocking=1"};
+  p7r::connector client{test_env->api,
+    "tcp4://127.0.0.1:54412?blocking=1&zerocopy=1"};
+
+  ASSERT_EQ(p7r::ERR_SUCCESS, server.listen());
+  auto err = client.connect();
+  if (p7r::ERR_UNSUPPORTED_ACTION == err) {
+    GTEST_SKIP();
+  }
+  ASSERT_EQ(p7r::ERR_SUCCESS, err);
+  auto accepted = server.accept();
+  ASSERT_TRUE(accepted.connected());
+
+  // Reset the connection, so the client has a pending error.
+  ::linger lin{1, 0};
+  ASSERT_EQ(0, ::setsockopt(accepted.get_read_handle().sys_handle(),
+        SOL_SOCKET, SO_LINGER, &lin, sizeof(lin)));
+  accepted.close();
+
+  p7r::scheduler sched(test_env->api, 0);
+  p7r::events_t reported = 0;
+  auto cb = [&reported](p7r::time_point const &, p7r::events_t events,
+      p7r::connector *) -> p7r::error_t
+  {
+    reported |= events;
+    return p7r::ERR_SUCCESS;
+  };
+  sched.register_connector(p7r::PEV_IO_ERROR | p7r::PEV_IO_ZEROCOPY,
+      client, cb);
+  for (int i = 0 ; i < 50 && !reported ; ++i) {
+    sched.process_events(TEST_SLEEP_TIME);
+  }
+  ASSERT_TRUE(reported & p7r::PEV_IO_ERROR);
+
+  // The scheduler must not have consumed the error.
+  int value = 0;
+  ::socklen_t len = sizeof(value);
+  ASSERT_EQ(0, ::getsockopt(client.get_read_handle().sys_handle(),
+        SOL_SOCKET, SO_ERROR, &value, &len));
+  ASSERT_EQ(ECONNRESET, value);
+
+  sched.unregister_connector(p7r::PEV_IO_ERROR | p7r::PEV_IO_ZEROCOPY,
+      client, cb);
+}
+
+
+
+TEST(ConnectorTCP, zerocopy_collected_without_callback)
+{
+  p7r::connector server{test_env->api, "tcp4://127.0.0.1:54424?blocking=1"};
+  p7r::connector client{test_env->api,
+    "tcp4://127.0.0.1:54424?blocking=1&zerocopy=1"};
+
+  ASSERT_EQ(p7r::ERR_SUCCESS, server.listen());
+  auto err = client.connect();
+  if (p7r::ERR_UNSUPPORTED_ACTION == err) {
+    GTEST_SKIP();
+  }
+  ASSERT_EQ(p7r::ERR_SUCCESS, err);
+  auto accepted = server.accept();
+  ASSERT_TRUE(accepted.connected());
+
+  // Nobody is registered for PEV_IO_ZEROCOPY.
+  p7r::scheduler sched(test_env->api, 0);
+  p7r::events_t reported = 0;
+  auto cb = [&reported](p7r::time_point const &, p7r::events_t events,
+      p7r::connector *) -> p7r::error_t
+  {
+    reported |= events;
+    return p7r::ERR_SUCCESS;
+  };
+  sched.register_connector(p7r::PEV_IO_READ, client, cb);
+
+  constexpr size_t BUFSIZE = 64 * 1024;
+  std::vector<char> buf(BUFSIZE, 'z');
+  size_t amount = 0;
+  uint32_t sequence = 0;
+  size_t offset = 0;
+  while (offset < BUFSIZE) {
+    ASSERT_EQ(p7r::ERR_SUCCESS, client.write_zerocopy(&buf[offset],
+          BUFSIZE - offset, amount, sequence));
+    offset += amount;
+  }
+
+  std::vector<char> result(BUFSIZE);
+  offset = 0;
+  while (offset < BUFSIZE) {
+    ASSERT_EQ(p7r::ERR_SUCCESS, accepted.read(&result[offset],
+          BUFSIZE - offset, amount));
+    offset += amount;
+  }
+
+  // The scheduler must collect the completions, or the socket stays in an
+  // error condition, and level-triggered I/O subsystems keep reporting it.
+  ::pollfd pfd{};
+  for (int i = 0 ; i < 50 ; ++i) {
+    sched.process_events(TEST_SLEEP_TIME);
+    pfd = ::pollfd{client.get_read_handle().sys_handle(), 0, 0};
+    ASSERT_LE(0, ::poll(&pfd, 1, 0));
+    if (!(pfd.revents & POLLERR)) {
+      break;
+    }
+  }
+  ASSERT_FALSE(pfd.revents & POLLERR);
+  ASSERT_FALSE(reported & p7r::PEV_IO_ZEROCOPY);
+
+  // The collected completions are kept for retrieval.
+  uint32_t completed = 0;
+  for (int i = 0 ; i < 50 && completed <= sequence ; ++i) {
+    p7r::zerocopy_completion completions[4];
+    size_t received = 0;
+    while (p7r::ERR_SUCCESS == client.zerocopy_completions(completions, 4,
+          received))
+    {
+      for (size_t j = 0 ; j < received ; ++j) {
+        completed += completions[j].last - completions[j].first + 1;
+      }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  ASSERT_EQ(sequence + 1, completed);
+
+  sched.unregister_connector(p7r::PEV_IO_READ, client, cb);
+}
+#endif
+
+
+TEST(ConnectorTCP, zerocopy_read_lease)
+{
+  p7r::connector server{test_env->api,
+    "tcp4://127.0.0.1:54411?blocking=1&zerocopy_receive=1"};
+  p7r::connector client{test_env->api, "tcp4://127.0.0.1:54411?blocking=1"};
+  ASSERT_TRUE(server.get_options() & p7r::CO_ZEROCOPY_RECEIVE);
+  ASSERT_FALSE(client.get_options() & p7r::CO_ZEROCOPY_RECEIVE);
+
+  auto err = server.listen();
+  if (p7r::ERR_UNSUPPORTED_ACTION == err) {
+    GTEST_SKIP();
+  }
+  ASSERT_EQ(p7r::ERR_SUCCESS, err);
+  ASSERT_EQ(p7r::ERR_SUCCESS, client.connect());
+  auto accepted = server.accept();
+  ASSERT_TRUE(accepted.connected());
+  ASSERT_TRUE(accepted.get_options() & p7r::CO_ZEROCOPY_RECEIVE);
+
+  // Send a few pages' worth, and a tail that does not fill a page.
+  std::vector<char> data(1024 * 1024 + 123);
+  for (size_t i = 0 ; i < data.size() ; ++i) {
+    data[i] = static_cast<char>(i % 251);
+  }
+  size_t offset = 0;
+  while (offset < data.size()) {
+    size_t amount = 0;
+    ASSERT_EQ(p7r::ERR_SUCCESS, client.write(&data[offset],
+          data.size() - offset, amount));
+    offset += amount;
+  }
+
+  // Leases must deliver the same byte stream, however it is split.
+  std::vector<char> result;
+  while (result.size() < data.size()) {
+    p7r::read_lease lease;
+    ASSERT_EQ(p7r::ERR_SUCCESS, accepted.read(lease));
+    ASSERT_NE(nullptr, lease.data);
+    ASSERT_GT(lease.size, 0);
+    auto start = static_cast<char const *>(lease.data);
+    result.insert(result.end(), start, start + lease.size);
+    ASSERT_EQ(p7r::ERR_SUCCESS, accepted.release(lease));
+    ASSERT_EQ(nullptr, lease.data);
+  }
+  ASSERT_EQ(data, result);
+
+  // Releasing twice is an error.
+  p7r::read_lease lease;
+  ASSERT_EQ(p7r::ERR_INVALID_VALUE, accepted.release(lease));
+
+  // Connectors without the option copy into the lease.
+  char msg[] = "hello";
+  size_t amount = 0;
+  ASSERT_EQ(p7r::ERR_SUCCESS, accepted.write(msg, sizeof(msg), amount));
+  ASSERT_EQ(p7r::ERR_SUCCESS, client.read(lease));
+  ASSERT_EQ(sizeof(msg), lease.size);
+  ASSERT_EQ(0, std::memcmp(msg, lease.data, sizeof(msg)));
+  auto buffer = lease.data;
+  ASSERT_EQ(p7r::ERR_SUCCESS, client.release(lease));
+
+  // Their buffer is reused.
+  ASSERT_EQ(p7r::ERR_SUCCESS, accepted.write(msg, sizeof(msg), amount));
+  ASSERT_EQ(p7r::ERR_SUCCESS, client.read(lease));
+  ASSERT_EQ(buffer, lease.data);
+  ASSERT_EQ(p7r::ERR_SUCCESS, client.release(lease));
+
+  // Leases outlive closing the connector.
+  std::vector<char> pages(64 * 1024, 'x');
+  ASSERT_EQ(p7r::ERR_SUCCESS, client.write(pages.data(), pages.size(),
+        amount));
+  ASSERT_EQ(p7r::ERR_SUCCESS, accepted.read(lease));
+  ASSERT_GT(lease.size, 0);
+  accepted.close();
+  ASSERT_EQ(std::vector<char>(lease.size, 'x'),
+      std::vector<char>(static_cast<char const *>(lease.data),
+        static_cast<char const *>(lease.data) + lease.size));
+  ASSERT_EQ(p7r::ERR_SUCCESS, accepted.release(lease));
+}
+
+
+
+namespace {
+
+void
+accept_from_group(std::string const & url, bool steer_by_cpu)
+{
+  std::vector<p7r::connector> group;
+  auto err = p7r::listen_group(test_env->api, url, 3, group, steer_by_cpu);
+  if (steer_by_cpu && p7r::ERR_UNSUPPORTED_ACTION == err) {
+    GTEST_SKIP();
+  }
+  ASSERT_EQ(p7r::ERR_SUCCESS, err);
+  ASSERT_EQ(3, group.size());
+
+  // Connectors outside the group can't share the address.
+  p7r::connector outsider{test_env->api, url};
+  ASSERT_EQ(p7r::ERR_ADDRESS_IN_USE, outsider.listen());
+
+  // Whichever member the kernel picks accepts the connection.
+  p7r::scheduler sched{test_env->api, 0};
+  std::vector<p7r::connector> accepted;
+  auto cb = [&accepted](p7r::time_point const &, p7r::events_t,
+      p7r::connector * conn) -> p7r::error_t
+  {
+    auto result = conn->accept();
+    if (result.communicating()) {
+      accepted.push_back(result);
+    }
+    return p7r::ERR_SUCCESS;
+  };
+  for (auto & member : group) {
+    sched.register_connector(p7r::PEV_IO_READ, member, cb);
+  }
+
+  std::vector<p7r::connector> clients;
+  for (int i = 0 ; i < 12 ; ++i) {
+    p7r::connector client{test_env->api, url};
+    auto cerr = client.connect();
+    ASSERT_TRUE(p7r::ERR_SUCCESS == cerr || p7r::ERR_ASYNC == cerr);
+    clients.push_back(client);
+  }
+
+  for (int rounds = 0 ; rounds < 500 && accepted.size() < clients.size()
+      ; ++rounds)
+  {
+    sched.process_events(std::chrono::milliseconds(1));
+  }
+  ASSERT_EQ(clients.size(), accepted.size());
+
+  for (auto & member : group) {
+    sched.unregister_connector(member);
+  }
+}
+
+} // anonymous namespace
+
+
+TEST(ConnectorTCP, listen_group)
+{
+  accept_from_group("tcp4://127.0.0.1:54414", false);
+}
+
+
+
+TEST(ConnectorTCP, listen_group_steer_by_cpu)
+{
+  accept_from_group("tcp4://127.0.0.1:54415", true);
+}
+
+
+
+TEST(ConnectorUDP, listen_group)
+{
+  std::vector<p7r::connector> group;
+  ASSERT_EQ(p7r::ERR_SUCCESS, p7r::listen_group(test_env->api,
+        "udp4://127.0.0.1:54416", 2, group));
+  ASSERT_EQ(2, group.size());
+  ASSERT_EQ("1", group[0].connect_url().query["reuseport"]);
+
+  // Bad groups.
+  std::vector<p7r::connector> bad;
+  ASSERT_EQ(p7r::ERR_INVALID_VALUE, p7r::listen_group(test_env->api,
+        "udp4://127.0.0.1:54417", 0, bad));
+  ASSERT_EQ(p7r::ERR_INVALID_OPTION, p7r::listen_group(test_env->api,
+        "anon://", 2, bad));
+  ASSERT_TRUE(bad.empty());
+}
+
+
+
+#if defined(PACKETEER_POSIX)
+namespace {
+
+int
+get_int_option(p7r::connector const & conn, int level, int name)
+{
+  int value = 0;
+  ::socklen_t len = sizeof(value);
+  auto ret = ::getsockopt(conn.get_read_handle().sys_handle(), level, name,
+      &value, &len);
+  EXPECT_EQ(0, ret);
+  return value;
+}
+
+} // anonymous namespace
+
+
+
+TEST(ConnectorTCP, tunables)
+{
+  p7r::connector server{test_env->api,
+    "tcp4://127.0.0.1:54420?rcvbuf=256K&nodelay=1&backlog=1024"};
+  ASSERT_EQ(p7r::ERR_SUCCESS, server.listen());
+
+  // The kernel may round buffer sizes up.
+  ASSERT_GE(get_int_option(server, SOL_SOCKET, SO_RCVBUF), 256 * 1024);
+  ASSERT_EQ(1, get_int_option(server, IPPROTO_TCP, TCP_NODELAY));
+
+  p7r::connector client{test_env->api,
+    "tcp4://127.0.0.1:54420?sndbuf=128K&nodelay=1"};
+  auto err = client.connect();
+  ASSERT_TRUE(p7r::ERR_SUCCESS == err || p7r::ERR_ASYNC == err);
+  ASSERT_GE(get_int_option(client, SOL_SOCKET, SO_SNDBUF), 128 * 1024);
+  ASSERT_EQ(1, get_int_option(client, IPPROTO_TCP, TCP_NODELAY));
+
+  // Bad values fail when the socket is created, or for the backlog, when
+  // the connector is.
+  p7r::connector bad_size{test_env->api,
+    "tcp4://127.0.0.1:54421?rcvbuf=lots"};
+  ASSERT_EQ(p7r::ERR_INVALID_VALUE, bad_size.listen());
+  p7r::connector bad_flag{test_env->api,
+    "tcp4://127.0.0.1:54421?nodelay=yes"};
+  ASSERT_EQ(p7r::ERR_INVALID_VALUE, bad_flag.listen());
+  ASSERT_THROW((p7r::connector{test_env->api,
+        "tcp4://127.0.0.1:54421?backlog=-1"}), p7r::exception);
+}
+
+
+
+TEST(ConnectorUDP, tunables)
+{
+  p7r::connector conn{test_env->api, "udp4://127.0.0.1:54422?rcvbuf=1M"};
+  ASSERT_EQ(p7r::ERR_SUCCESS, conn.listen());
+  ASSERT_GE(get_int_option(conn, SOL_SOCKET, SO_RCVBUF), 1024 * 1024);
+
+  // TCP options make no sense here.
+  p7r::connector bad{test_env->api, "udp4://127.0.0.1:54423?nodelay=1"};
+  ASSERT_EQ(p7r::ERR_UNSUPPORTED_ACTION, bad.listen());
+}
+#endif // PACKETEER_POSIX
+
+
+
+namespace {
+
+void
+fastopen_exchange(std::string const & server_url,
+    std::string const & client_url, bool with_data)
+{
+  p7r::connector server{test_env->api, server_url};
+  ASSERT_EQ(p7r::ERR_SUCCESS, server.listen());
+
+  // Twice, so that the second connection may use a Fast Open cookie.
+  for (int i = 0 ; i < 2 ; ++i) {
+    std::string msg = "Hello, world!";
+    p7r::connector client{test_env->api, client_url};
+
+    size_t written = 0;
+    p7r::error_t err = p7r::ERR_SUCCESS;
+    if (with_data) {
+      err = client.connect_with_data(msg.c_str(), msg.size(), written);
+    }
+    else {
+      err = client.connect();
+    }
+    ASSERT_TRUE(p7r::ERR_SUCCESS == err || p7r::ERR_ASYNC == err);
+    ASSERT_LE(written, msg.size());
+
+    p7r::connector conn;
+    for (int rounds = 0 ; rounds < 500 && !conn.communicating() ; ++rounds) {
+      conn = server.accept();
+      if (!conn.communicating()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+    ASSERT_TRUE(conn.communicating());
+
+    // Whatever did not go into the connection request is written now.
+    while (written < msg.size()) {
+      size_t amount = 0;
+      err = client.write(msg.c_str() + written, msg.size() - written, amount);
+      if (p7r::ERR_SUCCESS == err) {
+        written += amount;
+      }
+      else {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+
+    std::string received;
+    for (int rounds = 0 ; rounds < 500 && received.size() < msg.size()
+        ; ++rounds)
+    {
+      char buf[200] = { 0 };
+      size_t amount = 0;
+      err = conn.read(buf, sizeof(buf), amount);
+      if (p7r::ERR_SUCCESS == err) {
+        received.append(buf, amount);
+      }
+      else {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+    ASSERT_EQ(msg, received);
+  }
+}
+
+} // anonymous namespace
+
+
+
+TEST(ConnectorTCP, connect_with_data)
+{
+  fastopen_exchange("tcp4://127.0.0.1:54425?fastopen=16",
+      "tcp4://127.0.0.1:54425", true);
+}
+
+
+
+TEST(ConnectorTCP, fastopen_connect)
+{
+  p7r::connector probe{test_env->api,
+    "tcp4://127.0.0.1:54426?fastopen_connect=1"};
+  if (p7r::ERR_UNSUPPORTED_ACTION == probe.connect()) {
+    GTEST_SKIP();
+  }
+  probe.close();
+
+  fastopen_exchange("tcp4://127.0.0.1:54427?fastopen=16",
+      "tcp4://127.0.0.1:54427?fastopen_connect=1", false);
+}
+
+
+
+TEST(ConnectorAnon, connect_with_data)
+{
+  p7r::connector conn{test_env->api, "anon://?blocking=1"};
+
+  std::string msg = "Hello, world!";
+  size_t written = 0;
+  ASSERT_EQ(p7r::ERR_SUCCESS, conn.connect_with_data(msg.c_str(), msg.size(),
+        written));
+  ASSERT_EQ(msg.size(), written);
+
+  char buf[200] = { 0 };
+  size_t amount = 0;
+  ASSERT_EQ(p7r::ERR_SUCCESS, conn.read(buf, sizeof(buf), amount));
+  ASSERT_EQ(msg, std::string(buf, amount));
+}
+
+
+
+TEST(ConnectorTCP, accept_many)
+{
+  p7r::connector server{test_env->api, "tcp4://127.0.0.1:54418"};
+  ASSERT_EQ(p7r::ERR_SUCCESS, server.listen());
+
+  std::vector<p7r::connector> accepted;
+  ASSERT_EQ(p7r::ERR_REPEAT_ACTION, server.accept_many(accepted, 16));
+  ASSERT_TRUE(accepted.empty());
+
+  std::vector<p7r::connector> clients;
+  for (int i = 0 ; i < 5 ; ++i) {
+    p7r::connector client{test_env->api, "tcp4://127.0.0.1:54418"};
+    auto err = client.connect();
+    ASSERT_TRUE(p7r::ERR_SUCCESS == err || p7r::ERR_ASYNC == err);
+    clients.push_back(client);
+  }
+
+  // At most max connections are accepted per call, but the backlog is
+  // drained eventually.
+  for (int rounds = 0 ; rounds < 500 && accepted.size() < clients.size()
+      ; ++rounds)
+  {
+    auto before = accepted.size();
+    auto err = server.accept_many(accepted, 2);
+    if (p7r::ERR_REPEAT_ACTION == err) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      continue;
+    }
+    ASSERT_EQ(p7r::ERR_SUCCESS, err);
+    ASSERT_LE(accepted.size() - before, 2);
+  }
+  ASSERT_EQ(clients.size(), accepted.size());
+
+  for (auto & conn : accepted) {
+    ASSERT_TRUE(conn.communicating());
+    ASSERT_FALSE(conn.is_blocking());
+    ASSERT_EQ(server.type(), conn.type());
+  }
+}
+
+
+
+TEST(ConnectorTCP, accept_many_blocking)
+{
+  p7r::connector server{test_env->api, "tcp4://127.0.0.1:54419?blocking=1"};
+  ASSERT_EQ(p7r::ERR_SUCCESS, server.listen());
+  ASSERT_TRUE(server.is_blocking());
+
+  p7r::connector client{test_env->api, "tcp4://127.0.0.1:54419"};
+  auto err = client.connect();
+  ASSERT_TRUE(p7r::ERR_SUCCESS == err || p7r::ERR_ASYNC == err);
+
+  // A blocking listener must not wait for more requests than are pending.
+  std::vector<p7r::connector> accepted;
+  ASSERT_EQ(p7r::ERR_SUCCESS, server.accept_many(accepted, 16));
+  ASSERT_EQ(1, accepted.size());
+  ASSERT_TRUE(accepted[0].communicating());
+}
+
+
+
+TEST(ConnectorAnon, accept_many)
+{
+  p7r::connector conn{test_env->api, "anon://"};
+  ASSERT_EQ(p7r::ERR_SUCCESS, conn.listen());
+
+  // Connectors returning themselves are only accepted once.
+  std::vector<p7r::connector> accepted;
+  ASSERT_EQ(p7r::ERR_SUCCESS, conn.accept_many(accepted, 16));
+  ASSERT_EQ(1, accepted.size());
+  ASSERT_EQ(conn, accepted[0]);
+}
+
+
+
+TEST(ConnectorSplice, anon_to_anon)
+{
+  p7r::connector in{test_env->api, "anon://"};
+  p7r::connector out{test_env->api, "anon://"};
+  ASSERT_EQ(p7r::ERR_SUCCESS, in.connect());
+  ASSERT_EQ(p7r::ERR_SUCCESS, out.connect());
+
+  // Nothing to forward yet.
+  size_t transferred = 0;
+  ASSERT_EQ(p7r::ERR_REPEAT_ACTION, in.splice_to(out, 100, transferred));
+  ASSERT_EQ(0, transferred);
+
+  // Forwarding respects the maximum.
+  size_t amount = 0;
+  ASSERT_EQ(p7r::ERR_SUCCESS, in.write("hello, world", 12, amount));
+  ASSERT_EQ(p7r::ERR_SUCCESS, in.splice_to(out, 5, transferred));
+  ASSERT_EQ(5, transferred);
+  ASSERT_EQ(p7r::ERR_SUCCESS, in.splice_to(out, 100, transferred));
+  ASSERT_EQ(7, transferred);
+
+  char buf[4096];
+  ASSERT_EQ(p7r::ERR_SUCCESS, out.read(buf, sizeof(buf), amount));
+  ASSERT_EQ(std::string{"hello, world"}, std::string(buf, amount));
+
+  // Fill the destination. Data read from the source is then held back until
+  // the destination drains.
+  std::memset(buf, 'x', sizeof(buf));
+  while (p7r::ERR_SUCCESS == out.write(buf, sizeof(buf), amount)
+      && amount == sizeof(buf))
+  {
+  }
+  ASSERT_EQ(p7r::ERR_SUCCESS, in.write("abc", 3, amount));
+  ASSERT_EQ(p7r::ERR_ASYNC, in.splice_to(out, 100, transferred));
+  ASSERT_EQ(0, transferred);
+
+  while (p7r::ERR_SUCCESS == out.read(buf, sizeof(buf), amount)) {
+    ASSERT_EQ('x', buf[0]);
+  }
+  ASSERT_EQ(p7r::ERR_SUCCESS, in.splice_to(out, 100, transferred));
+  ASSERT_EQ(3, transferred);
+  ASSERT_EQ(p7r::ERR_SUCCESS, out.read(buf, sizeof(buf), amount));
+  ASSERT_EQ(std::string{"abc"}, std::string(buf, amount));
+}
+
+
+
+TEST(ConnectorSplice, tcp_to_tcp)
+{
+  p7r::connector server1{test_env->api, "tcp4://127.0.0.1:54412?blocking=1"};
+  p7r::connector server2{test_env->api, "tcp4://127.0.0.1:54413?blocking=1"};
+  p7r::connector client1{test_env->api, "tcp4://127.0.0.1:54412?blocking=1"};
+  p7r::connector client2{test_env->api, "tcp4://127.0.0.1:54413?blocking=1"};
+  ASSERT_EQ(p7r::ERR_SUCCESS, server1.listen());
+  ASSERT_EQ(p7r::ERR_SUCCESS, server2.listen());
+  ASSERT_EQ(p7r::ERR_SUCCESS, client1.connect());
+  ASSERT_EQ(p7r::ERR_SUCCESS, client2.connect());
+  auto accepted1 = server1.accept();
+  auto accepted2 = server2.accept();
+
+  // Forward everything client1 sends from accepted1 to client2, and read it
+  // back from accepted2.
+  std::vector<char> data(256 * 1024);
+  for (size_t i = 0 ; i < data.size() ; ++i) {
+    data[i] = static_cast<char>(i % 251);
+  }
+  std::thread sender([&]()
+  {
+    size_t offset = 0;
+    while (offset < data.size()) {
+      size_t amount = 0;
+      ASSERT_EQ(p7r::ERR_SUCCESS, client1.write(&data[offset],
+            data.size() - offset, amount));
+      offset += amount;
+    }
+  });
+
+  // Sockets are closed forcibly, so we can't signal the end of data by
+  // closing them; forward exactly the amount sent instead.
+  std::thread forwarder([&]()
+  {
+    size_t total = 0;
+    while (total < data.size()) {
+      size_t transferred = 0;
+      ASSERT_EQ(p7r::ERR_SUCCESS, accepted1.splice_to(client2,
+            data.size() - total, transferred, p7r::SF_MORE));
+      ASSERT_GT(transferred, 0);
+      total += transferred;
+    }
+  });
+
+  std::vector<char> result;
+  char buf[8192];
+  while (result.size() < data.size()) {
+    size_t amount = 0;
+    ASSERT_EQ(p7r::ERR_SUCCESS, accepted2.read(buf, sizeof(buf), amount));
+    ASSERT_GT(amount, 0);
+    result.insert(result.end(), buf, buf + amount);
+  }
+
+  sender.join();
+  forwarder.join();
+  ASSERT_EQ(data, result);
+}
+
+
 /*****************************************************************************
  * ConnectorDGram
  */
@@ -1051,6 +1910,126 @@ void send_message_dgram(p7r::connector & sender, p7r::connector & receiver,
 
 
 
+void send_message_dgram_vectored(p7r::connector & sender,
+    p7r::connector & receiver)
+{
+  std::string header = "HEAD";
+  std::string payload = "hello, world!";
+  p7r::const_io_buffer out[] = {
+    { header.c_str(), header.size() },
+    { payload.c_str(), payload.size() },
+  };
+  size_t amount = 0;
+  ASSERT_EQ(p7r::ERR_SUCCESS, sender.send(out, 2, amount,
+      receiver.peer_addr()));
+  ASSERT_EQ(header.size() + payload.size(), amount);
+
+  std::this_thread::sleep_for(TEST_SLEEP_TIME);
+
+  // The whole datagram is scattered across both buffers.
+  char first[4] = { 0 };
+  char second[100] = { 0 };
+  p7r::io_buffer in[] = {
+    { first, sizeof(first) },
+    { second, sizeof(second) },
+  };
+  packeteer::peer_address sendaddr;
+  ASSERT_EQ(p7r::ERR_SUCCESS, receiver.receive(in, 2, amount, sendaddr));
+  ASSERT_EQ(header.size() + payload.size(), amount);
+  ASSERT_EQ(sender.peer_addr(), sendaddr);
+
+  ASSERT_EQ(header, (std::string{first, first + sizeof(first)}));
+  ASSERT_EQ(payload, (std::string{second, second + payload.size()}));
+}
+
+
+
+void send_message_dgram_batch(p7r::connector & sender,
+    p7r::connector & receiver)
+{
+  constexpr size_t COUNT = 5;
+
+  std::vector<std::string> payloads;
+  p7r::const_datagram_message out[COUNT];
+  for (size_t i = 0 ; i < COUNT ; ++i) {
+    payloads.push_back("Hello, world! [" + std::to_string(i) + "]");
+  }
+  for (size_t i = 0 ; i < COUNT ; ++i) {
+    out[i].buffer = { payloads[i].c_str(), payloads[i].size() };
+    out[i].length = 0;
+    out[i].address = receiver.peer_addr().socket_address();
+  }
+
+  size_t amount = 0;
+  ASSERT_EQ(p7r::ERR_SUCCESS, sender.send_batch(out, COUNT, amount));
+  ASSERT_EQ(COUNT, amount);
+  for (size_t i = 0 ; i < COUNT ; ++i) {
+    ASSERT_EQ(payloads[i].size(), out[i].length);
+  }
+
+  std::this_thread::sleep_for(TEST_SLEEP_TIME);
+
+  // Offer more slots than there are datagrams pending.
+  char bufs[COUNT + 2][100];
+  p7r::datagram_message in[COUNT + 2];
+  for (size_t i = 0 ; i < COUNT + 2 ; ++i) {
+    in[i].buffer = { bufs[i], sizeof(bufs[i]) };
+    in[i].length = 0;
+  }
+
+  ASSERT_EQ(p7r::ERR_SUCCESS, receiver.receive_batch(in, COUNT + 2, amount));
+  ASSERT_EQ(COUNT, amount);
+  for (size_t i = 0 ; i < COUNT ; ++i) {
+    ASSERT_EQ(payloads[i], (std::string{bufs[i], bufs[i] + in[i].length}));
+    ASSERT_EQ(sender.peer_addr().socket_address(), in[i].address);
+  }
+
+  // Nothing is left to receive.
+  ASSERT_EQ(p7r::ERR_REPEAT_ACTION, receiver.receive_batch(in, 1, amount));
+}
+
+
+
+void send_message_dgram_segmented(p7r::connector & sender,
+    p7r::connector & receiver)
+{
+  // Three full segments and a shorter one.
+  constexpr size_t SEGMENT = 100;
+  std::string payload;
+  for (size_t i = 0 ; i < 3 * SEGMENT + SEGMENT / 2 ; ++i) {
+    payload.push_back('a' + (i / SEGMENT));
+  }
+
+  size_t amount = 0;
+  ASSERT_EQ(p7r::ERR_SUCCESS, sender.send(payload.c_str(), payload.size(),
+      amount, receiver.peer_addr(), SEGMENT));
+  ASSERT_EQ(payload.size(), amount);
+
+  std::this_thread::sleep_for(TEST_SLEEP_TIME);
+
+  // Datagrams may or may not be coalesced, but each has the segment size,
+  // except for the last.
+  std::string received;
+  std::vector<char> buf(65536);
+  while (received.size() < payload.size()) {
+    p7r::peer_address sendaddr;
+    size_t segment_size = 0;
+    ASSERT_EQ(p7r::ERR_SUCCESS, receiver.receive(&buf[0], buf.size(), amount,
+        sendaddr, segment_size));
+    ASSERT_GT(amount, 0);
+    if (amount > segment_size) {
+      ASSERT_EQ(SEGMENT, segment_size);
+    }
+    else {
+      ASSERT_EQ(amount, segment_size);
+    }
+    received.append(&buf[0], amount);
+  }
+  ASSERT_EQ(payload, received);
+}
+
+
+
 void send_message_dgram_async(int index,
     std::multimap<p7r::peer_address, std::string> & result,
     p7r::connector & sender,
@@ -1228,6 +2207,90 @@ TEST_P(ConnectorDGram, messaging)
 
 
 
+TEST_P(ConnectorDGram, vectored_messaging)
+{
+  auto td = GetParam();
+
+  auto surl = liberate::net::url::parse(td.dgram_first);
+  surl.query["behaviour"] = "datagram";
+  auto curl = liberate::net::url::parse(td.dgram_second);
+  curl.query["behaviour"] = "datagram";
+
+  auto res = setup_dgram_connection(td.type, surl, {curl});
+  if (!res.first) GTEST_SKIP();
+
+  auto server = res.first;
+  auto client = res.second[0];
+
+  send_message_dgram_vectored(client, server);
+  send_message_dgram_vectored(server, client);
+}
+
+
+
+TEST_P(ConnectorDGram, batch_messaging)
+{
+  auto td = GetParam();
+
+  auto surl = liberate::net::url::parse(td.dgram_first);
+  surl.query["behaviour"] = "datagram";
+  auto curl = liberate::net::url::parse(td.dgram_second);
+  curl.query["behaviour"] = "datagram";
+
+  auto res = setup_dgram_connection(td.type, surl, {curl});
+  if (!res.first) GTEST_SKIP();
+
+  auto server = res.first;
+  auto client = res.second[0];
+
+  send_message_dgram_batch(client, server);
+  send_message_dgram_batch(server, client);
+}
+
+
+
+TEST_P(ConnectorDGram, segmented_messaging)
+{
+  auto td = GetParam();
+
+  auto surl = liberate::net::url::parse(td.dgram_first);
+  surl.query["behaviour"] = "datagram";
+  auto curl = liberate::net::url::parse(td.dgram_second);
+  curl.query["behaviour"] = "datagram";
+
+  auto res = setup_dgram_connection(td.type, surl, {curl});
+  if (!res.first) GTEST_SKIP();
+
+  auto server = res.first;
+  auto client = res.second[0];
+
+  send_message_dgram_segmented(client, server);
+  send_message_dgram_segmented(server, client);
+}
+
+
+
+TEST(ConnectorUDP, segmented_messaging_gro)
+{
+  // With receive offload, the kernel may coalesce the segments again.
+  p7r::connector first{test_env->api, "udp4://127.0.0.1:54321?gro=1"};
+  p7r::connector second{test_env->api, "udp4://127.0.0.1:54322?gro=1"};
+  ASSERT_TRUE(first.get_options() & p7r::CO_UDP_GRO);
+  ASSERT_TRUE(second.get_options() & p7r::CO_UDP_GRO);
+
+  auto err = first.listen();
+  if (p7r::ERR_UNSUPPORTED_ACTION == err) {
+    GTEST_SKIP();
+  }
+  ASSERT_EQ(p7r::ERR_SUCCESS, err);
+  ASSERT_EQ(p7r::ERR_SUCCESS, second.listen());
+
+  send_message_dgram_segmented(first, second);
+  send_message_dgram_segmented(second, first);
+}
+
+
+
 TEST_P(ConnectorDGram, peek_from_send)
 {
   // Tests for "datagram" connectors, i.e. connectors that allow synchronous,
@@ -155,3 +155,29 @@ TEST(PeerAddressValueSemantics, different_protocol)
   test_less_than(first, second);
   test_hashing_inequality(first, second);
 }
+
+
+TEST(PeerAddressValueSemantics, interned_scheme)
+{
+  using namespace packeteer;
+
+  auto api = packeteer::api::create();
+
+  peer_address first{api, "udp4://192.168.0.1:1234"};
+  peer_address second{api, "udp://192.168.0.2:1234"};
+  peer_address third{api, "tcp4://192.168.0.1:1234"};
+
+  // Addresses with the same scheme share its storage.
+  ASSERT_EQ(first.scheme_cstr(), second.scheme_cstr());
+  ASSERT_STREQ("udp4", first.scheme_cstr());
+
+  // Swapping swaps schemes, too.
+  swap(first, third);
+  ASSERT_EQ("tcp4", first.scheme());
+  ASSERT_EQ("udp4", third.scheme());
+
+  // Assigning the type keeps the socket address.
+  third.assign_type(first);
+  ASSERT_EQ("tcp4://192.168.0.1:1234", third.str());
+  ASSERT_EQ(first, third);
+}
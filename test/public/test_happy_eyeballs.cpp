@@ -0,0 +1,195 @@
+/**
+ * This file is part of packeteer.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <build-config.h>
+
+#include "../env.h"
+
+#include <packeteer/happy_eyeballs.h>
+
+#include <chrono>
+#include <vector>
+
+namespace p7r = packeteer;
+namespace l6e = liberate;
+
+namespace {
+
+struct race_result
+{
+  size_t          invocations = 0;
+  p7r::error_t    error = p7r::ERR_UNEXPECTED;
+  p7r::connector  conn = {};
+
+  p7r::happy_eyeballs_callback callback()
+  {
+    return [this](p7r::error_t err, p7r::connector const & c)
+    {
+      ++invocations;
+      error = err;
+      conn = c;
+    };
+  }
+};
+
+
+
+void
+process_until(p7r::scheduler & sched, race_result const & result)
+{
+  for (int rounds = 0 ; rounds < 2000 && !result.invocations ; ++rounds) {
+    sched.process_events(std::chrono::milliseconds(1));
+  }
+}
+
+
+
+std::set<l6e::net::url>
+candidates(std::vector<std::string> const & urls)
+{
+  std::set<l6e::net::url> result;
+  for (auto & url : urls) {
+    result.insert(l6e::net::url::parse(url));
+  }
+  return result;
+}
+
+} // anonymous namespace
+
+
+
+TEST(HappyEyeballs, errors)
+{
+  p7r::scheduler sched{test_env->api, 0};
+  race_result res;
+
+  ASSERT_EQ(p7r::ERR_INVALID_VALUE, p7r::happy_eyeballs_connect(test_env->api,
+        sched, std::set<l6e::net::url>{}, res.callback()));
+  ASSERT_EQ(p7r::ERR_EMPTY_CALLBACK, p7r::happy_eyeballs_connect(
+        test_env->api, sched, candidates({"tcp4://127.0.0.1:54440"}), {}));
+}
+
+
+
+TEST(HappyEyeballs, single_candidate)
+{
+  p7r::connector server{test_env->api, "tcp4://127.0.0.1:54441"};
+  ASSERT_EQ(p7r::ERR_SUCCESS, server.listen());
+
+  p7r::scheduler sched{test_env->api, 0};
+  race_result res;
+  ASSERT_EQ(p7r::ERR_SUCCESS, p7r::happy_eyeballs_connect(test_env->api,
+        sched, candidates({"tcp4://127.0.0.1:54441"}), res.callback()));
+
+  // The callback is only invoked from the scheduler.
+  ASSERT_EQ(0, res.invocations);
+  process_until(sched, res);
+  ASSERT_EQ(1, res.invocations);
+  ASSERT_EQ(p7r::ERR_SUCCESS, res.error);
+  ASSERT_TRUE(res.conn.connected());
+  ASSERT_FALSE(res.conn.is_blocking());
+}
+
+
+
+TEST(HappyEyeballs, failure_starts_next_attempt)
+{
+  p7r::connector server{test_env->api, "tcp4://127.0.0.1:54442"};
+  ASSERT_EQ(p7r::ERR_SUCCESS, server.listen());
+
+  // IPv6 is tried first, but nothing listens there. The IPv4 attempt starts
+  // well before the attempt delay passed.
+  p7r::scheduler sched{test_env->api, 0};
+  race_result res;
+  auto start = p7r::clock::now();
+  ASSERT_EQ(p7r::ERR_SUCCESS, p7r::happy_eyeballs_connect(test_env->api,
+        sched, candidates({"tcp6://[::1]:54442", "tcp4://127.0.0.1:54442"}),
+        res.callback(), std::chrono::seconds(10)));
+
+  process_until(sched, res);
+  ASSERT_EQ(1, res.invocations);
+  ASSERT_EQ(p7r::ERR_SUCCESS, res.error);
+  ASSERT_EQ("tcp4", res.conn.connect_url().scheme);
+  ASSERT_LT(p7r::clock::now() - start, std::chrono::seconds(5));
+}
+
+
+
+TEST(HappyEyeballs, all_fail)
+{
+  p7r::scheduler sched{test_env->api, 0};
+  race_result res;
+  ASSERT_EQ(p7r::ERR_SUCCESS, p7r::happy_eyeballs_connect(test_env->api,
+        sched, candidates({"tcp6://[::1]:54443", "tcp4://127.0.0.1:54443"}),
+        res.callback()));
+
+  process_until(sched, res);
+  ASSERT_EQ(1, res.invocations);
+  ASSERT_NE(p7r::ERR_SUCCESS, res.error);
+  ASSERT_FALSE(res.conn);
+}
+
+
+
+#if defined(PACKETEER_HAVE_SELECT)
+TEST(HappyEyeballs, all_fail_with_select)
+{
+  // select() reports refused connections as writable only.
+  p7r::scheduler sched{test_env->api, 0, p7r::scheduler::TYPE_SELECT};
+  race_result res;
+  ASSERT_EQ(p7r::ERR_SUCCESS, p7r::happy_eyeballs_connect(test_env->api,
+        sched, candidates({"tcp6://[::1]:54445", "tcp4://127.0.0.1:54445"}),
+        res.callback()));
+
+  process_until(sched, res);
+  ASSERT_EQ(1, res.invocations);
+  ASSERT_NE(p7r::ERR_SUCCESS, res.error);
+  ASSERT_FALSE(res.conn);
+}
+#endif
+
+
+TEST(HappyEyeballs, slow_candidate_is_overtaken)
+{
+  // With a full accept queue, the kernel drops SYNs to the first address, so
+  // the attempt hangs. The second address wins after the attempt delay.
+  p7r::connector slow{test_env->api, "tcp4://127.0.0.1:54444?backlog=0"};
+  ASSERT_EQ(p7r::ERR_SUCCESS, slow.listen());
+  std::vector<p7r::connector> fill;
+  for (int i = 0 ; i < 4 ; ++i) {
+    fill.emplace_back(test_env->api, "tcp4://127.0.0.1:54444?blocking=0");
+    fill.back().connect();
+  }
+
+  p7r::connector fast{test_env->api, "tcp4://127.0.0.2:54444"};
+  ASSERT_EQ(p7r::ERR_SUCCESS, fast.listen());
+
+  p7r::scheduler sched{test_env->api, 0};
+  race_result res;
+  auto start = p7r::clock::now();
+  ASSERT_EQ(p7r::ERR_SUCCESS, p7r::happy_eyeballs_connect(test_env->api,
+        sched, candidates({"tcp4://127.0.0.1:54444", "tcp4://127.0.0.2:54444"}),
+        res.callback(), std::chrono::milliseconds(50)));
+
+  process_until(sched, res);
+  ASSERT_EQ(1, res.invocations);
+  ASSERT_EQ(p7r::ERR_SUCCESS, res.error);
+  ASSERT_EQ("127.0.0.2:54444", res.conn.connect_url().authority);
+  ASSERT_GE(p7r::clock::now() - start, std::chrono::milliseconds(50));
+}
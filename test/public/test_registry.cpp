@@ -98,6 +98,77 @@ TEST(Registry, parse_user)
 }
 
 
+/***************************************************************************
+ * Tunable interface
+ */
+
+TEST(Registry, tunable_empty)
+{
+  using namespace packeteer;
+  auto api = api::create();
+
+  ASSERT_EQ(ERR_INVALID_VALUE, api->reg().add_tunable("", nullptr));
+  ASSERT_EQ(ERR_EMPTY_CALLBACK, api->reg().add_tunable("foo", nullptr));
+}
+
+
+
+TEST(Registry, tunable_duplicate)
+{
+  using namespace packeteer;
+  auto api = api::create();
+
+  auto dummy = [] (handle const &, std::string const &) -> packeteer::error_t {
+    return ERR_SUCCESS;
+  };
+
+  ASSERT_EQ(ERR_SUCCESS, api->reg().add_tunable("foo", dummy));
+  ASSERT_EQ(ERR_INVALID_VALUE, api->reg().add_tunable("foo", dummy));
+
+  // Tunables and option parameters share names.
+  auto mapper = [] (std::string const &, bool) -> connector_options {
+    return CO_DEFAULT;
+  };
+  ASSERT_EQ(ERR_INVALID_VALUE, api->reg().add_parameter("foo", mapper));
+  ASSERT_EQ(ERR_INVALID_VALUE, api->reg().add_tunable("blocking", dummy));
+
+#if defined(PACKETEER_POSIX)
+  // Built-in tunables are registered.
+  ASSERT_EQ(ERR_INVALID_VALUE, api->reg().add_tunable("rcvbuf", dummy));
+#endif
+}
+
+
+
+TEST(Registry, tunable_user)
+{
+  using namespace packeteer;
+  auto api = api::create();
+
+  std::string applied;
+  auto tunable = [&applied] (handle const &, std::string const & value)
+    -> packeteer::error_t
+  {
+    applied = value;
+    return ERR_SUCCESS;
+  };
+  ASSERT_EQ(ERR_SUCCESS, api->reg().add_tunable("foo", tunable));
+
+  // Unknown parameters and option parameters are no tunables.
+  std::map<std::string, std::string> query;
+  query["bar"] = "1";
+  query["blocking"] = "1";
+  ASSERT_TRUE(api->reg().tunables_from_query(query).empty());
+
+  // With "foo", we get a tunable bound to the value.
+  query["foo"] = "42";
+  auto tunables = api->reg().tunables_from_query(query);
+  ASSERT_EQ(1, tunables.size());
+  ASSERT_EQ(ERR_SUCCESS, tunables[0](handle{}));
+  ASSERT_EQ("42", applied);
+}
+
+
 /***************************************************************************
  * Scheme interface
  */
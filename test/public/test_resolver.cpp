@@ -21,6 +21,12 @@
 
 #include <packeteer.h>
 #include <packeteer/resolver.h>
+#include <packeteer/scheduler.h>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
 
 namespace p7r = packeteer;
 namespace l6e = liberate;
@@ -278,3 +284,222 @@ TEST(Resolver, custom_scheme_produces_errors)
   err = api->resolver().resolve(results, url);
   ASSERT_EQ(p7r::ERR_UNEXPECTED, err);
 }
+
+
+
+namespace {
+
+struct async_result
+{
+  size_t                  invocations = 0;
+  p7r::error_t            error = p7r::ERR_UNEXPECTED;
+  std::set<l6e::net::url> results = {};
+
+  p7r::resolver::resolution_callback callback()
+  {
+    return [this](p7r::error_t err, std::set<l6e::net::url> const & res)
+    {
+      ++invocations;
+      error = err;
+      results = res;
+    };
+  }
+};
+
+
+
+void
+process_until(p7r::scheduler & sched, std::function<bool ()> predicate)
+{
+  for (int rounds = 0 ; rounds < 1000 && !predicate() ; ++rounds) {
+    sched.process_events(std::chrono::milliseconds(1));
+  }
+}
+
+
+
+// Counts invocations, and records the thread it was invoked on.
+struct counting_function
+{
+  std::atomic<size_t>     calls = 0;
+  std::thread::id         thread_id = {};
+  p7r::error_t            result = p7r::ERR_SUCCESS;
+
+  p7r::resolver::resolution_function function()
+  {
+    return [this](std::shared_ptr<p7r::api>, std::set<l6e::net::url> & res,
+        l6e::net::url const & query) -> p7r::error_t
+    {
+      thread_id = std::this_thread::get_id();
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      ++calls;
+      if (p7r::ERR_SUCCESS == result) {
+        auto copy = query;
+        copy.path = "/resolved";
+        res.insert(copy);
+      }
+      return result;
+    };
+  }
+};
+
+} // anonymous namespace
+
+
+TEST(Resolver, async_tcp4_with_ip)
+{
+  p7r::scheduler sched{test_env->api, 0};
+
+  async_result res;
+  auto url = l6e::net::url::parse("tcp4://127.0.0.1:12345/foo/bar?quux=asdas");
+  auto err = test_env->api->resolver().resolve_async(sched, url,
+      res.callback());
+  ASSERT_EQ(p7r::ERR_SUCCESS, err);
+
+  process_until(sched, [&res]() { return res.invocations > 0; });
+  ASSERT_EQ(1, res.invocations);
+  ASSERT_EQ(p7r::ERR_SUCCESS, res.error);
+  ASSERT_EQ(1, res.results.size());
+  ASSERT_EQ("127.0.0.1:12345", res.results.begin()->authority);
+}
+
+
+TEST(Resolver, async_errors)
+{
+  p7r::scheduler sched{test_env->api, 0};
+
+  auto url = l6e::net::url::parse("test-scheme:///foo/bar");
+  async_result res;
+  auto err = test_env->api->resolver().resolve_async(sched, url,
+      res.callback());
+  ASSERT_EQ(p7r::ERR_INVALID_VALUE, err);
+
+  url = l6e::net::url::parse("tcp4://127.0.0.1:12345");
+  err = test_env->api->resolver().resolve_async(sched, url, {});
+  ASSERT_EQ(p7r::ERR_EMPTY_CALLBACK, err);
+}
+
+
+TEST(Resolver, async_coalesces_and_caches)
+{
+  auto api = packeteer::api::create();
+  p7r::scheduler sched{api, 0};
+
+  counting_function func;
+  ASSERT_EQ(p7r::ERR_SUCCESS, api->resolver().register_resolution_function(
+        "test-scheme", func.function()));
+
+  // Identical queries in flight share a lookup, which does not run on the
+  // calling thread.
+  auto url = l6e::net::url::parse("test-scheme:///foo/bar");
+  async_result res[3];
+  for (auto & r : res) {
+    ASSERT_EQ(p7r::ERR_SUCCESS, api->resolver().resolve_async(sched, url,
+          r.callback()));
+  }
+
+  process_until(sched, [&res]() {
+      return res[0].invocations && res[1].invocations && res[2].invocations;
+  });
+  ASSERT_EQ(1, func.calls);
+  ASSERT_NE(std::this_thread::get_id(), func.thread_id);
+  for (auto & r : res) {
+    ASSERT_EQ(1, r.invocations);
+    ASSERT_EQ(p7r::ERR_SUCCESS, r.error);
+    ASSERT_EQ(1, r.results.size());
+    ASSERT_EQ("/resolved", r.results.begin()->path);
+  }
+
+  // Later queries are answered from the cache, asynchronously or not.
+  async_result cached;
+  ASSERT_EQ(p7r::ERR_SUCCESS, api->resolver().resolve_async(sched, url,
+        cached.callback()));
+  ASSERT_EQ(0, cached.invocations);
+  process_until(sched, [&cached]() { return cached.invocations > 0; });
+  ASSERT_EQ(1, cached.invocations);
+  ASSERT_EQ(1, cached.results.size());
+
+  std::set<l6e::net::url> results;
+  ASSERT_EQ(p7r::ERR_SUCCESS, api->resolver().resolve(results, url));
+  ASSERT_EQ(1, results.size());
+  ASSERT_EQ(1, func.calls);
+
+  // Until the cache is cleared.
+  api->resolver().clear_cache();
+  results.clear();
+  ASSERT_EQ(p7r::ERR_SUCCESS, api->resolver().resolve(results, url));
+  ASSERT_EQ(2, func.calls);
+}
+
+
+TEST(Resolver, async_throwing_function)
+{
+  auto api = packeteer::api::create();
+  p7r::scheduler sched{api, 0};
+
+  ASSERT_EQ(p7r::ERR_SUCCESS, api->resolver().register_resolution_function(
+        "test-scheme",
+        [](std::shared_ptr<p7r::api>, std::set<l6e::net::url> &,
+          l6e::net::url const &) -> p7r::error_t
+        {
+          throw std::runtime_error("resolution failed");
+        }));
+
+  // All waiters learn about the failure.
+  auto url = l6e::net::url::parse("test-scheme:///foo/bar");
+  async_result res[2];
+  for (auto & r : res) {
+    ASSERT_EQ(p7r::ERR_SUCCESS, api->resolver().resolve_async(sched, url,
+          r.callback()));
+  }
+
+  process_until(sched, [&res]() {
+      return res[0].invocations && res[1].invocations;
+  });
+  for (auto & r : res) {
+    ASSERT_EQ(1, r.invocations);
+    ASSERT_EQ(p7r::ERR_UNEXPECTED, r.error);
+    ASSERT_TRUE(r.results.empty());
+  }
+}
+
+
+TEST(Resolver, cache_ttl)
+{
+  auto api = packeteer::api::create();
+
+  counting_function func;
+  func.result = p7r::ERR_ADDRESS_NOT_AVAILABLE;
+  ASSERT_EQ(p7r::ERR_SUCCESS, api->resolver().register_resolution_function(
+        "test-scheme", func.function()));
+  auto url = l6e::net::url::parse("test-scheme:///foo/bar");
+  std::set<l6e::net::url> results;
+
+  // Failures are cached.
+  ASSERT_EQ(p7r::ERR_ADDRESS_NOT_AVAILABLE,
+      api->resolver().resolve(results, url));
+  ASSERT_EQ(p7r::ERR_ADDRESS_NOT_AVAILABLE,
+      api->resolver().resolve(results, url));
+  ASSERT_EQ(1, func.calls);
+
+  // Until they expire.
+  api->resolver().set_cache_ttl(std::chrono::milliseconds(10),
+      std::chrono::milliseconds(10));
+  api->resolver().clear_cache();
+  ASSERT_EQ(p7r::ERR_ADDRESS_NOT_AVAILABLE,
+      api->resolver().resolve(results, url));
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  ASSERT_EQ(p7r::ERR_ADDRESS_NOT_AVAILABLE,
+      api->resolver().resolve(results, url));
+  ASSERT_EQ(3, func.calls);
+
+  // A TTL of zero disables caching.
+  api->resolver().set_cache_ttl(std::chrono::seconds(1), p7r::duration{0});
+  api->resolver().clear_cache();
+  ASSERT_EQ(p7r::ERR_ADDRESS_NOT_AVAILABLE,
+      api->resolver().resolve(results, url));
+  ASSERT_EQ(p7r::ERR_ADDRESS_NOT_AVAILABLE,
+      api->resolver().resolve(results, url));
+  ASSERT_EQ(5, func.calls);
+  ASSERT_TRUE(results.empty());
+}
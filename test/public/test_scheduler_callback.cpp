@@ -24,6 +24,7 @@
 #include <gtest/gtest.h>
 
 #include <functional>
+#include <array>
 
 #include "../value_tests.h"
 #include "../test_name.h"
@@ -403,3 +404,65 @@ TEST(CallbackMisc, empty)
 
 
 
+
+
+
+TEST(CallbackMisc, inline_storage)
+{
+  // Mutable lambdas are shared between copies even if they are small enough
+  // for the inline storage, so copies see each other's state. Moving keeps
+  // the state.
+  auto now = p7r::clock::now();
+  int value = 3;
+  p7r::callback cb = [value](p7r::time_point const &, p7r::events_t,
+      p7r::connector *) mutable -> p7r::error_t
+  {
+    return p7r::error_t(value++);
+  };
+
+  auto copy = cb;
+  ASSERT_EQ(cb, copy);
+  ASSERT_EQ(cb.hash(), copy.hash());
+
+  ASSERT_EQ(p7r::error_t(3), cb(now, 0, nullptr));
+  ASSERT_EQ(p7r::error_t(4), copy(now, 0, nullptr));
+
+  auto moved = std::move(copy);
+  ASSERT_TRUE(copy.empty());
+  ASSERT_EQ(cb, moved);
+  ASSERT_EQ(p7r::error_t(5), moved(now, 0, nullptr));
+  ASSERT_EQ(p7r::error_t(6), cb(now, 0, nullptr));
+}
+
+
+
+TEST(CallbackMisc, large_capture)
+{
+  // Captures too large for the inline storage are shared between copies.
+  auto now = p7r::clock::now();
+  std::array<char, 2 * p7r::detail::CALLBACK_INLINE_SIZE> payload{};
+  int calls = 0;
+  p7r::callback cb = [payload, calls](p7r::time_point const &,
+      p7r::events_t, p7r::connector *) mutable -> p7r::error_t
+  {
+    return p7r::error_t(payload[0] + calls++);
+  };
+
+  auto copy = cb;
+  ASSERT_EQ(cb, copy);
+  ASSERT_EQ(cb.hash(), copy.hash());
+
+  ASSERT_EQ(p7r::error_t(0), cb(now, 0, nullptr));
+  ASSERT_EQ(p7r::error_t(1), copy(now, 0, nullptr));
+
+  p7r::callback other = [payload](p7r::time_point const &,
+      p7r::events_t, p7r::connector *) -> p7r::error_t
+  {
+    return p7r::error_t(payload[0]);
+  };
+  ASSERT_NE(cb, other);
+
+  cb = other;
+  ASSERT_EQ(cb, other);
+  ASSERT_EQ(p7r::error_t(2), copy(now, 0, nullptr));
+}